@@ -5,9 +5,21 @@
 #include <stdlib.h>
 #include <assert.h>
 
-branch* self = NULL;
-
-uint64_t branchRequest(trace_op* op, int processorNum);
+// State of one branch predictor instance, add your own fields here.
+typedef struct _branch_ctx {
+    branch pub; // Must be first, the instance is passed as a branch*.
+} branch_ctx;
+
+const int CADSS_ABI = CADSS_ABI_VERSION;
+
+static uint64_t branchRequest(branch* b, trace_op* op, int processorNum);
+static int tick(void* b);
+static int64_t idleTicks(void* b);
+static void skipTicks(void* b, int64_t ticks);
+static int finish(void* b, int outFd);
+static int destroy(void* b);
+static int save(void* b, FILE* f);
+static int restore(void* b, FILE* f);
 
 branch* init(branch_sim_args* csa)
 {
@@ -35,17 +47,21 @@ branch* init(branch_sim_args* csa)
         }
     }
 
-    self = malloc(sizeof(branch));
-    self->branchRequest = branchRequest;
-    self->si.tick = tick;
-    self->si.finish = finish;
-    self->si.destroy = destroy;
-
-    return self;
+    branch_ctx* self = calloc(1, sizeof(branch_ctx));
+    self->pub.branchRequest = branchRequest;
+    self->pub.si.tick = tick;
+    self->pub.si.finish = finish;
+    self->pub.si.destroy = destroy;
+    self->pub.si.idleTicks = idleTicks;
+    self->pub.si.skipTicks = skipTicks;
+    self->pub.si.save = save;
+    self->pub.si.restore = restore;
+
+    return &self->pub;
 }
 
 // Given a branch operation, return the predicted PC address
-uint64_t branchRequest(trace_op* op, int processorNum)
+static uint64_t branchRequest(branch* b, trace_op* op, int processorNum)
 {
     assert(op != NULL);
 
@@ -60,18 +76,37 @@ uint64_t branchRequest(trace_op* op, int processorNum)
     return predAddress;
 }
 
-int tick()
+static int tick(void* b)
 {
     return 1;
 }
 
-int finish(int outFd)
+static int64_t idleTicks(void* b)
+{
+    return SIM_IDLE_FOREVER;
+}
+
+static void skipTicks(void* b, int64_t ticks) {}
+
+// Save any predictor state here, so that it survives a checkpoint.
+static int save(void* b, FILE* f)
+{
+    return 0;
+}
+
+static int restore(void* b, FILE* f)
+{
+    return 0;
+}
+
+static int finish(void* b, int outFd)
 {
     return 0;
 }
 
-int destroy(void)
+static int destroy(void* b)
 {
     // free any internally allocated memory here
+    free(b);
     return 0;
 }
@@ -9,7 +9,7 @@ void initCPP()
     std::cout << "INIT\n" << std::endl;
 }
 
-uint64_t branchRequestCPP(trace_op* op, int processorNum)
+uint64_t branchRequestCPP(branch* self, trace_op* op, int processorNum)
 {
     std::cout << "TEST\n" << std::endl;
     return 1;
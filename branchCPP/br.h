@@ -7,7 +7,7 @@ extern "C" {
 #include <branch.h>
 #include <trace.h>
  
-uint64_t branchRequestCPP(trace_op* op, int processorNum);
+uint64_t branchRequestCPP(branch* self, trace_op* op, int processorNum);
 
 void initCPP();
 
@@ -7,9 +7,11 @@
 
 #include "br.h"
 
-branch* self = NULL;
+const int CADSS_ABI = CADSS_ABI_VERSION;
 
-uint64_t branchRequest(trace_op* op, int processorNum);
+static int tick(void* b);
+static int finish(void* b, int outFd);
+static int destroy(void* b);
 
 branch* init(branch_sim_args* csa)
 {
@@ -27,7 +29,7 @@ branch* init(branch_sim_args* csa)
         }
     }
     
-    self = malloc(sizeof(branch));
+    branch* self = calloc(1, sizeof(branch));
     self->branchRequest = branchRequestCPP;
     self->si.tick = tick;
     self->si.finish = finish;
@@ -38,19 +40,20 @@ branch* init(branch_sim_args* csa)
     return self;
 }
 
-int tick()
+static int tick(void* b)
 {
     
     return 1;
 }
 
-int finish(int outFd)
+static int finish(void* b, int outFd)
 {
     return 0;
 }
 
-int destroy(void)
+static int destroy(void* b)
 {
     // free any internally allocated memory here
+    free(b);
     return 0;
 }
@@ -8,84 +8,96 @@
 #include <inttypes.h>
 #include <stdio.h>
 
-// Structure representing the branch predictor
-branch* self = NULL;
+// Structure representing one branch predictor instance
+typedef struct _branch_ctx {
+    branch pub;               // Branch object, must be first
 
-// Simulator parameters
-int predictorSize = 0;    // Log2 of the predictor size
-int bhrSize = 0;          // Size of the Branch History Register (ignored in this implementation)
-int predictorModel = 0;   // Predictor model (only 2-bit predictor is implemented)
-int processorCount = 1;   // Number of processors (currently unused)
+    // Simulator parameters
+    int predictorSize;        // Log2 of the predictor size
+    int bhrSize;              // Size of the Branch History Register (ignored in this implementation)
+    int predictorModel;       // Predictor model (only 2-bit predictor is implemented)
 
-// Predictor data structures
-uint8_t* predictorTable = NULL; // Predictor table of 2-bit saturating counters
+    // Predictor data structures
+    uint8_t* predictorTable;  // Predictor table of 2-bit saturating counters
+} branch_ctx;
+
+const int CADSS_ABI = CADSS_ABI_VERSION;
 
 // Function declarations
-uint64_t branchRequest(trace_op* op, int processorNum);
-int tick();
-int finish(int outFd);
-int destroy(void);
+static uint64_t branchRequest(branch* b, trace_op* op, int processorNum);
+static int tick(void* b);
+static int64_t idleTicks(void* b);
+static void skipTicks(void* b, int64_t ticks);
+static int finish(void* b, int outFd);
+static int destroy(void* b);
+static int save(void* b, FILE* f);
+static int restore(void* b, FILE* f);
 
 // Initialize the branch predictor simulator
 branch* init(branch_sim_args* csa)
 {
     int op;
+    branch_ctx* self = calloc(1, sizeof(branch_ctx));
 
     // Parse command-line arguments
     while ((op = getopt(csa->arg_count, csa->arg_list, "p:s:b:g:")) != -1)
     {
         switch (op)
         {
-            // Processor count (currently unused)
+            // Processor count (unused, the engine provides it)
             case 'p':
-                processorCount = atoi(optarg);
                 break;
 
             // Predictor size (log2 of the number of entries)
             case 's':
-                predictorSize = atoi(optarg);
+                self->predictorSize = atoi(optarg);
                 break;
 
             // BHR size (ignored in this implementation)
             case 'b':
-                bhrSize = atoi(optarg);
+                self->bhrSize = atoi(optarg);
                 break;
 
             // Predictor model (only model 0 is implemented)
             case 'g':
-                predictorModel = atoi(optarg);
+                self->predictorModel = atoi(optarg);
                 break;
         }
     }
 
     // Initialize predictor table
-    int numEntries = 1 << predictorSize;
-    predictorTable = malloc(numEntries * sizeof(uint8_t));
+    int numEntries = 1 << self->predictorSize;
+    self->predictorTable = malloc(numEntries * sizeof(uint8_t));
    
     for (int i = 0; i < numEntries; i++) {
-        predictorTable[i] = 1; // Each counter defaults to state '01' (weakly not taken)
+        self->predictorTable[i] = 1; // Each counter defaults to state '01' (weakly not taken)
     }
 
     // Initialize branch struct
-    self = malloc(sizeof(branch));
-
-    self->branchRequest = branchRequest;
-    self->si.tick = tick;
-    self->si.finish = finish;
-    self->si.destroy = destroy;
-
-    return self;
+    self->pub.branchRequest = branchRequest;
+    self->pub.si.tick = tick;
+    self->pub.si.finish = finish;
+    self->pub.si.destroy = destroy;
+    self->pub.si.idleTicks = idleTicks;
+    self->pub.si.skipTicks = skipTicks;
+    self->pub.si.save = save;
+    self->pub.si.restore = restore;
+
+    return &self->pub;
 }
 
 // Given a branch operation, return the predicted PC address
-uint64_t branchRequest(trace_op* op, int processorNum)
+static uint64_t branchRequest(branch* b, trace_op* op, int processorNum)
 {
+    branch_ctx* self = (branch_ctx*)b;
+    uint8_t* predictorTable = self->predictorTable;
+
     assert(op != NULL);
 
     uint64_t pc = op->pcAddress >> 3; // Ignore the 3 least significant bits
 
     // Calculate index using PC bits
-    uint32_t index = pc & ((1 << predictorSize) - 1);
+    uint32_t index = pc & ((1 << self->predictorSize) - 1);
 
     // Get the counter value from the predictor table
     uint8_t counter = predictorTable[index];
@@ -117,27 +129,59 @@ uint64_t branchRequest(trace_op* op, int processorNum)
     return predAddress;
 }
 
-int tick()
+static int tick(void* b)
 {
     return 1;
 }
 
-int finish(int outFd)
+static int64_t idleTicks(void* b)
+{
+    return SIM_IDLE_FOREVER;
+}
+
+static void skipTicks(void* b, int64_t ticks) {}
+
+// The predictor table, which must be restored into one of the same size
+static int save(void* b, FILE* f)
+{
+    branch_ctx* self = (branch_ctx*)b;
+    int numEntries = 1 << self->predictorSize;
+
+    fwrite(&self->predictorSize, sizeof(int), 1, f);
+    fwrite(self->predictorTable, sizeof(uint8_t), numEntries, f);
+
+    return ferror(f) ? -1 : 0;
+}
+
+static int restore(void* b, FILE* f)
+{
+    branch_ctx* self = (branch_ctx*)b;
+    int numEntries = 1 << self->predictorSize;
+    int predictorSize;
+
+    if (fread(&predictorSize, sizeof(int), 1, f) != 1
+        || predictorSize != self->predictorSize)
+        return -1;
+
+    if (fread(self->predictorTable, sizeof(uint8_t), numEntries, f)
+        != numEntries)
+        return -1;
+
+    return 0;
+}
+
+static int finish(void* b, int outFd)
 {
     return 0;
 }
 
 // Clean up and free allocated memory
-int destroy(void)
+static int destroy(void* b)
 {
+    branch_ctx* self = (branch_ctx*)b;
+
     // Free any internally allocated memory here
-    if (predictorTable != NULL) {
-        free(predictorTable);
-        predictorTable = NULL;
-    }
-    if (self != NULL) {
-        free(self);
-        self = NULL;
-    }
+    free(self->predictorTable);
+    free(self);
     return 0;
-}
\ No newline at end of file
+}
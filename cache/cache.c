@@ -9,20 +9,29 @@
 typedef struct _pendingRequest {
     int64_t tag;
     int8_t procNum;
-    void (*memCallback)(int, int64_t);
+    void* ctx;
+    void (*memCallback)(void*, int, int64_t);
 } pendingRequest;
 
-cache* self = NULL;
-coher* coherComp = NULL;
-
-int processorCount = 1;
-int CADSS_VERBOSE = 0;
-pendingRequest pending = {0};
-int countDown = 0;
-
-void memoryRequest(trace_op* op, int processorNum, int64_t tag,
-                   void (*callback)(int, int64_t));
-void coherCallback(int type, int procNum, int64_t addr);
+// State of one cache instance, add your own fields here.
+typedef struct _cache_ctx {
+    cache pub; // Must be first, the instance is passed as a cache*.
+    coher* coherComp;
+    pendingRequest pending;
+    int countDown;
+} cache_ctx;
+
+const int CADSS_ABI = CADSS_ABI_VERSION;
+
+static void memoryRequest(cache* c, trace_op* op, int processorNum,
+                          int64_t tag, void* ctx,
+                          void (*callback)(void*, int, int64_t));
+static void coherCallback(void* c, int type, int procNum, int64_t addr);
+static int tick(void* c);
+static int64_t idleTicks(void* c);
+static void skipTicks(void* c, int64_t ticks);
+static int finish(void* c, int outFd);
+static int destroy(void* c);
 
 cache* init(cache_sim_args* csa)
 {
@@ -56,28 +65,33 @@ cache* init(cache_sim_args* csa)
         }
     }
 
-    self = malloc(sizeof(cache));
-    self->memoryRequest = memoryRequest;
-    self->si.tick = tick;
-    self->si.finish = finish;
-    self->si.destroy = destroy;
+    cache_ctx* self = calloc(1, sizeof(cache_ctx));
+    self->pub.memoryRequest = memoryRequest;
+    self->pub.si.tick = tick;
+    self->pub.si.finish = finish;
+    self->pub.si.destroy = destroy;
+    self->pub.si.idleTicks = idleTicks;
+    self->pub.si.skipTicks = skipTicks;
 
-    coherComp = csa->coherComp;
-    coherComp->registerCacheInterface(coherCallback);
+    self->coherComp = csa->coherComp;
+    self->coherComp->registerCacheInterface(self->coherComp, self,
+                                            coherCallback);
 
-    return self;
+    return &self->pub;
 }
 
 // This routine is a linkage to the rest of the memory hierarchy
-void coherCallback(int type, int procNum, int64_t addr)
+static void coherCallback(void* c, int type, int procNum, int64_t addr)
 {
+    cache_ctx* self = (cache_ctx*)c;
+
     switch (type)
     {
         case NO_ACTION:
         case DATA_RECV:
             // TODO: check that the addr is the pending access
             //  This indicates that the cache has received data from memory
-            countDown = 1;
+            self->countDown = 1;
             break;
 
         case INVALIDATE:
@@ -89,54 +103,78 @@ void coherCallback(int type, int procNum, int64_t addr)
     }  
 }
 
-void memoryRequest(trace_op* op, int processorNum, int64_t tag,
-                   void (*callback)(int, int64_t))
+static void memoryRequest(cache* c, trace_op* op, int processorNum,
+                          int64_t tag, void* ctx,
+                          void (*callback)(void*, int, int64_t))
 {
+    cache_ctx* self = (cache_ctx*)c;
+    pendingRequest* pending = &self->pending;
+
     assert(op != NULL);
     assert(callback != NULL);
 
     // Simple model to only have one outstanding memory operation
-    if (countDown != 0)
+    if (self->countDown != 0)
     {
-        assert(pending.memCallback != NULL);
-        pending.memCallback(pending.procNum, pending.tag);
+        assert(pending->memCallback != NULL);
+        pending->memCallback(pending->ctx, pending->procNum, pending->tag);
     }
 
-    pending = (pendingRequest){
-        .tag = tag, .procNum = processorNum, .memCallback = callback};
+    *pending = (pendingRequest){.tag = tag,
+                                .procNum = processorNum,
+                                .ctx = ctx,
+                                .memCallback = callback};
 
     // In a real cache simulator, the delay is based
     // on whether the request is a hit or miss.
-    countDown = 2;
+    self->countDown = 2;
     
     // Tell memory about this request
     // TODO: only do this if this is a miss
     // TODO: evictions will also need a call to memory with
     //  invlReq(addr, procNum) -> true if waiting, false if proceed
-    coherComp->permReq(false, op->memAddress, processorNum);
+    self->coherComp->permReq(self->coherComp, false, op->memAddress,
+                             processorNum);
 }
 
-int tick()
+static int tick(void* c)
 {
+    cache_ctx* self = (cache_ctx*)c;
+    pendingRequest* pending = &self->pending;
+
     // Advance ticks in the coherence component.
-    coherComp->si.tick();
+    self->coherComp->si.tick(self->coherComp);
     
-    if (countDown == 1)
+    if (self->countDown == 1)
     {
-        assert(pending.memCallback != NULL);
-        pending.memCallback(pending.procNum, pending.tag);
+        assert(pending->memCallback != NULL);
+        pending->memCallback(pending->ctx, pending->procNum, pending->tag);
     }
 
     return 1;
 }
 
-int finish(int outFd)
+static int64_t idleTicks(void* c)
+{
+    cache_ctx* self = (cache_ctx*)c;
+
+    return (self->countDown == 1) ? 0 : SIM_IDLE_FOREVER;
+}
+
+static void skipTicks(void* c, int64_t ticks) {}
+
+static int finish(void* c, int outFd)
 {
     return 0;
 }
 
-int destroy(void)
+static int destroy(void* c)
 {
+    cache_ctx* self = (cache_ctx*)c;
+    coher* coherComp = self->coherComp;
+
     // free any internally allocated memory here
-    return 0;
+    free(self);
+
+    return coherComp->si.destroy(coherComp);
 }
@@ -6,6 +6,9 @@
 #include <assert.h>
 
 #include <coherence.h>
+#include <events.h>
+#include <probes.h>
+#include <stats.h>
 #include "stree.h"
 
 typedef struct {
@@ -21,47 +24,67 @@ typedef struct {
     cache_line* lines;      // Array of cache lines in the set
 } cache_set;
 
-cache* self = NULL;          // Cache object 
-static cache_set* sets = NULL; // Pointer to the array of cache sets
-static int num_sets = 0;     // Number of sets in the cache
-static int lines_per_set = 0; // Number of lines per set (associativity)
-static int block_size = 0;   // Size of a single cache block
-static int RRPV_bits = 0;    // Number of bits used for RRIP
-static bool use_RRIP = false; // Flag indicating whether RRIP is used
-
-int processorCount = 1;      
-coher* coherComp = NULL;     
-int64_t* pendingTag = NULL;  
-
 // Callback function for memory requests
-typedef void (*memCallbackFunc)(int, int64_t);
-memCallbackFunc* memCallback = NULL;
+typedef void (*memCallbackFunc)(void*, int, int64_t);
 
 typedef struct _pendingRequest {
     int64_t tag;              
     int64_t addr;             
     int processorNum;         
-    void (*callback)(int, int64_t); 
+    void* ctx;
+    memCallbackFunc callback;
     struct _pendingRequest* next; 
 } pendingRequest;
 
-pendingRequest* readyReq = NULL;  // List of ready requests
-pendingRequest* pendReq = NULL;   // List of pending requests
-
-void coherCallback(int type, int processorNum, int64_t addr);
-void memoryRequest(trace_op* op, int processorNum, int64_t tag,
-                   void (*callback)(int, int64_t));
-
-static int get_set_index(uint64_t address) {
-    return (address / block_size) % num_sets; // Extract set index using block size and number of sets
+// State of one cache instance
+typedef struct _cache_ctx {
+    cache pub;                // Cache object, must be first
+    int processorCount;
+    const sim_env* env;       // Where request stages are reported
+    cache_set* sets;          // Pointer to the array of cache sets
+    int num_sets;             // Number of sets in the cache
+    int lines_per_set;        // Number of lines per set (associativity)
+    int block_size;           // Size of a single cache block
+    int RRPV_bits;            // Number of bits used for RRIP
+    bool use_RRIP;            // Flag indicating whether RRIP is used
+    coher* coherComp;
+    pendingRequest* readyReq; // List of ready requests
+    pendingRequest* pendReq;  // List of pending requests
+    void* requestorCtx;       // Given back after a restore
+    memCallbackFunc requestorCallback;
+
+    // Statistics of timed requests, per processor
+    uint64_t* hits;
+    uint64_t* misses;
+    uint64_t* coherMisses;    // Requests that waited on coherence
+    uint64_t evictions;
+} cache_ctx;
+
+const int CADSS_ABI = CADSS_ABI_VERSION;
+
+static void coherCallback(void* c, int type, int processorNum, int64_t addr);
+static void memoryRequest(cache* c, trace_op* op, int processorNum,
+                          int64_t tag, void* ctx, memCallbackFunc callback);
+static void warmRequest(cache* c, trace_op* op, int processorNum);
+static int tick(void* c);
+static int64_t idleTicks(void* c);
+static void skipTicks(void* c, int64_t ticks);
+static int finish(void* c, int outFd);
+static int destroy(void* c);
+static int save(void* c, FILE* f);
+static int restore(void* c, FILE* f);
+static void restoreRequestor(cache* c, void* ctx, memCallbackFunc callback);
+
+static int get_set_index(cache_ctx* self, uint64_t address) {
+    return (address / self->block_size) % self->num_sets; // Extract set index using block size and number of sets
 }
 
-static uint64_t get_tag(uint64_t address) {
-    return address / (block_size * num_sets); // Extract the tag using block size and number of sets
+static uint64_t get_tag(cache_ctx* self, uint64_t address) {
+    return address / (self->block_size * self->num_sets); // Extract the tag using block size and number of sets
 }
 
-static void update_LRU(cache_set* set, int way) {
-    for (int i = 0; i < lines_per_set; i++) {
+static void update_LRU(cache_ctx* self, cache_set* set, int way) {
+    for (int i = 0; i < self->lines_per_set; i++) {
         if (set->lines[i].valid && set->lines[i].LRU_counter < set->lines[way].LRU_counter) {
             set->lines[i].LRU_counter++;  // Increment LRU counters for all valid lines
         }
@@ -69,13 +92,15 @@ static void update_LRU(cache_set* set, int way) {
     set->lines[way].LRU_counter = 0; // Reset LRU counter for the accessed line
 }
 
-static void update_RRIP(cache_set* set, int way, bool hit) {
+static void update_RRIP(cache_ctx* self, cache_set* set, int way, bool hit) {
+    int RRPV_bits = self->RRPV_bits;
+
     if (hit) {
         set->lines[way].RRPV = 0;  // On hit, set RRPV to 0 (frequently accessed)
     } else {
         set->lines[way].RRPV = (1 << (RRPV_bits - 1)) - 1; // On miss, set RRPV to maximum value
         // Increment RRPV for other valid lines
-        for (int i = 0; i < lines_per_set; i++) {
+        for (int i = 0; i < self->lines_per_set; i++) {
             if (i != way && set->lines[i].valid && set->lines[i].RRPV < ((1 << RRPV_bits) - 1)) {
                 set->lines[i].RRPV++;
             }
@@ -83,8 +108,11 @@ static void update_RRIP(cache_set* set, int way, bool hit) {
     }
 }
 
-static int find_victim(cache_set* set) {
-    if (use_RRIP) {  // If RRIP is used
+static int find_victim(cache_ctx* self, cache_set* set) {
+    int lines_per_set = self->lines_per_set;
+
+    if (self->use_RRIP) {  // If RRIP is used
+        int RRPV_bits = self->RRPV_bits;
         while (1) {
             // Look for a line with the highest RRPV
             for (int i = 0; i < lines_per_set; i++) {
@@ -119,6 +147,7 @@ static int find_victim(cache_set* set) {
 cache* init(cache_sim_args* csa) {
     int opt;
     int s = 0, E = 0, b = 0, R = 0;
+    bool use_RRIP = false;
 
     while ((opt = getopt(csa->arg_count, csa->arg_list, "E:s:b:R:")) != -1) {
         switch (opt) {
@@ -138,53 +167,64 @@ cache* init(cache_sim_args* csa) {
         }
     }
 
-    num_sets = 1 << s;       // Number of sets in the cache
-    lines_per_set = E;       // Lines per set (associativity)
-    block_size = 1 << b;     // Size of each cache block
-    RRPV_bits = R;           // Number of bits for RRIP
+    // Allocate and initialize the cache object
+    cache_ctx* self = calloc(1, sizeof(cache_ctx));
+    self->processorCount = csa->env->processorCount;
+    self->env = csa->env;
+    self->num_sets = 1 << s;       // Number of sets in the cache
+    self->lines_per_set = E;       // Lines per set (associativity)
+    self->block_size = 1 << b;     // Size of each cache block
+    self->RRPV_bits = R;           // Number of bits for RRIP
+    self->use_RRIP = use_RRIP;
 
     // Allocate memory for cache sets and lines
-    sets = calloc(num_sets, sizeof(cache_set));
-    for (int i = 0; i < num_sets; i++) {
-        sets[i].lines = calloc(lines_per_set, sizeof(cache_line));
-        for (int j = 0; j < lines_per_set; j++) {
-            sets[i].lines[j].data = calloc(block_size, sizeof(uint8_t));  // Allocate space for cache line data
+    self->sets = calloc(self->num_sets, sizeof(cache_set));
+    for (int i = 0; i < self->num_sets; i++) {
+        self->sets[i].lines = calloc(self->lines_per_set, sizeof(cache_line));
+        for (int j = 0; j < self->lines_per_set; j++) {
+            self->sets[i].lines[j].data = calloc(self->block_size, sizeof(uint8_t));  // Allocate space for cache line data
         }
     }
 
-    // Allocate and initialize the cache object
-    self = malloc(sizeof(cache));
-    self->memoryRequest = memoryRequest;
-    self->si.tick = tick;
-    self->si.finish = finish;
-    self->si.destroy = destroy;
-
-    coherComp = csa->coherComp;
-    coherComp->registerCacheInterface(coherCallback);
-
-    memCallback = calloc(processorCount, sizeof(memCallbackFunc));
-    pendingTag = calloc(processorCount, sizeof(int));
-
-    return self;  // Return the initialized cache object
+    self->pub.memoryRequest = memoryRequest;
+    self->pub.warmRequest = warmRequest;
+    self->pub.restoreRequestor = restoreRequestor;
+    self->pub.si.tick = tick;
+    self->pub.si.finish = finish;
+    self->pub.si.destroy = destroy;
+    self->pub.si.idleTicks = idleTicks;
+    self->pub.si.skipTicks = skipTicks;
+    self->pub.si.save = save;
+    self->pub.si.restore = restore;
+
+    self->hits = calloc(self->processorCount, sizeof(uint64_t));
+    self->misses = calloc(self->processorCount, sizeof(uint64_t));
+    self->coherMisses = calloc(self->processorCount, sizeof(uint64_t));
+    statsVector(csa->env, "cache.hits", self->hits, self->processorCount);
+    statsVector(csa->env, "cache.misses", self->misses, self->processorCount);
+    statsVector(csa->env, "cache.coherMisses", self->coherMisses,
+                self->processorCount);
+    statsCounter(csa->env, "cache.evictions", &self->evictions);
+
+    self->coherComp = csa->coherComp;
+    self->coherComp->registerCacheInterface(self->coherComp, self, coherCallback);
+
+    return &self->pub;  // Return the initialized cache object
 }
 
-// Function to handle memory requests
-void memoryRequest(trace_op* op, int processorNum, int64_t tag,
-                   void (*callback)(int, int64_t)) {
-    assert(op != NULL);
-    assert(callback != NULL);
-
-    // Calculate the address aligned to the block size
-    uint64_t addr = (op->memAddress & ~(block_size - 1));
-    int set_index = get_set_index(addr);    // Get the cache set index
-    uint64_t cache_tag = get_tag(addr);     // Get the cache tag
-    cache_set* set = &sets[set_index];      // Get the cache set
+// Look up the block of addr, filling it on a miss, and update the
+// replacement state.  Returns whether it hit, and sets *evicted if a valid
+// line was replaced.
+static bool access_block(cache_ctx* self, uint64_t addr, bool* evicted) {
+    int set_index = get_set_index(self, addr);  // Get the cache set index
+    uint64_t cache_tag = get_tag(self, addr);   // Get the cache tag
+    cache_set* set = &self->sets[set_index];    // Get the cache set
 
     bool hit = false;
     int way;
 
     // Check for cache hit by comparing tags
-    for (way = 0; way < lines_per_set; way++) {
+    for (way = 0; way < self->lines_per_set; way++) {
         if (set->lines[way].valid && set->lines[way].tag == cache_tag) {
             hit = true;  // Cache hit found
             break;
@@ -193,64 +233,113 @@ void memoryRequest(trace_op* op, int processorNum, int64_t tag,
 
     if (hit) {
         // Update the replacement policy on cache hit
-        if (use_RRIP) {
-            update_RRIP(set, way, true);   // Update RRIP on hit
+        if (self->use_RRIP) {
+            update_RRIP(self, set, way, true);   // Update RRIP on hit
         } else {
-            update_LRU(set, way);          // Update LRU on hit
+            update_LRU(self, set, way);          // Update LRU on hit
         }
     } else {
         // On a cache miss, find a victim to evict
-        int evict_way = find_victim(set);
+        int evict_way = find_victim(self, set);
+        *evicted = set->lines[evict_way].valid;
+        if (*evicted) {
+            uint64_t victim = (set->lines[evict_way].tag * self->num_sets + set_index)
+                              * self->block_size;
+            CADSS_PROBE2(cache_evict, victim, addr);
+        }
         set->lines[evict_way].valid = true;  // Mark the victim line as valid
         set->lines[evict_way].tag = cache_tag; // Update the tag for the new block
-        if (use_RRIP) {
-            update_RRIP(set, evict_way, false); // Update RRIP on miss
+        if (self->use_RRIP) {
+            update_RRIP(self, set, evict_way, false); // Update RRIP on miss
         } else {
-            update_LRU(set, evict_way);        // Update LRU on miss
+            update_LRU(self, set, evict_way);        // Update LRU on miss
         }
     }
 
-    uint8_t perm = coherComp->permReq((op->op == MEM_LOAD), addr, processorNum);
+    return hit;
+}
+
+// Function to handle memory requests
+static void memoryRequest(cache* c, trace_op* op, int processorNum,
+                          int64_t tag, void* ctx, memCallbackFunc callback) {
+    cache_ctx* self = (cache_ctx*)c;
+    assert(op != NULL);
+    assert(callback != NULL);
+
+    // Calculate the address aligned to the block size
+    uint64_t addr = (op->memAddress & ~(self->block_size - 1));
+    bool evicted = false;
+    if (access_block(self, addr, &evicted)) {
+        self->hits[processorNum]++;
+        eventsReport(self->env, REQ_HIT, processorNum, addr, tag);
+    } else {
+        self->misses[processorNum]++;
+        self->evictions += evicted;
+        CADSS_PROBE2(cache_miss, processorNum, addr);
+        eventsReport(self->env, REQ_MISS, processorNum, addr, tag);
+    }
+
+    coher* coherComp = self->coherComp;
+    eventsReport(self->env, REQ_PERM, processorNum, addr, tag);
+    uint8_t perm = coherComp->permReq(coherComp, (op->op == MEM_LOAD), addr, processorNum);
+    if (perm != 1) {
+        self->coherMisses[processorNum]++;
+    }
 
     pendingRequest* pr = malloc(sizeof(pendingRequest));
     pr->tag = tag;
     pr->addr = addr;
+    pr->ctx = ctx;
     pr->callback = callback;
     pr->processorNum = processorNum;
 
     if (perm == 1) {  // If permission is granted, add to the ready request queue
-        pr->next = readyReq;
-        readyReq = pr;
+        pr->next = self->readyReq;
+        self->readyReq = pr;
     } else {  // Otherwise, add to the pending request queue
-        pr->next = pendReq;
-        pendReq = pr;
+        pr->next = self->pendReq;
+        self->pendReq = pr;
     }
 }
 
-void coherCallback(int type, int processorNum, int64_t addr) {
-    assert(pendReq != NULL);   // Ensure there are pending requests
-    assert(processorNum < processorCount);
+// Same lookup as a memory request, but the coherence state is set at once
+static void warmRequest(cache* c, trace_op* op, int processorNum) {
+    cache_ctx* self = (cache_ctx*)c;
+    uint64_t addr = (op->memAddress & ~(self->block_size - 1));
+    bool evicted = false;
+
+    access_block(self, addr, &evicted);
+
+    coher* coherComp = self->coherComp;
+    if (coherComp->warmReq != NULL)
+        coherComp->warmReq(coherComp, (op->op == MEM_LOAD), addr, processorNum);
+}
+
+static void coherCallback(void* c, int type, int processorNum, int64_t addr) {
+    cache_ctx* self = (cache_ctx*)c;
+    assert(processorNum < self->processorCount);
 
     // Only process data receive events
     if (type != DATA_RECV)
         return;
+    assert(self->pendReq != NULL);   // Ensure there are pending requests
 
     // Check if the address matches the pending request
-    if (pendReq->processorNum == processorNum && pendReq->addr == addr) {
-        pendingRequest* pr = pendReq;
-        pendReq = pendReq->next;
-        pr->next = readyReq;
-        readyReq = pr;  // Move the request to the ready queue
+    if (self->pendReq->processorNum == processorNum && self->pendReq->addr == addr) {
+        pendingRequest* pr = self->pendReq;
+        self->pendReq = self->pendReq->next;
+        pr->next = self->readyReq;
+        self->readyReq = pr;  // Move the request to the ready queue
     } else {
-        pendingRequest* prevReq = pendReq;
-        pendingRequest* pr = pendReq->next;
+        pendingRequest* prevReq = self->pendReq;
+        pendingRequest* pr = self->pendReq->next;
 
         // Search the pending request list for a matching request
         while (pr != NULL) {
             if (pr->processorNum == processorNum && pr->addr == addr) {
                 prevReq->next = pr->next;
-                pr->next = readyReq;
-                readyReq = pr;  // Move the matching request to the ready queue
+                pr->next = self->readyReq;
+                self->readyReq = pr;  // Move the matching request to the ready queue
                 break;
             }
             pr = pr->next;
@@ -261,38 +350,181 @@ void coherCallback(int type, int processorNum, int64_t addr) {
     }
 }
 
-int tick() {
-    coherComp->si.tick();  
+static int tick(void* c) {
+    cache_ctx* self = (cache_ctx*)c;
+    self->coherComp->si.tick(self->coherComp);  
 
     // Process ready requests
-    pendingRequest* pr = readyReq;
+    pendingRequest* pr = self->readyReq;
     while (pr != NULL) {
         pendingRequest* t = pr;
-        pr->callback(pr->processorNum, pr->tag);  // Execute the callback for each request
+        pr->callback(pr->ctx, pr->processorNum, pr->tag);  // Execute the callback for each request
         pr = pr->next;
         free(t);  
     }
-    readyReq = NULL;  // Clear the ready queue
+    self->readyReq = NULL;  // Clear the ready queue
 
     return 1;
 }
 
-int finish(int outFd) {
+static int64_t idleTicks(void* c) {
+    cache_ctx* self = (cache_ctx*)c;
+
+    // Completed requests are delivered on the next tick.
+    return (self->readyReq != NULL) ? 0 : SIM_IDLE_FOREVER;
+}
+
+static void skipTicks(void* c, int64_t ticks) {
+}
+
+// Cache geometry, which must match when restoring
+typedef struct {
+    int num_sets;
+    int lines_per_set;
+    int block_size;
+    int RRPV_bits;
+} cache_geometry;
+
+// A request in flight, without its callback into the processor
+typedef struct {
+    int64_t tag;
+    int64_t addr;
+    int32_t processorNum;
+} saved_request;
+
+static void saveRequests(pendingRequest* list, FILE* f) {
+    int32_t count = 0;
+    for (pendingRequest* pr = list; pr != NULL; pr = pr->next)
+        count++;
+    fwrite(&count, sizeof(count), 1, f);
+
+    for (pendingRequest* pr = list; pr != NULL; pr = pr->next) {
+        saved_request sr = {pr->tag, pr->addr, pr->processorNum};
+        fwrite(&sr, sizeof(sr), 1, f);
+    }
+}
+
+// Read back a list in its saved order, bound to the requestor
+static int restoreRequests(cache_ctx* self, pendingRequest** list, FILE* f) {
+    int32_t count;
+    if (fread(&count, sizeof(count), 1, f) != 1)
+        return -1;
+
+    pendingRequest** tail = list;
+    for (int32_t i = 0; i < count; i++) {
+        saved_request sr;
+        if (fread(&sr, sizeof(sr), 1, f) != 1)
+            return -1;
+
+        pendingRequest* pr = malloc(sizeof(pendingRequest));
+        pr->tag = sr.tag;
+        pr->addr = sr.addr;
+        pr->processorNum = sr.processorNum;
+        pr->ctx = self->requestorCtx;
+        pr->callback = self->requestorCallback;
+        pr->next = NULL;
+        *tail = pr;
+        tail = &pr->next;
+    }
+
     return 0;
 }
 
-int destroy(void) {
-    // Free the memory allocated for cache sets and lines
-    for (int i = 0; i < num_sets; i++) {
-        for (int j = 0; j < lines_per_set; j++) {
-            free(sets[i].lines[j].data);  // Free data for each cache line
+static int save(void* c, FILE* f) {
+    cache_ctx* self = (cache_ctx*)c;
+
+    saveRequests(self->readyReq, f);
+    saveRequests(self->pendReq, f);
+
+    cache_geometry g = {self->num_sets, self->lines_per_set, self->block_size,
+                        self->RRPV_bits};
+    fwrite(&g, sizeof(g), 1, f);
+
+    for (int i = 0; i < self->num_sets; i++) {
+        for (int j = 0; j < self->lines_per_set; j++) {
+            cache_line* line = &self->sets[i].lines[j];
+            fwrite(&line->valid, sizeof(line->valid), 1, f);
+            fwrite(&line->dirty, sizeof(line->dirty), 1, f);
+            fwrite(&line->tag, sizeof(line->tag), 1, f);
+            fwrite(&line->LRU_counter, sizeof(line->LRU_counter), 1, f);
+            fwrite(&line->RRPV, sizeof(line->RRPV), 1, f);
+            fwrite(line->data, sizeof(uint8_t), self->block_size, f);
+        }
+    }
+
+    return ferror(f) ? -1 : 0;
+}
+
+static int restore(void* c, FILE* f) {
+    cache_ctx* self = (cache_ctx*)c;
+    cache_geometry g;
+
+    if (restoreRequests(self, &self->readyReq, f) != 0
+        || restoreRequests(self, &self->pendReq, f) != 0)
+        return -1;
+
+    if (fread(&g, sizeof(g), 1, f) != 1 || g.num_sets != self->num_sets
+        || g.lines_per_set != self->lines_per_set
+        || g.block_size != self->block_size || g.RRPV_bits != self->RRPV_bits) {
+        fprintf(stderr, "Checkpoint is for a different cache geometry\n");
+        return -1;
+    }
+
+    for (int i = 0; i < self->num_sets; i++) {
+        for (int j = 0; j < self->lines_per_set; j++) {
+            cache_line* line = &self->sets[i].lines[j];
+            if (fread(&line->valid, sizeof(line->valid), 1, f) != 1
+                || fread(&line->dirty, sizeof(line->dirty), 1, f) != 1
+                || fread(&line->tag, sizeof(line->tag), 1, f) != 1
+                || fread(&line->LRU_counter, sizeof(line->LRU_counter), 1, f) != 1
+                || fread(&line->RRPV, sizeof(line->RRPV), 1, f) != 1
+                || fread(line->data, sizeof(uint8_t), self->block_size, f)
+                       != self->block_size)
+                return -1;
         }
-        free(sets[i].lines);  // Free the cache lines array for each set
     }
-    free(sets);  // Free the cache sets array
 
-    free(memCallback);  // Free the memory for memory callback functions
-    free(pendingTag);   // Free the memory for pending tags
-    free(self);         // Free the cache object itself
     return 0;
-}
\ No newline at end of file
+}
+
+// The processor restores after the cache, so rebind what restore read back
+static void restoreRequestor(cache* c, void* ctx, memCallbackFunc callback) {
+    cache_ctx* self = (cache_ctx*)c;
+
+    self->requestorCtx = ctx;
+    self->requestorCallback = callback;
+    for (pendingRequest* pr = self->readyReq; pr != NULL; pr = pr->next) {
+        pr->ctx = ctx;
+        pr->callback = callback;
+    }
+    for (pendingRequest* pr = self->pendReq; pr != NULL; pr = pr->next) {
+        pr->ctx = ctx;
+        pr->callback = callback;
+    }
+}
+
+static int finish(void* c, int outFd) {
+    return 0;
+}
+
+static int destroy(void* c) {
+    cache_ctx* self = (cache_ctx*)c;
+
+    // Free the memory allocated for cache sets and lines
+    for (int i = 0; i < self->num_sets; i++) {
+        for (int j = 0; j < self->lines_per_set; j++) {
+            free(self->sets[i].lines[j].data);  // Free data for each cache line
+        }
+        free(self->sets[i].lines);  // Free the cache lines array for each set
+    }
+    free(self->sets);  // Free the cache sets array
+    free(self->hits);
+    free(self->misses);
+    free(self->coherMisses);
+
+    coher* coherComp = self->coherComp;
+    free(self);        // Free the cache object itself
+
+    // The cache destroys the coherence component that it uses in turn
+    return coherComp->si.destroy(coherComp);
+}
@@ -1,10 +1,11 @@
 #ifndef COHER_INTERNAL_H
 #define COHER_INTERNAL_H
 
+#include <coherence.h>
 #include <interconnect.h>
 #include <stdio.h>
 
-extern interconn* inter_sim;
+#include "stree.h"
 
 typedef enum _coherence_states
 {
@@ -23,11 +24,24 @@ typedef enum _coherence_scheme
     MESIF
 } coherence_scheme;
 
+typedef void (*cacheCallbackFunc)(void*, int, int, int64_t);
+
+// State of one coherence instance.
+typedef struct _coher_ctx {
+    coher pub; // Must be first, the instance is passed as a coher*.
+    int processorCount;
+    coherence_scheme cs;
+    tree_t** coherStates;
+    interconn* inter_sim;
+    void* cacheCtx;
+    cacheCallbackFunc cacheCallback;
+} coher_ctx;
+
 coherence_states
-cacheMI(uint8_t is_read, uint8_t* permAvail, coherence_states currentState,
-        uint64_t addr, int procNum);
+cacheMI(coher_ctx* self, uint8_t is_read, uint8_t* permAvail,
+        coherence_states currentState, uint64_t addr, int procNum);
 coherence_states
-snoopMI(bus_req_type reqType, cache_action* ca, coherence_states currentState,
-        uint64_t addr, int procNum);
+snoopMI(coher_ctx* self, bus_req_type reqType, cache_action* ca,
+        coherence_states currentState, uint64_t addr, int procNum);
 
 #endif
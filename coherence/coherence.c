@@ -1,28 +1,36 @@
 #include <coherence.h>
 #include <trace.h>
 #include <getopt.h>
+#include <probes.h>
 #include "coher_internal.h"
 
 #include "stree.h"
 
-typedef void (*cacheCallbackFunc)(int, int, int64_t);
-
-tree_t** coherStates = NULL;
-int processorCount = 1;
-int CADSS_VERBOSE = 0;
-coherence_scheme cs = MI;
-coher* self = NULL;
-interconn* inter_sim = NULL;
-cacheCallbackFunc cacheCallback = NULL;
-
-uint8_t busReq(bus_req_type reqType, uint64_t addr, int processorNum);
-uint8_t permReq(uint8_t is_read, uint64_t addr, int processorNum);
-uint8_t invlReq(uint64_t addr, int processorNum);
-void registerCacheInterface(void (*callback)(int, int, int64_t));
+const int CADSS_ABI = CADSS_ABI_VERSION;
+
+static uint8_t busReq(coher* c, bus_req_type reqType, uint64_t addr,
+                      int processorNum);
+static uint8_t permReq(coher* c, uint8_t is_read, uint64_t addr,
+                       int processorNum);
+static uint8_t invlReq(coher* c, uint64_t addr, int processorNum);
+static void warmReq(coher* c, uint8_t is_read, uint64_t addr,
+                    int processorNum);
+static const char* stateName(coher* c, uint64_t addr, int processorNum);
+static void registerCacheInterface(coher* c, void* ctx,
+                                   void (*callback)(void*, int, int, int64_t));
+static int tick(void* c);
+static int64_t idleTicks(void* c);
+static void skipTicks(void* c, int64_t ticks);
+static int finish(void* c, int outFd);
+static int destroy(void* c);
+static int save(void* c, FILE* f);
+static int restore(void* c, FILE* f);
 
 coher* init(coher_sim_args* csa)
 {
     int op;
+    coherence_scheme cs = MI;
+    int processorCount = csa->env->processorCount;
 
     while ((op = getopt(csa->arg_count, csa->arg_list, "s:")) != -1)
     {
@@ -42,64 +50,96 @@ coher* init(coher_sim_args* csa)
         return NULL;
     }
 
-    coherStates = malloc(sizeof(tree_t*) * processorCount);
+    coher_ctx* self = calloc(1, sizeof(coher_ctx));
+    self->processorCount = processorCount;
+    self->cs = cs;
+
+    self->coherStates = malloc(sizeof(tree_t*) * processorCount);
     for (int i = 0; i < processorCount; i++)
     {
-        coherStates[i] = tree_new();
+        self->coherStates[i] = tree_new();
     }
 
-    inter_sim = csa->inter;
-
-    self = malloc(sizeof(coher));
-    self->si.tick = tick;
-    self->si.finish = finish;
-    self->si.destroy = destroy;
-    self->permReq = permReq;
-    self->busReq = busReq;
-    self->invlReq = invlReq;
-    self->registerCacheInterface = registerCacheInterface;
-
-    inter_sim->registerCoher(self);
-
-    return self;
+    self->inter_sim = csa->inter;
+
+    self->pub.si.tick = tick;
+    self->pub.si.finish = finish;
+    self->pub.si.destroy = destroy;
+    self->pub.si.idleTicks = idleTicks;
+    self->pub.si.skipTicks = skipTicks;
+    self->pub.si.save = save;
+    self->pub.si.restore = restore;
+    self->pub.permReq = permReq;
+    self->pub.busReq = busReq;
+    self->pub.invlReq = invlReq;
+    self->pub.warmReq = warmReq;
+    self->pub.stateName = stateName;
+    self->pub.registerCacheInterface = registerCacheInterface;
+
+    self->inter_sim->registerCoher(self->inter_sim, &self->pub);
+
+    return &self->pub;
 }
 
-void registerCacheInterface(void (*callback)(int, int, int64_t))
+static void registerCacheInterface(coher* c, void* ctx,
+                                   void (*callback)(void*, int, int, int64_t))
 {
-    cacheCallback = callback;
+    coher_ctx* self = (coher_ctx*)c;
+
+    self->cacheCtx = ctx;
+    self->cacheCallback = callback;
 }
 
-coherence_states getState(uint64_t addr, int processorNum)
+static coherence_states getState(coher_ctx* self, uint64_t addr,
+                                 int processorNum)
 {
-    coherence_states lookState
-        = (coherence_states)tree_find(coherStates[processorNum], addr);
+    coherence_states lookState = (coherence_states)tree_find(
+        self->coherStates[processorNum], addr);
     if (lookState == UNDEF)
         return INVALID;
 
     return lookState;
 }
 
-void setState(uint64_t addr, int processorNum, coherence_states nextState)
+static const char* stateNames[] = {
+    [UNDEF] = "Undefined",
+    [MODIFIED] = "Modified",
+    [INVALID] = "Invalid",
+    [INVALID_MODIFIED] = "Invalid->Modified",
+};
+
+static const char* stateName(coher* c, uint64_t addr, int processorNum)
+{
+    coher_ctx* self = (coher_ctx*)c;
+
+    return stateNames[getState(self, addr, processorNum)];
+}
+
+static void setState(coher_ctx* self, uint64_t addr, int processorNum,
+                     coherence_states nextState)
 {
-    tree_insert(coherStates[processorNum], addr, (void*)nextState);
+    tree_insert(self->coherStates[processorNum], addr, (void*)nextState);
 }
 
-uint8_t busReq(bus_req_type reqType, uint64_t addr, int processorNum)
+static uint8_t busReq(coher* c, bus_req_type reqType, uint64_t addr,
+                      int processorNum)
 {
-    if (processorNum < 0 || processorNum >= processorCount)
+    coher_ctx* self = (coher_ctx*)c;
+
+    if (processorNum < 0 || processorNum >= self->processorCount)
     {
         // ERROR
     }
 
-    coherence_states currentState = getState(addr, processorNum);
+    coherence_states currentState = getState(self, addr, processorNum);
     coherence_states nextState;
     cache_action ca;
 
-    switch (cs)
+    switch (self->cs)
     {
         case MI:
-            nextState
-                = snoopMI(reqType, &ca, currentState, addr, processorNum);
+            nextState = snoopMI(self, reqType, &ca, currentState, addr,
+                                processorNum);
             break;
         case MSI:
             // TODO: Implement this.
@@ -114,7 +154,7 @@ uint8_t busReq(bus_req_type reqType, uint64_t addr, int processorNum)
             // TODO: Implement this.
             break;
         default:
-            fprintf(stderr, "Undefined coherence scheme - %d\n", cs);
+            fprintf(stderr, "Undefined coherence scheme - %d\n", self->cs);
             break;
     }
 
@@ -123,45 +163,51 @@ uint8_t busReq(bus_req_type reqType, uint64_t addr, int processorNum)
         case DATA_RECV:
         case INVALIDATE:
         case NO_ACTION:
-            cacheCallback(ca, processorNum, addr);
+            self->cacheCallback(self->cacheCtx, ca, processorNum, addr);
             break;
 
         default:
             assert(0);
     }
 
+    if (nextState != currentState)
+        CADSS_PROBE4(coher_state, processorNum, addr, currentState, nextState);
+
     // If the destination state is invalid, that is an implicit
     // state and does not need to be stored in the tree.
     if (nextState == INVALID)
     {
         if (currentState != INVALID)
         {
-            tree_remove(coherStates[processorNum], addr);
+            tree_remove(self->coherStates[processorNum], addr);
         }
     }
     else
     {
-        setState(addr, processorNum, nextState);
+        setState(self, addr, processorNum, nextState);
     }
 
     return 0;
 }
 
-uint8_t permReq(uint8_t is_read, uint64_t addr, int processorNum)
+static uint8_t permReq(coher* c, uint8_t is_read, uint64_t addr,
+                       int processorNum)
 {
-    if (processorNum < 0 || processorNum >= processorCount)
+    coher_ctx* self = (coher_ctx*)c;
+
+    if (processorNum < 0 || processorNum >= self->processorCount)
     {
         // ERROR
     }
 
-    coherence_states currentState = getState(addr, processorNum);
+    coherence_states currentState = getState(self, addr, processorNum);
     coherence_states nextState;
     uint8_t permAvail = 0;
 
-    switch (cs)
+    switch (self->cs)
     {
         case MI:
-            nextState = cacheMI(is_read, &permAvail, currentState, addr,
+            nextState = cacheMI(self, is_read, &permAvail, currentState, addr,
                                 processorNum);
             break;
 
@@ -182,36 +228,41 @@ uint8_t permReq(uint8_t is_read, uint64_t addr, int processorNum)
             break;
 
         default:
-            fprintf(stderr, "Undefined coherence scheme - %d\n", cs);
+            fprintf(stderr, "Undefined coherence scheme - %d\n", self->cs);
             break;
     }
 
-    setState(addr, processorNum, nextState);
+    if (nextState != currentState)
+        CADSS_PROBE4(coher_state, processorNum, addr, currentState, nextState);
+
+    setState(self, addr, processorNum, nextState);
     return permAvail;
 }
 
-uint8_t invlReq(uint64_t addr, int processorNum)
+static uint8_t invlReq(coher* c, uint64_t addr, int processorNum)
 {
+    coher_ctx* self = (coher_ctx*)c;
     coherence_states currentState, nextState = INVALID;
     cache_action ca;
     uint8_t flush;
 
-    if (processorNum < 0 || processorNum >= processorCount)
+    if (processorNum < 0 || processorNum >= self->processorCount)
     {
         // ERROR
     }
 
-    currentState = getState(addr, processorNum);
+    currentState = getState(self, addr, processorNum);
 	//printf("%d - %d - %p\n", processorNum, currentState, addr);
 
     flush = 0;
-    switch (cs)
+    switch (self->cs)
     {
         case MI:
             nextState = INVALID;
             if (currentState != INVALID)
             {
-                inter_sim->busReq(DATA, addr, processorNum);
+                self->inter_sim->busReq(self->inter_sim, DATA, addr,
+                                        processorNum);
                 flush = 1;
             }
             break;
@@ -232,29 +283,155 @@ uint8_t invlReq(uint64_t addr, int processorNum)
             break;
 
         default:
-            fprintf(stderr, "Undefined coherence scheme - %d\n", cs);
+            fprintf(stderr, "Undefined coherence scheme - %d\n", self->cs);
             break;
     }
 
-    tree_remove(coherStates[processorNum], addr);
+    if (currentState != INVALID)
+        CADSS_PROBE4(coher_state, processorNum, addr, currentState, INVALID);
+    tree_remove(self->coherStates[processorNum], addr);
 
     // Notify about "permReqOnFlush".
     return flush;
 }
 
-int tick()
+static void warmReq(coher* c, uint8_t is_read, uint64_t addr,
+                    int processorNum)
+{
+    coher_ctx* self = (coher_ctx*)c;
+
+    switch (self->cs)
+    {
+        case MI:
+            // Any access leaves the line modified in this cache alone.
+            for (int i = 0; i < self->processorCount; i++)
+            {
+                if (i != processorNum && getState(self, addr, i) != INVALID)
+                    tree_remove(self->coherStates[i], addr);
+            }
+            setState(self, addr, processorNum, MODIFIED);
+            break;
+
+        case MSI:
+            // TODO: Implement this.
+            break;
+        case MESI:
+            // TODO: Implement this.
+            break;
+
+        case MOESI:
+            // TODO: Implement this.
+            break;
+
+        case MESIF:
+            // TODO: Implement this.
+            break;
+
+        default:
+            fprintf(stderr, "Undefined coherence scheme - %d\n", self->cs);
+            break;
+    }
+}
+
+static int tick(void* c)
+{
+    coher_ctx* self = (coher_ctx*)c;
+
+    return self->inter_sim->si.tick(self->inter_sim);
+}
+
+// Coherence state only changes on requests, so it never needs a tick.
+static int64_t idleTicks(void* c)
+{
+    return SIM_IDLE_FOREVER;
+}
+
+static void skipTicks(void* c, int64_t ticks) {}
+
+// Each saved line is its address and state.
+typedef struct _saved_state {
+    int64_t addr;
+    int32_t state;
+} saved_state;
+
+static void saveTree(node_t* n, FILE* f)
+{
+    if (n == NULL)
+        return;
+
+    saved_state ss = {n->key, (coherence_states)(intptr_t)n->record};
+    fwrite(&ss, sizeof(ss), 1, f);
+
+    saveTree(n->left, f);
+    saveTree(n->right, f);
+}
+
+// The state of every line in each processor's tree.  Lines are inserted
+//   again on restore, which may give the trees a different shape.
+static int save(void* c, FILE* f)
+{
+    coher_ctx* self = (coher_ctx*)c;
+
+    fwrite(&self->processorCount, sizeof(int), 1, f);
+    fwrite(&self->cs, sizeof(self->cs), 1, f);
+    for (int i = 0; i < self->processorCount; i++)
+    {
+        uint64_t count = self->coherStates[i]->node_count;
+        fwrite(&count, sizeof(count), 1, f);
+        saveTree(self->coherStates[i]->root, f);
+    }
+
+    return ferror(f) ? -1 : 0;
+}
+
+static int restore(void* c, FILE* f)
 {
-    return inter_sim->si.tick();
+    coher_ctx* self = (coher_ctx*)c;
+    int processorCount;
+    coherence_scheme cs;
+
+    if (fread(&processorCount, sizeof(int), 1, f) != 1
+        || fread(&cs, sizeof(cs), 1, f) != 1
+        || processorCount != self->processorCount || cs != self->cs)
+        return -1;
+
+    for (int i = 0; i < self->processorCount; i++)
+    {
+        uint64_t count;
+        if (fread(&count, sizeof(count), 1, f) != 1)
+            return -1;
+
+        for (uint64_t j = 0; j < count; j++)
+        {
+            saved_state ss;
+            if (fread(&ss, sizeof(ss), 1, f) != 1)
+                return -1;
+
+            setState(self, ss.addr, i, ss.state);
+        }
+    }
+
+    return 0;
 }
 
-int finish(int outFd)
+static int finish(void* c, int outFd)
 {
-    return inter_sim->si.finish(outFd);
+    coher_ctx* self = (coher_ctx*)c;
+
+    return self->inter_sim->si.finish(self->inter_sim, outFd);
 }
 
-int destroy(void)
+static int destroy(void* c)
 {
-    // TODO
+    coher_ctx* self = (coher_ctx*)c;
+    interconn* inter_sim = self->inter_sim;
+
+    for (int i = 0; i < self->processorCount; i++)
+    {
+        tree_free(self->coherStates[i], NULL);
+    }
+    free(self->coherStates);
+    free(self);
 
-    return inter_sim->si.destroy();
+    return inter_sim->si.destroy(inter_sim);
 }
@@ -1,34 +1,34 @@
 #include "coher_internal.h"
 
-void sendBusRd(uint64_t addr, int procNum)
+void sendBusRd(coher_ctx* self, uint64_t addr, int procNum)
 {
-    inter_sim->busReq(BUSRD, addr, procNum);
+    self->inter_sim->busReq(self->inter_sim, BUSRD, addr, procNum);
 }
 
-void sendBusWr(uint64_t addr, int procNum)
+void sendBusWr(coher_ctx* self, uint64_t addr, int procNum)
 {
-    inter_sim->busReq(BUSWR, addr, procNum);
+    self->inter_sim->busReq(self->inter_sim, BUSWR, addr, procNum);
 }
 
-void sendData(uint64_t addr, int procNum)
+void sendData(coher_ctx* self, uint64_t addr, int procNum)
 {
-    inter_sim->busReq(DATA, addr, procNum);
+    self->inter_sim->busReq(self->inter_sim, DATA, addr, procNum);
 }
 
-void indicateShared(uint64_t addr, int procNum)
+void indicateShared(coher_ctx* self, uint64_t addr, int procNum)
 {
-    inter_sim->busReq(SHARED, addr, procNum);
+    self->inter_sim->busReq(self->inter_sim, SHARED, addr, procNum);
 }
 
 coherence_states
-cacheMI(uint8_t is_read, uint8_t* permAvail, coherence_states currentState,
-        uint64_t addr, int procNum)
+cacheMI(coher_ctx* self, uint8_t is_read, uint8_t* permAvail,
+        coherence_states currentState, uint64_t addr, int procNum)
 {
     switch (currentState)
     {
         case INVALID:
             *permAvail = 0;
-            sendBusWr(addr, procNum);
+            sendBusWr(self, addr, procNum);
             return INVALID_MODIFIED;
         case MODIFIED:
             *permAvail = 1;
@@ -48,8 +48,8 @@ cacheMI(uint8_t is_read, uint8_t* permAvail, coherence_states currentState,
 }
 
 coherence_states
-snoopMI(bus_req_type reqType, cache_action* ca, coherence_states currentState,
-        uint64_t addr, int procNum)
+snoopMI(coher_ctx* self, bus_req_type reqType, cache_action* ca,
+        coherence_states currentState, uint64_t addr, int procNum)
 {
     *ca = NO_ACTION;
     switch (currentState)
@@ -57,8 +57,8 @@ snoopMI(bus_req_type reqType, cache_action* ca, coherence_states currentState,
         case INVALID:
             return INVALID;
         case MODIFIED:
-            sendData(addr, procNum);
-            // indicateShared(addr, procNum); // Needed for E state
+            sendData(self, addr, procNum);
+            // indicateShared(self, addr, procNum); // Needed for E state
             *ca = INVALIDATE;
             return INVALID;
         case INVALID_MODIFIED:
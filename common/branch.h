@@ -15,11 +15,13 @@ enum BRANCH_MODEL_TYPE
 typedef struct _branch_sim_args {
     int arg_count;
     char** arg_list;
+    const sim_env* env;
 } branch_sim_args;
 
 typedef struct _branch {
     sim_interface si;
-    uint64_t (*branchRequest)(trace_op*, int);
+    uint64_t (*branchRequest)(struct _branch* self, trace_op* op,
+                              int processorNum);
     debug_env_vars dbgEnv;
 } branch;
 
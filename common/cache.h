@@ -8,13 +8,25 @@
 typedef struct _cache_sim_args {
     int arg_count;
     char** arg_list;
+    const sim_env* env;
     coher* coherComp;
 } cache_sim_args;
 
 typedef struct _cache {
     sim_interface si;
-    void (*memoryRequest)(trace_op*, int, int64_t,
-                          void (*callback)(int, int64_t));
+    // callback(ctx, processorNum, tag) is called once the request completes.
+    void (*memoryRequest)(struct _cache* self, trace_op* op, int processorNum,
+                          int64_t tag, void* ctx,
+                          void (*callback)(void*, int, int64_t));
+    // Optional, applies op to the cache state at once, with no ticks,
+    //   callback or bus traffic, to warm the cache before a timed run.
+    void (*warmRequest)(struct _cache* self, trace_op* op, int processorNum);
+    // Optional, gives the requests in flight that restore read back the
+    //   ctx and callback of their requestor, which calls it from its own
+    //   restore.  Without it, the requestor cannot be saved with requests
+    //   in flight.
+    void (*restoreRequestor)(struct _cache* self, void* ctx,
+                             void (*callback)(void*, int, int64_t));
     debug_env_vars dbgEnv;
 } cache;
 
@@ -12,6 +12,7 @@ struct _interconn;
 typedef struct _coher_sim_args {
     int arg_count;
     char** arg_list;
+    const sim_env* env;
     struct _interconn* inter;
 } coher_sim_args;
 
@@ -24,10 +25,22 @@ typedef enum _cache_action
 
 typedef struct _coher {
     sim_interface si;
-    void (*registerCacheInterface)(void (*callback)(int, int, int64_t));
-    uint8_t (*permReq)(uint8_t is_read, uint64_t addr, int processorNum);
-    uint8_t (*invlReq)(uint64_t addr, int processorNum);
-    uint8_t (*busReq)(bus_req_type reqType, uint64_t addr, int processorNum);
+    // callback(ctx, cache_action, processorNum, addr)
+    void (*registerCacheInterface)(struct _coher* self, void* ctx,
+                                   void (*callback)(void*, int, int, int64_t));
+    uint8_t (*permReq)(struct _coher* self, uint8_t is_read, uint64_t addr,
+                       int processorNum);
+    uint8_t (*invlReq)(struct _coher* self, uint64_t addr, int processorNum);
+    uint8_t (*busReq)(struct _coher* self, bus_req_type reqType, uint64_t addr,
+                      int processorNum);
+    // Optional, moves addr to the state that a completed permReq would
+    //   leave it in, with no bus traffic.  For warming.
+    void (*warmReq)(struct _coher* self, uint8_t is_read, uint64_t addr,
+                    int processorNum);
+    // Optional, the name of the state of addr in processorNum's cache, for
+    //   the debugger.
+    const char* (*stateName)(struct _coher* self, uint64_t addr,
+                             int processorNum);
     debug_env_vars dbgEnv;
 } coher;
 
@@ -6,26 +6,77 @@
 #include <stdlib.h>
 #include <string.h>
 #include <signal.h>
+#include <stdio.h>
 
-// Every component needs to define the following:
-int tick();
-int finish(int);
-int destroy(void);
+// Version of the component interface.  Every component built against these
+//   headers must define:
+//     const int CADSS_ABI = CADSS_ABI_VERSION;
+//   Components without it are assumed to use the original interface, where
+//   each component was a single instance kept in globals, and are adapted by
+//   the engine.
+#define CADSS_ABI_VERSION 6
+extern const int CADSS_ABI;
 
-// Every componet also needs to define an init that returns
-//   a pointer specific to that type of component
+struct _stats_registry;
+struct _events_sink;
+
+// Settings shared by every component instance of a simulation.
+typedef struct _sim_env {
+    int processorCount;
+    int verbose;
+    // Nonzero when components run on clock domains of their own, so that
+    //   one may see a request after another has finished it.
+    int clockDomains;
+    // Where to register statistics, see stats.h; NULL if not collected.
+    const struct _stats_registry* stats;
+    // Where to report the stages of memory requests, see events.h; NULL if
+    //   not recorded.
+    const struct _events_sink* events;
+} sim_env;
+
+// Every component's init takes its own *_sim_args and returns a pointer to
+//   a new instance, which starts with a sim_interface.  The instance is
+//   passed back as the first argument of each of its functions, so that a
+//   process can hold any number of instances of a component.
+//
+//   idleTicks and skipTicks are optional (NULL), and let the engine skip
+//   ticks in which the component would only be counting down:
+//   idleTicks - number of upcoming ticks in which tick() would do nothing
+//               but count down; 0 if there is work on the next tick, or
+//               SIM_IDLE_FOREVER if nothing is pending.
+//   skipTicks - advance as if tick() had been called that many idle times.
+//   A component that does not provide both is ticked every cycle.
+//
+//   reconfigure is also optional, and applies a new set of the component's
+//   arguments to an instance that has already run, such as one that was
+//   warmed up before its process forked.  It returns 0 on success.
+//
+//   save and restore are optional too, and write or read the state of an
+//   instance for a checkpoint:
+//   save    - write the state to f and return 0, SIM_SAVE_BUSY while a
+//             request with a callback is in flight that it cannot save, or
+//             -1 if the state cannot be saved at all.  The engine tries
+//             again on the next tick while any component is busy, for a
+//             bounded number of ticks.  Requests in flight are saved
+//             without their callbacks, which the requestor gives back
+//             through restoreRequestor of the cache or memory.
+//   restore - read the state written by save into an instance that was
+//             just created with the same wiring, 0 on success.  Settings
+//             that only affect later requests may differ from the saved run.
+#define SIM_IDLE_FOREVER INT64_MAX
+#define SIM_SAVE_BUSY 1
 
 typedef struct _sim_interface {
-    int (*tick)(void);
-    int (*finish)(int);
-    int (*destroy)(void);
+    int (*tick)(void* self);
+    int (*finish)(void* self, int outFd);
+    int (*destroy)(void* self);
+    int64_t (*idleTicks)(void* self);
+    void (*skipTicks)(void* self, int64_t ticks);
+    int (*reconfigure)(void* self, int arg_count, char** arg_list);
+    int (*save)(void* self, FILE* f);
+    int (*restore)(void* self, FILE* f);
 } sim_interface;
 
-// Flag set by engine if verbose flag is passed in,
-// components can read flag
-extern int CADSS_VERBOSE;
-extern int processorCount;
-
 // For cadss debugging functionality.
 typedef struct _debug_env_vars {
     int cadssDbgWatchedComp;
@@ -0,0 +1,53 @@
+#ifndef EVENTS_H
+#define EVENTS_H
+
+#include <stdint.h>
+
+#include "common.h"
+
+//
+// EVENTS H - Points in the life of a memory request that components report
+//
+//   A component reports the stages that only it can see, such as a grant of
+// the bus, through the sink in its sim_env, which is NULL unless the engine
+// records them, so a report costs no more than that test.  The engine sees
+// the issue of each request and its completion itself.  Stages of a request
+// in the cache carry its tag and block address; the stages past the cache
+// only know the processor and block, and are matched to the oldest request
+// of that processor to the block.
+//
+
+enum req_stage
+{
+    REQ_ISSUE,           // To the cache, with the byte address.
+    REQ_HIT,             // The block is in the cache.
+    REQ_MISS,
+    REQ_PERM,            // Coherence is asked for permission.
+    REQ_BUS_QUEUE,       // Waiting for the bus.
+    REQ_BUS_GRANT,       // Offered to the caches.
+    REQ_SNOOP,           // Broadcast to the other caches, and to memory.
+    REQ_CACHE_TRANSFER,  // Another cache has the data.
+    REQ_MEMORY_TRANSFER, // Memory has the data.
+    REQ_BUS_DONE,        // Off the bus.
+    REQ_DRAM_START,
+    REQ_DRAM_END,
+    REQ_SQUELCH,         // The fetch was dropped for a cache transfer.
+    REQ_DONE,            // The callback to the processor.
+    REQ_STAGES
+};
+
+typedef struct _events_sink {
+    void* self;
+    // tag is -1 if the stage is not for a request in the cache.
+    void (*event)(void* self, int stage, int processorNum, uint64_t addr,
+                  int64_t tag);
+} events_sink;
+
+static inline void eventsReport(const sim_env* env, int stage,
+                                int processorNum, uint64_t addr, int64_t tag)
+{
+    if (env->events != NULL)
+        env->events->event(env->events->self, stage, processorNum, addr, tag);
+}
+
+#endif
@@ -21,14 +21,20 @@ typedef enum _bus_req_type
 typedef struct _inter_sim_args {
     int arg_count;
     char** arg_list;
+    const sim_env* env;
     struct _memory* memory;
 } inter_sim_args;
 
 typedef struct _interconn {
     sim_interface si;
-    void (*busReq)(bus_req_type brt, uint64_t addr, int procNum);
-    void (*registerCoher)(struct _coher* coherComp);
-    int (*busReqCacheTransfer)(uint64_t addr, int procNum);
+    void (*busReq)(struct _interconn* self, bus_req_type brt, uint64_t addr,
+                   int procNum);
+    void (*registerCoher)(struct _interconn* self, struct _coher* coherComp);
+    int (*busReqCacheTransfer)(struct _interconn* self, uint64_t addr,
+                               int procNum);
+    // Optional, the number of procNum's requests waiting for the bus, for
+    //   the debugger.
+    int (*queueLength)(struct _interconn* self, int procNum);
     debug_env_vars dbgEnv;
 } interconn;
 
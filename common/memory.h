@@ -9,12 +9,19 @@ struct _interconn;
 typedef struct _memory_sim_args {
     int arg_count;
     char** arg_list;
+    const sim_env* env;
 } memory_sim_args;
 
 typedef struct _memory {
     sim_interface si;
-    int (*busReq)(uint64_t addr, int procNum, void (*callback)(int, uint64_t));
-    void (*registerInterconnect)(struct _interconn* interconnect);
+    // callback(ctx, procNum, addr) is called when the data is available.
+    int (*busReq)(struct _memory* self, uint64_t addr, int procNum, void* ctx,
+                  void (*callback)(void*, int, uint64_t));
+    void (*registerInterconnect)(struct _memory* self,
+                                 struct _interconn* interconnect);
+    // Optional, as restoreRequestor of the cache.
+    void (*restoreRequestor)(struct _memory* self, void* ctx,
+                             void (*callback)(void*, int, uint64_t));
     debug_env_vars dbgEnv;
 } memory;
 
@@ -0,0 +1,48 @@
+#ifndef PROBES_H
+#define PROBES_H
+
+//
+// PROBES H - Static tracepoints in the hot paths of components
+//
+//   Each CADSS_PROBEn(name, ...) is a USDT probe of the provider cadss, with
+// n integer arguments, that Linux tracing tools can attach to in the
+// component's library without rebuilding it, such as
+//   bpftrace -e 'usdt:cache_simulator/libcache_simulator.so:cadss:cache_miss
+//                { @[arg0] = count(); }' -p <pid of cadss-engine>
+// or perf probe, after perf buildid-cache --add on the library.  A probe
+// that nothing is attached to is a single nop.  The probes are:
+//   mem_issue(proc, addr, tag)            processor, a request to the cache
+//   mem_done(proc, tag, ticks)            processor, its callback
+//   branch_mispredict(proc, pc, predicted)
+//   cache_miss(proc, addr)
+//   cache_evict(victim, addr)             the block replaced, for addr
+//   coher_state(proc, addr, from, to)     coherence_states, as numbers
+//   bus_grant(proc, addr, waited)         ticks spent queued for the bus
+//   dram_issue(proc, addr, ticks)
+//   dram_squelch(proc, addr)
+//   Without <sys/sdt.h>, from systemtap-sdt-dev or systemtap-sdt-devel, or
+// with CADSS_NO_PROBES defined, the probes compile to nothing.
+//
+
+#if !defined(CADSS_NO_PROBES) && defined(__has_include)
+#if __has_include(<sys/sdt.h>)
+#include <sys/sdt.h>
+#define CADSS_PROBES 1
+#endif
+#endif
+
+#ifdef CADSS_PROBES
+#define CADSS_PROBE2(name, a, b) DTRACE_PROBE2(cadss, name, a, b)
+#define CADSS_PROBE3(name, a, b, c) DTRACE_PROBE3(cadss, name, a, b, c)
+#define CADSS_PROBE4(name, a, b, c, d) DTRACE_PROBE4(cadss, name, a, b, c, d)
+#else
+// The arguments are still used, so values computed only for a probe do not
+//   warn as unused.
+#define CADSS_PROBE2(name, a, b) do { (void)(a); (void)(b); } while (0)
+#define CADSS_PROBE3(name, a, b, c)                                            \
+    do { (void)(a); (void)(b); (void)(c); } while (0)
+#define CADSS_PROBE4(name, a, b, c, d)                                         \
+    do { (void)(a); (void)(b); (void)(c); (void)(d); } while (0)
+#endif
+
+#endif
@@ -12,6 +12,7 @@ typedef struct _processor_sim_args {
     branch* branch_sim;
     int arg_count;
     char** arg_list;
+    const sim_env* env;
 } processor_sim_args;
 
 typedef struct _processor {
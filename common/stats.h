@@ -0,0 +1,89 @@
+#ifndef STATS_H
+#define STATS_H
+
+#include <stdint.h>
+
+#include "common.h"
+
+//
+// STATS H - Statistics that components register with the engine
+//
+//   A component keeps its counters in its own instance, as plain uint64_t
+// that it increments, and registers their addresses from init.  The engine
+// reads them whenever it writes the statistics of a simulation, so an
+// update costs no more than the increment.  Names are dotted and start with
+// the component's role, such as "cache.misses".
+//
+
+#define STAT_HIST_BUCKETS 64
+
+// Bucket i counts the values v with v / width == i, or with a width of 0,
+//   the values with i significant bits (0 in bucket 0, 1 in bucket 1, 2 and
+//   3 in bucket 2, ...).  The last bucket also counts every larger value.
+typedef struct _stat_hist {
+    uint64_t width;
+    uint64_t count;
+    uint64_t sum;
+    uint64_t max;
+    uint64_t buckets[STAT_HIST_BUCKETS];
+} stat_hist;
+
+typedef struct _stats_registry {
+    void* self;
+    void (*counter)(void* self, const char* name, const uint64_t* value);
+    // One value for each of count, usually one per processor.
+    void (*vector)(void* self, const char* name, const uint64_t* values,
+                   int count);
+    void (*hist)(void* self, const char* name, const stat_hist* h);
+    // A level rather than a count, such as the depth of a queue.
+    void (*gauge)(void* self, const char* name, const uint64_t* value);
+} stats_registry;
+
+static inline void statsCounter(const sim_env* env, const char* name,
+                                const uint64_t* value)
+{
+    if (env->stats != NULL)
+        env->stats->counter(env->stats->self, name, value);
+}
+
+static inline void statsVector(const sim_env* env, const char* name,
+                               const uint64_t* values, int count)
+{
+    if (env->stats != NULL)
+        env->stats->vector(env->stats->self, name, values, count);
+}
+
+static inline void statsHist(const sim_env* env, const char* name,
+                             const stat_hist* h)
+{
+    if (env->stats != NULL)
+        env->stats->hist(env->stats->self, name, h);
+}
+
+static inline void statsGauge(const sim_env* env, const char* name,
+                              const uint64_t* value)
+{
+    if (env->stats != NULL)
+        env->stats->gauge(env->stats->self, name, value);
+}
+
+static inline void statHistAdd(stat_hist* h, uint64_t v)
+{
+    uint64_t b = v;
+
+    if (h->width > 0)
+        b = v / h->width;
+    else if (v > 0)
+        b = 64 - __builtin_clzll(v);
+
+    if (b >= STAT_HIST_BUCKETS)
+        b = STAT_HIST_BUCKETS - 1;
+
+    h->buckets[b]++;
+    h->count++;
+    h->sum += v;
+    if (v > h->max)
+        h->max = v;
+}
+
+#endif
@@ -37,11 +37,26 @@ typedef struct _trace_op {
 typedef struct _trace_sim_args {
     int arg_count;
     char** arg_list;
+    const sim_env* env;
 } trace_sim_args;
 
+// Called with a basic block and the number of its instructions to count.
+typedef void (*trace_bb_visit)(void* ctx, uint64_t block, uint64_t ops);
+
 typedef struct _trace_reader {
     sim_interface si;
-    trace_op* (*getNextOp)(int);
+    trace_op* (*getNextOp)(struct _trace_reader* self, int processorNum);
+
+    // Optional, for profiling.  Visits the basic blocks executed up to and
+    //   including the op last returned for processorNum, since the op before
+    //   it.  Blocks are identified by their address or by an id from the
+    //   trace.
+    void (*basicBlocks)(struct _trace_reader* self, int processorNum,
+                        trace_bb_visit visit, void* ctx);
+
+    // Optional, the fraction of the trace read so far, or -1 if it is not
+    //   known.
+    double (*consumed)(struct _trace_reader* self);
 } trace_reader;
 
 #endif
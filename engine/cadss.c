@@ -0,0 +1,257 @@
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cadss.h"
+#include "config.h"
+#include "sim.h"
+#include "tracebuf.h"
+
+struct _cadss_trace {
+    trace_buffer* tb;
+};
+
+struct _cadss_sim {
+    simulation s;
+    trace_reader* tr;
+    int legacyRoles; // Bit i for all[i] in cadssCreate.
+};
+
+// Components kept loaded, by name.
+typedef struct _loaded_sim {
+    char* name;
+    struct sim* sim;
+} loaded_sim;
+
+static loaded_sim* loaded = NULL;
+static int loadedCount = 0;
+
+// The roles that a live simulation has a legacy component in.  The globals
+//   of a legacy component, and its view in legacy.c, are one for the
+//   process, so no two simulations can share them.
+static int legacyLive = 0;
+
+static struct sim* cadssLoad(const char* name, char* type, const sim_env* env)
+{
+    if (name == NULL)
+        name = type;
+
+    for (int i = 0; i < loadedCount; i++)
+    {
+        if (strcmp(loaded[i].name, name) == 0)
+            return loaded[i].sim;
+    }
+
+    // loadSim may change the name that it is given.
+    char* copy = strdup(name);
+    if (copy == NULL)
+        return NULL;
+
+    struct sim* s = loadSim(copy, type, env);
+    free(copy);
+    if (s == NULL)
+        return NULL;
+
+    // Legacy components take their settings from globals when loaded, and
+    //   are loaded for each simulation.
+    if (s->legacy)
+        return s;
+
+    loaded_sim* ls = realloc(loaded, (loadedCount + 1) * sizeof(loaded_sim));
+    if (ls == NULL)
+        return s;
+    loaded = ls;
+
+    loaded[loadedCount].name = strdup(name);
+    if (loaded[loadedCount].name == NULL)
+        return s;
+    loaded[loadedCount].sim = s;
+    loadedCount++;
+
+    s->keep = 1;
+    return s;
+}
+
+void cadssUnload(void)
+{
+    for (int i = 0; i < loadedCount; i++)
+    {
+        unloadSim(loaded[i].sim);
+        free(loaded[i].name);
+    }
+
+    free(loaded);
+    loaded = NULL;
+    loadedCount = 0;
+}
+
+cadss_trace* cadssTraceOpen(const char* path, int processorCount)
+{
+    sim_env env = {0};
+    env.processorCount = processorCount;
+
+    struct sim* trace = cadssLoad(NULL, "trace", &env);
+    if (trace == NULL)
+        return NULL;
+
+    // The trace only takes its own argument.
+    char* traceArgs[] = {"cadss", "-t", (char*)path, NULL};
+    trace_sim_args tsa;
+    tsa.arg_count = (path == NULL) ? 1 : 3;
+    tsa.arg_list = traceArgs;
+    tsa.env = &env;
+    optind = 1;
+    trace_reader* tr = trace->init(&tsa);
+    if (tr == NULL)
+        return NULL;
+
+    cadss_trace* t = malloc(sizeof(cadss_trace));
+    if (t != NULL)
+    {
+        t->tb = traceBufferDecode(tr, processorCount);
+        if (t->tb == NULL)
+        {
+            free(t);
+            t = NULL;
+        }
+    }
+
+    tr->si.destroy(tr);
+    if (!trace->keep)
+        unloadSim(trace);
+
+    return t;
+}
+
+void cadssTraceFree(cadss_trace* trace)
+{
+    traceBufferFree(trace->tb);
+    free(trace);
+}
+
+cadss_sim* cadssCreate(const char* config, const cadss_components* components,
+                       const cadss_trace* trace)
+{
+    cadss_components none = {0};
+    if (components == NULL)
+        components = &none;
+
+    sim_env env = {0};
+    env.processorCount = trace->tb->processorCount;
+
+    cadss_sim* cs = calloc(1, sizeof(cadss_sim));
+    if (cs == NULL)
+        return NULL;
+
+    cs->tr = traceBufferReader(trace->tb);
+    if (cs->tr == NULL || openSettingsText(config) != 0)
+    {
+        cadssDestroy(cs);
+        return NULL;
+    }
+
+    sim_loaded sims;
+    sims.inter = cadssLoad(components->interconnect, "interconnect", &env);
+    sims.coher = cadssLoad(components->coherence, "coherence", &env);
+    sims.cache = cadssLoad(components->cache, "cache", &env);
+    sims.proc = cadssLoad(components->processor, "processor", &env);
+    sims.branch = cadssLoad(components->branch, "branch", &env);
+    sims.mem = cadssLoad(components->memory, "memory", &env);
+
+    struct sim* all[] = {sims.inter, sims.coher, sims.cache,
+                         sims.proc, sims.branch, sims.mem};
+    int loadedAll = 1;
+    int legacyRoles = 0;
+    for (int i = 0; i < sizeof(all) / sizeof(all[0]); i++)
+    {
+        if (all[i] == NULL)
+            loadedAll = 0;
+        else if (all[i]->legacy)
+            legacyRoles |= 1 << i;
+    }
+
+    int r = -1;
+    if (loadedAll && (legacyRoles & legacyLive) != 0)
+    {
+        fprintf(stderr, "A legacy component can only be in one simulation "
+                        "at a time, and another simulation has one in the "
+                        "same role\n");
+    }
+    else if (loadedAll)
+    {
+        r = simCreateLoaded(&cs->s, &sims, cs->tr, &env);
+        if (r == 0)
+        {
+            cs->legacyRoles = legacyRoles;
+            legacyLive |= legacyRoles;
+        }
+    }
+
+    // Once created, the simulation unloads its components when destroyed.
+    //   Otherwise only what was loaded for it alone is unloaded.
+    if (r != 0 && cs->s.env.stats == NULL)
+    {
+        for (int i = 0; i < sizeof(all) / sizeof(all[0]); i++)
+        {
+            if (all[i] != NULL && !all[i]->keep)
+                unloadSim(all[i]);
+        }
+    }
+
+    // No component keeps its arguments past its init.
+    freeSettings();
+
+    if (r != 0)
+    {
+        cadssDestroy(cs);
+        return NULL;
+    }
+    return cs;
+}
+
+void cadssRun(cadss_sim* sim)
+{
+    simRun(&sim->s);
+}
+
+int cadssRunTicks(cadss_sim* sim, int64_t ticks)
+{
+    int64_t endTick = INT64_MAX;
+    if (ticks < INT64_MAX - sim->s.tickCount)
+        endTick = sim->s.tickCount + ticks;
+
+    return simRunUntil(&sim->s, endTick);
+}
+
+int64_t cadssTicks(const cadss_sim* sim)
+{
+    return sim->s.tickCount;
+}
+
+int cadssStat(const cadss_sim* sim, const char* name, uint64_t* values,
+              int count)
+{
+    return statsTableValues(&sim->s.stats, name, values, count);
+}
+
+int cadssWriteStats(cadss_sim* sim, const char* path)
+{
+    return simWriteStats(&sim->s, path);
+}
+
+int cadssFinish(cadss_sim* sim, int outFd)
+{
+    return simFinish(&sim->s, outFd);
+}
+
+void cadssDestroy(cadss_sim* sim)
+{
+    // A simulation that failed to be created has its stats table at least.
+    if (sim->s.env.stats != NULL)
+        simDestroy(&sim->s);
+    if (sim->tr != NULL)
+        sim->tr->si.destroy(sim->tr);
+    legacyLive &= ~sim->legacyRoles;
+    free(sim);
+}
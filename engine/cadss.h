@@ -0,0 +1,79 @@
+#ifndef CADSS_H
+#define CADSS_H
+
+#include <stdint.h>
+
+//
+// libcadss
+//
+//   The simulator as a library, for programs that run many simulations in
+// one process.  A trace is decoded once and kept in memory, and each
+// component stays loaded from the first simulation that uses it, so a new
+// simulation only creates the component instances.  Components and traces
+// are found as by cadss-engine, relative to the working directory.
+//
+//   One thread at a time may use the library, as the configuration being
+// read and the debugger are shared by the process.  Any number of
+// simulations may exist at once, except that a component built for the
+// original, single instance interface has one state for the process, as
+// dlopen returns the same library each time: while a simulation has one in
+// a role, creating another with a legacy component in that role fails.
+//
+
+#define CADSS_API __attribute__((visibility("default")))
+
+typedef struct _cadss_trace cadss_trace;
+typedef struct _cadss_sim cadss_sim;
+
+// Components for each role, by the names that cadss-engine takes, or NULL
+//   for the default component of the role.
+typedef struct _cadss_components {
+    const char* processor;
+    const char* branch;
+    const char* cache;
+    const char* coherence;
+    const char* interconnect;
+    const char* memory;
+} cadss_components;
+
+// Decode the trace file or directory at path for processorCount
+//   processors, NULL on failure.
+CADSS_API cadss_trace* cadssTraceOpen(const char* path, int processorCount);
+CADSS_API void cadssTraceFree(cadss_trace* trace);
+
+// A new simulation of trace, which must outlive it.  config has the text
+//   of a configuration file, with the arguments of each component.
+//   components may be NULL for the defaults.  NULL on failure.
+CADSS_API cadss_sim* cadssCreate(const char* config,
+                                 const cadss_components* components,
+                                 const cadss_trace* trace);
+
+// Run until the processor is done.
+CADSS_API void cadssRun(cadss_sim* sim);
+
+// Run for up to ticks more ticks, 1 if the processor has more to do.
+CADSS_API int cadssRunTicks(cadss_sim* sim, int64_t ticks);
+
+CADSS_API int64_t cadssTicks(const cadss_sim* sim);
+
+// Copy up to count values of the named statistic, such as "cache.misses",
+//   to values.  A histogram has its width, count, sum, max and then 64
+//   buckets.  The number of values of the statistic, or -1 if there is
+//   none by name.
+CADSS_API int cadssStat(const cadss_sim* sim, const char* name,
+                        uint64_t* values, int count);
+
+// Write every statistic as JSON, or as CSV if path ends in ".csv", to
+//   stdout if path is "-".  0 on success.
+CADSS_API int cadssWriteStats(cadss_sim* sim, const char* path);
+
+// Have the components write their results to outFd, as at the end of a
+//   cadss-engine run.
+CADSS_API int cadssFinish(cadss_sim* sim, int outFd);
+
+CADSS_API void cadssDestroy(cadss_sim* sim);
+
+// Unload the components kept loaded, once no simulation is left.
+CADSS_API void cadssUnload(void);
+
+#endif
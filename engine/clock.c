@@ -0,0 +1,165 @@
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <stats.h>
+
+#include "clock.h"
+#include "config.h"
+
+static const char* domainName[CLOCK_DOMAIN_COUNT] = {
+    [CLOCK_CORE] = "core",
+    [CLOCK_UNCORE] = "uncore",
+    [CLOCK_DRAM] = "DRAM",
+};
+
+int clockOpen(sim_clock* c, const sim_env* env)
+{
+    memset(c, 0, sizeof(sim_clock));
+
+    if (!hasSettings("clock"))
+        return 0;
+
+    int argCount = 0;
+    char** arg = getSettings("clock", &argCount);
+
+    int64_t mhz[CLOCK_DOMAIN_COUNT] = {1000, 0, 0};
+    int op;
+    optind = 1;
+    while ((op = getopt(argCount, arg, "c:u:d:")) != -1)
+    {
+        switch (op)
+        {
+            case 'c':
+                mhz[CLOCK_CORE] = atoll(optarg);
+                break;
+            case 'u':
+                mhz[CLOCK_UNCORE] = atoll(optarg);
+                break;
+            case 'd':
+                mhz[CLOCK_DRAM] = atoll(optarg);
+                break;
+            default:
+                fprintf(stderr, "Clock takes -c, -u and -d <MHz>\n");
+                return -1;
+        }
+    }
+
+    for (int d = 0; d < CLOCK_DOMAIN_COUNT; d++)
+    {
+        if (mhz[d] == 0 && d != CLOCK_CORE)
+            mhz[d] = mhz[CLOCK_CORE];
+        if (mhz[d] <= 0)
+        {
+            fprintf(stderr, "The %s clock must be at least 1 MHz\n",
+                    domainName[d]);
+            return -1;
+        }
+        c->mhz[d] = mhz[d];
+    }
+
+    c->on = 1;
+    statsVector(env, "clock.ticks", c->ticks, CLOCK_DOMAIN_COUNT);
+    statsCounter(env, "clock.ns", &c->ns);
+    return 0;
+}
+
+// Stands in for the tick of an attached component when it is called by
+//   the component that uses it.
+static int clockStub(void* self)
+{
+    return 1;
+}
+
+// Edges so far, and the phase, of every domain at tickCount.
+static void clockSet(sim_clock* c, int64_t tickCount)
+{
+    for (int d = 0; d < CLOCK_DOMAIN_COUNT; d++)
+    {
+        unsigned __int128 t = (unsigned __int128)tickCount * c->mhz[d];
+
+        c->ticks[d] = t / c->mhz[CLOCK_CORE];
+        c->phase[d] = t % c->mhz[CLOCK_CORE];
+    }
+    clockSync(c, tickCount);
+}
+
+void clockAttach(sim_clock* c, sim_interface* si, int domain,
+                 int64_t tickCount)
+{
+    assert(c->simCount < CLOCK_MAX_SIMS);
+
+    if (c->simCount == 0)
+        clockSet(c, tickCount);
+
+    int i = c->simCount++;
+    c->sims[i] = si;
+    c->tick[i] = si->tick;
+    c->domain[i] = domain;
+    si->tick = clockStub;
+}
+
+void clockDetach(sim_clock* c, int64_t tickCount)
+{
+    for (int i = 0; i < c->simCount; i++)
+        c->sims[i]->tick = c->tick[i];
+    c->simCount = 0;
+
+    clockSync(c, tickCount);
+}
+
+void clockTick(sim_clock* c)
+{
+    uint64_t core = c->mhz[CLOCK_CORE];
+    uint64_t edges[CLOCK_DOMAIN_COUNT];
+
+    for (int d = 0; d < CLOCK_DOMAIN_COUNT; d++)
+    {
+        c->phase[d] += c->mhz[d];
+        edges[d] = c->phase[d] / core;
+        c->phase[d] -= edges[d] * core;
+        c->ticks[d] += edges[d];
+    }
+
+    for (int i = 0; i < c->simCount; i++)
+    {
+        for (uint64_t e = 0; e < edges[c->domain[i]]; e++)
+            c->tick[i](c->sims[i]);
+    }
+}
+
+int64_t clockCoreTicks(const sim_clock* c, int domain, int64_t ticks)
+{
+    // The most core cycles b with phase + b * mhz < (ticks + 1) * core.
+    unsigned __int128 limit =
+        (unsigned __int128)(ticks + 1) * c->mhz[CLOCK_CORE];
+    unsigned __int128 b = (limit - c->phase[domain] - 1) / c->mhz[domain];
+
+    return (b >= SIM_IDLE_FOREVER) ? SIM_IDLE_FOREVER - 1 : (int64_t)b;
+}
+
+int64_t clockEdges(const sim_clock* c, int domain, int64_t coreTicks)
+{
+    unsigned __int128 t =
+        c->phase[domain] + (unsigned __int128)coreTicks * c->mhz[domain];
+
+    return t / c->mhz[CLOCK_CORE];
+}
+
+void clockSkip(sim_clock* c, int64_t coreTicks)
+{
+    for (int d = 0; d < CLOCK_DOMAIN_COUNT; d++)
+    {
+        unsigned __int128 t =
+            c->phase[d] + (unsigned __int128)coreTicks * c->mhz[d];
+
+        c->ticks[d] += t / c->mhz[CLOCK_CORE];
+        c->phase[d] = t % c->mhz[CLOCK_CORE];
+    }
+}
+
+void clockSync(sim_clock* c, int64_t tickCount)
+{
+    c->ns = (unsigned __int128)tickCount * 1000 / c->mhz[CLOCK_CORE];
+}
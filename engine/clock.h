@@ -0,0 +1,85 @@
+#ifndef CLOCK_H
+#define CLOCK_H
+
+#include <stdint.h>
+
+#include <common.h>
+
+//
+// Clock
+//
+//   Clock domains, from the "__clock" entry of the configuration:
+//
+//     __clock -c <MHz> -u <MHz> -d <MHz>
+//
+// for the core (processor, branch predictor and cache), the uncore
+// (coherence and interconnect) and DRAM (memory) domains.  The core clock
+// defaults to 1000 MHz and the others to the core clock.  One tick of the
+// simulation is one core cycle, and each component counts its own latencies
+// in cycles of its domain.
+//
+//   Components normally tick the components that they use at the start of
+// their own tick.  While a simulation with clock domains runs, those ticks
+// are replaced by a stub, and the engine ticks each component itself on
+// every edge of its domain, in the order that the chain would, before it
+// ticks the processor.  A domain that is faster than the core gets more
+// than one tick in some core cycles.  Every domain starts at tick 0, so its
+// edges so far only depend on the tick count.
+//
+
+enum clock_domain
+{
+    CLOCK_CORE,
+    CLOCK_UNCORE,
+    CLOCK_DRAM,
+    CLOCK_DOMAIN_COUNT
+};
+
+// Components below the processor in the tick chain.
+#define CLOCK_MAX_SIMS 8
+
+typedef struct _sim_clock {
+    int on; // The configuration has clock domains.
+    uint64_t mhz[CLOCK_DOMAIN_COUNT];
+
+    // Edges of each domain so far, and how far it is through the next core
+    //   cycle, in units of mhz[CLOCK_CORE].
+    uint64_t ticks[CLOCK_DOMAIN_COUNT];
+    uint64_t phase[CLOCK_DOMAIN_COUNT];
+    uint64_t ns;
+
+    // While attached, the components that the engine ticks and their
+    //   original tick.
+    int simCount;
+    sim_interface* sims[CLOCK_MAX_SIMS];
+    int (*tick[CLOCK_MAX_SIMS])(void*);
+    int domain[CLOCK_MAX_SIMS];
+} sim_clock;
+
+// Read the clock domains of the open settings, and register their
+//   statistics.  0 on success, including when there are none.
+int clockOpen(sim_clock* c, const sim_env* env);
+
+// Tick si on the edges of domain instead of when its caller ticks it, in
+//   the order that the components are attached, until detached.  tickCount
+//   is the tick that the simulation is at.
+void clockAttach(sim_clock* c, sim_interface* si, int domain,
+                 int64_t tickCount);
+void clockDetach(sim_clock* c, int64_t tickCount);
+
+// Tick the attached components for the next core cycle.
+void clockTick(sim_clock* c);
+
+// Core cycles in which domain has at most ticks edges, from now.
+int64_t clockCoreTicks(const sim_clock* c, int domain, int64_t ticks);
+
+// Edges of domain in the next coreTicks core cycles.
+int64_t clockEdges(const sim_clock* c, int domain, int64_t coreTicks);
+
+// Advance every domain by coreTicks core cycles that were skipped.
+void clockSkip(sim_clock* c, int64_t coreTicks);
+
+// Bring the time in nanoseconds up to tickCount.
+void clockSync(sim_clock* c, int64_t tickCount);
+
+#endif
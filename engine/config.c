@@ -20,6 +20,14 @@ struct element {
     int argCount;
     char** argList;
     struct element* next;
+    
+    // For settings of some processors, __name[<first>-<last>], the length
+    //   of name without the processors, and the arguments of name followed
+    //   by these, once asked for.  firstCore is -1 for every processor.
+    size_t baseLength;
+    int firstCore;
+    int lastCore;
+    char** coreArgList;
 };
 
 struct element* componentList = NULL;
@@ -45,6 +53,42 @@ void printSettings()
     }
 }
 
+// Settings for some processors are named __name[<first>-<last>] or
+//   __name[<processor>].
+static void parseCores(struct element* e)
+{
+    e->baseLength = strlen(e->name);
+    e->firstCore = -1;
+    e->lastCore = -1;
+    e->coreArgList = NULL;
+    
+    char* open = strchr(e->name, '[');
+    if (open == NULL) return;
+    
+    int first = 0;
+    int last = 0;
+    int n = 0;
+    if (sscanf(open, "[%d-%d]%n", &first, &last, &n) != 2 || open[n] != '\0')
+    {
+        n = 0;
+        if (sscanf(open, "[%d]%n", &first, &n) != 1 || open[n] != '\0')
+        {
+            n = 0;
+        }
+        last = first;
+    }
+    if (n == 0 || first < 0 || last < first)
+    {
+        fprintf(stderr, "Warning - %s does not name processors as "
+                        "[<first>-<last>] or [<processor>]\n", e->name);
+        return;
+    }
+    
+    e->baseLength = open - e->name;
+    e->firstCore = first;
+    e->lastCore = last;
+}
+
 //
 //  parseSettings
 //
@@ -145,6 +189,7 @@ static void parseSettings()
             nextComp->argList = malloc(sizeof(char*) * ARG_LIST_CHUNK_SIZE);
             nextComp->argList[0] = componentName;
             nextComp->argList[1] = NULL;
+            parseCores(nextComp);
             argSize = ARG_LIST_CHUNK_SIZE;
             if (current == NULL)
             {
@@ -209,8 +254,9 @@ static void parseSettings()
             //fprintf(stderr, "Copying from %zd to %zd, %c - %c\n", argPosStart, pos,
             //                configContents[argPosStart], configContents[pos]);
             
+            // Arguments stay in place, ended by the '\0'.
             configContents[pos] = '\0';
-            char* arg = strdup(&configContents[argPosStart]);
+            char* arg = &configContents[argPosStart];
             
             if (current->argCount == argSize)
             {
@@ -232,6 +278,19 @@ static void parseSettings()
     
 }
 
+// Parse contents, a buffer of len characters and a '\0' that the settings
+//   now own.
+static void useSettings(char* contents, size_t len)
+{
+    freeSettings();
+
+    configContents = contents;
+    length = len;
+    parseSettings();
+
+    //printSettings();
+}
+
 int openSettings(char* configName)
 {
     int configDesc = open(configName, O_RDONLY);
@@ -248,9 +307,9 @@ int openSettings(char* configName)
         close(configDesc);
         return -1;
     }
-    length = sb.st_size;
+    size_t fileLength = sb.st_size;
     
-    char* configContentsTemp = mmap(NULL, length, PROT_READ, MAP_PRIVATE, configDesc, 0);
+    char* configContentsTemp = mmap(NULL, fileLength, PROT_READ, MAP_PRIVATE, configDesc, 0);
     if (configContentsTemp == NULL)
     {
         perror("Reading settings file contents");
@@ -261,27 +320,52 @@ int openSettings(char* configName)
     // N.B. As getopt needs to permute the arguments, the configuration
     //   is copied locally so that any change is not reflected in the
     //   on disk file.
-    configContents = malloc(length + 1);
-    if (configContents == NULL)
+    char* contents = malloc(fileLength + 1);
+    if (contents == NULL)
     {
         perror("Allocating local space for settings arguments");
-        munmap(configContentsTemp, length);
+        munmap(configContentsTemp, fileLength);
         close(configDesc);
         return -1;
     }
-    memcpy(configContents, configContentsTemp, length);
-    configContents[length] = '\0';
+    memcpy(contents, configContentsTemp, fileLength);
+    contents[fileLength] = '\0';
     
-    munmap(configContentsTemp, length);
+    munmap(configContentsTemp, fileLength);
     close(configDesc);
     
-    parseSettings();
-    
-    //printSettings();
+    useSettings(contents, fileLength);
     
     return 0;
 }
 
+int openSettingsText(const char* text)
+{
+    char* contents = strdup(text);
+    if (contents == NULL)
+    {
+        perror("Allocating local space for settings arguments");
+        return -1;
+    }
+
+    useSettings(contents, strlen(contents));
+
+    return 0;
+}
+
+static struct element* findSettings(const char* componentName)
+{
+    struct element* e = componentList;
+    while (e != NULL)
+    {
+        if (strcmp(e->name, componentName) == 0) break;
+        
+        e = e->next;
+    }
+    
+    return e;
+}
+
 char** getSettings(char* componentName, int* count)
 {
     *count = 0;
@@ -298,14 +382,7 @@ char** getSettings(char* componentName, int* count)
         return NULL;
     }
     
-    struct element* e = componentList;
-    while (e != NULL)
-    {
-        if (strcmp(e->name, componentName) == 0) break;
-        
-        e = e->next;
-    }
-    
+    struct element* e = findSettings(componentName);
     if (e == NULL)
     {
         fprintf(stderr, "Component name - %s was not found in settings\n", componentName);
@@ -316,7 +393,135 @@ char** getSettings(char* componentName, int* count)
     return e->argList;
 }
 
+int hasSettings(const char* componentName)
+{
+    return findSettings(componentName) != NULL;
+}
+
+// Whether e is of componentName for processor core, or for any processor
+//   if core is -1.
+static int coversCore(const struct element* e, const char* componentName,
+                      int core)
+{
+    return e->firstCore >= 0 && strlen(componentName) == e->baseLength
+           && strncmp(e->name, componentName, e->baseLength) == 0
+           && (core < 0 || (e->firstCore <= core && core <= e->lastCore));
+}
+
+int hasCoreSettings(const char* componentName)
+{
+    for (struct element* e = componentList; e != NULL; e = e->next)
+    {
+        if (coversCore(e, componentName, -1)) return 1;
+    }
+    
+    return 0;
+}
+
+void checkCoreSettings(const char* componentName, int processorCount)
+{
+    for (struct element* e = componentList; e != NULL; e = e->next)
+    {
+        if (!coversCore(e, componentName, -1)) continue;
+        
+        if (e->lastCore >= processorCount)
+        {
+            fprintf(stderr, "Warning - %s names processors beyond the %d "
+                            "of the simulation\n", e->name, processorCount);
+        }
+    }
+}
+
+int refuseCoreSettings(const char* componentName)
+{
+    int refused = 0;
+    for (struct element* e = componentList; e != NULL; e = e->next)
+    {
+        if (!coversCore(e, componentName, -1)) continue;
+        
+        fprintf(stderr, "Error - %s: only the cache and branch predictor "
+                        "take settings for some processors\n", e->name);
+        refused = 1;
+    }
+    
+    return refused;
+}
+
+char** getCoreSettings(char* componentName, int core, int* count,
+                       const char** coreName)
+{
+    struct element* c = NULL;
+    for (struct element* e = componentList; e != NULL; e = e->next)
+    {
+        if (coversCore(e, componentName, core)) c = e;
+    }
+    
+    *coreName = NULL;
+    if (c == NULL)
+    {
+        return getSettings(componentName, count);
+    }
+    
+    // The processors' own arguments follow, so that they override.
+    struct element* base = findSettings(componentName);
+    int baseCount = (base != NULL) ? base->argCount : 1;
+    char** argList = malloc(sizeof(char*) * (baseCount + c->argCount));
+    if (argList == NULL)
+    {
+        *count = 0;
+        return NULL;
+    }
+    
+    argList[0] = (base != NULL) ? base->argList[0] : c->argList[0];
+    for (int i = 1; i < baseCount; i++)
+    {
+        argList[i] = base->argList[i];
+    }
+    for (int i = 1; i < c->argCount; i++)
+    {
+        argList[baseCount + i - 1] = c->argList[i];
+    }
+    argList[baseCount + c->argCount - 1] = NULL;
+    
+    free(c->coreArgList);
+    c->coreArgList = argList;
+    *count = baseCount + c->argCount - 1;
+    *coreName = c->name;
+    return argList;
+}
+
+void visitSettings(void (*visit)(char* componentName, char** arg, void* ctx),
+                   void* ctx)
+{
+    struct element* e = componentList;
+    while (e != NULL)
+    {
+        // argList[0] is the component name itself.
+        for (int i = 1; i < e->argCount; i++)
+        {
+            visit(e->name, &e->argList[i], ctx);
+        }
+
+        e = e->next;
+    }
+}
+
 void freeSettings()
 {
+    struct element* e = componentList;
+    while (e != NULL)
+    {
+        struct element* next = e->next;
+
+        free(e->name);
+        free(e->argList);
+        free(e->coreArgList);
+        free(e);
+        e = next;
+    }
+    componentList = NULL;
+
     free(configContents);
+    configContents = NULL;
+    length = 0;
 }
@@ -13,12 +13,44 @@
 //   Component names start with __ such as:
 //  __processor
 //
+//   Settings for only some processors add them to the name, as a range or
+// a single processor, and follow the settings of the component, so that
+// their options take precedence for those processors:
+//  __cache -E 1 -b 4 -s 8
+//  __cache[0-3] -s 10 -E 8
+// Only the cache and branch predictor have an instance per processor, so
+// the engine refuses such settings for any other component.
+//
 //   As whitespace is ignored, the configuration file can be mixed tabs, spaces,
 // newlines, and other inelegant melanges of horrors.
 //
 
 int openSettings(char*);
+// The same from the text of a configuration rather than a file.
+int openSettingsText(const char* text);
 char** getSettings(char*, int*);
+// Whether there are settings for componentName, which may be optional.
+int hasSettings(const char* componentName);
+// Whether componentName has settings for only some processors.
+int hasCoreSettings(const char* componentName);
+// Warns of settings of componentName for processors beyond processorCount.
+void checkCoreSettings(const char* componentName, int processorCount);
+// Reports any settings of componentName for only some processors, which
+//   it has no instances for, and returns 1 if there are.
+int refuseCoreSettings(const char* componentName);
+// The arguments of componentName for processor core: those of the last
+//   settings for some processors that cover it, after those for every
+//   processor, with *coreName set to the name of those settings, such as
+//   "cache[0-3]"; or as getSettings with *coreName NULL.  The arguments
+//   last until the next call for the same settings.
+char** getCoreSettings(char* componentName, int core, int* count,
+                       const char** coreName);
+
+// Calls visit with each argument of each component, in file order.  The
+//   argument may be replaced through arg before the component is created.
+void visitSettings(void (*visit)(char* componentName, char** arg, void* ctx),
+                   void* ctx);
+// Release the open settings, whose arguments must no longer be in use.
 void freeSettings();
 
 #endif
@@ -0,0 +1,665 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cosim.h"
+#include "engine.h"
+
+enum cosim_role
+{
+    COSIM_BRANCH,
+    COSIM_CACHE,
+    COSIM_MEMORY,
+    COSIM_ROLE_COUNT
+};
+
+static const char* roleName[COSIM_ROLE_COUNT] = {
+    [COSIM_BRANCH] = "branch",
+    [COSIM_CACHE] = "cache",
+    [COSIM_MEMORY] = "memory",
+};
+
+static const char* defaultRef[COSIM_ROLE_COUNT] = {
+    [COSIM_BRANCH] = "refBranch",
+    [COSIM_CACHE] = "refCache",
+    [COSIM_MEMORY] = "refMemory",
+};
+
+enum cosim_kind
+{
+    COSIM_PREDICT, // Predicted PC.
+    COSIM_DONE,    // Tag of a completed request.
+    COSIM_FETCH,   // Ticks to fetch, returned by busReq.
+    COSIM_DATA     // Address of the data called back.
+};
+
+// An output of one side.
+typedef struct _cosim_event {
+    int64_t tick;
+    int kind;
+    int processorNum;
+    uint64_t value;
+} cosim_event;
+
+// Outputs of one side that the other has not given yet, in order.
+typedef struct _cosim_queue {
+    cosim_event* events;
+    int head;
+    int count;
+    int size;
+} cosim_queue;
+
+enum cosim_side
+{
+    COSIM_CANDIDATE,
+    COSIM_REFERENCE
+};
+
+// The shadow coherence, interconnect and memory of a reference cache.
+#define COSIM_MAX_BELOW 3
+
+typedef struct _cosim_check {
+    int on;
+    char* refName;
+    struct sim* rsim;
+    sim_interface* cand;
+    sim_interface* ref;
+    sim_interface* below[COSIM_MAX_BELOW];
+    int belowCount;
+
+    // Original entry points of the candidate.
+    int (*tick)(void*);
+    int64_t (*idleTicks)(void*);
+    void (*skipTicks)(void*, int64_t);
+
+    cosim_queue q[2];
+    uint64_t requests;
+    uint64_t matched;
+    int64_t divergeTick; // -1 while they match.
+} cosim_check;
+
+static struct {
+    simulation* s;
+    cosim_check checks[COSIM_ROLE_COUNT];
+    sim_env env; // Of the references, which have no statistics or events.
+
+    uint64_t (*branchRequest)(branch*, trace_op*, int);
+    void (*memoryRequest)(cache*, trace_op*, int, int64_t, void*,
+                          void (*)(void*, int, int64_t));
+    void (*warmRequest)(cache*, trace_op*, int);
+    int (*memBusReq)(memory*, uint64_t, int, void*,
+                     void (*)(void*, int, uint64_t));
+
+    // The requestors of the cache and memory.
+    void* cacheCtx;
+    void (*cacheCallback)(void*, int, int64_t);
+    void* memCtx;
+    void (*memCallback)(void*, int, uint64_t);
+
+    branch* refBranch;
+    cache* refCache;
+    memory* refMemory;
+    coher* shadowCoher;
+} co;
+
+//
+// Comparison
+//
+static const char* cosimDescribe(const cosim_event* e, char* buf, size_t len)
+{
+    switch (e->kind)
+    {
+        case COSIM_PREDICT:
+            snprintf(buf, len, "predicts 0x%lx for processor %d", e->value,
+                     e->processorNum);
+            break;
+        case COSIM_DONE:
+            snprintf(buf, len, "completes tag %ld of processor %d",
+                     (int64_t)e->value, e->processorNum);
+            break;
+        case COSIM_FETCH:
+            snprintf(buf, len, "fetches for processor %d in %ld ticks",
+                     e->processorNum, (int64_t)e->value);
+            break;
+        default:
+            snprintf(buf, len, "returns 0x%lx to processor %d", e->value,
+                     e->processorNum);
+            break;
+    }
+    return buf;
+}
+
+static void cosimDiverge(cosim_check* c, int role, const cosim_event* cand,
+                         const cosim_event* ref, FILE* f)
+{
+    char cb[96];
+    char rb[96];
+
+    if (cand != NULL && (ref == NULL || cand->tick <= ref->tick))
+        c->divergeTick = cand->tick;
+    else
+        c->divergeTick = ref->tick;
+
+    fprintf(f, "Co-simulation - %s diverges from %s at tick %ld:\n",
+            roleName[role], c->refName, c->divergeTick);
+    if (cand != NULL)
+        fprintf(f, "  candidate %s at tick %ld\n",
+                cosimDescribe(cand, cb, sizeof(cb)), cand->tick);
+    else
+        fprintf(f, "  candidate has nothing more\n");
+    if (ref != NULL)
+        fprintf(f, "  reference %s at tick %ld\n",
+                cosimDescribe(ref, rb, sizeof(rb)), ref->tick);
+    else
+        fprintf(f, "  reference has nothing more\n");
+}
+
+static cosim_event* cosimPeek(cosim_queue* q)
+{
+    return (q->count > 0) ? &q->events[q->head] : NULL;
+}
+
+static void cosimPop(cosim_queue* q)
+{
+    q->head = (q->head + 1) % q->size;
+    q->count--;
+}
+
+static int cosimPush(cosim_queue* q, const cosim_event* e)
+{
+    if (q->count == q->size)
+    {
+        int size = (q->size > 0) ? q->size * 2 : 64;
+        cosim_event* events = malloc(size * sizeof(cosim_event));
+        if (events == NULL)
+            return -1;
+
+        for (int i = 0; i < q->count; i++)
+            events[i] = q->events[(q->head + i) % q->size];
+        free(q->events);
+        q->events = events;
+        q->head = 0;
+        q->size = size;
+    }
+
+    q->events[(q->head + q->count) % q->size] = *e;
+    q->count++;
+    return 0;
+}
+
+// Record an output of one side, and compare it with the other's once both
+//   have given it.
+static void cosimEvent(int role, int side, int kind, int processorNum,
+                       uint64_t value)
+{
+    cosim_check* c = &co.checks[role];
+    if (c->divergeTick >= 0)
+        return;
+
+    cosim_event e = {co.s->tickCount, kind, processorNum, value};
+    if (cosimPush(&c->q[side], &e) != 0)
+    {
+        cosimDiverge(c, role, &e, NULL, stderr);
+        return;
+    }
+
+    cosim_event* cand;
+    cosim_event* ref;
+    while ((cand = cosimPeek(&c->q[COSIM_CANDIDATE])) != NULL
+           && (ref = cosimPeek(&c->q[COSIM_REFERENCE])) != NULL)
+    {
+        if (cand->tick != ref->tick || cand->kind != ref->kind
+            || cand->processorNum != ref->processorNum
+            || cand->value != ref->value)
+        {
+            cosimDiverge(c, role, cand, ref, stderr);
+            return;
+        }
+
+        c->matched++;
+        cosimPop(&c->q[COSIM_CANDIDATE]);
+        cosimPop(&c->q[COSIM_REFERENCE]);
+    }
+}
+
+//
+// Wrappers
+//
+static int64_t cosimIdle(cosim_check* c, void* self)
+{
+    int64_t idle = c->idleTicks(self);
+    sim_interface* others[COSIM_MAX_BELOW + 1] = {c->ref};
+    for (int i = 0; i < c->belowCount; i++)
+        others[i + 1] = c->below[i];
+
+    for (int i = 0; i <= c->belowCount && idle > 0; i++)
+    {
+        if (others[i]->idleTicks == NULL || others[i]->skipTicks == NULL)
+            return 0;
+
+        int64_t t = others[i]->idleTicks(others[i]);
+        if (t < idle)
+            idle = t;
+    }
+
+    return idle;
+}
+
+static void cosimSkip(cosim_check* c, void* self, int64_t ticks)
+{
+    c->skipTicks(self, ticks);
+    c->ref->skipTicks(c->ref, ticks);
+    for (int i = 0; i < c->belowCount; i++)
+        c->below[i]->skipTicks(c->below[i], ticks);
+}
+
+// The reference is ticked right after the candidate, within the same tick.
+#define COSIM_SI(name, role)                                                   \
+    static int name##Tick(void* self)                                          \
+    {                                                                          \
+        cosim_check* c = &co.checks[role];                                     \
+        int r = c->tick(self);                                                 \
+        c->ref->tick(c->ref);                                                  \
+        return r;                                                              \
+    }                                                                          \
+    static int64_t name##IdleTicks(void* self)                                 \
+    {                                                                          \
+        return cosimIdle(&co.checks[role], self);                              \
+    }                                                                          \
+    static void name##SkipTicks(void* self, int64_t ticks)                     \
+    {                                                                          \
+        cosimSkip(&co.checks[role], self, ticks);                              \
+    }
+
+COSIM_SI(cosimBranch, COSIM_BRANCH)
+COSIM_SI(cosimCache, COSIM_CACHE)
+COSIM_SI(cosimMemory, COSIM_MEMORY)
+
+static uint64_t cosimBranchRequest(branch* b, trace_op* op, int processorNum)
+{
+    uint64_t pc = co.branchRequest(b, op, processorNum);
+    uint64_t refPc =
+        co.refBranch->branchRequest(co.refBranch, op, processorNum);
+
+    co.checks[COSIM_BRANCH].requests++;
+    cosimEvent(COSIM_BRANCH, COSIM_CANDIDATE, COSIM_PREDICT, processorNum, pc);
+    cosimEvent(COSIM_BRANCH, COSIM_REFERENCE, COSIM_PREDICT, processorNum,
+               refPc);
+    return pc;
+}
+
+static void cosimCacheDone(void* ctx, int processorNum, int64_t tag)
+{
+    cosimEvent(COSIM_CACHE, COSIM_CANDIDATE, COSIM_DONE, processorNum, tag);
+    co.cacheCallback(co.cacheCtx, processorNum, tag);
+}
+
+static void cosimRefCacheDone(void* ctx, int processorNum, int64_t tag)
+{
+    cosimEvent(COSIM_CACHE, COSIM_REFERENCE, COSIM_DONE, processorNum, tag);
+}
+
+static void cosimMemoryRequest(cache* c, trace_op* op, int processorNum,
+                               int64_t tag, void* ctx,
+                               void (*callback)(void*, int, int64_t))
+{
+    co.cacheCtx = ctx;
+    co.cacheCallback = callback;
+    co.checks[COSIM_CACHE].requests++;
+
+    co.memoryRequest(c, op, processorNum, tag, NULL, cosimCacheDone);
+    co.refCache->memoryRequest(co.refCache, op, processorNum, tag, NULL,
+                               cosimRefCacheDone);
+}
+
+static void cosimWarmRequest(cache* c, trace_op* op, int processorNum)
+{
+    co.warmRequest(c, op, processorNum);
+    co.refCache->warmRequest(co.refCache, op, processorNum);
+}
+
+static void cosimMemDone(void* ctx, int procNum, uint64_t addr)
+{
+    cosimEvent(COSIM_MEMORY, COSIM_CANDIDATE, COSIM_DATA, procNum, addr);
+    co.memCallback(co.memCtx, procNum, addr);
+}
+
+static void cosimRefMemDone(void* ctx, int procNum, uint64_t addr)
+{
+    cosimEvent(COSIM_MEMORY, COSIM_REFERENCE, COSIM_DATA, procNum, addr);
+}
+
+static int cosimMemBusReq(memory* m, uint64_t addr, int procNum, void* ctx,
+                          void (*callback)(void*, int, uint64_t))
+{
+    co.memCtx = ctx;
+    co.memCallback = callback;
+    co.checks[COSIM_MEMORY].requests++;
+
+    int r = co.memBusReq(m, addr, procNum, NULL, cosimMemDone);
+    cosimEvent(COSIM_MEMORY, COSIM_CANDIDATE, COSIM_FETCH, procNum, r);
+    int refR = co.refMemory->busReq(co.refMemory, addr, procNum, NULL,
+                                    cosimRefMemDone);
+    cosimEvent(COSIM_MEMORY, COSIM_REFERENCE, COSIM_FETCH, procNum, refR);
+    return r;
+}
+
+//
+// Attaching
+//
+static int cosimParse(const char* spec)
+{
+    char* copy = strdup(spec);
+    if (copy == NULL)
+        return -1;
+
+    int r = 0;
+    char* save = NULL;
+    for (char* item = strtok_r(copy, ",", &save); item != NULL && r == 0;
+         item = strtok_r(NULL, ",", &save))
+    {
+        char* ref = strchr(item, '=');
+        if (ref != NULL)
+            *ref++ = '\0';
+
+        int role = 0;
+        while (role < COSIM_ROLE_COUNT && strcmp(item, roleName[role]) != 0)
+            role++;
+        if (role == COSIM_ROLE_COUNT || (ref != NULL && *ref == '\0'))
+        {
+            fprintf(stderr, "Co-simulation checks branch, cache or memory"
+                            "[=<reference>], not %s\n",
+                    item);
+            r = -1;
+            break;
+        }
+
+        cosim_check* c = &co.checks[role];
+        free(c->refName);
+        c->on = 1;
+        c->refName = strdup((ref != NULL) ? ref : defaultRef[role]);
+        if (c->refName == NULL)
+            r = -1;
+    }
+
+    free(copy);
+    return r;
+}
+
+static struct sim* cosimLoad(cosim_check* c, int role, struct sim* candidate)
+{
+    // loadSim may change the name that it is given.
+    char name[SIM_NAME_LIMIT];
+    snprintf(name, sizeof(name), "%s", c->refName);
+
+    struct sim* rsim = loadSim(name, (char*)roleName[role], &co.env);
+    if (rsim != NULL && rsim->legacy && candidate->legacy)
+    {
+        fprintf(stderr, "The %s and its reference cannot both be legacy "
+                        "components\n",
+                roleName[role]);
+        unloadSim(rsim);
+        return NULL;
+    }
+
+    return rsim;
+}
+
+// As simInit does for each role, so that the debug hooks of the reference,
+//   which may be left in allocated memory, start out off.
+static void cosimInitDebug(struct sim* rsim, debug_env_vars* dbgEnv)
+{
+    debugInitEnv(rsim->legacy ? rsim->dbgEnv : dbgEnv);
+}
+
+// Watch the candidate's sim_interface and tick the reference with it.
+static void cosimWrap(cosim_check* c, sim_interface* cand, sim_interface* ref,
+                      int (*tick)(void*), int64_t (*idleTicks)(void*),
+                      void (*skipTicks)(void*, int64_t))
+{
+    c->cand = cand;
+    c->ref = ref;
+    c->tick = cand->tick;
+    c->idleTicks = cand->idleTicks;
+    c->skipTicks = cand->skipTicks;
+    c->divergeTick = -1;
+
+    cand->tick = tick;
+    if (cand->idleTicks != NULL && cand->skipTicks != NULL)
+    {
+        cand->idleTicks = idleTicks;
+        cand->skipTicks = skipTicks;
+    }
+}
+
+static int cosimAttachBranch(simulation* s)
+{
+    cosim_check* c = &co.checks[COSIM_BRANCH];
+
+    c->rsim = cosimLoad(c, COSIM_BRANCH, s->bsim);
+    if (c->rsim == NULL)
+        return -1;
+    co.refBranch = simBranchInit(c->rsim, &co.env);
+    if (co.refBranch == NULL)
+        return -1;
+    cosimInitDebug(c->rsim, &co.refBranch->dbgEnv);
+
+    cosimWrap(c, &s->branch_sim->si, &co.refBranch->si, cosimBranchTick,
+              cosimBranchIdleTicks, cosimBranchSkipTicks);
+    co.branchRequest = s->branch_sim->branchRequest;
+    s->branch_sim->branchRequest = cosimBranchRequest;
+    return 0;
+}
+
+static int cosimAttachCache(simulation* s)
+{
+    cosim_check* c = &co.checks[COSIM_CACHE];
+
+    // The reference hierarchy is ticked with the cache.
+    if (s->clock.on)
+    {
+        fprintf(stderr, "The cache cannot be co-simulated with clock "
+                        "domains\n");
+        return -1;
+    }
+    if (s->osim->legacy || s->isim->legacy || s->msim->legacy)
+    {
+        fprintf(stderr, "The cache can only be co-simulated over a "
+                        "coherence, interconnect and memory that are not "
+                        "legacy components\n");
+        return -1;
+    }
+
+    c->rsim = cosimLoad(c, COSIM_CACHE, s->csim);
+    if (c->rsim == NULL)
+        return -1;
+
+    memory* mem = simMemoryInit(s->msim, &co.env);
+    interconn* inter = (mem != NULL) ? simInterInit(s->isim, &co.env, mem)
+                                     : NULL;
+    co.shadowCoher =
+        (inter != NULL) ? simCoherInit(s->osim, &co.env, inter) : NULL;
+    if (co.shadowCoher == NULL)
+    {
+        if (inter != NULL)
+            inter->si.destroy(inter);
+        else if (mem != NULL)
+            mem->si.destroy(mem);
+        return -1;
+    }
+    debugInitEnv(&mem->dbgEnv);
+    debugInitEnv(&inter->dbgEnv);
+    debugInitEnv(&co.shadowCoher->dbgEnv);
+    c->below[c->belowCount++] = &co.shadowCoher->si;
+    c->below[c->belowCount++] = &inter->si;
+    c->below[c->belowCount++] = &mem->si;
+
+    co.refCache = simCacheInit(c->rsim, &co.env, co.shadowCoher);
+    if (co.refCache == NULL)
+        return -1;
+    cosimInitDebug(c->rsim, &co.refCache->dbgEnv);
+
+    cosimWrap(c, &s->cache_sim->si, &co.refCache->si, cosimCacheTick,
+              cosimCacheIdleTicks, cosimCacheSkipTicks);
+    co.memoryRequest = s->cache_sim->memoryRequest;
+    s->cache_sim->memoryRequest = cosimMemoryRequest;
+
+    // Both are warmed, or neither can be.
+    co.warmRequest = s->cache_sim->warmRequest;
+    if (co.refCache->warmRequest == NULL)
+        s->cache_sim->warmRequest = NULL;
+    else if (co.warmRequest != NULL)
+        s->cache_sim->warmRequest = cosimWarmRequest;
+    return 0;
+}
+
+static int cosimAttachMemory(simulation* s)
+{
+    cosim_check* c = &co.checks[COSIM_MEMORY];
+
+    c->rsim = cosimLoad(c, COSIM_MEMORY, s->msim);
+    if (c->rsim == NULL)
+        return -1;
+    co.refMemory = simMemoryInit(c->rsim, &co.env);
+    if (co.refMemory == NULL)
+        return -1;
+    cosimInitDebug(c->rsim, &co.refMemory->dbgEnv);
+
+    // The reference sees the same cache-to-cache transfers.
+    co.refMemory->registerInterconnect(co.refMemory, s->inter_sim);
+
+    cosimWrap(c, &s->mem_sim->si, &co.refMemory->si, cosimMemoryTick,
+              cosimMemoryIdleTicks, cosimMemorySkipTicks);
+    co.memBusReq = s->mem_sim->busReq;
+    s->mem_sim->busReq = cosimMemBusReq;
+    return 0;
+}
+
+int cosimAttach(simulation* s, const char* spec)
+{
+    if (co.s != NULL)
+    {
+        fprintf(stderr, "Only one simulation can be co-simulated at a time\n");
+        return -1;
+    }
+
+    memset(&co, 0, sizeof(co));
+    co.s = s;
+    co.env = s->env;
+    co.env.stats = NULL;
+    co.env.events = NULL;
+
+    int r = cosimParse(spec);
+    if (r == 0 && co.checks[COSIM_BRANCH].on)
+        r = cosimAttachBranch(s);
+    if (r == 0 && co.checks[COSIM_CACHE].on)
+        r = cosimAttachCache(s);
+    if (r == 0 && co.checks[COSIM_MEMORY].on)
+        r = cosimAttachMemory(s);
+
+    if (r != 0)
+    {
+        fprintf(stderr, "Failed to set up the co-simulation\n");
+        cosimDetach(s);
+    }
+    return r;
+}
+
+//
+// Detaching
+//
+static int cosimStubDestroy(void* self)
+{
+    return 0;
+}
+
+void cosimDetach(simulation* s)
+{
+    if (co.s != s)
+        return;
+
+    for (int role = 0; role < COSIM_ROLE_COUNT; role++)
+    {
+        cosim_check* c = &co.checks[role];
+        if (c->cand == NULL)
+            continue;
+
+        c->cand->tick = c->tick;
+        c->cand->idleTicks = c->idleTicks;
+        c->cand->skipTicks = c->skipTicks;
+    }
+    if (co.branchRequest != NULL)
+        s->branch_sim->branchRequest = co.branchRequest;
+    if (co.memoryRequest != NULL)
+    {
+        s->cache_sim->memoryRequest = co.memoryRequest;
+        s->cache_sim->warmRequest = co.warmRequest;
+    }
+    if (co.memBusReq != NULL)
+        s->mem_sim->busReq = co.memBusReq;
+
+    if (co.refBranch != NULL)
+        co.refBranch->si.destroy(co.refBranch);
+    if (co.refMemory != NULL)
+        co.refMemory->si.destroy(co.refMemory);
+
+    // A reference cache may or may not destroy its coherence in turn, so
+    //   the shadow hierarchy is destroyed here either way.
+    if (co.shadowCoher != NULL)
+    {
+        int (*destroy)(void*) = co.shadowCoher->si.destroy;
+        co.shadowCoher->si.destroy = cosimStubDestroy;
+        if (co.refCache != NULL)
+            co.refCache->si.destroy(co.refCache);
+        destroy(co.shadowCoher);
+    }
+
+    for (int role = 0; role < COSIM_ROLE_COUNT; role++)
+    {
+        cosim_check* c = &co.checks[role];
+        if (c->rsim != NULL && !c->rsim->keep)
+            unloadSim(c->rsim);
+        free(c->refName);
+        free(c->q[COSIM_CANDIDATE].events);
+        free(c->q[COSIM_REFERENCE].events);
+    }
+
+    memset(&co, 0, sizeof(co));
+}
+
+int cosimReport(FILE* f)
+{
+    int r = 0;
+
+    for (int role = 0; role < COSIM_ROLE_COUNT; role++)
+    {
+        cosim_check* c = &co.checks[role];
+        if (c->cand == NULL)
+            continue;
+
+        // An output that the other side never gave.
+        if (c->divergeTick < 0)
+        {
+            cosim_event* cand = cosimPeek(&c->q[COSIM_CANDIDATE]);
+            cosim_event* ref = cosimPeek(&c->q[COSIM_REFERENCE]);
+            if (cand != NULL || ref != NULL)
+                cosimDiverge(c, role, cand, ref, stderr);
+        }
+
+        if (c->divergeTick < 0)
+        {
+            fprintf(f, "Co-simulation - %s matches %s over %lu requests, "
+                       "%lu outputs\n",
+                    roleName[role], c->refName, c->requests, c->matched);
+        }
+        else
+        {
+            fprintf(f, "Co-simulation - %s diverges from %s at tick %ld, "
+                       "after %lu matching outputs\n",
+                    roleName[role], c->refName, c->divergeTick, c->matched);
+            r = -1;
+        }
+    }
+
+    return r;
+}
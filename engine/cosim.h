@@ -0,0 +1,45 @@
+#ifndef COSIM_H
+#define COSIM_H
+
+#include <stdio.h>
+
+#include "sim.h"
+
+//
+// Co-simulation
+//
+//   Checks components of a simulation against reference implementations,
+// such as the ref* libraries, in lockstep.  For each checked role, the
+// reference is loaded next to the candidate and given every request that
+// the candidate is given, at the same tick, and is ticked whenever the
+// candidate is:
+//   branch - each branchRequest, comparing the predicted PCs
+//   cache  - each memoryRequest, comparing the ticks and tags of the
+//            completions; the reference cache has a coherence, interconnect
+//            and memory of its own, new instances of those of the
+//            simulation
+//   memory - each busReq, comparing the fetch times returned and the ticks
+//            of the callbacks
+// The outputs of each side are compared in order, and the first that
+// differ are reported as soon as they are seen, with the tick at which they
+// diverge.  Only the candidate drives the simulation.
+//
+//   Like the legacy views, a candidate and its reference cannot both be
+// legacy components, and only one simulation in a process can be checked at
+// a time.  The requestor of the cache and of memory is taken to be the same
+// for every request, as it is with the components in this repository.
+//
+
+// Check the roles in spec, a comma separated list of branch, cache or
+//   memory, each with an optional =<reference>, by default refBranch,
+//   refCache and refMemory.  0 on success.
+int cosimAttach(simulation* s, const char* spec);
+
+// Put back the original entry points of s and release the references.
+void cosimDetach(simulation* s);
+
+// Write whether each checked role matched its reference, and where it
+//   diverged.  0 if they all matched.
+int cosimReport(FILE* f);
+
+#endif
@@ -1,12 +1,14 @@
 #include <stdio.h>
 #include <stdint.h>
 #include <stdlib.h>
+#include <string.h>
 #include <sys/ptrace.h>
 #include <sys/wait.h>
 #include <unistd.h>
 #include <assert.h>
 
 #include "engine.h"
+#include "watch.h"
 
 int CADSS_DBG_ON = 0;
 int64_t CADSS_DBG_TICK = -1;
@@ -64,9 +66,19 @@ static void printDebugHelp()
            "              arg: T, where T > 0\n"
            "              If unspecified, advances by 1 tick.\n\n"
            "     c        Continue execution until state change.\n\n"
-           "     e        Exit from debug REPL.\n\n"
+           "     a [addr] Break when a processor requests addr.\n"
+           "              addr: in hex, as in the trace.  Addresses\n"
+           "              match by the block of the processor's\n"
+           "              cache, as set by its -b.\n\n"
+           "     s [addr] Break when the coherence state of addr changes\n"
+           "              in any cache.\n\n"
+           "     p [P] [N]\n"
+           "              Break when more than N requests of processor P\n"
+           "              wait for the bus.  Without N, stops watching P.\n\n"
+           "     x [addr] Delete the watchpoints on addr, or all of them.\n\n"
+           "     e        Exit from debug REPL, until a watchpoint is hit.\n\n"
            "     q        Quit (exit and halt) the simulation.\n\n"
-           "     l        List watched components.\n\n"
+           "     l        List watched components and watchpoints.\n\n"
            "     h        Show help message.\n");
 }
 
@@ -80,7 +92,26 @@ static void printDebugWatchedComps()
            !!(CADSS_DBG_WLIST_STATE & CADSS_DBG_WATCH_COHER),
            !!(CADSS_DBG_WLIST_STATE & CADSS_DBG_WATCH_INTER),
            !!(CADSS_DBG_WLIST_STATE & CADSS_DBG_WATCH_MEM));
+
+    if (watchCount() > 0)
+        watchList();
+}
+
+// Parse the address argument of a watchpoint command, 0 on success.
+static int parseDebugAddr(const char* args, uint64_t* addr)
+{
+    char* end;
+
+    *addr = strtoull(args, &end, 16);
+    if (end == args)
+    {
+        printf("Expected an address in hex.\n");
+        return -1;
+    }
+
+    return 0;
 }
+
 enum dbgCmd parseDebugReplCmd(const char* cmdStr)
 {
     switch (cmdStr[0])
@@ -101,6 +132,14 @@ enum dbgCmd parseDebugReplCmd(const char* cmdStr)
             return CMD_HLP;
         case 'l':
             return CMD_LST;
+        case 'a':
+            return CMD_ADR;
+        case 's':
+            return CMD_STA;
+        case 'p':
+            return CMD_QUE;
+        case 'x':
+            return CMD_DEL;
         default:
             return CMD_ERR;
     }
@@ -154,6 +193,37 @@ int handleDbgReplCmd(enum dbgCmd cmd, const char* cmdStr)
             CADSS_DBG_WLIST_STATE = 0;
             break;
 
+        case CMD_ADR:
+        case CMD_STA:
+        {
+            uint64_t addr;
+            if (parseDebugAddr(cmdStr + 1, &addr) == 0)
+                watchAddress(addr,
+                             (cmd == CMD_ADR) ? WATCH_REQUEST : WATCH_STATE);
+            break;
+        }
+
+        case CMD_QUE:
+        {
+            int proc, length = -1;
+            if (sscanf(cmdStr + 1, "%d %d", &proc, &length) < 1)
+                printf("Expected a processor and a queue length.\n");
+            else
+                watchQueue(proc, length);
+            break;
+        }
+
+        case CMD_DEL:
+        {
+            uint64_t addr;
+            if (strspn(cmdStr + 1, " ") == strlen(cmdStr + 1))
+                watchClear();
+            else if (parseDebugAddr(cmdStr + 1, &addr) == 0
+                     && watchRemove(addr) != 0)
+                printf("No watchpoint on %lx.\n", addr);
+            break;
+        }
+
         default:
             printf("Invalid command; use 'h' to display usage.\n");
             break;
@@ -196,3 +266,97 @@ int isProcTracedExt()
 
     return WEXITSTATUS(status);
 }
+
+// Handle debug REPL prompts.
+int debugRepl(int64_t tickCount)
+{
+    char line[MAX_DBG_LINE_BUF_SIZE + 1] = {0};
+    enum dbgCmd cmd;
+    int showPrompt = 1;
+
+    // Disable cadss debug REPL if the engine
+    // is invoked with an external debugger.
+    if (CADSS_DBG_EXT)
+        return 0;
+
+    // If "-d <tick>", then turn on debugging after that tick, once.
+    if (CADSS_DBG_TICK >= 0 && tickCount >= CADSS_DBG_TICK)
+    {
+        CADSS_DBG_ON = 1;
+        CADSS_DBG_TICK = -1;
+    }
+
+    // A watchpoint that was hit stops any stepping or continuing, even
+    // after the REPL was exited.
+    const char* hit = watchHit();
+    if (hit != NULL)
+    {
+        printf("%s\n", hit);
+        CADSS_DBG_ON = 1;
+        CADSS_DBG_NOTIF = 0;
+        CADSS_DBG_STEP_TICKS = 0;
+    }
+
+    if (!CADSS_DBG_ON)
+        return 0;
+
+    if (CADSS_DBG_NOTIF)
+        return 0;
+
+    // Step through.
+    if (--CADSS_DBG_STEP_TICKS > 0)
+    {
+        return 0;
+    }
+
+    // REPL.
+    while (showPrompt)
+    {
+        memset(line, 0x0, MAX_DBG_LINE_BUF_SIZE + 1);
+
+        // Display prompt, get input.
+        if (tickCount)
+            printf("Tick: %ld\n", tickCount);
+
+        printf("> ");
+        if (fgets(line, MAX_DBG_LINE_BUF_SIZE, stdin) != line)
+            continue;
+
+        line[strcspn(line, "\n")] = '\0';
+        cmd = parseDebugReplCmd(line);
+
+        if (cmd == CMD_HLT)
+            return 1;
+
+        showPrompt = handleDbgReplCmd(cmd, line);
+    }
+
+    return 0;
+}
+
+int debugActive(void)
+{
+    return CADSS_DBG_ON || CADSS_DBG_TICK >= 0 || CADSS_DBG_EXT
+           || watchCount() > 0;
+}
+
+void debugInitEnv(debug_env_vars* compEnv)
+{
+    compEnv->cadssDbgNotifyState = 0;
+    compEnv->cadssDbgWatchedComp = 0;
+    compEnv->cadssDbgExternBreak = CADSS_DBG_EXT;
+}
+
+void debugWatchComponent(debug_env_vars* compEnv, uint8_t mask)
+{
+    compEnv->cadssDbgWatchedComp = !!(CADSS_DBG_WLIST_STATE & mask);
+
+    if (compEnv->cadssDbgWatchedComp)
+        compEnv->cadssDbgNotifyState = CADSS_DBG_NOTIF;
+}
+
+void debugCheckNotif(debug_env_vars* compEnv)
+{
+    if (compEnv->cadssDbgWatchedComp)
+        CADSS_DBG_NOTIF &= compEnv->cadssDbgNotifyState;
+}
@@ -0,0 +1,177 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "digest.h"
+
+enum digest_kind
+{
+    DIGEST_CACHE_DONE,
+    DIGEST_INTER_BUS,
+    DIGEST_COHER_BUS,
+    DIGEST_MEM_DONE
+};
+
+// FNV-1a, 64 bit.
+#define DIGEST_HASH_BASIS 0xcbf29ce484222325UL
+#define DIGEST_HASH_PRIME 0x100000001b3UL
+
+static struct {
+    simulation* s;
+    FILE* f;
+    int64_t interval;
+    int64_t end; // Of the interval being hashed.
+    uint64_t hash;
+    uint64_t events;
+
+    // Original entry points.
+    void (*memoryRequest)(cache*, trace_op*, int, int64_t, void*,
+                          void (*)(void*, int, int64_t));
+    void (*interBusReq)(interconn*, bus_req_type, uint64_t, int);
+    uint8_t (*coherBusReq)(coher*, bus_req_type, uint64_t, int);
+    int (*memBusReq)(memory*, uint64_t, int, void*,
+                     void (*)(void*, int, uint64_t));
+
+    // The requestors of the cache and memory.
+    void* cacheCtx;
+    void (*cacheCallback)(void*, int, int64_t);
+    void* memCtx;
+    void (*memCallback)(void*, int, uint64_t);
+} dg;
+
+static inline void digestWord(uint64_t w)
+{
+    uint64_t h = dg.hash;
+
+    for (int i = 0; i < 8; i++)
+    {
+        h ^= (w >> (8 * i)) & 0xff;
+        h *= DIGEST_HASH_PRIME;
+    }
+    dg.hash = h;
+}
+
+// Write every interval that ended before tick.
+static void digestFlush(int64_t tick)
+{
+    while (tick >= dg.end)
+    {
+        fprintf(dg.f, "%ld,%lu,%016lx\n", dg.end, dg.events, dg.hash);
+        dg.events = 0;
+        dg.end += dg.interval;
+    }
+}
+
+static void digestEvent(int kind, uint64_t a, uint64_t b, uint64_t c)
+{
+    int64_t tick = dg.s->tickCount;
+
+    digestFlush(tick);
+    digestWord(tick);
+    digestWord(kind);
+    digestWord(a);
+    digestWord(b);
+    digestWord(c);
+    dg.events++;
+}
+
+//
+// Wrappers
+//
+static void digestCacheDone(void* ctx, int processorNum, int64_t tag)
+{
+    digestEvent(DIGEST_CACHE_DONE, processorNum, tag, 0);
+    dg.cacheCallback(dg.cacheCtx, processorNum, tag);
+}
+
+static void digestMemoryRequest(cache* c, trace_op* op, int processorNum,
+                                int64_t tag, void* ctx,
+                                void (*callback)(void*, int, int64_t))
+{
+    dg.cacheCtx = ctx;
+    dg.cacheCallback = callback;
+    dg.memoryRequest(c, op, processorNum, tag, NULL, digestCacheDone);
+}
+
+static void digestInterBusReq(interconn* ic, bus_req_type brt, uint64_t addr,
+                              int procNum)
+{
+    digestEvent(DIGEST_INTER_BUS, brt, addr, procNum);
+    dg.interBusReq(ic, brt, addr, procNum);
+}
+
+static uint8_t digestCoherBusReq(coher* cc, bus_req_type reqType,
+                                 uint64_t addr, int processorNum)
+{
+    digestEvent(DIGEST_COHER_BUS, reqType, addr, processorNum);
+    return dg.coherBusReq(cc, reqType, addr, processorNum);
+}
+
+static void digestMemDone(void* ctx, int procNum, uint64_t addr)
+{
+    digestEvent(DIGEST_MEM_DONE, procNum, addr, 0);
+    dg.memCallback(dg.memCtx, procNum, addr);
+}
+
+static int digestMemBusReq(memory* m, uint64_t addr, int procNum, void* ctx,
+                           void (*callback)(void*, int, uint64_t))
+{
+    dg.memCtx = ctx;
+    dg.memCallback = callback;
+    return dg.memBusReq(m, addr, procNum, NULL, digestMemDone);
+}
+
+int digestAttach(simulation* s, FILE* f, int64_t interval)
+{
+    if (dg.s != NULL)
+    {
+        fprintf(stderr, "Only one simulation can be digested at a time\n");
+        return -1;
+    }
+    if (interval <= 0)
+    {
+        fprintf(stderr, "The digest interval must be at least 1 tick\n");
+        return -1;
+    }
+
+    memset(&dg, 0, sizeof(dg));
+    dg.s = s;
+    dg.f = f;
+    dg.interval = interval;
+    dg.end = s->tickCount + interval;
+    dg.hash = DIGEST_HASH_BASIS;
+    fprintf(f, "tick,events,hash\n");
+
+    dg.memoryRequest = s->cache_sim->memoryRequest;
+    s->cache_sim->memoryRequest = digestMemoryRequest;
+
+    dg.interBusReq = s->inter_sim->busReq;
+    s->inter_sim->busReq = digestInterBusReq;
+
+    dg.coherBusReq = s->coher_sim->busReq;
+    s->coher_sim->busReq = digestCoherBusReq;
+
+    dg.memBusReq = s->mem_sim->busReq;
+    s->mem_sim->busReq = digestMemBusReq;
+
+    return 0;
+}
+
+void digestDetach(simulation* s)
+{
+    if (dg.s != s)
+        return;
+
+    // The last interval ends with the run.
+    digestFlush(s->tickCount - 1);
+    if (dg.events > 0 || dg.end - dg.interval < s->tickCount)
+        fprintf(dg.f, "%ld,%lu,%016lx\n", s->tickCount, dg.events, dg.hash);
+    fflush(dg.f);
+
+    s->cache_sim->memoryRequest = dg.memoryRequest;
+    s->inter_sim->busReq = dg.interBusReq;
+    s->coher_sim->busReq = dg.coherBusReq;
+    s->mem_sim->busReq = dg.memBusReq;
+
+    dg.s = NULL;
+}
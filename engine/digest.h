@@ -0,0 +1,38 @@
+#ifndef DIGEST_H
+#define DIGEST_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "sim.h"
+
+//
+// Digest
+//
+//   A rolling hash of the events that can be observed between the
+// components of a simulation, to show that a change to a component keeps
+// every cycle the same.  The events are:
+//   - completions of cache requests, with the processor and tag
+//   - bus requests to the interconnect, and from it to coherence, with the
+//     type, address and processor
+//   - completions of memory fetches, with the processor and address
+// each hashed with the tick at which it happens.  At the end of every
+// interval of ticks, the hash so far and the number of events in the
+// interval are written as a CSV line of tick,events,hash, with an empty
+// interval written as such, so that the lines of two runs always cover the
+// same ticks.  cadss-digest compares two of them.
+//
+//   Like the profiler, the digest wraps the entry points of the instances,
+// and only one simulation in a process can be digested at a time.  The
+// requestor of the cache and of memory is taken to be the same for every
+// request.
+//
+
+// Start the digest of s, written to f every interval ticks from the tick
+//   that s is at.  0 on success.
+int digestAttach(simulation* s, FILE* f, int64_t interval);
+
+// Write the last, partial interval and put back the entry points of s.
+void digestDetach(simulation* s);
+
+#endif
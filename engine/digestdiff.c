@@ -0,0 +1,131 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+//
+// Digest diff
+//
+//   Compares the digests of two runs, as written by cadss-engine -H, and
+// reports the first interval in which they differ: the first in which the
+// events so far hash differently, or that one run has and the other does
+// not.  The two runs match cycle for cycle, as far as the digest can tell,
+// if every interval does.  Exits with 0 if they match, 1 if they differ and
+// 2 if a digest cannot be read.
+//
+
+#define DIGEST_LINE_LIMIT 256
+
+struct digest_line {
+    int64_t tick;
+    uint64_t events;
+    uint64_t hash;
+};
+
+// The next interval of f, 1 if there is one, 0 at the end and -1 if the line
+//   cannot be read.
+static int readInterval(FILE* f, const char* path, int64_t* lineNum,
+                        struct digest_line* dl)
+{
+    char line[DIGEST_LINE_LIMIT];
+
+    while (fgets(line, sizeof(line), f) != NULL)
+    {
+        (*lineNum)++;
+        if (strncmp(line, "tick,", 5) == 0)
+            continue;
+
+        if (sscanf(line, "%ld,%lu,%lx", &dl->tick, &dl->events, &dl->hash)
+            != 3)
+        {
+            fprintf(stderr, "%s:%ld: expected tick,events,hash\n", path,
+                    *lineNum);
+            return -1;
+        }
+        return 1;
+    }
+
+    return ferror(f) ? -1 : 0;
+}
+
+static void printInterval(const char* path, int more,
+                          const struct digest_line* dl)
+{
+    if (more)
+        printf("  %s: %lu events, hash %016lx\n", path, dl->events,
+               dl->hash);
+    else
+        printf("  %s: ended\n", path);
+}
+
+int main(int argc, char** argv)
+{
+    int help = (argc == 2 && strcmp(argv[1], "-h") == 0);
+    if (argc != 3 || help)
+    {
+        printf("%s <digest> <digest>\n", argv[0]);
+        printf("  Compare the digests of two runs, written by cadss-engine "
+               "-H, and report\n  the first interval in which they "
+               "differ\n");
+        return help ? 0 : 2;
+    }
+
+    FILE* f[2];
+    for (int i = 0; i < 2; i++)
+    {
+        f[i] = fopen(argv[i + 1], "r");
+        if (f[i] == NULL)
+        {
+            perror(argv[i + 1]);
+            return 2;
+        }
+    }
+
+    int64_t lineNum[2] = {0, 0};
+    int64_t intervals = 0;
+    int64_t start = 0; // Of the interval being compared.
+    uint64_t events = 0;
+    int r = 0;
+    while (r == 0)
+    {
+        struct digest_line dl[2];
+        int more[2];
+        for (int i = 0; i < 2; i++)
+        {
+            more[i] = readInterval(f[i], argv[i + 1], &lineNum[i], &dl[i]);
+            if (more[i] < 0)
+                r = 2;
+        }
+        if (r != 0 || (!more[0] && !more[1]))
+            break;
+
+        if (more[0] && more[1] && dl[0].tick == dl[1].tick
+            && dl[0].events == dl[1].events && dl[0].hash == dl[1].hash)
+        {
+            intervals++;
+            events += dl[0].events;
+            start = dl[0].tick;
+            continue;
+        }
+
+        int64_t end = (more[0] && (!more[1] || dl[0].tick <= dl[1].tick))
+                          ? dl[0].tick
+                          : dl[1].tick;
+        printf("First difference in the interval from tick %ld to %ld, "
+               "after %ld matching intervals:\n",
+               start, end, intervals);
+        printInterval(argv[1], more[0], &dl[0]);
+        printInterval(argv[2], more[1], &dl[1]);
+        r = 1;
+    }
+
+    if (r == 0)
+    {
+        printf("Digests match over %ld intervals, %lu events, to tick %ld\n",
+               intervals, events, start);
+    }
+
+    fclose(f[0]);
+    fclose(f[1]);
+    return r;
+}
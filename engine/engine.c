@@ -1,19 +1,51 @@
 #include <stdio.h>
 #include <getopt.h>
-#include <dlfcn.h>
 #include <stdlib.h>
+#include <string.h>
 #include <trace.h>
-#include <processor.h>
-#include <branch.h>
 #include <unistd.h>
-#include <libgen.h>
 
 #include "config.h"
+#include "cosim.h"
+#include "digest.h"
 #include "engine.h"
+#include "latency.h"
+#include "memo.h"
+#include "mix.h"
+#include "profile.h"
+#include "reqtrace.h"
+#include "sim.h"
 
 int CADSS_VERBOSE = 0;
 int processorCount = 1;
 
+// Long options that have no short form.
+enum
+{
+    OPT_PROFILE = 256,
+    OPT_MIN_OPS,
+    OPT_RATE,
+    OPT_MEMO,
+    OPT_COSIM,
+    OPT_DIGEST_EVERY,
+    OPT_REQ_TRACE,
+    OPT_REQ_TRACE_SIZE,
+    OPT_LATENCY
+};
+
+static struct option longOptions[] = {
+    {"profile", optional_argument, NULL, OPT_PROFILE},
+    {"min-ops", required_argument, NULL, OPT_MIN_OPS},
+    {"rate", optional_argument, NULL, OPT_RATE},
+    {"memo", required_argument, NULL, OPT_MEMO},
+    {"cosim", required_argument, NULL, OPT_COSIM},
+    {"digest-every", required_argument, NULL, OPT_DIGEST_EVERY},
+    {"req-trace", required_argument, NULL, OPT_REQ_TRACE},
+    {"req-trace-size", required_argument, NULL, OPT_REQ_TRACE_SIZE},
+    {"latency", no_argument, NULL, OPT_LATENCY},
+    {NULL, 0, NULL, 0},
+};
+
 void printHelp(char* prog)
 {
     printf("%s \n", prog);
@@ -27,7 +59,50 @@ void printHelp(char* prog)
     printf("  -b <file>   \t Branch simulator\n");
     printf("  -m <file>   \t Memory simulator\n");
     printf("  -t <file>   \t Trace file / directory\n");
+    printf("  -M <file>   \t Mix of a trace for each processor, one per\n"
+           "              \t  line as <trace> [<offset> [<alone IPC>]];\n"
+           "              \t  sets -n and reports the speedups\n");
+    printf("  --min-ops <ops>\t With -M, start programs over until each\n"
+           "              \t  has run <ops> ops\n");
+    printf("  --rate[=<stride>]\t Run the trace file on every processor,\n"
+           "              \t  decoded once, with data addresses <stride>\n"
+           "              \t  apart on each, default 0x10000000000\n");
     printf("  -s <file>   \t Setting / configuration file\n");
+    printf("  -w <ops>    \t Warm caches and predictors with <ops> ops of\n"
+           "              \t  each processor before the timed run\n");
+    printf("  -S <file>   \t Write statistics as JSON, or as CSV if <file>\n"
+           "              \t  ends in .csv, - for stdout\n");
+    printf("  -T <file>   \t Write statistics every interval, as CSV\n");
+    printf("  -e <ticks>  \t Interval for -T, default 10000 ticks\n");
+    printf("  -E <ops>    \t Interval for -T in committed ops instead\n");
+    printf("  -C <names>  \t Statistics for -T, comma separated, such as\n"
+           "              \t  cache,interconnect.busyTicks; default all\n");
+    printf("  -H <file>   \t Write a rolling hash of the cache completions,\n"
+           "              \t  bus requests and memory completions every\n"
+           "              \t  interval, to compare runs with cadss-digest\n");
+    printf("  --digest-every <ticks>\t Interval for -H, default 10000 ticks\n");
+    printf("  --latency   \t Report the latency of memory requests for each\n"
+           "              \t  processor and outcome: hit, upgrade, cache\n"
+           "              \t  transfer or dram\n");
+    printf("  --req-trace <file>\t Write the stages of the last memory\n"
+           "              \t  requests as Chrome trace-event JSON, with\n"
+           "              \t  ticks as timestamps, shown as microseconds\n");
+    printf("  --req-trace-size <events>\t Events kept for --req-trace,\n"
+           "              \t  default 1048576\n");
+    printf("  -k <tick>   \t Write a checkpoint at <tick> and stop\n");
+    printf("  -f <file>   \t Checkpoint file for -k, default cadss.ckpt\n");
+    printf("  -r <file>   \t Resume from a checkpoint\n");
+    printf("  -P <sec>    \t Print progress every <sec> seconds; SIGUSR1\n"
+           "              \t  writes the statistics at any time\n");
+    printf("  --memo <dir>\t Write the results of an identical earlier run\n"
+           "              \t  kept in <dir> instead of simulating, or keep\n"
+           "              \t  these there\n");
+    printf("  --cosim <roles>\t Check branch, cache and/or memory, comma\n"
+           "              \t  separated, against refBranch, refCache and\n"
+           "              \t  refMemory, or <role>=<reference>, in lockstep,\n"
+           "              \t  reporting the first tick where they diverge\n");
+    printf("  --profile[=perf]\t Report the host time spent in each component\n"
+           "              \t  entry point, with perf counters if =perf\n");
     printf("  -d [<tick>] \t Enable debugging\n"
            "              \t  - drops into a debug REPL\n"
            "              \t  - if <tick> specified, waits for <tick>\n"
@@ -36,171 +111,84 @@ void printHelp(char* prog)
            "              \t    changes deliver SIGTRAP\n");
 }
 
-//
-// loadSim (name, type)
-//    Attempts to load "name/libname.so"
-//
-struct sim* loadSim(char* name, char* type)
-{
-    char* baseName = NULL;
-    char fullName[SIM_NAME_LIMIT] = {0};
-    ssize_t len;
-
-    // TODO
-    //  - Support for alternate naming schemes
-    //  - if debug == 1, try loading a -debug.so
-    baseName = basename(name);
-
-    len = snprintf(fullName, SIM_NAME_LIMIT, "%s/lib%s.so", name, baseName);
-    if (len == SIM_NAME_LIMIT || len < 0)
-    {
-        fprintf(stderr,
-                "Failed to generate so name for %s component using %s\n", type,
-                name);
-
-        return NULL;
-    }
-
-    void* handle = dlopen(fullName, RTLD_LAZY);
-    if (handle == NULL)
-    {
-        fprintf(stderr, "Failed to load %s component using %s: %s\n", type,
-                fullName, dlerror());
-        return NULL;
-    }
-
-    struct sim* s = malloc(sizeof(struct sim));
-    if (s == NULL)
-    {
-        dlclose(handle);
-        fprintf(stderr, "Failed to allocate space for %s component\n", type);
-        return NULL;
-    }
-
-    s->handle = handle;
-    s->init = dlsym(handle, "init");
-    s->tick = dlsym(handle, "tick");
-    s->finish = dlsym(handle, "finish");
-    s->destroy = dlsym(handle, "destroy");
-    s->CADSS_VERBOSE = dlsym(handle, "CADSS_VERBOSE");
-    if (s->CADSS_VERBOSE != NULL)
-    {
-        *(s->CADSS_VERBOSE) = CADSS_VERBOSE;
-    }
-
-    int* pCount = dlsym(handle, "processorCount");
-    if (pCount != NULL)
-    {
-        *pCount = processorCount;
-    }
-
-    if (s->init == NULL || s->tick == NULL || s->finish == NULL
-        || s->destroy == NULL)
-    {
-        dlclose(handle);
-        free(s);
-        fprintf(stderr, "Failed to load interface for %s component\n", type);
-        return NULL;
-    }
-    return s;
-}
-
-// Handle debug REPL prompts.
-static int debugRepl(int64_t tickCount)
+// Add everything that the results of the run depend on to the key of mm:
+//   the engine, the components, the settings, the trace and the options.
+//   0 if the trace could be read.
+static int memoRun(memo* mm, const sim_names* names, const char* traceName,
+                   const mix* m, const char* rateStride, int64_t warmOps,
+                   int64_t minOps, int latency)
 {
-    char line[MAX_DBG_LINE_BUF_SIZE + 1] = {0};
-    enum dbgCmd cmd;
-    int showPrompt = 1;
-
-    // Disable cadss debug REPL if the engine
-    // is invoked with an external debugger.
-    if (CADSS_DBG_EXT)
-        return 0;
-
-    // If "-d <tick>", then turn on debugging after that tick.
-    if (CADSS_DBG_TICK >= 0 && tickCount >= CADSS_DBG_TICK)
-    {
-        CADSS_DBG_ON = 1;
-    }
-
-    if (!CADSS_DBG_ON)
-        return 0;
-
-    if (CADSS_DBG_NOTIF)
-        return 0;
-
-    // Step through.
-    if (--CADSS_DBG_STEP_TICKS > 0)
-    {
-        return 0;
-    }
-
-    // REPL.
-    while (showPrompt)
+    memoPath(mm, "/proc/self/exe");
+
+    const char* roles[][2] = {
+        {"trace", "trace"},
+        {names->proc, "processor"},
+        {names->branch, "branch"},
+        {names->cache, "cache"},
+        {names->coher, "coherence"},
+        {names->inter, "interconnect"},
+        {names->mem, "memory"},
+    };
+    for (int i = 0; i < sizeof(roles) / sizeof(roles[0]); i++)
+        memoComponent(mm, (roles[i][0] != NULL) ? roles[i][0] : roles[i][1]);
+
+    memoSettings(mm);
+    memoInt(mm, processorCount);
+    memoInt(mm, warmOps);
+    memoInt(mm, minOps);
+    memoInt(mm, latency);
+    memoString(mm, (rateStride != NULL) ? rateStride : "");
+
+    if (m->count == 0)
+        return memoPath(mm, traceName);
+
+    for (int i = 0; i < m->count; i++)
     {
-        memset(line, 0x0, MAX_DBG_LINE_BUF_SIZE + 1);
-
-        // Display prompt, get input.
-        if (tickCount)
-            printf("Tick: %ld\n", tickCount);
-
-        printf("> ");
-        if (fgets(line, MAX_DBG_LINE_BUF_SIZE, stdin) != line)
-            continue;
-
-        line[strcspn(line, "\n")] = '\0';
-        cmd = parseDebugReplCmd(line);
-
-        if (cmd == CMD_HLT)
-            return 1;
-
-        showPrompt = handleDbgReplCmd(cmd, line);
+        const mix_program* p = &m->programs[i];
+        if (memoPath(mm, p->trace) != 0)
+            return -1;
+        memoInt(mm, p->offset);
+        memoBytes(mm, &p->aloneIpc, sizeof(p->aloneIpc));
     }
-
     return 0;
 }
 
-static void debugInitEnv(debug_env_vars* compEnv)
-{
-    compEnv->cadssDbgNotifyState = 0;
-    compEnv->cadssDbgWatchedComp = 0;
-    compEnv->cadssDbgExternBreak = CADSS_DBG_EXT;
-}
-
-static void debugWatchComponent(debug_env_vars* compEnv, uint8_t mask)
-{
-    compEnv->cadssDbgWatchedComp = !!(CADSS_DBG_WLIST_STATE & mask);
-
-    if (compEnv->cadssDbgWatchedComp)
-        compEnv->cadssDbgNotifyState = CADSS_DBG_NOTIF;
-}
-
-static void debugCheckNotif(debug_env_vars* compEnv)
-{
-    if (compEnv->cadssDbgWatchedComp)
-        CADSS_DBG_NOTIF &= compEnv->cadssDbgNotifyState;
-}
-
 int main(int argc, char** argv)
 {
     int opt;
-    struct sim* csim = NULL;
-    struct sim* psim = NULL;
-    struct sim* bsim = NULL;
-    struct sim* isim = NULL;
-    struct sim* osim = NULL;
     struct sim* trace = NULL;
-    struct sim* msim = NULL;
     char* settingFile = NULL;
-    char* cacheName = NULL;
-    char* branchName = NULL;
-    char* procName = NULL;
-    char* coherName = NULL;
-    char* interName = NULL;
-    char* memName = NULL;
-
-    // TODO - switch to getopt_long that accepts -- arguments
-    while ((opt = getopt(argc, argv, ":hvc:p:o:n:i:b:t:s:m:d:")) != -1)
+    char* traceName = NULL;
+    char* mixFile = NULL;
+    char* rateStride = NULL;
+    char* memoDir = NULL;
+    char* cosimSpec = NULL;
+    char* checkpointFile = "cadss.ckpt";
+    char* restoreFile = NULL;
+    char* statsFile = NULL;
+    char* seriesFile = NULL;
+    char* seriesSelect = NULL;
+    char* digestFile = NULL;
+    int64_t digestEvery = 10000;
+    char* reqTraceFile = NULL;
+    int64_t reqTraceSize = 1 << 20;
+    int latency = 0;
+    int64_t sampleEvery = 10000;
+    int sampleOps = 0;
+    int profile = 0;
+    int progressSeconds = 0;
+    int64_t checkpointTick = -1;
+    int64_t warmOps = 0;
+    int64_t minOps = 0;
+    sim_names names = {0};
+    mix m = {0};
+    memo mm = {0};
+    int memoize = 0;
+
+    while ((opt = getopt_long(argc, argv,
+                              ":hvc:p:o:n:i:b:t:s:m:d:k:f:r:w:S:T:e:E:C:P:M:H:",
+                              longOptions, NULL))
+           != -1)
     {
         switch (opt)
         {
@@ -216,31 +204,102 @@ int main(int argc, char** argv)
                 printHelp(argv[0]);
                 return 0;
             case 'p':
-                procName = optarg;
+                names.proc = optarg;
                 break;
             case 'v':
                 CADSS_VERBOSE = 1;
                 break;
             case 'c':
-                cacheName = optarg;
+                names.cache = optarg;
                 break;
             case 'b':
-                branchName = optarg;
+                names.branch = optarg;
                 break;
             case 's':
                 settingFile = optarg;
                 break;
             case 'o':
-                coherName = optarg;
+                names.coher = optarg;
                 break;
             case 'n':
                 processorCount = atoi(optarg);
                 break;
             case 'i':
-                interName = optarg;
+                names.inter = optarg;
                 break;
             case 'm':
-                memName = optarg;
+                names.mem = optarg;
+                break;
+            case 't':
+                traceName = optarg;
+                break;
+            case 'M':
+                mixFile = optarg;
+                break;
+            case 'k':
+                checkpointTick = atoll(optarg);
+                break;
+            case 'f':
+                checkpointFile = optarg;
+                break;
+            case 'r':
+                restoreFile = optarg;
+                break;
+            case 'w':
+                warmOps = atoll(optarg);
+                break;
+            case 'S':
+                statsFile = optarg;
+                break;
+            case 'T':
+                seriesFile = optarg;
+                break;
+            case 'e':
+                sampleEvery = atoll(optarg);
+                sampleOps = 0;
+                break;
+            case 'E':
+                sampleEvery = atoll(optarg);
+                sampleOps = 1;
+                break;
+            case 'C':
+                seriesSelect = optarg;
+                break;
+            case 'P':
+                progressSeconds = atoi(optarg);
+                break;
+            case 'H':
+                digestFile = optarg;
+                break;
+            case OPT_DIGEST_EVERY:
+                digestEvery = atoll(optarg);
+                break;
+            case OPT_REQ_TRACE:
+                reqTraceFile = optarg;
+                break;
+            case OPT_REQ_TRACE_SIZE:
+                reqTraceSize = atoll(optarg);
+                break;
+            case OPT_LATENCY:
+                latency = 1;
+                break;
+            case OPT_PROFILE:
+                profile = (optarg != NULL && strcmp(optarg, "perf") == 0)
+                              ? 2
+                              : 1;
+                break;
+            case OPT_MIN_OPS:
+                minOps = atoll(optarg);
+                break;
+            case OPT_RATE:
+                // Far above the addresses of a usual trace.
+                rateStride = (optarg != NULL) ? optarg : "0x10000000000";
+                break;
+            case OPT_MEMO:
+                memoDir = optarg;
+                break;
+            case OPT_COSIM:
+                cosimSpec = optarg;
                 break;
             case ':':
                 if (optopt == 'd')
@@ -254,12 +313,53 @@ int main(int argc, char** argv)
     if (isProcTracedExt() && CADSS_DBG_ON)
         CADSS_DBG_EXT = 1;
 
-    trace = loadSim("trace", "trace");
-    trace_sim_args tsa;
-    tsa.arg_count = argc;
-    tsa.arg_list = argv;
-    optind = 1;
-    trace_reader* tr = trace->init(&tsa);
+    if (mixFile != NULL)
+    {
+        if (mixOpen(&m, mixFile) != 0)
+            return 0;
+        processorCount = m.count;
+    }
+
+    sim_env env;
+    env.processorCount = processorCount;
+    env.verbose = CADSS_VERBOSE;
+    env.clockDomains = 0;
+    env.stats = NULL;
+    env.events = NULL;
+
+    trace = loadSim("trace", "trace", &env);
+    if (trace == NULL)
+    {
+        return 0;
+    }
+    trace_reader* tr = NULL;
+    if (m.count > 0)
+    {
+        tr = mixReader(trace, m.programs, m.count, minOps, CADSS_VERBOSE);
+    }
+    else
+    {
+        // The trace only takes its own arguments.
+        char* traceArgs[6] = {argv[0]};
+        int traceArgCount = 1;
+        if (traceName != NULL)
+        {
+            traceArgs[traceArgCount++] = "-t";
+            traceArgs[traceArgCount++] = traceName;
+        }
+        if (rateStride != NULL)
+        {
+            traceArgs[traceArgCount++] = "-R";
+            traceArgs[traceArgCount++] = rateStride;
+        }
+
+        trace_sim_args tsa;
+        tsa.arg_count = traceArgCount;
+        tsa.arg_list = traceArgs;
+        tsa.env = &env;
+        optind = 1;
+        tr = trace->init(&tsa);
+    }
 
     if (settingFile == NULL)
     {
@@ -272,213 +372,174 @@ int main(int argc, char** argv)
         return 0;
     }
 
-    if (interName == NULL)
+    // Runs that write more than the report and statistics, or step
+    //   through the simulation, are not kept.
+    if (memoDir != NULL)
     {
-        isim = loadSim("interconnect", "interconnect");
-    }
-    else
-    {
-        isim = loadSim(interName, "interconnect");
-        if (isim == NULL)
+        if (CADSS_DBG_ON || CADSS_DBG_TICK >= 0 || checkpointTick >= 0
+            || restoreFile != NULL || seriesFile != NULL || profile
+            || cosimSpec != NULL || digestFile != NULL || reqTraceFile != NULL
+            || (traceName == NULL && m.count == 0))
         {
-            return 0;
+            fprintf(stderr, "--memo is not used with -d, -k, -r, -T, -H, "
+                            "--profile, --cosim, --req-trace or a trace on "
+                            "stdin\n");
+        }
+        else if (memoOpen(&mm, memoDir) == 0)
+        {
+            memoize = (memoRun(&mm, &names, traceName, &m, rateStride, warmOps,
+                               minOps, latency)
+                       == 0);
         }
     }
-
-    if (coherName == NULL)
+    if (memoize && memoReplay(&mm, statsFile))
     {
-        osim = loadSim("coherence", "coherence");
+        if (CADSS_VERBOSE)
+            fprintf(stderr, "Result %s kept in %s\n", mm.key, memoDir);
+
+        memoFree(&mm);
+        tr->si.destroy(tr);
+        mixFree(&m);
+        unloadSim(trace);
+        return 0;
     }
-    else
+
+    // The speedups are over each program running on its own.
+    if (m.count > 0
+        && mixMeasureAlone(&m, trace, &names, minOps, CADSS_VERBOSE) != 0)
     {
-        osim = loadSim(coherName, "coherence");
-        if (osim == NULL)
-        {
-            return 0;
-        }
+        fprintf(stderr, "Failed to run the programs of the mix alone\n");
+        return 0;
     }
 
-    if (cacheName == NULL)
+    // The components report to these from the start.
+    if (latency && latencyOpen(&env) != 0)
+        return 0;
+    if (reqTraceFile != NULL && reqTraceOpen(&env, reqTraceSize) != 0)
+        return 0;
+
+    simulation s;
+    if (simCreate(&s, &names, tr, &env) != 0)
     {
-        csim = loadSim("cache", "cache");
+        return 0;
     }
-    else
+    if (m.count > 0)
     {
-        csim = loadSim(cacheName, "cache");
-        if (csim == NULL)
-        {
-            return 0;
-        }
+        mixReaderClock(tr, &s.tickCount);
+        mixReaderStats(tr, &s.env);
     }
 
-    if (procName == NULL)
+    // The references start out empty, as the candidates do.
+    if (cosimSpec != NULL && restoreFile != NULL)
     {
-        psim = loadSim("processor", "processor");
+        fprintf(stderr, "--cosim cannot be used with -r\n");
+        return 0;
     }
-    else
+    if (cosimSpec != NULL && cosimAttach(&s, cosimSpec) != 0)
+        return 0;
+
+    if (restoreFile != NULL && simRestore(&s, restoreFile) != 0)
     {
-        psim = loadSim(procName, "processor");
-        if (psim == NULL)
-        {
-            return 0;
-        }
+        fprintf(stderr, "Failed to restore checkpoint - %s\n", restoreFile);
     }
-
-    if (branchName == NULL)
+    else if (warmOps > 0 && simWarm(&s, warmOps) < 0)
     {
-        bsim = loadSim("branch", "branch");
+        fprintf(stderr, "Failed to warm up\n");
     }
-    else
+    else if (checkpointTick >= 0)
     {
-        bsim = loadSim(branchName, "branch");
-        if (bsim == NULL)
+        if (simCheckpoint(&s, checkpointTick, checkpointFile) == 0)
         {
-            return 0;
+            printf("Checkpoint at tick %ld written to %s\n", s.tickCount,
+                   checkpointFile);
         }
     }
-
-    if (memName == NULL)
-    {
-        msim = loadSim("memory", "memory");
-    }
     else
     {
-        msim = loadSim(memName, "memory");
-        if (msim == NULL)
+        FILE* series = NULL;
+        if (seriesFile != NULL)
         {
-            return 0;
+            series = fopen(seriesFile, "w");
+            if (series == NULL)
+                perror("Opening statistics series");
+            else if (simSampleStats(&s, series, sampleEvery, sampleOps,
+                                    seriesSelect) != 0)
+                fprintf(stderr, "Failed to sample statistics\n");
         }
-    }
 
-    // B.N. - set optind to 1 before calling init on any component
-    //  that resets getopt() so the component can use it safely on its arguments
-    int argCount = 0;
-    char** arg = NULL;
-
-    cache* cache_sim = NULL;
-    branch* branch_sim = NULL;
-    coher* coher_sim = NULL;
-    interconn* inter_sim = NULL;
-    memory* mem_sim = NULL;
-    processor* proc_sim = NULL;
-
-    arg = getSettings("memory", &argCount);
-    if (arg == NULL) {}
-
-    memory_sim_args msa;
-    msa.arg_count = argCount;
-    msa.arg_list = arg;
-    if ((mem_sim = msim->init(&msa)) != 0) {}
-
-    arg = getSettings("interconnect", &argCount);
-    if (arg == NULL) {}
-
-    inter_sim_args isa;
-    isa.arg_count = argCount;
-    isa.arg_list = arg;
-    isa.memory = mem_sim;
-    optind = 1;
-    if ((inter_sim = isim->init(&isa)) == NULL) {}
-
-    arg = getSettings("coherence", &argCount);
-    if (arg == NULL) {}
-
-    coher_sim_args osa;
-    osa.arg_count = argCount;
-    osa.arg_list = arg;
-    osa.inter = inter_sim;
-    optind = 1;
-    if ((coher_sim = osim->init(&osa)) == NULL) {}
-
-    optind = 1;
-    arg = getSettings("cache", &argCount);
-    if (arg == NULL) {}
-
-    cache_sim_args csa;
-    csa.arg_count = argCount;
-    csa.arg_list = arg;
-    csa.coherComp = coher_sim;
-    if ((cache_sim = csim->init(&csa)) == NULL) {}
-
-    optind = 1;
-    arg = getSettings("branch", &argCount);
-    if (arg == NULL) {}
-
-    branch_sim_args bsa;
-    bsa.arg_count = argCount;
-    bsa.arg_list = arg;
-    if ((branch_sim = bsim->init(&bsa)) == NULL) {}
-
-    optind = 1;
-    arg = getSettings("processor", &argCount);
-    if (arg == NULL) {}
-
-    processor_sim_args psa;
-    psa.arg_count = argCount;
-    psa.arg_list = arg;
-    psa.tr = tr;
-    psa.cache_sim = cache_sim;
-    psa.branch_sim = branch_sim;
-    if ((proc_sim = psim->init(&psa)) == NULL)
-    {
-        printf("Failed to initialize processor!\n");
-        assert(0);
-    }
+        FILE* digest = NULL;
+        if (digestFile != NULL)
+        {
+            digest = fopen(digestFile, "w");
+            if (digest == NULL)
+                perror("Opening digest");
+            else if (digestAttach(&s, digest, digestEvery) != 0)
+                fprintf(stderr, "Failed to digest the run\n");
+        }
 
-    // Main sim loop
-    int progress = 0;
-    int dbgHalt;
-    int64_t dbgTickCount = 0;
+        if (latency)
+            latencyAttach(&s);
+        if (reqTraceFile != NULL)
+            reqTraceAttach(&s);
+        if (profile)
+            profileAttach(&s, profile == 2);
+        if (simMonitor(progressSeconds, NULL) != 0)
+            perror("Reporting progress");
+
+        // The report is written to stdout once it is kept.
+        FILE* out = (memoize) ? memoBegin(&mm) : NULL;
+        if (out == NULL)
+            out = stdout;
+
+        simRun(&s);
+        reqTraceDetach(&s);
+        latencyDetach(&s);
+        digestDetach(&s);
+        simFinish(&s, fileno(out));
+        if (s.clock.on)
+            fprintf(out, "Time - %lu ns\n", s.clock.ns);
+        if (m.count > 0)
+            mixReport(&m, tr, s.tickCount, out);
+        if (cosimSpec != NULL)
+            cosimReport(out);
+        if (latency)
+            latencyReport(out);
+        if (out != stdout)
+            memoStore(&mm, &s.stats);
+        if (profile)
+        {
+            profileDetach(&s);
+            profileReport(stderr);
+        }
+        if (statsFile != NULL)
+            simWriteStats(&s, statsFile);
+        if (series != NULL)
+            fclose(series);
+        if (digest != NULL)
+            fclose(digest);
+        if (reqTraceFile != NULL)
+        {
+            FILE* f = fopen(reqTraceFile, "w");
+            if (f == NULL)
+                perror("Opening request trace");
+            else
+            {
+                if (reqTraceWrite(f) != 0)
+                    fprintf(stderr, "Failed to write the request trace\n");
+                fclose(f);
+            }
+        }
+    }
 
-    debugInitEnv(&(proc_sim->dbgEnv));
-    debugInitEnv(&(branch_sim->dbgEnv));
-    debugInitEnv(&(cache_sim->dbgEnv));
-    debugInitEnv(&(coher_sim->dbgEnv));
-    debugInitEnv(&(inter_sim->dbgEnv));
-    debugInitEnv(&(mem_sim->dbgEnv));
+    cosimDetach(&s);
+    simDestroy(&s);
+    tr->si.destroy(tr);
+    mixFree(&m);
+    memoFree(&mm);
+    reqTraceClose();
+    latencyClose();
 
-    do
-    {
-        dbgHalt = debugRepl(dbgTickCount);
-        if (dbgHalt)
-            break;
-
-        // Mark components to watch and notify state changes.
-        debugWatchComponent(&(proc_sim->dbgEnv), CADSS_DBG_WATCH_PROC);
-        debugWatchComponent(&(branch_sim->dbgEnv), CADSS_DBG_WATCH_BRANCH);
-        debugWatchComponent(&(cache_sim->dbgEnv), CADSS_DBG_WATCH_CACHE);
-        debugWatchComponent(&(coher_sim->dbgEnv), CADSS_DBG_WATCH_COHER);
-        debugWatchComponent(&(inter_sim->dbgEnv), CADSS_DBG_WATCH_INTER);
-        debugWatchComponent(&(mem_sim->dbgEnv), CADSS_DBG_WATCH_MEM);
-
-        // Processor requests trace ops as needed.
-        progress = psim->tick();
-        dbgTickCount++;
-
-        // Check if any of the watched components
-        // requested to be notified of state change.
-        debugCheckNotif(&(proc_sim->dbgEnv));
-        debugCheckNotif(&(branch_sim->dbgEnv));
-        debugCheckNotif(&(cache_sim->dbgEnv));
-        debugCheckNotif(&(coher_sim->dbgEnv));
-        debugCheckNotif(&(inter_sim->dbgEnv));
-        debugCheckNotif(&(mem_sim->dbgEnv));
-    } while (progress);
-
-    psim->finish(STDOUT_FILENO);
-    psim->destroy();
-    trace->destroy();
-
-    dlclose(csim->handle);
-    free(csim);
-    dlclose(psim->handle);
-    free(psim);
-    dlclose(bsim->handle);
-    free(bsim);
-    dlclose(trace->handle);
-    free(trace);
-    dlclose(msim->handle);
-    free(msim);
+    unloadSim(trace);
 
     return 0;
 }
@@ -1,8 +1,15 @@
 #ifndef ENGINE_H
 #define ENGINE_H
 
+#include <common.h>
+
+#include "clock.h"
+
 #define SIM_NAME_LIMIT 256
 
+// Components in the tick chain that the scheduler tracks.
+#define SCHED_MAX_SIMS 8
+
 // Line buffer size for REPL command line.
 #define MAX_DBG_LINE_BUF_SIZE 31
 
@@ -26,15 +33,18 @@ enum dbgCmd
     CMD_HLT, // q:  Quit
     CMD_HLP, // h:  Help
     CMD_LST, // l:  List
+    CMD_ADR, // a:  Break on address request
+    CMD_STA, // s:  Break on coherence state change
+    CMD_QUE, // p:  Break on bus queue length
+    CMD_DEL, // x:  Delete watchpoints
 };
 
 struct sim {
     void* handle;
     void* (*init)(void*);
-    int (*tick)(void);
-    int (*finish)(int);
-    int (*destroy)(void);
-    int* CADSS_VERBOSE;
+    int legacy; // Built for the original, single-instance interface.
+    int keep;   // Stays loaded when its simulation is destroyed.
+    debug_env_vars* dbgEnv;
 };
 
 // Engine started with "-d".
@@ -56,6 +66,29 @@ extern int CADSS_DBG_STEP_TICKS;
 // If the program is externally traced.
 extern int CADSS_DBG_EXT;
 
+#ifdef CADSS_STATIC
+struct sim* staticSim(const char* name);
+#endif
+
+// Components that the scheduler of one simulation tracks, and with clock
+//   domains, the domain of each.
+typedef struct _sim_sched {
+    sim_interface* sims[SCHED_MAX_SIMS];
+    int domain[SCHED_MAX_SIMS];
+    int simCount;
+    sim_clock* clock; // NULL without clock domains.
+} sim_sched;
+
+void schedRegister(sim_sched* sc, void* comp, int domain);
+int64_t schedIdleTicks(sim_sched* sc);
+void schedSkip(sim_sched* sc, int64_t ticks);
+
+// Whether the main loop has to call the debug hooks.
+int debugActive(void);
+int debugRepl(int64_t tickCount);
+void debugInitEnv(debug_env_vars* compEnv);
+void debugWatchComponent(debug_env_vars* compEnv, uint8_t mask);
+void debugCheckNotif(debug_env_vars* compEnv);
 enum dbgCmd parseDebugReplCmd(const char* cmdStr);
 int handleDbgReplCmd(enum dbgCmd cmd, const char* cmdStr);
 int isProcTracedExt(void);
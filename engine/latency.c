@@ -0,0 +1,330 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <events.h>
+
+#include "latency.h"
+
+enum lat_outcome
+{
+    LAT_HIT,
+    LAT_UPGRADE,
+    LAT_CACHE,
+    LAT_DRAM,
+    LAT_OTHER,
+    LAT_OUTCOMES
+};
+
+static const char* outcomeNames[LAT_OUTCOMES] = {
+    [LAT_HIT] = "hit",
+    [LAT_UPGRADE] = "upgrade",
+    [LAT_CACHE] = "cache",
+    [LAT_DRAM] = "dram",
+    [LAT_OTHER] = "other",
+};
+
+// Latencies below 2 * LAT_SUB have a bucket each; above, each power of two
+//   is split into LAT_SUB buckets.
+#define LAT_SUB_BITS 6
+#define LAT_SUB (1 << LAT_SUB_BITS)
+#define LAT_BUCKETS ((64 - LAT_SUB_BITS + 1) * LAT_SUB)
+
+typedef struct _lat_hist {
+    uint64_t count;
+    uint64_t sum;
+    uint64_t max;
+    uint64_t buckets[LAT_BUCKETS];
+} lat_hist;
+
+// A request that has been issued and not yet called back.
+struct lat_request {
+    int64_t tag;
+    int64_t issued;
+    uint64_t block;
+    uint8_t hasBlock;
+    uint8_t tagHit;  // The block was in the cache.
+    uint8_t bus;     // Went on the bus.
+    uint8_t busDone;
+    uint8_t transfer; // REQ_CACHE_TRANSFER or REQ_MEMORY_TRANSFER, or 0.
+};
+
+struct lat_open {
+    struct lat_request* reqs; // In the order issued.
+    int count;
+    int size;
+};
+
+static struct {
+    events_sink sink;
+    const events_sink* next; // That was in the env, given every event too.
+    simulation* s;
+    int processorCount;
+    lat_hist* hists; // LAT_OUTCOMES for each processor.
+    struct lat_open* open;
+
+    // Original entry point.
+    void (*memoryRequest)(cache*, trace_op*, int, int64_t, void*,
+                          void (*)(void*, int, int64_t));
+
+    // The requestor of the cache.
+    void* cacheCtx;
+    void (*cacheCallback)(void*, int, int64_t);
+
+    // Requests passed on without being timed, for lack of memory.
+    uint64_t unmeasured;
+} lat;
+
+static int latBucket(uint64_t v)
+{
+    if (v < 2 * LAT_SUB)
+        return v;
+
+    int e = 63 - __builtin_clzll(v) - LAT_SUB_BITS;
+    return (e + 1) * LAT_SUB + (int)((v >> e) - LAT_SUB);
+}
+
+// The largest latency in bucket b.
+static uint64_t latBucketTop(int b)
+{
+    if (b < 2 * LAT_SUB)
+        return b;
+
+    int e = b / LAT_SUB - 1;
+    uint64_t low = (uint64_t)(b % LAT_SUB + LAT_SUB) << e;
+    return low + (1UL << e) - 1;
+}
+
+static void latHistAdd(lat_hist* h, uint64_t v)
+{
+    h->buckets[latBucket(v)]++;
+    h->count++;
+    h->sum += v;
+    if (v > h->max)
+        h->max = v;
+}
+
+// The latency that a fraction q of the requests are no slower than.
+static uint64_t latPercentile(const lat_hist* h, double q)
+{
+    uint64_t rank = (uint64_t)(q * h->count);
+    uint64_t seen = 0;
+
+    if (rank < q * h->count || rank == 0)
+        rank++;
+    for (int b = 0; b < LAT_BUCKETS; b++)
+    {
+        seen += h->buckets[b];
+        if (seen >= rank)
+        {
+            uint64_t top = latBucketTop(b);
+            return (top < h->max) ? top : h->max;
+        }
+    }
+    return h->max;
+}
+
+static struct lat_request* findTag(struct lat_open* o, int64_t tag)
+{
+    for (int i = 0; i < o->count; i++)
+    {
+        if (o->reqs[i].tag == tag)
+            return &o->reqs[i];
+    }
+    return NULL;
+}
+
+// The oldest request to block still on, or waiting for, the bus.
+static struct lat_request* findBlock(struct lat_open* o, uint64_t block)
+{
+    for (int i = 0; i < o->count; i++)
+    {
+        struct lat_request* r = &o->reqs[i];
+        if (r->hasBlock && r->block == block && !r->busDone)
+            return r;
+    }
+    return NULL;
+}
+
+static int latOutcome(const struct lat_request* r)
+{
+    if (!r->hasBlock)
+        return LAT_OTHER;
+    if (!r->bus)
+        return LAT_HIT;
+    if (r->tagHit)
+        return LAT_UPGRADE;
+    if (r->transfer == REQ_CACHE_TRANSFER)
+        return LAT_CACHE;
+    return LAT_DRAM;
+}
+
+static void latencyEvent(void* self, int stage, int processorNum,
+                         uint64_t addr, int64_t tag)
+{
+    if (lat.next != NULL)
+        lat.next->event(lat.next->self, stage, processorNum, addr, tag);
+    if (lat.s == NULL || processorNum < 0
+        || processorNum >= lat.processorCount)
+        return;
+
+    struct lat_open* o = &lat.open[processorNum];
+    struct lat_request* r = NULL;
+    switch (stage)
+    {
+        case REQ_HIT:
+        case REQ_MISS:
+        case REQ_PERM:
+            r = findTag(o, tag);
+            if (r == NULL)
+                return;
+            r->block = addr;
+            r->hasBlock = 1;
+            if (stage == REQ_HIT)
+                r->tagHit = 1;
+            break;
+
+        case REQ_BUS_QUEUE:
+        case REQ_BUS_GRANT:
+        case REQ_SNOOP:
+        case REQ_CACHE_TRANSFER:
+        case REQ_MEMORY_TRANSFER:
+        case REQ_BUS_DONE:
+            r = findBlock(o, addr);
+            if (r == NULL)
+                return;
+            r->bus = 1;
+            if (stage == REQ_CACHE_TRANSFER || stage == REQ_MEMORY_TRANSFER)
+                r->transfer = stage;
+            r->busDone = (stage == REQ_BUS_DONE);
+            break;
+    }
+}
+
+//
+// Wrappers
+//
+static void latencyDone(void* ctx, int processorNum, int64_t tag)
+{
+    struct lat_open* o = &lat.open[processorNum];
+    struct lat_request* r = findTag(o, tag);
+
+    if (r != NULL)
+    {
+        lat_hist* h = &lat.hists[processorNum * LAT_OUTCOMES + latOutcome(r)];
+        latHistAdd(h, lat.s->tickCount - r->issued);
+
+        o->count--;
+        memmove(r, r + 1, (o->reqs + o->count - r) * sizeof(*r));
+    }
+    lat.cacheCallback(lat.cacheCtx, processorNum, tag);
+}
+
+static void latencyMemoryRequest(cache* c, trace_op* op, int processorNum,
+                                 int64_t tag, void* ctx,
+                                 void (*callback)(void*, int, int64_t))
+{
+    struct lat_open* o = &lat.open[processorNum];
+
+    lat.cacheCtx = ctx;
+    lat.cacheCallback = callback;
+    if (o->count == o->size)
+    {
+        int size = (o->size == 0) ? 16 : 2 * o->size;
+        struct lat_request* reqs = realloc(o->reqs, size * sizeof(*reqs));
+        if (reqs == NULL)
+        {
+            lat.unmeasured++;
+            lat.memoryRequest(c, op, processorNum, tag, ctx, callback);
+            return;
+        }
+        o->reqs = reqs;
+        o->size = size;
+    }
+
+    struct lat_request* r = &o->reqs[o->count++];
+    memset(r, 0, sizeof(*r));
+    r->tag = tag;
+    r->issued = lat.s->tickCount;
+
+    lat.memoryRequest(c, op, processorNum, tag, NULL, latencyDone);
+}
+
+int latencyOpen(sim_env* env)
+{
+    if (lat.hists != NULL)
+    {
+        fprintf(stderr, "Only one simulation can be measured at a time\n");
+        return -1;
+    }
+
+    memset(&lat, 0, sizeof(lat));
+    lat.processorCount = env->processorCount;
+    lat.hists = calloc(env->processorCount * LAT_OUTCOMES, sizeof(lat_hist));
+    lat.open = calloc(env->processorCount, sizeof(struct lat_open));
+    if (lat.hists == NULL || lat.open == NULL)
+    {
+        perror("Allocating latency histograms");
+        latencyClose();
+        return -1;
+    }
+    lat.sink.self = NULL;
+    lat.sink.event = latencyEvent;
+    lat.next = env->events;
+    env->events = &lat.sink;
+
+    return 0;
+}
+
+void latencyAttach(simulation* s)
+{
+    lat.s = s;
+    lat.memoryRequest = s->cache_sim->memoryRequest;
+    s->cache_sim->memoryRequest = latencyMemoryRequest;
+}
+
+void latencyDetach(simulation* s)
+{
+    if (lat.s != s)
+        return;
+
+    s->cache_sim->memoryRequest = lat.memoryRequest;
+    lat.s = NULL;
+}
+
+void latencyReport(FILE* f)
+{
+    fprintf(f, "Memory latency - ticks from issue to callback\n");
+    fprintf(f, "  %4s %-8s %10s %9s %7s %7s %7s %7s\n", "proc", "outcome",
+            "count", "mean", "p50", "p99", "p99.9", "max");
+    for (int i = 0; i < lat.processorCount; i++)
+    {
+        for (int j = 0; j < LAT_OUTCOMES; j++)
+        {
+            const lat_hist* h = &lat.hists[i * LAT_OUTCOMES + j];
+            if (h->count == 0)
+                continue;
+
+            fprintf(f, "  %4d %-8s %10lu %9.2f %7lu %7lu %7lu %7lu\n", i,
+                    outcomeNames[j], h->count, (double)h->sum / h->count,
+                    latPercentile(h, 0.5), latPercentile(h, 0.99),
+                    latPercentile(h, 0.999), h->max);
+        }
+    }
+
+    if (lat.unmeasured > 0)
+        fprintf(f, "  %lu requests not measured, out of memory\n",
+                lat.unmeasured);
+}
+
+void latencyClose(void)
+{
+    if (lat.open != NULL)
+    {
+        for (int i = 0; i < lat.processorCount; i++)
+            free(lat.open[i].reqs);
+    }
+    free(lat.open);
+    free(lat.hists);
+    memset(&lat, 0, sizeof(lat));
+}
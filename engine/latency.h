@@ -0,0 +1,46 @@
+#ifndef LATENCY_H
+#define LATENCY_H
+
+#include <stdio.h>
+
+#include "sim.h"
+
+//
+// Latency
+//
+//   Histograms of the ticks from the issue of each memory request to the
+// cache to its callback, for each processor and for each outcome of the
+// request, told from the stages that the components report, see events.h:
+//   hit     - done without the bus
+//   upgrade - the block was in the cache, but coherence needed the bus
+//   cache   - the data came from another cache
+//   dram    - the data came from memory
+//   other   - the cache reports no stages, as the ref* libraries do not
+// The buckets are log-linear, so each percentile reported is exact below
+// 128 ticks and within 1/64 of the latency above, and a histogram is kept
+// in a few tens of kilobytes however long the run.
+//
+//   Like the profiler, only one simulation in a process can be measured at
+// a time, and the requestor of the cache is taken to be the same for every
+// request.
+//
+
+// Measure the simulation that will be created with env, whose components
+//   report to it, and pass the stages on to any sink that env already had.
+//   0 on success.
+int latencyOpen(sim_env* env);
+
+// Time each request to the cache of s, which was created with the env
+//   given to latencyOpen.
+void latencyAttach(simulation* s);
+
+// Put back the entry points of s.
+void latencyDetach(simulation* s);
+
+// Write the count, mean, p50, p99, p99.9 and maximum of each histogram.
+void latencyReport(FILE* f);
+
+// Release the histograms.
+void latencyClose(void);
+
+#endif
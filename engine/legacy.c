@@ -0,0 +1,559 @@
+#include <dlfcn.h>
+#include <stdio.h>
+
+#include "legacy.h"
+
+// Argument layouts of the original interface.
+typedef struct _legacy_sim_args {
+    int arg_count;
+    char** arg_list;
+} legacy_sim_args;
+
+typedef struct _legacy_cache_sim_args {
+    int arg_count;
+    char** arg_list;
+    legacy_coher* coherComp;
+} legacy_cache_sim_args;
+
+typedef struct _legacy_coher_sim_args {
+    int arg_count;
+    char** arg_list;
+    legacy_interconn* inter;
+} legacy_coher_sim_args;
+
+typedef struct _legacy_inter_sim_args {
+    int arg_count;
+    char** arg_list;
+    legacy_memory* memory;
+} legacy_inter_sim_args;
+
+typedef struct _legacy_processor_sim_args {
+    legacy_trace_reader* tr;
+    legacy_cache* cache_sim;
+    legacy_branch* branch_sim;
+    int arg_count;
+    char** arg_list;
+} legacy_processor_sim_args;
+
+// Legacy views forward the original interface to a current instance,
+//   beginning with its sim_interface.
+#define LEGACY_VIEW_SI(name, target)                                        \
+    static int name##Tick(void)                                            \
+    {                                                                      \
+        return target->si.tick(target);                                    \
+    }                                                                      \
+    static int name##Finish(int outFd)                                     \
+    {                                                                      \
+        return target->si.finish(target, outFd);                           \
+    }                                                                      \
+    static int name##Destroy(void)                                         \
+    {                                                                      \
+        return target->si.destroy(target);                                 \
+    }
+
+// New views forward the current interface to the legacy instance.
+#define NEW_VIEW_SI(name, target)                                           \
+    static int name##Tick(void* self)                                      \
+    {                                                                      \
+        return target->si.tick();                                          \
+    }                                                                      \
+    static int name##Finish(void* self, int outFd)                         \
+    {                                                                      \
+        return target->si.finish(outFd);                                   \
+    }                                                                      \
+    static int name##Destroy(void* self)                                   \
+    {                                                                      \
+        return target->si.destroy();                                       \
+    }
+
+#define SET_SI(face, name)                                                  \
+    do                                                                     \
+    {                                                                      \
+        (face).si.tick = name##Tick;                                       \
+        (face).si.finish = name##Finish;                                   \
+        (face).si.destroy = name##Destroy;                                 \
+    } while (0)
+
+//
+// Trace
+//
+static trace_reader* lvTrace = NULL;
+static legacy_trace_reader lvTraceFace;
+
+LEGACY_VIEW_SI(lvTrace, lvTrace)
+
+static trace_op* lvTraceGetNextOp(int processorNum)
+{
+    return lvTrace->getNextOp(lvTrace, processorNum);
+}
+
+static legacy_trace_reader* legacyViewTrace(trace_reader* tr)
+{
+    lvTrace = tr;
+    SET_SI(lvTraceFace, lvTrace);
+    lvTraceFace.getNextOp = lvTraceGetNextOp;
+
+    return &lvTraceFace;
+}
+
+//
+// Branch
+//
+static branch* lvBranch = NULL;
+static legacy_branch lvBranchFace;
+static legacy_branch* nvBranch = NULL;
+static branch nvBranchFace;
+
+LEGACY_VIEW_SI(lvBranch, lvBranch)
+NEW_VIEW_SI(nvBranch, nvBranch)
+
+static uint64_t lvBranchRequest(trace_op* op, int processorNum)
+{
+    return lvBranch->branchRequest(lvBranch, op, processorNum);
+}
+
+static uint64_t nvBranchRequest(branch* self, trace_op* op, int processorNum)
+{
+    return nvBranch->branchRequest(op, processorNum);
+}
+
+static legacy_branch* legacyViewBranch(branch* b)
+{
+    if (b == &nvBranchFace)
+        return nvBranch;
+
+    lvBranch = b;
+    SET_SI(lvBranchFace, lvBranch);
+    lvBranchFace.branchRequest = lvBranchRequest;
+
+    return &lvBranchFace;
+}
+
+static branch* newViewBranch(legacy_branch* lb)
+{
+    if (lb == &lvBranchFace)
+        return lvBranch;
+
+    nvBranch = lb;
+    SET_SI(nvBranchFace, nvBranch);
+    nvBranchFace.branchRequest = nvBranchRequest;
+
+    return &nvBranchFace;
+}
+
+//
+// Cache
+//
+static cache* lvCache = NULL;
+static legacy_cache lvCacheFace;
+static void (*lvCacheCallback)(int, int64_t) = NULL;
+static legacy_cache* nvCache = NULL;
+static cache nvCacheFace;
+static void* nvCacheCtx = NULL;
+static void (*nvCacheCallback)(void*, int, int64_t) = NULL;
+
+LEGACY_VIEW_SI(lvCache, lvCache)
+NEW_VIEW_SI(nvCache, nvCache)
+
+static void lvCacheDone(void* ctx, int processorNum, int64_t tag)
+{
+    lvCacheCallback(processorNum, tag);
+}
+
+static void lvCacheMemoryRequest(trace_op* op, int processorNum, int64_t tag,
+                                 void (*callback)(int, int64_t))
+{
+    lvCacheCallback = callback;
+    lvCache->memoryRequest(lvCache, op, processorNum, tag, NULL, lvCacheDone);
+}
+
+// Legacy caches only take a function, so every request is assumed to come
+//   from the same requestor.
+static void nvCacheDone(int processorNum, int64_t tag)
+{
+    nvCacheCallback(nvCacheCtx, processorNum, tag);
+}
+
+static void nvCacheMemoryRequest(cache* self, trace_op* op, int processorNum,
+                                 int64_t tag, void* ctx,
+                                 void (*callback)(void*, int, int64_t))
+{
+    nvCacheCtx = ctx;
+    nvCacheCallback = callback;
+    nvCache->memoryRequest(op, processorNum, tag, nvCacheDone);
+}
+
+static legacy_cache* legacyViewCache(cache* c)
+{
+    if (c == &nvCacheFace)
+        return nvCache;
+
+    lvCache = c;
+    SET_SI(lvCacheFace, lvCache);
+    lvCacheFace.memoryRequest = lvCacheMemoryRequest;
+
+    return &lvCacheFace;
+}
+
+static cache* newViewCache(legacy_cache* lc)
+{
+    if (lc == &lvCacheFace)
+        return lvCache;
+
+    nvCache = lc;
+    SET_SI(nvCacheFace, nvCache);
+    nvCacheFace.memoryRequest = nvCacheMemoryRequest;
+
+    return &nvCacheFace;
+}
+
+//
+// Coherence
+//
+static coher* lvCoher = NULL;
+static legacy_coher lvCoherFace;
+static void (*lvCoherCallback)(int, int, int64_t) = NULL;
+static legacy_coher* nvCoher = NULL;
+static coher nvCoherFace;
+static void* nvCoherCtx = NULL;
+static void (*nvCoherCallback)(void*, int, int, int64_t) = NULL;
+
+LEGACY_VIEW_SI(lvCoher, lvCoher)
+NEW_VIEW_SI(nvCoher, nvCoher)
+
+static void lvCoherCacheCallback(void* ctx, int type, int processorNum,
+                                 int64_t addr)
+{
+    lvCoherCallback(type, processorNum, addr);
+}
+
+static void lvCoherRegisterCacheInterface(void (*callback)(int, int, int64_t))
+{
+    lvCoherCallback = callback;
+    lvCoher->registerCacheInterface(lvCoher, NULL, lvCoherCacheCallback);
+}
+
+static uint8_t lvCoherPermReq(uint8_t is_read, uint64_t addr, int processorNum)
+{
+    return lvCoher->permReq(lvCoher, is_read, addr, processorNum);
+}
+
+static uint8_t lvCoherInvlReq(uint64_t addr, int processorNum)
+{
+    return lvCoher->invlReq(lvCoher, addr, processorNum);
+}
+
+static uint8_t lvCoherBusReq(bus_req_type reqType, uint64_t addr,
+                             int processorNum)
+{
+    return lvCoher->busReq(lvCoher, reqType, addr, processorNum);
+}
+
+static void nvCoherCacheCallback(int type, int processorNum, int64_t addr)
+{
+    nvCoherCallback(nvCoherCtx, type, processorNum, addr);
+}
+
+static void nvCoherRegisterCacheInterface(coher* self, void* ctx,
+                                          void (*callback)(void*, int, int,
+                                                           int64_t))
+{
+    nvCoherCtx = ctx;
+    nvCoherCallback = callback;
+    nvCoher->registerCacheInterface(nvCoherCacheCallback);
+}
+
+static uint8_t nvCoherPermReq(coher* self, uint8_t is_read, uint64_t addr,
+                              int processorNum)
+{
+    return nvCoher->permReq(is_read, addr, processorNum);
+}
+
+static uint8_t nvCoherInvlReq(coher* self, uint64_t addr, int processorNum)
+{
+    return nvCoher->invlReq(addr, processorNum);
+}
+
+static uint8_t nvCoherBusReq(coher* self, bus_req_type reqType, uint64_t addr,
+                             int processorNum)
+{
+    return nvCoher->busReq(reqType, addr, processorNum);
+}
+
+static legacy_coher* legacyViewCoher(coher* c)
+{
+    if (c == &nvCoherFace)
+        return nvCoher;
+
+    lvCoher = c;
+    SET_SI(lvCoherFace, lvCoher);
+    lvCoherFace.registerCacheInterface = lvCoherRegisterCacheInterface;
+    lvCoherFace.permReq = lvCoherPermReq;
+    lvCoherFace.invlReq = lvCoherInvlReq;
+    lvCoherFace.busReq = lvCoherBusReq;
+
+    return &lvCoherFace;
+}
+
+static coher* newViewCoher(legacy_coher* lc)
+{
+    if (lc == &lvCoherFace)
+        return lvCoher;
+
+    nvCoher = lc;
+    SET_SI(nvCoherFace, nvCoher);
+    nvCoherFace.registerCacheInterface = nvCoherRegisterCacheInterface;
+    nvCoherFace.permReq = nvCoherPermReq;
+    nvCoherFace.invlReq = nvCoherInvlReq;
+    nvCoherFace.busReq = nvCoherBusReq;
+
+    return &nvCoherFace;
+}
+
+//
+// Interconnect
+//
+static interconn* lvInter = NULL;
+static legacy_interconn lvInterFace;
+static legacy_interconn* nvInter = NULL;
+static interconn nvInterFace;
+
+LEGACY_VIEW_SI(lvInter, lvInter)
+NEW_VIEW_SI(nvInter, nvInter)
+
+static void lvInterBusReq(bus_req_type brt, uint64_t addr, int procNum)
+{
+    lvInter->busReq(lvInter, brt, addr, procNum);
+}
+
+static void lvInterRegisterCoher(legacy_coher* coherComp)
+{
+    lvInter->registerCoher(lvInter, newViewCoher(coherComp));
+}
+
+static int lvInterBusReqCacheTransfer(uint64_t addr, int procNum)
+{
+    return lvInter->busReqCacheTransfer(lvInter, addr, procNum);
+}
+
+static void nvInterBusReq(interconn* self, bus_req_type brt, uint64_t addr,
+                          int procNum)
+{
+    nvInter->busReq(brt, addr, procNum);
+}
+
+static void nvInterRegisterCoher(interconn* self, coher* coherComp)
+{
+    nvInter->registerCoher(legacyViewCoher(coherComp));
+}
+
+static int nvInterBusReqCacheTransfer(interconn* self, uint64_t addr,
+                                      int procNum)
+{
+    return nvInter->busReqCacheTransfer(addr, procNum);
+}
+
+static legacy_interconn* legacyViewInter(interconn* ic)
+{
+    if (ic == &nvInterFace)
+        return nvInter;
+
+    lvInter = ic;
+    SET_SI(lvInterFace, lvInter);
+    lvInterFace.busReq = lvInterBusReq;
+    lvInterFace.registerCoher = lvInterRegisterCoher;
+    lvInterFace.busReqCacheTransfer = lvInterBusReqCacheTransfer;
+
+    return &lvInterFace;
+}
+
+static interconn* newViewInter(legacy_interconn* li)
+{
+    if (li == &lvInterFace)
+        return lvInter;
+
+    nvInter = li;
+    SET_SI(nvInterFace, nvInter);
+    nvInterFace.busReq = nvInterBusReq;
+    nvInterFace.registerCoher = nvInterRegisterCoher;
+    nvInterFace.busReqCacheTransfer = nvInterBusReqCacheTransfer;
+
+    return &nvInterFace;
+}
+
+//
+// Memory
+//
+static memory* lvMemory = NULL;
+static legacy_memory lvMemoryFace;
+static void (*lvMemoryCallback)(int, uint64_t) = NULL;
+static legacy_memory* nvMemory = NULL;
+static memory nvMemoryFace;
+static void* nvMemoryCtx = NULL;
+static void (*nvMemoryCallback)(void*, int, uint64_t) = NULL;
+
+LEGACY_VIEW_SI(lvMemory, lvMemory)
+NEW_VIEW_SI(nvMemory, nvMemory)
+
+static void lvMemoryDone(void* ctx, int procNum, uint64_t addr)
+{
+    lvMemoryCallback(procNum, addr);
+}
+
+static int lvMemoryBusReq(uint64_t addr, int procNum,
+                          void (*callback)(int, uint64_t))
+{
+    lvMemoryCallback = callback;
+    return lvMemory->busReq(lvMemory, addr, procNum, NULL, lvMemoryDone);
+}
+
+static void lvMemoryRegisterInterconnect(legacy_interconn* interconnect)
+{
+    lvMemory->registerInterconnect(lvMemory, newViewInter(interconnect));
+}
+
+static void nvMemoryDone(int procNum, uint64_t addr)
+{
+    nvMemoryCallback(nvMemoryCtx, procNum, addr);
+}
+
+static int nvMemoryBusReq(memory* self, uint64_t addr, int procNum, void* ctx,
+                          void (*callback)(void*, int, uint64_t))
+{
+    nvMemoryCtx = ctx;
+    nvMemoryCallback = callback;
+    return nvMemory->busReq(addr, procNum, nvMemoryDone);
+}
+
+static void nvMemoryRegisterInterconnect(memory* self, interconn* interconnect)
+{
+    nvMemory->registerInterconnect(legacyViewInter(interconnect));
+}
+
+static legacy_memory* legacyViewMemory(memory* m)
+{
+    if (m == &nvMemoryFace)
+        return nvMemory;
+
+    lvMemory = m;
+    SET_SI(lvMemoryFace, lvMemory);
+    lvMemoryFace.busReq = lvMemoryBusReq;
+    lvMemoryFace.registerInterconnect = lvMemoryRegisterInterconnect;
+
+    return &lvMemoryFace;
+}
+
+static memory* newViewMemory(legacy_memory* lm)
+{
+    if (lm == &lvMemoryFace)
+        return lvMemory;
+
+    nvMemory = lm;
+    SET_SI(nvMemoryFace, nvMemory);
+    nvMemoryFace.busReq = nvMemoryBusReq;
+    nvMemoryFace.registerInterconnect = nvMemoryRegisterInterconnect;
+
+    return &nvMemoryFace;
+}
+
+//
+// Processor
+//
+// The engine used to tick the processor through its exported symbols, so
+//   a legacy processor need not fill in its own sim_interface.
+static struct {
+    legacy_si si;
+} nvProcSyms;
+static processor nvProcFace;
+
+NEW_VIEW_SI(nvProc, (&nvProcSyms))
+
+static processor* newViewProc(void* handle)
+{
+    nvProcSyms.si.tick = dlsym(handle, "tick");
+    nvProcSyms.si.finish = dlsym(handle, "finish");
+    nvProcSyms.si.destroy = dlsym(handle, "destroy");
+    SET_SI(nvProcFace, nvProc);
+
+    return &nvProcFace;
+}
+
+//
+// Initialization
+//
+branch* legacyBranchInit(struct sim* s, branch_sim_args* bsa)
+{
+    legacy_sim_args lbsa = {bsa->arg_count, bsa->arg_list};
+
+    legacy_branch* lb = s->init(&lbsa);
+    if (lb == NULL)
+        return NULL;
+
+    s->dbgEnv = &lb->dbgEnv;
+    return newViewBranch(lb);
+}
+
+cache* legacyCacheInit(struct sim* s, cache_sim_args* csa)
+{
+    legacy_cache_sim_args lcsa = {csa->arg_count, csa->arg_list,
+                                  legacyViewCoher(csa->coherComp)};
+
+    legacy_cache* lc = s->init(&lcsa);
+    if (lc == NULL)
+        return NULL;
+
+    s->dbgEnv = &lc->dbgEnv;
+    return newViewCache(lc);
+}
+
+coher* legacyCoherInit(struct sim* s, coher_sim_args* osa)
+{
+    legacy_coher_sim_args losa = {osa->arg_count, osa->arg_list,
+                                  legacyViewInter(osa->inter)};
+
+    legacy_coher* lo = s->init(&losa);
+    if (lo == NULL)
+        return NULL;
+
+    s->dbgEnv = &lo->dbgEnv;
+    return newViewCoher(lo);
+}
+
+interconn* legacyInterInit(struct sim* s, inter_sim_args* isa)
+{
+    legacy_inter_sim_args lisa = {isa->arg_count, isa->arg_list,
+                                  legacyViewMemory(isa->memory)};
+
+    legacy_interconn* li = s->init(&lisa);
+    if (li == NULL)
+        return NULL;
+
+    s->dbgEnv = &li->dbgEnv;
+    return newViewInter(li);
+}
+
+memory* legacyMemoryInit(struct sim* s, memory_sim_args* msa)
+{
+    legacy_sim_args lmsa = {msa->arg_count, msa->arg_list};
+
+    legacy_memory* lm = s->init(&lmsa);
+    if (lm == NULL)
+        return NULL;
+
+    s->dbgEnv = &lm->dbgEnv;
+    return newViewMemory(lm);
+}
+
+processor* legacyProcInit(struct sim* s, processor_sim_args* psa)
+{
+    legacy_processor_sim_args lpsa = {
+        legacyViewTrace(psa->tr), legacyViewCache(psa->cache_sim),
+        legacyViewBranch(psa->branch_sim), psa->arg_count, psa->arg_list};
+
+    legacy_processor* lp = s->init(&lpsa);
+    if (lp == NULL)
+        return NULL;
+
+    s->dbgEnv = &lp->dbgEnv;
+    return newViewProc(s->handle);
+}
@@ -0,0 +1,87 @@
+#ifndef LEGACY_H
+#define LEGACY_H
+
+#include <trace.h>
+#include <branch.h>
+#include <cache.h>
+#include <coherence.h>
+#include <interconnect.h>
+#include <memory.h>
+#include <processor.h>
+
+#include "engine.h"
+
+//
+// Legacy
+//
+//   Components built before CADSS_ABI_VERSION 2 keep their state in globals
+// and their functions take no instance argument.  The engine adapts each of
+// them to the current interface by giving it a "legacy view" of the
+// components that it calls and wrapping its own interface in a "new view".
+// As the legacy component is a single instance, so are the views: at most
+// one legacy component can be loaded for each role.
+//
+
+typedef struct _legacy_si {
+    int (*tick)(void);
+    int (*finish)(int);
+    int (*destroy)(void);
+} legacy_si;
+
+typedef struct _legacy_trace_reader {
+    legacy_si si;
+    trace_op* (*getNextOp)(int);
+} legacy_trace_reader;
+
+typedef struct _legacy_branch {
+    legacy_si si;
+    uint64_t (*branchRequest)(trace_op*, int);
+    debug_env_vars dbgEnv;
+} legacy_branch;
+
+typedef struct _legacy_cache {
+    legacy_si si;
+    void (*memoryRequest)(trace_op*, int, int64_t,
+                          void (*callback)(int, int64_t));
+    debug_env_vars dbgEnv;
+} legacy_cache;
+
+typedef struct _legacy_coher {
+    legacy_si si;
+    void (*registerCacheInterface)(void (*callback)(int, int, int64_t));
+    uint8_t (*permReq)(uint8_t is_read, uint64_t addr, int processorNum);
+    uint8_t (*invlReq)(uint64_t addr, int processorNum);
+    uint8_t (*busReq)(bus_req_type reqType, uint64_t addr, int processorNum);
+    debug_env_vars dbgEnv;
+} legacy_coher;
+
+typedef struct _legacy_interconn {
+    legacy_si si;
+    void (*busReq)(bus_req_type brt, uint64_t addr, int procNum);
+    void (*registerCoher)(legacy_coher* coherComp);
+    int (*busReqCacheTransfer)(uint64_t addr, int procNum);
+    debug_env_vars dbgEnv;
+} legacy_interconn;
+
+typedef struct _legacy_memory {
+    legacy_si si;
+    int (*busReq)(uint64_t addr, int procNum, void (*callback)(int, uint64_t));
+    void (*registerInterconnect)(legacy_interconn* interconnect);
+    debug_env_vars dbgEnv;
+} legacy_memory;
+
+typedef struct _legacy_processor {
+    legacy_si si;
+    debug_env_vars dbgEnv;
+} legacy_processor;
+
+// Initialize a legacy component from the current init arguments.  On
+//   success, s->dbgEnv is set to the component's own debug variables.
+branch* legacyBranchInit(struct sim* s, branch_sim_args* bsa);
+cache* legacyCacheInit(struct sim* s, cache_sim_args* csa);
+coher* legacyCoherInit(struct sim* s, coher_sim_args* osa);
+interconn* legacyInterInit(struct sim* s, inter_sim_args* isa);
+memory* legacyMemoryInit(struct sim* s, memory_sim_args* msa);
+processor* legacyProcInit(struct sim* s, processor_sim_args* psa);
+
+#endif
@@ -0,0 +1,309 @@
+#include <dirent.h>
+#include <errno.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "config.h"
+#include "engine.h"
+#include "memo.h"
+#include "sim.h"
+
+// FNV-1a, 64 bit.
+#define MEMO_HASH_BASIS 0xcbf29ce484222325UL
+#define MEMO_HASH_PRIME 0x100000001b3UL
+
+int memoOpen(memo* m, const char* dir)
+{
+    memset(m, 0, sizeof(memo));
+    m->hash = MEMO_HASH_BASIS;
+    m->dir = strdup(dir);
+    return (m->dir == NULL) ? -1 : 0;
+}
+
+void memoFree(memo* m)
+{
+    if (m->out != NULL)
+    {
+        fclose(m->out);
+        unlink(m->outPath);
+    }
+    free(m->outPath);
+    free(m->dir);
+    memset(m, 0, sizeof(memo));
+}
+
+void memoBytes(memo* m, const void* p, size_t len)
+{
+    const uint8_t* b = p;
+    uint64_t h = m->hash;
+
+    for (size_t i = 0; i < len; i++)
+    {
+        h ^= b[i];
+        h *= MEMO_HASH_PRIME;
+    }
+    m->hash = h;
+}
+
+// With the terminator, so that "ab" "c" and "a" "bc" differ.
+void memoString(memo* m, const char* s)
+{
+    memoBytes(m, s, strlen(s) + 1);
+}
+
+void memoInt(memo* m, int64_t v)
+{
+    memoBytes(m, &v, sizeof(v));
+}
+
+static int memoFile(memo* m, const char* path)
+{
+    FILE* f = fopen(path, "rb");
+    if (f == NULL)
+        return -1;
+
+    char buf[65536];
+    size_t n;
+    int64_t size = 0;
+    while ((n = fread(buf, 1, sizeof(buf), f)) > 0)
+    {
+        memoBytes(m, buf, n);
+        size += n;
+    }
+    memoInt(m, size);
+
+    int r = ferror(f) ? -1 : 0;
+    fclose(f);
+    return r;
+}
+
+int memoPath(memo* m, const char* path)
+{
+    struct stat st;
+    if (stat(path, &st) != 0)
+        return -1;
+    if (!S_ISDIR(st.st_mode))
+        return memoFile(m, path);
+
+    // Entries in name order, as hidden files are not traces.
+    struct dirent** entries = NULL;
+    int count = scandir(path, &entries, NULL, alphasort);
+    if (count < 0)
+        return -1;
+
+    int r = 0;
+    for (int i = 0; i < count; i++)
+    {
+        char entry[PATH_MAX];
+        if (r == 0 && entries[i]->d_name[0] != '.')
+        {
+            memoString(m, entries[i]->d_name);
+            if (snprintf(entry, sizeof(entry), "%s/%s", path,
+                         entries[i]->d_name)
+                    >= sizeof(entry)
+                || memoPath(m, entry) != 0)
+                r = -1;
+        }
+        free(entries[i]);
+    }
+    free(entries);
+
+    return r;
+}
+
+void memoComponent(memo* m, const char* name)
+{
+    char copy[SIM_NAME_LIMIT];
+    char path[SIM_NAME_LIMIT];
+
+    memoString(m, name);
+    snprintf(copy, sizeof(copy), "%s", name);
+    if (simComponentPath(copy, path, sizeof(path)) == 0)
+        memoFile(m, path);
+}
+
+static void memoArg(char* componentName, char** arg, void* ctx)
+{
+    memoString(ctx, componentName);
+    memoString(ctx, *arg);
+}
+
+void memoSettings(memo* m)
+{
+    visitSettings(memoArg, m);
+
+    // Clock domains also change the report without any arguments.
+    memoInt(m, hasSettings("clock"));
+}
+
+// The path of the result for the key with suffix, which the caller frees.
+static char* memoResult(memo* m, const char* suffix)
+{
+    snprintf(m->key, sizeof(m->key), "%016lx", m->hash);
+
+    size_t len = strlen(m->dir) + strlen(m->key) + strlen(suffix) + 2;
+    char* path = malloc(len);
+    if (path != NULL)
+        snprintf(path, len, "%s/%s%s", m->dir, m->key, suffix);
+    return path;
+}
+
+static void memoCopy(FILE* from, FILE* to)
+{
+    char buf[65536];
+    size_t n;
+
+    while ((n = fread(buf, 1, sizeof(buf), from)) > 0)
+        fwrite(buf, 1, n, to);
+    fflush(to);
+}
+
+// Statistics are kept in both formats, and written in the one that
+//   simWriteStats would use for path.
+static const char* memoStatsSuffix(const char* path)
+{
+    size_t len = strlen(path);
+    if (len >= 4 && strcmp(path + len - 4, ".csv") == 0)
+        return ".csv";
+    return ".json";
+}
+
+int memoReplay(memo* m, const char* statsFile)
+{
+    char* outPath = memoResult(m, ".out");
+    char* statsPath =
+        (statsFile != NULL) ? memoResult(m, memoStatsSuffix(statsFile)) : NULL;
+    FILE* out = (outPath != NULL) ? fopen(outPath, "r") : NULL;
+    FILE* stats = (statsPath != NULL) ? fopen(statsPath, "r") : NULL;
+    int hit = (out != NULL && (statsFile == NULL || stats != NULL));
+
+    if (hit)
+        memoCopy(out, stdout);
+    if (hit && statsFile != NULL)
+    {
+        if (strcmp(statsFile, "-") == 0)
+        {
+            memoCopy(stats, stdout);
+        }
+        else
+        {
+            FILE* f = fopen(statsFile, "w");
+            if (f == NULL)
+                perror("Opening statistics file");
+            else
+            {
+                memoCopy(stats, f);
+                fclose(f);
+            }
+        }
+    }
+
+    if (out != NULL)
+        fclose(out);
+    if (stats != NULL)
+        fclose(stats);
+    free(outPath);
+    free(statsPath);
+    return hit;
+}
+
+FILE* memoBegin(memo* m)
+{
+    if (mkdir(m->dir, 0777) != 0 && errno != EEXIST)
+    {
+        perror("Creating the result directory");
+        return NULL;
+    }
+
+    m->outPath = memoResult(m, ".out.XXXXXX");
+    if (m->outPath == NULL)
+        return NULL;
+
+    int fd = mkstemp(m->outPath);
+    if (fd < 0 || (m->out = fdopen(fd, "w+")) == NULL)
+    {
+        perror("Creating a result file");
+        if (fd >= 0)
+        {
+            close(fd);
+            unlink(m->outPath);
+        }
+        free(m->outPath);
+        m->outPath = NULL;
+        return NULL;
+    }
+
+    return m->out;
+}
+
+// Write the statistics with write to the result with suffix.
+static int memoKeep(memo* m, const char* suffix, const stats_table* st,
+                    void (*write)(const stats_table*, FILE*))
+{
+    char* path = memoResult(m, suffix);
+    size_t len = (path != NULL) ? strlen(path) + 8 : 0;
+    char* temp = (path != NULL) ? malloc(len) : NULL;
+    int r = -1;
+
+    if (temp != NULL)
+    {
+        snprintf(temp, len, "%s.XXXXXX", path);
+        int fd = mkstemp(temp);
+        FILE* f = (fd >= 0) ? fdopen(fd, "w") : NULL;
+        if (f != NULL)
+        {
+            write(st, f);
+            r = ferror(f) ? -1 : 0;
+            if (fclose(f) != 0)
+                r = -1;
+        }
+        else if (fd >= 0)
+        {
+            close(fd);
+        }
+
+        if (fd >= 0 && (r != 0 || rename(temp, path) != 0))
+        {
+            unlink(temp);
+            r = -1;
+        }
+    }
+
+    free(temp);
+    free(path);
+    return r;
+}
+
+int memoStore(memo* m, const stats_table* st)
+{
+    char* outPath = memoResult(m, ".out");
+    int r = -1;
+
+    // The report is only kept once its statistics are.
+    fflush(m->out);
+    if (outPath != NULL && !ferror(m->out)
+        && memoKeep(m, ".json", st, statsTableJson) == 0
+        && memoKeep(m, ".csv", st, statsTableCsv) == 0
+        && rename(m->outPath, outPath) == 0)
+    {
+        r = 0;
+    }
+    else
+    {
+        fprintf(stderr, "Failed to keep the result in %s\n", m->dir);
+        unlink(m->outPath);
+    }
+
+    // The report is written either way.
+    rewind(m->out);
+    memoCopy(m->out, stdout);
+
+    fclose(m->out);
+    m->out = NULL;
+    free(outPath);
+    return r;
+}
@@ -0,0 +1,61 @@
+#ifndef MEMO_H
+#define MEMO_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "registry.h"
+
+//
+// Memo
+//
+//   Results of earlier runs, kept in a directory under a key that hashes
+// everything that they depend on: the engine, the shared object of every
+// component, the trace, the open settings and the options of the run.  A run
+// with the same key writes the kept report and statistics instead of
+// simulating, and a rebuilt component or changed trace gives a new key.
+//
+//   The report of a run is kept as <key>.out, with its statistics as
+// <key>.json and <key>.csv, each written under a temporary name first so that
+// a run that fails or is interrupted leaves no result behind.
+//
+
+typedef struct _memo {
+    char* dir;
+    uint64_t hash;
+    char key[17];
+    char* outPath; // While the report is written.
+    FILE* out;
+} memo;
+
+// Start a key for results kept in dir, 0 on success.
+int memoOpen(memo* m, const char* dir);
+void memoFree(memo* m);
+
+// Add to the key.  A path may be a file or a directory, whose entries are
+//   added in order, and is 0 once it is read.
+void memoBytes(memo* m, const void* p, size_t len);
+void memoString(memo* m, const char* s);
+void memoInt(memo* m, int64_t v);
+int memoPath(memo* m, const char* path);
+
+// The shared object of the named component, or only its name if there is
+//   none, as a built in component is part of the engine.
+void memoComponent(memo* m, const char* name);
+
+// Every argument of the open settings.
+void memoSettings(memo* m);
+
+// Write the kept report to stdout, and its statistics to statsFile as
+//   simWriteStats would, if there is a result for the key.  1 if so.
+int memoReplay(memo* m, const char* statsFile);
+
+// A file for the report of the run, to be passed to memoStore, or NULL if
+//   it cannot be kept.
+FILE* memoBegin(memo* m);
+
+// Keep the report written to the file from memoBegin and the statistics of
+//   st, then write the report to stdout.  0 on success.
+int memoStore(memo* m, const stats_table* st);
+
+#endif
@@ -0,0 +1,419 @@
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "mix.h"
+
+#define MIX_LINE_LIMIT 4096
+
+int mixOpen(mix* m, const char* path)
+{
+    memset(m, 0, sizeof(mix));
+
+    FILE* f = fopen(path, "r");
+    if (f == NULL)
+    {
+        perror("Attempt to open mix file");
+        return -1;
+    }
+
+    char line[MIX_LINE_LIMIT];
+    int lineNum = 0;
+    int r = 0;
+    while (r == 0 && fgets(line, sizeof(line), f) != NULL)
+    {
+        lineNum++;
+        line[strcspn(line, "#\r\n")] = '\0';
+
+        char* save = NULL;
+        char* trace = strtok_r(line, " \t", &save);
+        char* offset = strtok_r(NULL, " \t", &save);
+        char* alone = strtok_r(NULL, " \t", &save);
+        if (trace == NULL)
+            continue;
+
+        mix_program p = {0};
+        char* end = NULL;
+        if (offset != NULL)
+        {
+            p.offset = strtoull(offset, &end, 0);
+            if (*end != '\0')
+                r = -1;
+        }
+        if (alone != NULL)
+        {
+            p.aloneIpc = strtod(alone, &end);
+            if (*end != '\0' || p.aloneIpc <= 0)
+                r = -1;
+        }
+        if (r != 0 || strtok_r(NULL, " \t", &save) != NULL)
+        {
+            fprintf(stderr, "%s:%d: expected <trace> [<offset> [<IPC>]]\n",
+                    path, lineNum);
+            r = -1;
+            break;
+        }
+
+        mix_program* programs =
+            realloc(m->programs, (m->count + 1) * sizeof(mix_program));
+        p.trace = strdup(trace);
+        if (programs == NULL || p.trace == NULL)
+        {
+            if (programs != NULL)
+                m->programs = programs;
+            free(p.trace);
+            r = -1;
+            break;
+        }
+        m->programs = programs;
+        m->programs[m->count++] = p;
+    }
+
+    fclose(f);
+    if (r == 0 && m->count == 0)
+    {
+        fprintf(stderr, "%s has no programs\n", path);
+        r = -1;
+    }
+    if (r != 0)
+        mixFree(m);
+    return r;
+}
+
+void mixFree(mix* m)
+{
+    for (int i = 0; i < m->count; i++)
+        free(m->programs[i].trace);
+    free(m->programs);
+    memset(m, 0, sizeof(mix));
+}
+
+//
+// Reader
+//
+typedef struct _mix_stream {
+    trace_reader* tr;
+    const mix_program* prog;
+    int ended; // Will not start over.
+    int done;  // Has run its minimum, or ended.
+} mix_stream;
+
+typedef struct _mix_ctx {
+    trace_reader pub; // Must be first, the instance is passed as a trace_reader*.
+    struct sim* trace;
+    sim_env env;    // Of the trace instances, which have one processor.
+    int verbose;
+    int count;
+    int64_t minOps;
+    int pending;    // Programs yet to run minOps.
+    mix_stream* streams;
+    const int64_t* tick;
+    uint64_t* ops;
+    uint64_t* restarts;
+    uint64_t* doneOps;
+    uint64_t* doneTick;
+} mix_ctx;
+
+static trace_reader* mixTraceOpen(mix_ctx* self, const mix_program* p)
+{
+    // Each instance reads the program as processor 0.
+    char* traceArgs[] = {"cadss", "-t", p->trace, NULL};
+    trace_sim_args tsa;
+    tsa.arg_count = 3;
+    tsa.arg_list = traceArgs;
+    tsa.env = &self->env;
+
+    optind = 1;
+    return self->trace->init(&tsa);
+}
+
+// The program on processorNum has run its minimum, or ended.
+static void mixProgramDone(mix_ctx* self, int processorNum)
+{
+    mix_stream* ms = &self->streams[processorNum];
+    if (ms->done)
+        return;
+
+    ms->done = 1;
+    self->doneOps[processorNum] = self->ops[processorNum];
+    self->doneTick[processorNum] = (self->tick != NULL) ? *self->tick : 0;
+    if (self->minOps > 0)
+        self->pending--;
+}
+
+static trace_op* mixGetNextOp(trace_reader* r, int processorNum)
+{
+    mix_ctx* self = (mix_ctx*)r;
+
+    if (processorNum >= self->count)
+        return NULL;
+    if (self->minOps > 0 && self->pending == 0)
+        return NULL;
+
+    mix_stream* ms = &self->streams[processorNum];
+    trace_op* op = ms->tr->getNextOp(ms->tr, 0);
+
+    // Start over while any program is short of its minimum.
+    if (op == NULL && !ms->ended && self->pending > 0)
+    {
+        trace_reader* tr = mixTraceOpen(self, ms->prog);
+        if (tr != NULL)
+        {
+            ms->tr->si.destroy(ms->tr);
+            ms->tr = tr;
+            op = tr->getNextOp(tr, 0);
+            self->restarts[processorNum]++;
+        }
+
+        if (op == NULL)
+            fprintf(stderr, "%s could not be started over\n",
+                    ms->prog->trace);
+        else if (self->verbose)
+        {
+            fprintf(stderr, "%s started over after %lu ops\n",
+                    ms->prog->trace, self->ops[processorNum]);
+        }
+    }
+    if (op == NULL)
+    {
+        ms->ended = 1;
+        mixProgramDone(self, processorNum);
+        return NULL;
+    }
+
+    if (op->op == MEM_LOAD || op->op == MEM_STORE)
+        op->memAddress += ms->prog->offset;
+
+    if (++self->ops[processorNum] == self->minOps)
+        mixProgramDone(self, processorNum);
+    return op;
+}
+
+static void mixBasicBlocks(trace_reader* r, int processorNum,
+                           trace_bb_visit visit, void* ctx)
+{
+    mix_ctx* self = (mix_ctx*)r;
+    trace_reader* tr = self->streams[processorNum].tr;
+
+    if (tr->basicBlocks != NULL)
+        tr->basicBlocks(tr, 0, visit, ctx);
+}
+
+// How far the last program is through its minimum, or else through its
+//   trace.
+static double mixConsumed(trace_reader* r)
+{
+    mix_ctx* self = (mix_ctx*)r;
+    double least = 1;
+
+    for (int i = 0; i < self->count; i++)
+    {
+        double c;
+        if (self->minOps > 0)
+        {
+            c = (double)self->ops[i] / self->minOps;
+        }
+        else
+        {
+            // Not safe to call while the stream starts over.
+            trace_reader* tr = self->streams[i].tr;
+            c = (tr->consumed != NULL) ? tr->consumed(tr) : -1;
+            if (c < 0)
+                return -1;
+        }
+
+        if (c < least)
+            least = c;
+    }
+
+    return least;
+}
+
+static int mixTick(void* r)
+{
+    return 1;
+}
+
+static int mixFinish(void* r, int outFd)
+{
+    return 0;
+}
+
+static int mixDestroy(void* r)
+{
+    mix_ctx* self = (mix_ctx*)r;
+
+    for (int i = 0; self->streams != NULL && i < self->count; i++)
+    {
+        if (self->streams[i].tr != NULL)
+            self->streams[i].tr->si.destroy(self->streams[i].tr);
+    }
+
+    free(self->streams);
+    free(self->ops);
+    free(self->restarts);
+    free(self->doneOps);
+    free(self->doneTick);
+    free(self);
+    return 0;
+}
+
+trace_reader* mixReader(struct sim* trace, const mix_program* programs,
+                        int count, int64_t minOps, int verbose)
+{
+    mix_ctx* self = calloc(1, sizeof(mix_ctx));
+    if (self == NULL)
+        return NULL;
+
+    self->trace = trace;
+    self->env.processorCount = 1;
+    self->env.verbose = verbose;
+    self->verbose = verbose;
+    self->count = count;
+    self->minOps = (minOps > 0) ? minOps : 0;
+    self->pending = (minOps > 0) ? count : 0;
+    self->streams = calloc(count, sizeof(mix_stream));
+    self->ops = calloc(count, sizeof(uint64_t));
+    self->restarts = calloc(count, sizeof(uint64_t));
+    self->doneOps = calloc(count, sizeof(uint64_t));
+    self->doneTick = calloc(count, sizeof(uint64_t));
+    if (self->streams == NULL || self->ops == NULL || self->restarts == NULL
+        || self->doneOps == NULL || self->doneTick == NULL)
+    {
+        mixDestroy(self);
+        return NULL;
+    }
+
+    for (int i = 0; i < count; i++)
+    {
+        mix_stream* ms = &self->streams[i];
+        ms->prog = &programs[i];
+        ms->tr = mixTraceOpen(self, ms->prog);
+        if (ms->tr == NULL)
+        {
+            mixDestroy(self);
+            return NULL;
+        }
+
+        if (ms->tr->basicBlocks != NULL)
+            self->pub.basicBlocks = mixBasicBlocks;
+    }
+
+    self->pub.si.tick = mixTick;
+    self->pub.si.finish = mixFinish;
+    self->pub.si.destroy = mixDestroy;
+    self->pub.getNextOp = mixGetNextOp;
+    self->pub.consumed = mixConsumed;
+
+    return &self->pub;
+}
+
+void mixReaderClock(trace_reader* r, const int64_t* tick)
+{
+    ((mix_ctx*)r)->tick = tick;
+}
+
+void mixReaderStats(trace_reader* r, const sim_env* env)
+{
+    mix_ctx* self = (mix_ctx*)r;
+
+    statsVector(env, "mix.ops", self->ops, self->count);
+    statsVector(env, "mix.restarts", self->restarts, self->count);
+    statsVector(env, "mix.doneOps", self->doneOps, self->count);
+    statsVector(env, "mix.doneTick", self->doneTick, self->count);
+}
+
+// Over the ops run until the program was done, or the whole run if it was
+//   not.
+static double mixReaderIpc(trace_reader* r, int processorNum, int64_t ticks)
+{
+    mix_ctx* self = (mix_ctx*)r;
+
+    if (self->streams[processorNum].done)
+    {
+        return (self->doneTick[processorNum] > 0)
+                   ? (double)self->doneOps[processorNum]
+                         / self->doneTick[processorNum]
+                   : 0;
+    }
+    return (ticks > 0) ? (double)self->ops[processorNum] / ticks : 0;
+}
+
+//
+// Results
+//
+int mixMeasureAlone(mix* m, struct sim* trace, const sim_names* names,
+                    int64_t minOps, int verbose)
+{
+    sim_env env = {0};
+    env.processorCount = 1;
+    env.verbose = verbose;
+
+    for (int i = 0; i < m->count; i++)
+    {
+        mix_program* p = &m->programs[i];
+        if (p->aloneIpc > 0)
+            continue;
+
+        trace_reader* tr = mixReader(trace, p, 1, minOps, verbose);
+        if (tr == NULL)
+            return -1;
+
+        simulation s;
+        if (simCreate(&s, names, tr, &env) != 0)
+        {
+            simDestroy(&s);
+            tr->si.destroy(tr);
+            return -1;
+        }
+        mixReaderClock(tr, &s.tickCount);
+        simRun(&s);
+
+        p->aloneIpc = mixReaderIpc(tr, 0, s.tickCount);
+        if (verbose)
+            fprintf(stderr, "%s alone: IPC %.4f over %ld ticks\n", p->trace,
+                    p->aloneIpc, s.tickCount);
+
+        simDestroy(&s);
+        tr->si.destroy(tr);
+    }
+
+    return 0;
+}
+
+void mixReport(const mix* m, trace_reader* r, int64_t ticks, FILE* f)
+{
+    mix_ctx* self = (mix_ctx*)r;
+    double weighted = 0;
+    double inverse = 0;
+    int complete = 1;
+
+    fprintf(f, "Mix - %d programs\n", m->count);
+    for (int i = 0; i < m->count; i++)
+    {
+        const mix_program* p = &m->programs[i];
+        double ipc = mixReaderIpc(r, i, ticks);
+
+        fprintf(f, "  %d: %s - %lu ops, %lu restarts, IPC %.4f", i,
+                p->trace, self->ops[i], self->restarts[i], ipc);
+        if (p->aloneIpc > 0 && ipc > 0)
+        {
+            double speedup = ipc / p->aloneIpc;
+            weighted += speedup;
+            inverse += 1 / speedup;
+            fprintf(f, ", alone %.4f, speedup %.4f", p->aloneIpc, speedup);
+        }
+        else
+        {
+            complete = 0;
+        }
+        fprintf(f, "\n");
+    }
+
+    if (complete)
+    {
+        fprintf(f, "Weighted speedup - %.4f\n", weighted);
+        fprintf(f, "Harmonic mean fairness - %.4f\n", m->count / inverse);
+    }
+}
@@ -0,0 +1,69 @@
+#ifndef MIX_H
+#define MIX_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "sim.h"
+
+//
+// Mix
+//
+//   A multiprogrammed workload, with a different trace on each core.  A mix
+// file lists one program per line, in the order of the cores:
+//
+//     <trace> [<offset> [<alone IPC>]]
+//
+// The offset is added to every data address of the program, so that
+// programs traced at the same addresses do not share blocks, and the alone
+// IPC is that of the program running on its own, measured by the engine if
+// it is not given.  '#' starts a comment.
+//
+//   Each core reads its program through one instance of the trace component.
+// With a minimum number of ops, a program that ends before every program has
+// run that many starts over, and the run stops once they all have, so each
+// program shares the machine for the whole run.  The IPC of a program is
+// taken over its ops up to its minimum, or else up to its end, as read from
+// the trace.
+//
+
+typedef struct _mix_program {
+    char* trace;
+    uint64_t offset;
+    double aloneIpc; // 0 if not known.
+} mix_program;
+
+typedef struct _mix {
+    int count;
+    mix_program* programs;
+} mix;
+
+// Read the mix file at path, 0 on success.
+int mixOpen(mix* m, const char* path);
+void mixFree(mix* m);
+
+// A new trace_reader with program i of programs on core i, read through the
+//   instances of trace, which must outlive it.  minOps may be 0 for no
+//   minimum.
+trace_reader* mixReader(struct sim* trace, const mix_program* programs,
+                        int count, int64_t minOps, int verbose);
+
+// Have the reader note the tick at which each program is done, by having
+//   run its minimum or by ending, from the tick count of its simulation.
+void mixReaderClock(trace_reader* r, const int64_t* tick);
+
+// Register the ops run by each program, the times that it started over,
+//   and the ops and tick at which it was done.
+void mixReaderStats(trace_reader* r, const sim_env* env);
+
+// Run each program without an alone IPC on one core of its own, with the
+//   open settings.  0 on success.
+int mixMeasureAlone(mix* m, struct sim* trace, const sim_names* names,
+                    int64_t minOps, int verbose);
+
+// Write the IPC of each program up to the tick at which it was done, and
+//   the weighted speedup and harmonic mean of the speedups over running
+//   alone.
+void mixReport(const mix* m, trace_reader* r, int64_t ticks, FILE* f);
+
+#endif
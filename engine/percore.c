@@ -0,0 +1,595 @@
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <stats.h>
+
+#include "config.h"
+#include "legacy.h"
+#include "percore.h"
+
+#define PERCORE_NAME_LIMIT 256
+
+// Registers the statistics of an instance with the processors that it is
+//   for in their names.
+typedef struct _percore_stats {
+    stats_registry reg;
+    const stats_registry* to;
+    const char* cores; // Such as "[0-3]".
+} percore_stats;
+
+struct _percore;
+
+// The coherence component as one cache instance sees it.  Only the proxy
+//   of the first instance passes on tick, finish and destroy, as each cache
+//   passes them on to its coherence component and the uncore is shared.
+typedef struct _percore_coher {
+    coher pub;
+    coher* to;
+    int chained;
+
+    // The coherence callback of the instance.
+    void* ctx;
+    void (*callback)(void*, int, int, int64_t);
+} percore_coher;
+
+// One instance for each set of processors, behind the cache or branch
+//   predictor of the simulation.
+typedef struct _percore {
+    union {
+        cache cache;
+        branch branch;
+    } pub; // Must be first, the instance is passed as either.
+    int count;
+    sim_interface** inst;
+    int* owner; // The instance of each processor.
+    sim_env* env;
+    percore_stats* stats;
+    percore_coher* coher; // For each cache.
+} percore;
+
+//
+// Statistics
+//
+static void percoreName(percore_stats* ps, const char* name, char* buf)
+{
+    size_t role = strcspn(name, ".");
+    snprintf(buf, PERCORE_NAME_LIMIT, "%.*s%s%s", (int)role, name, ps->cores,
+             name + role);
+}
+
+static void percoreCounter(void* self, const char* name,
+                           const uint64_t* value)
+{
+    percore_stats* ps = self;
+    char buf[PERCORE_NAME_LIMIT];
+
+    percoreName(ps, name, buf);
+    ps->to->counter(ps->to->self, buf, value);
+}
+
+static void percoreVector(void* self, const char* name,
+                          const uint64_t* values, int count)
+{
+    percore_stats* ps = self;
+    char buf[PERCORE_NAME_LIMIT];
+
+    percoreName(ps, name, buf);
+    ps->to->vector(ps->to->self, buf, values, count);
+}
+
+static void percoreHist(void* self, const char* name, const stat_hist* h)
+{
+    percore_stats* ps = self;
+    char buf[PERCORE_NAME_LIMIT];
+
+    percoreName(ps, name, buf);
+    ps->to->hist(ps->to->self, buf, h);
+}
+
+static void percoreGauge(void* self, const char* name, const uint64_t* value)
+{
+    percore_stats* ps = self;
+    char buf[PERCORE_NAME_LIMIT];
+
+    percoreName(ps, name, buf);
+    ps->to->gauge(ps->to->self, buf, value);
+}
+
+//
+// sim_interface of the instances together
+//
+static int percoreTick(void* self)
+{
+    percore* pc = self;
+
+    for (int i = 0; i < pc->count; i++)
+        pc->inst[i]->tick(pc->inst[i]);
+    return 0;
+}
+
+static int percoreFinish(void* self, int outFd)
+{
+    percore* pc = self;
+    int r = 0;
+
+    for (int i = 0; i < pc->count; i++)
+        r |= pc->inst[i]->finish(pc->inst[i], outFd);
+    return r;
+}
+
+static void percoreFree(percore* pc)
+{
+    free(pc->inst);
+    free(pc->owner);
+    free(pc->env);
+    free(pc->stats);
+    free(pc->coher);
+    free(pc);
+}
+
+static int percoreDestroy(void* self)
+{
+    percore* pc = self;
+    int r = 0;
+
+    for (int i = 0; i < pc->count; i++)
+        r |= pc->inst[i]->destroy(pc->inst[i]);
+    percoreFree(pc);
+    return r;
+}
+
+static int64_t percoreIdleTicks(void* self)
+{
+    percore* pc = self;
+    int64_t idle = SIM_IDLE_FOREVER;
+
+    for (int i = 0; i < pc->count && idle > 0; i++)
+    {
+        int64_t t = pc->inst[i]->idleTicks(pc->inst[i]);
+        if (t < idle)
+            idle = t;
+    }
+    return idle;
+}
+
+static void percoreSkipTicks(void* self, int64_t ticks)
+{
+    percore* pc = self;
+
+    for (int i = 0; i < pc->count; i++)
+        pc->inst[i]->skipTicks(pc->inst[i], ticks);
+}
+
+static int percoreSave(void* self, FILE* f)
+{
+    percore* pc = self;
+
+    for (int i = 0; i < pc->count; i++)
+    {
+        int r = pc->inst[i]->save(pc->inst[i], f);
+        if (r != 0)
+            return r;
+    }
+    return 0;
+}
+
+static int percoreRestore(void* self, FILE* f)
+{
+    percore* pc = self;
+
+    for (int i = 0; i < pc->count; i++)
+    {
+        if (pc->inst[i]->restore(pc->inst[i], f) != 0)
+            return -1;
+    }
+    return 0;
+}
+
+// The optional entry points are only there if every instance has them.
+static void percoreInterface(percore* pc, sim_interface* si)
+{
+    int idle = 1;
+    int save = 1;
+
+    for (int i = 0; i < pc->count; i++)
+    {
+        idle &= (pc->inst[i]->idleTicks != NULL
+                 && pc->inst[i]->skipTicks != NULL);
+        save &= (pc->inst[i]->save != NULL && pc->inst[i]->restore != NULL);
+    }
+
+    si->tick = percoreTick;
+    si->finish = percoreFinish;
+    si->destroy = percoreDestroy;
+    si->idleTicks = (idle) ? percoreIdleTicks : NULL;
+    si->skipTicks = (idle) ? percoreSkipTicks : NULL;
+    si->reconfigure = NULL;
+    si->save = (save) ? percoreSave : NULL;
+    si->restore = (save) ? percoreRestore : NULL;
+}
+
+// Group the processors by the settings of componentName that they have,
+//   into pc->owner, and make an env for each group.  The first processor
+//   of each group is written to first.  The number of groups, or -1.
+static int percoreGroups(percore* pc, char* componentName,
+                         const sim_env* env, int* first)
+{
+    int processorCount = env->processorCount;
+    const char** names = calloc(processorCount, sizeof(char*));
+    pc->owner = calloc(processorCount, sizeof(int));
+    if (names == NULL || pc->owner == NULL)
+    {
+        free(names);
+        return -1;
+    }
+
+    for (int i = 0; i < processorCount; i++)
+    {
+        int argCount = 0;
+        const char* coreName = NULL;
+        getCoreSettings(componentName, i, &argCount, &coreName);
+
+        int g = 0;
+        while (g < pc->count && names[g] != coreName)
+            g++;
+        if (g == pc->count)
+        {
+            names[g] = coreName;
+            first[g] = i;
+            pc->count++;
+        }
+        pc->owner[i] = g;
+    }
+
+    pc->env = calloc(pc->count, sizeof(sim_env));
+    pc->stats = calloc(pc->count, sizeof(percore_stats));
+    if (pc->env == NULL || pc->stats == NULL)
+    {
+        free(names);
+        return -1;
+    }
+
+    for (int g = 0; g < pc->count; g++)
+    {
+        pc->env[g] = *env;
+        if (names[g] == NULL || env->stats == NULL)
+            continue;
+
+        percore_stats* ps = &pc->stats[g];
+        ps->reg.self = ps;
+        ps->reg.counter = percoreCounter;
+        ps->reg.vector = percoreVector;
+        ps->reg.hist = percoreHist;
+        ps->reg.gauge = percoreGauge;
+        ps->to = env->stats;
+        ps->cores = strchr(names[g], '[');
+        pc->env[g].stats = &ps->reg;
+    }
+
+    free(names);
+    return pc->count;
+}
+
+// A new percore for the processors of env, or NULL if componentName has
+//   the same settings for all of them.
+static percore* percoreNew(struct sim* sim, char* componentName,
+                           const sim_env* env, int* first, int* failed)
+{
+    *failed = 0;
+    if (!hasCoreSettings(componentName))
+        return NULL;
+    checkCoreSettings(componentName, env->processorCount);
+
+    percore* pc = calloc(1, sizeof(percore));
+    if (pc == NULL || percoreGroups(pc, componentName, env, first) < 0)
+    {
+        fprintf(stderr, "Failed to group the processors of %s\n",
+                componentName);
+        *failed = 1;
+    }
+    else if (pc->count > 1 && sim->legacy)
+    {
+        fprintf(stderr, "The %s component has a single instance and cannot "
+                        "have settings for some processors\n",
+                componentName);
+        *failed = 1;
+    }
+    else
+    {
+        pc->inst = calloc(pc->count, sizeof(sim_interface*));
+        if (pc->inst != NULL)
+            return pc;
+        *failed = 1;
+    }
+
+    if (pc != NULL)
+        percoreFree(pc);
+    return NULL;
+}
+
+//
+// Cache
+//
+static void percoreMemoryRequest(cache* c, trace_op* op, int processorNum,
+                                 int64_t tag, void* ctx,
+                                 void (*callback)(void*, int, int64_t))
+{
+    percore* pc = (percore*)c;
+    cache* inst = (cache*)pc->inst[pc->owner[processorNum]];
+
+    inst->memoryRequest(inst, op, processorNum, tag, ctx, callback);
+}
+
+static void percoreWarmRequest(cache* c, trace_op* op, int processorNum)
+{
+    percore* pc = (percore*)c;
+    cache* inst = (cache*)pc->inst[pc->owner[processorNum]];
+
+    inst->warmRequest(inst, op, processorNum);
+}
+
+static void percoreRestoreRequestor(cache* c, void* ctx,
+                                    void (*callback)(void*, int, int64_t))
+{
+    percore* pc = (percore*)c;
+
+    for (int i = 0; i < pc->count; i++)
+    {
+        cache* inst = (cache*)pc->inst[i];
+        inst->restoreRequestor(inst, ctx, callback);
+    }
+}
+
+static void percoreCoherCallback(void* ctx, int type, int processorNum,
+                                 int64_t addr)
+{
+    percore* pc = ctx;
+    percore_coher* pco = &pc->coher[pc->owner[processorNum]];
+
+    pco->callback(pco->ctx, type, processorNum, addr);
+}
+
+//
+// Coherence proxy
+//
+static int percoreCoherTick(void* self)
+{
+    percore_coher* pco = self;
+    return (pco->chained) ? pco->to->si.tick(pco->to) : 0;
+}
+
+static int percoreCoherFinish(void* self, int outFd)
+{
+    percore_coher* pco = self;
+    return (pco->chained) ? pco->to->si.finish(pco->to, outFd) : 0;
+}
+
+static int percoreCoherDestroy(void* self)
+{
+    percore_coher* pco = self;
+    return (pco->chained) ? pco->to->si.destroy(pco->to) : 0;
+}
+
+static void percoreRegisterCache(coher* cc, void* ctx,
+                                 void (*callback)(void*, int, int, int64_t))
+{
+    percore_coher* pco = (percore_coher*)cc;
+
+    pco->ctx = ctx;
+    pco->callback = callback;
+}
+
+static uint8_t percorePermReq(coher* cc, uint8_t is_read, uint64_t addr,
+                              int processorNum)
+{
+    coher* to = ((percore_coher*)cc)->to;
+    return to->permReq(to, is_read, addr, processorNum);
+}
+
+static uint8_t percoreInvlReq(coher* cc, uint64_t addr, int processorNum)
+{
+    coher* to = ((percore_coher*)cc)->to;
+    return to->invlReq(to, addr, processorNum);
+}
+
+static uint8_t percoreBusReq(coher* cc, bus_req_type reqType, uint64_t addr,
+                             int processorNum)
+{
+    coher* to = ((percore_coher*)cc)->to;
+    return to->busReq(to, reqType, addr, processorNum);
+}
+
+static void percoreWarmReq(coher* cc, uint8_t is_read, uint64_t addr,
+                           int processorNum)
+{
+    coher* to = ((percore_coher*)cc)->to;
+    to->warmReq(to, is_read, addr, processorNum);
+}
+
+static const char* percoreStateName(coher* cc, uint64_t addr,
+                                    int processorNum)
+{
+    coher* to = ((percore_coher*)cc)->to;
+    return to->stateName(to, addr, processorNum);
+}
+
+static void percoreCoherInit(percore_coher* pco, coher* to, int chained)
+{
+    memset(pco, 0, sizeof(percore_coher));
+    pco->to = to;
+    pco->chained = chained;
+    pco->pub.si.tick = percoreCoherTick;
+    pco->pub.si.finish = percoreCoherFinish;
+    pco->pub.si.destroy = percoreCoherDestroy;
+    pco->pub.registerCacheInterface = percoreRegisterCache;
+    pco->pub.permReq = percorePermReq;
+    pco->pub.invlReq = percoreInvlReq;
+    pco->pub.busReq = percoreBusReq;
+    pco->pub.warmReq = (to->warmReq != NULL) ? percoreWarmReq : NULL;
+    pco->pub.stateName = (to->stateName != NULL) ? percoreStateName : NULL;
+}
+
+static cache* cacheInit(struct sim* csim, const sim_env* env,
+                        coher* coherComp, char* componentName, int core)
+{
+    int argCount = 0;
+    const char* coreName = NULL;
+    char** arg = getCoreSettings(componentName, core, &argCount, &coreName);
+
+    cache_sim_args csa;
+    csa.arg_count = argCount;
+    csa.arg_list = arg;
+    csa.env = env;
+    csa.coherComp = coherComp;
+    optind = 1;
+    return csim->legacy ? legacyCacheInit(csim, &csa) : csim->init(&csa);
+}
+
+cache* percoreCacheInit(struct sim* csim, const sim_env* env,
+                        coher* coherComp)
+{
+    int* first = calloc(env->processorCount, sizeof(int));
+    int failed = 0;
+    percore* pc = (first != NULL)
+                      ? percoreNew(csim, "cache", env, first, &failed)
+                      : NULL;
+    if (first == NULL || failed)
+    {
+        free(first);
+        return NULL;
+    }
+    if (pc == NULL)
+    {
+        free(first);
+        return simCacheInit(csim, env, coherComp);
+    }
+    if (pc->count == 1)
+    {
+        percoreFree(pc);
+        free(first);
+        return cacheInit(csim, env, coherComp, "cache", 0);
+    }
+
+    pc->coher = calloc(pc->count, sizeof(percore_coher));
+    if (pc->coher == NULL)
+    {
+        percoreFree(pc);
+        free(first);
+        return NULL;
+    }
+
+    int made = 0;
+    for (; made < pc->count; made++)
+    {
+        percoreCoherInit(&pc->coher[made], coherComp, made == 0);
+        pc->inst[made] = (sim_interface*)cacheInit(csim, &pc->env[made],
+                                                   &pc->coher[made].pub,
+                                                   "cache", first[made]);
+        if (pc->inst[made] == NULL)
+            break;
+    }
+    free(first);
+
+    // The coherence component is left to the caller, as on any failure.
+    if (made < pc->count)
+    {
+        for (int i = 0; i < made; i++)
+        {
+            pc->coher[i].chained = 0;
+            pc->inst[i]->destroy(pc->inst[i]);
+        }
+        percoreFree(pc);
+        return NULL;
+    }
+    coherComp->registerCacheInterface(coherComp, pc, percoreCoherCallback);
+
+    int warm = 1;
+    int rebind = 1;
+    for (int i = 0; i < pc->count; i++)
+    {
+        warm &= (((cache*)pc->inst[i])->warmRequest != NULL);
+        rebind &= (((cache*)pc->inst[i])->restoreRequestor != NULL);
+    }
+
+    percoreInterface(pc, &pc->pub.cache.si);
+    pc->pub.cache.memoryRequest = percoreMemoryRequest;
+    pc->pub.cache.warmRequest = (warm) ? percoreWarmRequest : NULL;
+    pc->pub.cache.restoreRequestor = (rebind) ? percoreRestoreRequestor : NULL;
+    return &pc->pub.cache;
+}
+
+//
+// Branch predictor
+//
+static uint64_t percoreBranchRequest(branch* b, trace_op* op,
+                                     int processorNum)
+{
+    percore* pc = (percore*)b;
+    branch* inst = (branch*)pc->inst[pc->owner[processorNum]];
+
+    return inst->branchRequest(inst, op, processorNum);
+}
+
+static branch* branchInit(struct sim* bsim, const sim_env* env,
+                          char* componentName, int core)
+{
+    int argCount = 0;
+    const char* coreName = NULL;
+    char** arg = getCoreSettings(componentName, core, &argCount, &coreName);
+
+    branch_sim_args bsa;
+    bsa.arg_count = argCount;
+    bsa.arg_list = arg;
+    bsa.env = env;
+    optind = 1;
+    return bsim->legacy ? legacyBranchInit(bsim, &bsa) : bsim->init(&bsa);
+}
+
+branch* percoreBranchInit(struct sim* bsim, const sim_env* env)
+{
+    int* first = calloc(env->processorCount, sizeof(int));
+    int failed = 0;
+    percore* pc = (first != NULL)
+                      ? percoreNew(bsim, "branch", env, first, &failed)
+                      : NULL;
+    if (first == NULL || failed)
+    {
+        free(first);
+        return NULL;
+    }
+    if (pc == NULL)
+    {
+        free(first);
+        return simBranchInit(bsim, env);
+    }
+    if (pc->count == 1)
+    {
+        percoreFree(pc);
+        free(first);
+        return branchInit(bsim, env, "branch", 0);
+    }
+
+    int made = 0;
+    for (; made < pc->count; made++)
+    {
+        pc->inst[made] = (sim_interface*)branchInit(bsim, &pc->env[made],
+                                                    "branch", first[made]);
+        if (pc->inst[made] == NULL)
+            break;
+    }
+    free(first);
+
+    if (made < pc->count)
+    {
+        for (int i = 0; i < made; i++)
+            pc->inst[i]->destroy(pc->inst[i]);
+        percoreFree(pc);
+        return NULL;
+    }
+
+    percoreInterface(pc, &pc->pub.branch.si);
+    pc->pub.branch.branchRequest = percoreBranchRequest;
+    return &pc->pub.branch;
+}
@@ -0,0 +1,29 @@
+#ifndef PERCORE_H
+#define PERCORE_H
+
+#include "sim.h"
+
+//
+// Per-core instances
+//
+//   With settings for some processors, see config.h, the cache or branch
+// predictor of a simulation is an instance for each set of processors with
+// the same settings, behind one that passes each request, and each
+// coherence callback, to the instance of its processor, so that cores can
+// differ as in big.LITTLE designs.  Every instance sees the processors by
+// their numbers in the simulation, and is ticked, saved and finished with
+// the others.  The statistics of an instance for some processors are named
+// with them, such as "cache[0-3].hits".
+//
+//   As a legacy component has a single instance, it cannot be given
+// settings for some processors.
+//
+
+// The cache of a simulation, or NULL on failure.
+cache* percoreCacheInit(struct sim* csim, const sim_env* env,
+                        coher* coherComp);
+
+// The branch predictor of a simulation, or NULL on failure.
+branch* percoreBranchInit(struct sim* bsim, const sim_env* env);
+
+#endif
@@ -0,0 +1,432 @@
+#include <linux/perf_event.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#include "profile.h"
+
+enum prof_point
+{
+    PROF_TRACE_NEXT,
+    PROF_PROC_TICK,
+    PROF_BRANCH_TICK,
+    PROF_BRANCH_REQ,
+    PROF_CACHE_TICK,
+    PROF_CACHE_REQ,
+    PROF_COHER_TICK,
+    PROF_COHER_PERM,
+    PROF_COHER_BUS,
+    PROF_INTER_TICK,
+    PROF_INTER_BUS,
+    PROF_INTER_XFER,
+    PROF_MEM_TICK,
+    PROF_MEM_BUS,
+    PROF_POINT_COUNT
+};
+
+static const char* pointName[PROF_POINT_COUNT] = {
+    [PROF_TRACE_NEXT] = "trace.getNextOp",
+    [PROF_PROC_TICK] = "processor.tick",
+    [PROF_BRANCH_TICK] = "branch.tick",
+    [PROF_BRANCH_REQ] = "branch.branchRequest",
+    [PROF_CACHE_TICK] = "cache.tick",
+    [PROF_CACHE_REQ] = "cache.memoryRequest",
+    [PROF_COHER_TICK] = "coherence.tick",
+    [PROF_COHER_PERM] = "coherence.permReq",
+    [PROF_COHER_BUS] = "coherence.busReq",
+    [PROF_INTER_TICK] = "interconnect.tick",
+    [PROF_INTER_BUS] = "interconnect.busReq",
+    [PROF_INTER_XFER] = "interconnect.busReqCacheTransfer",
+    [PROF_MEM_TICK] = "memory.tick",
+    [PROF_MEM_BUS] = "memory.busReq",
+};
+
+// Calls nest through the tick chain, a few levels deep.
+#define PROF_MAX_DEPTH 64
+
+// Instructions and last level cache misses.
+#define PROF_EVENTS 2
+
+typedef struct _prof_count {
+    uint64_t calls;
+    uint64_t self;
+    uint64_t total;
+    uint64_t events[PROF_EVENTS]; // Self
+} prof_count;
+
+static struct {
+    simulation* s;
+
+    // Original entry points.
+    trace_op* (*getNextOp)(trace_reader*, int);
+    int (*procTick)(void*);
+    int (*branchTick)(void*);
+    uint64_t (*branchRequest)(branch*, trace_op*, int);
+    int (*cacheTick)(void*);
+    void (*memoryRequest)(cache*, trace_op*, int, int64_t, void*,
+                          void (*)(void*, int, int64_t));
+    int (*coherTick)(void*);
+    uint8_t (*permReq)(coher*, uint8_t, uint64_t, int);
+    uint8_t (*coherBusReq)(coher*, bus_req_type, uint64_t, int);
+    int (*interTick)(void*);
+    void (*interBusReq)(interconn*, bus_req_type, uint64_t, int);
+    int (*busReqCacheTransfer)(interconn*, uint64_t, int);
+    int (*memTick)(void*);
+    int (*memBusReq)(memory*, uint64_t, int, void*,
+                     void (*)(void*, int, uint64_t));
+
+    prof_count counts[PROF_POINT_COUNT];
+    int depth;
+    uint64_t start[PROF_MAX_DEPTH];
+    uint64_t child[PROF_MAX_DEPTH];
+    uint64_t evStart[PROF_MAX_DEPTH][PROF_EVENTS];
+    uint64_t evChild[PROF_MAX_DEPTH][PROF_EVENTS];
+
+    int perfFd[PROF_EVENTS]; // The first leads the group, -1 if closed.
+
+    uint64_t timeStart;
+    uint64_t timeEnd;
+    struct timespec wallStart;
+    struct timespec wallEnd;
+} prof;
+
+static inline uint64_t profNow(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+#endif
+}
+
+static void profReadEvents(uint64_t* ev)
+{
+    struct {
+        uint64_t nr;
+        uint64_t values[PROF_EVENTS];
+    } rf;
+
+    if (read(prof.perfFd[0], &rf, sizeof(rf)) != sizeof(rf))
+    {
+        memset(ev, 0, sizeof(rf.values));
+        return;
+    }
+    memcpy(ev, rf.values, sizeof(rf.values));
+}
+
+static inline void profEnter(void)
+{
+    int d = prof.depth++;
+    assert(d < PROF_MAX_DEPTH);
+
+    prof.child[d] = 0;
+    if (prof.perfFd[0] >= 0)
+    {
+        memset(prof.evChild[d], 0, sizeof(prof.evChild[d]));
+        profReadEvents(prof.evStart[d]);
+    }
+    prof.start[d] = profNow();
+}
+
+static inline void profLeave(enum prof_point point)
+{
+    uint64_t now = profNow();
+    int d = --prof.depth;
+    uint64_t elapsed = now - prof.start[d];
+    prof_count* c = &prof.counts[point];
+
+    c->calls++;
+    c->total += elapsed;
+    c->self += elapsed - prof.child[d];
+    if (d > 0)
+        prof.child[d - 1] += elapsed;
+
+    if (prof.perfFd[0] >= 0)
+    {
+        uint64_t ev[PROF_EVENTS];
+        profReadEvents(ev);
+
+        for (int e = 0; e < PROF_EVENTS; e++)
+        {
+            uint64_t counted = ev[e] - prof.evStart[d][e];
+            c->events[e] += counted - prof.evChild[d][e];
+            if (d > 0)
+                prof.evChild[d - 1][e] += counted;
+        }
+    }
+}
+
+//
+// Wrappers
+//
+#define PROF_TICK(wrapper, orig, point)                                        \
+    static int wrapper(void* self)                                             \
+    {                                                                          \
+        profEnter();                                                           \
+        int r = prof.orig(self);                                               \
+        profLeave(point);                                                      \
+        return r;                                                              \
+    }
+
+PROF_TICK(profProcTick, procTick, PROF_PROC_TICK)
+PROF_TICK(profBranchTick, branchTick, PROF_BRANCH_TICK)
+PROF_TICK(profCacheTick, cacheTick, PROF_CACHE_TICK)
+PROF_TICK(profCoherTick, coherTick, PROF_COHER_TICK)
+PROF_TICK(profInterTick, interTick, PROF_INTER_TICK)
+PROF_TICK(profMemTick, memTick, PROF_MEM_TICK)
+
+static trace_op* profGetNextOp(trace_reader* tr, int processorNum)
+{
+    profEnter();
+    trace_op* op = prof.getNextOp(tr, processorNum);
+    profLeave(PROF_TRACE_NEXT);
+    return op;
+}
+
+static uint64_t profBranchRequest(branch* b, trace_op* op, int processorNum)
+{
+    profEnter();
+    uint64_t r = prof.branchRequest(b, op, processorNum);
+    profLeave(PROF_BRANCH_REQ);
+    return r;
+}
+
+static void profMemoryRequest(cache* c, trace_op* op, int processorNum,
+                              int64_t tag, void* ctx,
+                              void (*callback)(void*, int, int64_t))
+{
+    profEnter();
+    prof.memoryRequest(c, op, processorNum, tag, ctx, callback);
+    profLeave(PROF_CACHE_REQ);
+}
+
+static uint8_t profPermReq(coher* cc, uint8_t is_read, uint64_t addr,
+                           int processorNum)
+{
+    profEnter();
+    uint8_t r = prof.permReq(cc, is_read, addr, processorNum);
+    profLeave(PROF_COHER_PERM);
+    return r;
+}
+
+static uint8_t profCoherBusReq(coher* cc, bus_req_type reqType, uint64_t addr,
+                               int processorNum)
+{
+    profEnter();
+    uint8_t r = prof.coherBusReq(cc, reqType, addr, processorNum);
+    profLeave(PROF_COHER_BUS);
+    return r;
+}
+
+static void profInterBusReq(interconn* ic, bus_req_type brt, uint64_t addr,
+                            int procNum)
+{
+    profEnter();
+    prof.interBusReq(ic, brt, addr, procNum);
+    profLeave(PROF_INTER_BUS);
+}
+
+static int profBusReqCacheTransfer(interconn* ic, uint64_t addr, int procNum)
+{
+    profEnter();
+    int r = prof.busReqCacheTransfer(ic, addr, procNum);
+    profLeave(PROF_INTER_XFER);
+    return r;
+}
+
+static int profMemBusReq(memory* m, uint64_t addr, int procNum, void* ctx,
+                         void (*callback)(void*, int, uint64_t))
+{
+    profEnter();
+    int r = prof.memBusReq(m, addr, procNum, ctx, callback);
+    profLeave(PROF_MEM_BUS);
+    return r;
+}
+
+//
+// perf
+//
+static int perfOpen(uint64_t config, int group)
+{
+    struct perf_event_attr pe;
+
+    memset(&pe, 0, sizeof(pe));
+    pe.type = PERF_TYPE_HARDWARE;
+    pe.size = sizeof(pe);
+    pe.config = config;
+    pe.exclude_kernel = 1;
+    pe.exclude_hv = 1;
+    pe.read_format = PERF_FORMAT_GROUP;
+
+    return syscall(SYS_perf_event_open, &pe, 0, -1, group, 0);
+}
+
+static void perfClose(void)
+{
+    for (int e = PROF_EVENTS - 1; e >= 0; e--)
+    {
+        if (prof.perfFd[e] >= 0)
+            close(prof.perfFd[e]);
+        prof.perfFd[e] = -1;
+    }
+}
+
+static void perfStart(void)
+{
+    prof.perfFd[0] = perfOpen(PERF_COUNT_HW_INSTRUCTIONS, -1);
+    if (prof.perfFd[0] >= 0)
+        prof.perfFd[1] = perfOpen(PERF_COUNT_HW_CACHE_MISSES, prof.perfFd[0]);
+
+    if (prof.perfFd[0] < 0 || prof.perfFd[1] < 0)
+    {
+        perror("perf counters are not available");
+        perfClose();
+    }
+}
+
+int profileAttach(simulation* s, int perf)
+{
+    if (prof.s != NULL)
+    {
+        fprintf(stderr, "Only one simulation can be profiled at a time\n");
+        return -1;
+    }
+
+    memset(&prof, 0, sizeof(prof));
+    prof.s = s;
+    prof.perfFd[0] = -1;
+    prof.perfFd[1] = -1;
+    if (perf)
+        perfStart();
+
+    prof.getNextOp = s->tr->getNextOp;
+    s->tr->getNextOp = profGetNextOp;
+
+    prof.procTick = s->proc_sim->si.tick;
+    s->proc_sim->si.tick = profProcTick;
+
+    prof.branchTick = s->branch_sim->si.tick;
+    prof.branchRequest = s->branch_sim->branchRequest;
+    s->branch_sim->si.tick = profBranchTick;
+    s->branch_sim->branchRequest = profBranchRequest;
+
+    prof.cacheTick = s->cache_sim->si.tick;
+    prof.memoryRequest = s->cache_sim->memoryRequest;
+    s->cache_sim->si.tick = profCacheTick;
+    s->cache_sim->memoryRequest = profMemoryRequest;
+
+    prof.coherTick = s->coher_sim->si.tick;
+    prof.permReq = s->coher_sim->permReq;
+    prof.coherBusReq = s->coher_sim->busReq;
+    s->coher_sim->si.tick = profCoherTick;
+    s->coher_sim->permReq = profPermReq;
+    s->coher_sim->busReq = profCoherBusReq;
+
+    prof.interTick = s->inter_sim->si.tick;
+    prof.interBusReq = s->inter_sim->busReq;
+    prof.busReqCacheTransfer = s->inter_sim->busReqCacheTransfer;
+    s->inter_sim->si.tick = profInterTick;
+    s->inter_sim->busReq = profInterBusReq;
+    s->inter_sim->busReqCacheTransfer = profBusReqCacheTransfer;
+
+    prof.memTick = s->mem_sim->si.tick;
+    prof.memBusReq = s->mem_sim->busReq;
+    s->mem_sim->si.tick = profMemTick;
+    s->mem_sim->busReq = profMemBusReq;
+
+    clock_gettime(CLOCK_MONOTONIC, &prof.wallStart);
+    prof.timeStart = profNow();
+
+    return 0;
+}
+
+void profileDetach(simulation* s)
+{
+    if (prof.s != s)
+        return;
+
+    prof.timeEnd = profNow();
+    clock_gettime(CLOCK_MONOTONIC, &prof.wallEnd);
+
+    s->tr->getNextOp = prof.getNextOp;
+    s->proc_sim->si.tick = prof.procTick;
+    s->branch_sim->si.tick = prof.branchTick;
+    s->branch_sim->branchRequest = prof.branchRequest;
+    s->cache_sim->si.tick = prof.cacheTick;
+    s->cache_sim->memoryRequest = prof.memoryRequest;
+    s->coher_sim->si.tick = prof.coherTick;
+    s->coher_sim->permReq = prof.permReq;
+    s->coher_sim->busReq = prof.coherBusReq;
+    s->inter_sim->si.tick = prof.interTick;
+    s->inter_sim->busReq = prof.interBusReq;
+    s->inter_sim->busReqCacheTransfer = prof.busReqCacheTransfer;
+    s->mem_sim->si.tick = prof.memTick;
+    s->mem_sim->busReq = prof.memBusReq;
+
+    perfClose();
+    prof.s = NULL;
+}
+
+void profileReport(FILE* f)
+{
+    // A report before detaching covers the time so far.
+    uint64_t timeEnd = prof.timeEnd;
+    struct timespec wallEnd = prof.wallEnd;
+    if (prof.s != NULL)
+    {
+        timeEnd = profNow();
+        clock_gettime(CLOCK_MONOTONIC, &wallEnd);
+    }
+
+    double wall = (wallEnd.tv_sec - prof.wallStart.tv_sec)
+                  + (wallEnd.tv_nsec - prof.wallStart.tv_nsec) / 1e9;
+    uint64_t elapsed = timeEnd - prof.timeStart;
+    if (elapsed == 0)
+        elapsed = 1;
+
+    int perf = 0;
+    uint64_t inComponents = 0;
+    for (int i = 0; i < PROF_POINT_COUNT; i++)
+    {
+        inComponents += prof.counts[i].self;
+        for (int e = 0; e < PROF_EVENTS; e++)
+            perf |= (prof.counts[i].events[e] != 0);
+    }
+
+    fprintf(f, "Profile of %.3f s, timer at %.3f GHz\n", wall,
+            (wall > 0) ? elapsed / wall / 1e9 : 0.0);
+    fprintf(f, "%-34s %12s %7s %12s %12s", "entry point", "calls", "self %",
+            "self/call", "total/call");
+    if (perf)
+        fprintf(f, " %12s %12s", "instr/call", "LLC miss/call");
+    fprintf(f, "\n");
+
+    for (int i = 0; i < PROF_POINT_COUNT; i++)
+    {
+        prof_count* c = &prof.counts[i];
+        if (c->calls == 0)
+            continue;
+
+        fprintf(f, "%-34s %12lu %7.2f %12.1f %12.1f", pointName[i], c->calls,
+                100.0 * c->self / elapsed, (double)c->self / c->calls,
+                (double)c->total / c->calls);
+        if (perf)
+        {
+            fprintf(f, " %12.1f %12.3f", (double)c->events[0] / c->calls,
+                    (double)c->events[1] / c->calls);
+        }
+        fprintf(f, "\n");
+    }
+
+    uint64_t engine = (elapsed > inComponents) ? elapsed - inComponents : 0;
+    fprintf(f, "%-34s %12s %7.2f\n", "engine", "", 100.0 * engine / elapsed);
+}
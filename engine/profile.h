@@ -0,0 +1,35 @@
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include <stdio.h>
+
+#include "sim.h"
+
+//
+// Profile
+//
+//   Host time spent in each component entry point of a simulation.  Every
+// entry point that one component calls on another is replaced in the
+// instance by a wrapper that counts the call and reads the host timer, the
+// time stamp counter where there is one, on the way in and out.  Time is
+// reported both inclusive of the calls that the entry point makes in turn
+// and as its own, self time, which adds up to the time in the components.
+// The rest is the engine's own loop and scheduler.
+//
+//   With perf set, instructions and last level cache misses are also read
+// from Linux perf_event_open counters, which costs a system call on each
+// way, so the times are then inflated.  Only one simulation in a process
+// can be profiled at a time.
+//
+
+// Start profiling s, 0 on success.  perf counters that cannot be opened
+//   are reported and left out.
+int profileAttach(simulation* s, int perf);
+
+// Put back the original entry points of s.
+void profileDetach(simulation* s);
+
+// Write the calls, times and counters of each entry point since attaching.
+void profileReport(FILE* f);
+
+#endif
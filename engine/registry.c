@@ -0,0 +1,304 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "registry.h"
+
+static void addEntry(stats_table* st, const char* name, enum stat_kind kind,
+                     const void* value, int count)
+{
+    if (st->count == st->size)
+    {
+        int size = (st->size == 0) ? 32 : st->size * 2;
+        stat_entry* entries = realloc(st->entries, size * sizeof(stat_entry));
+        if (entries == NULL)
+        {
+            fprintf(stderr, "Failed to register statistic - %s\n", name);
+            return;
+        }
+        st->entries = entries;
+        st->size = size;
+    }
+
+    stat_entry* e = &st->entries[st->count++];
+    e->name = strdup(name);
+    e->kind = kind;
+    e->value = value;
+    e->count = count;
+}
+
+static void regCounter(void* self, const char* name, const uint64_t* value)
+{
+    addEntry(self, name, STAT_COUNTER, value, 1);
+}
+
+static void regVector(void* self, const char* name, const uint64_t* values,
+                      int count)
+{
+    addEntry(self, name, STAT_VECTOR, values, count);
+}
+
+static void regHist(void* self, const char* name, const stat_hist* h)
+{
+    addEntry(self, name, STAT_HIST, h, STAT_HIST_BUCKETS);
+}
+
+static void regGauge(void* self, const char* name, const uint64_t* value)
+{
+    addEntry(self, name, STAT_GAUGE, value, 1);
+}
+
+void statsTableInit(stats_table* st)
+{
+    memset(st, 0, sizeof(stats_table));
+    st->reg.self = st;
+    st->reg.counter = regCounter;
+    st->reg.vector = regVector;
+    st->reg.hist = regHist;
+    st->reg.gauge = regGauge;
+}
+
+void statsTableFree(stats_table* st)
+{
+    for (int i = 0; i < st->count; i++)
+        free(st->entries[i].name);
+    free(st->entries);
+
+    st->entries = NULL;
+    st->count = 0;
+    st->size = 0;
+}
+
+int64_t statsTableSum(const stats_table* st, const char* name)
+{
+    for (int i = 0; i < st->count; i++)
+    {
+        const stat_entry* e = &st->entries[i];
+        if (e->kind == STAT_HIST || strcmp(e->name, name) != 0)
+            continue;
+
+        const uint64_t* v = e->value;
+        int64_t sum = 0;
+        for (int j = 0; j < e->count; j++)
+            sum += v[j];
+        return sum;
+    }
+
+    return -1;
+}
+
+int statsTableValues(const stats_table* st, const char* name,
+                     uint64_t* values, int count)
+{
+    for (int i = 0; i < st->count; i++)
+    {
+        const stat_entry* e = &st->entries[i];
+        if (strcmp(e->name, name) != 0)
+            continue;
+
+        // A histogram is read as its fields, then its buckets.
+        int n = e->count;
+        if (e->kind == STAT_HIST)
+            n = sizeof(stat_hist) / sizeof(uint64_t);
+
+        int copied = (n < count) ? n : count;
+        if (copied > 0)
+            memcpy(values, e->value, copied * sizeof(uint64_t));
+        return n;
+    }
+
+    return -1;
+}
+
+// Buckets up to the last one used, at least one.
+static int histBuckets(const stat_hist* h)
+{
+    int n = STAT_HIST_BUCKETS;
+    while (n > 1 && h->buckets[n - 1] == 0)
+        n--;
+    return n;
+}
+
+static void jsonArray(FILE* f, const uint64_t* values, int count)
+{
+    fputc('[', f);
+    for (int i = 0; i < count; i++)
+        fprintf(f, "%s%lu", (i > 0) ? ", " : "", values[i]);
+    fputc(']', f);
+}
+
+void statsTableJson(const stats_table* st, FILE* f)
+{
+    fprintf(f, "{");
+    for (int i = 0; i < st->count; i++)
+    {
+        const stat_entry* e = &st->entries[i];
+
+        fprintf(f, "%s\n  \"%s\": ", (i > 0) ? "," : "", e->name);
+        switch (e->kind)
+        {
+            case STAT_COUNTER:
+            case STAT_GAUGE:
+                fprintf(f, "%lu", *(const uint64_t*)e->value);
+                break;
+            case STAT_VECTOR:
+                jsonArray(f, e->value, e->count);
+                break;
+            case STAT_HIST:
+            {
+                const stat_hist* h = e->value;
+                fprintf(f,
+                        "{\"width\": %lu, \"count\": %lu, \"sum\": %lu, "
+                        "\"max\": %lu, \"buckets\": ",
+                        h->width, h->count, h->sum, h->max);
+                jsonArray(f, h->buckets, histBuckets(h));
+                fputc('}', f);
+                break;
+            }
+        }
+    }
+    fprintf(f, "\n}\n");
+}
+
+void statsTableCsv(const stats_table* st, FILE* f)
+{
+    fprintf(f, "name,value\n");
+    for (int i = 0; i < st->count; i++)
+    {
+        const stat_entry* e = &st->entries[i];
+        const uint64_t* v = e->value;
+
+        switch (e->kind)
+        {
+            case STAT_COUNTER:
+            case STAT_GAUGE:
+                fprintf(f, "%s,%lu\n", e->name, *v);
+                break;
+            case STAT_VECTOR:
+                for (int j = 0; j < e->count; j++)
+                    fprintf(f, "%s[%d],%lu\n", e->name, j, v[j]);
+                break;
+            case STAT_HIST:
+            {
+                const stat_hist* h = e->value;
+                fprintf(f, "%s.width,%lu\n", e->name, h->width);
+                fprintf(f, "%s.count,%lu\n", e->name, h->count);
+                fprintf(f, "%s.sum,%lu\n", e->name, h->sum);
+                fprintf(f, "%s.max,%lu\n", e->name, h->max);
+                for (int j = 0; j < histBuckets(h); j++)
+                    fprintf(f, "%s.buckets[%d],%lu\n", e->name, j,
+                            h->buckets[j]);
+                break;
+            }
+        }
+    }
+}
+
+static int selected(const char* name, const char* select)
+{
+    if (select == NULL)
+        return 1;
+
+    size_t len = strlen(name);
+    for (const char* s = select; *s != '\0';)
+    {
+        size_t n = strcspn(s, ",");
+        if (n > 0 && strncmp(name, s, n) == 0
+            && (n == len || name[n] == '.'))
+            return 1;
+
+        s += n;
+        if (*s == ',')
+            s++;
+    }
+
+    return 0;
+}
+
+int statsSeriesOpen(stats_series* ss, const stats_table* st, FILE* f,
+                    const char* select)
+{
+    memset(ss, 0, sizeof(stats_series));
+
+    int columns = 0;
+    for (int i = 0; i < st->count; i++)
+    {
+        const stat_entry* e = &st->entries[i];
+
+        if (strcmp(e->name, "processor.ops") == 0)
+            ss->ops = e;
+        if (e->kind != STAT_HIST && selected(e->name, select))
+            columns += e->count;
+    }
+
+    ss->values = calloc(columns, sizeof(uint64_t*));
+    ss->gauge = calloc(columns, sizeof(uint8_t));
+    ss->last = calloc(columns, sizeof(uint64_t));
+    if (ss->values == NULL || ss->gauge == NULL || ss->last == NULL)
+    {
+        statsSeriesClose(ss);
+        return -1;
+    }
+
+    fprintf(f, "tick");
+    for (int i = 0; i < st->count; i++)
+    {
+        const stat_entry* e = &st->entries[i];
+        if (e->kind == STAT_HIST || !selected(e->name, select))
+            continue;
+
+        for (int j = 0; j < e->count; j++)
+        {
+            const uint64_t* v = (const uint64_t*)e->value + j;
+
+            if (e->kind == STAT_VECTOR)
+                fprintf(f, ",%s[%d]", e->name, j);
+            else
+                fprintf(f, ",%s", e->name);
+
+            ss->values[ss->columns] = v;
+            ss->gauge[ss->columns] = (e->kind == STAT_GAUGE);
+            ss->last[ss->columns] = *v;
+            ss->columns++;
+        }
+    }
+    fputc('\n', f);
+
+    ss->f = f;
+    return 0;
+}
+
+void statsSeriesSample(stats_series* ss, int64_t tick)
+{
+    fprintf(ss->f, "%ld", tick);
+    for (int i = 0; i < ss->columns; i++)
+    {
+        uint64_t v = *ss->values[i];
+
+        fprintf(ss->f, ",%lu", ss->gauge[i] ? v : v - ss->last[i]);
+        ss->last[i] = v;
+    }
+    fputc('\n', ss->f);
+
+    ss->lastTick = tick;
+}
+
+int64_t statsSeriesOps(const stats_series* ss)
+{
+    if (ss->ops == NULL)
+        return -1;
+
+    const uint64_t* v = ss->ops->value;
+    int64_t ops = 0;
+    for (int i = 0; i < ss->ops->count; i++)
+        ops += v[i];
+    return ops;
+}
+
+void statsSeriesClose(stats_series* ss)
+{
+    free(ss->values);
+    free(ss->gauge);
+    free(ss->last);
+    memset(ss, 0, sizeof(stats_series));
+}
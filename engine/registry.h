@@ -0,0 +1,77 @@
+#ifndef REGISTRY_H
+#define REGISTRY_H
+
+#include <stdio.h>
+
+#include <stats.h>
+
+//
+// Registry
+//
+//   The statistics registered by the components of one simulation, see
+// stats.h.  Only the addresses are kept, so the values written are always
+// the current ones.
+//
+
+enum stat_kind
+{
+    STAT_COUNTER,
+    STAT_VECTOR,
+    STAT_HIST,
+    STAT_GAUGE
+};
+
+typedef struct _stat_entry {
+    char* name;
+    enum stat_kind kind;
+    const void* value;
+    int count;
+} stat_entry;
+
+typedef struct _stats_table {
+    stats_registry reg; // Handed to the components through sim_env.
+    stat_entry* entries;
+    int count;
+    int size;
+} stats_table;
+
+void statsTableInit(stats_table* st);
+void statsTableFree(stats_table* st);
+
+// Sum of the values of a counter or vector, -1 if there is none by name.
+int64_t statsTableSum(const stats_table* st, const char* name);
+
+// Copy up to count values of the named statistic to values, the width,
+//   count, sum, max and buckets of a histogram.  The number of values that
+//   it has, or -1 if there is none by name.
+int statsTableValues(const stats_table* st, const char* name,
+                     uint64_t* values, int count);
+
+// Write every statistic to f as one JSON object, or as name,value lines.
+void statsTableJson(const stats_table* st, FILE* f);
+void statsTableCsv(const stats_table* st, FILE* f);
+
+// Samples of selected statistics written as CSV, one line per interval
+//   with the tick and, for each value, its change over the interval, or
+//   its level for a gauge.
+typedef struct _stats_series {
+    FILE* f;
+    int columns;
+    const uint64_t** values;
+    uint8_t* gauge;
+    uint64_t* last;
+    const stat_entry* ops; // processor.ops, to count committed ops.
+    int64_t lastTick;      // Of the last sample.
+} stats_series;
+
+// Select the counters, vectors and gauges of st whose name is one of the
+//   comma separated names in select, or starts with one and a '.', or all
+//   of them if select is NULL, and write the header line.  0 on success.
+int statsSeriesOpen(stats_series* ss, const stats_table* st, FILE* f,
+                    const char* select);
+void statsSeriesSample(stats_series* ss, int64_t tick);
+// Ops committed by every processor, -1 if the processor has no count.
+int64_t statsSeriesOps(const stats_series* ss);
+void statsSeriesClose(stats_series* ss);
+
+#endif
@@ -0,0 +1,421 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <events.h>
+
+#include "reqtrace.h"
+
+struct rt_event {
+    int64_t tick;
+    uint64_t addr;
+    int64_t tag;
+    int32_t stage;
+    int32_t processorNum;
+};
+
+static struct {
+    events_sink sink;
+    const events_sink* next; // That was in the env, given every event too.
+    simulation* s;
+    int processorCount;
+    struct rt_event* ring;
+    int64_t capacity;
+    uint64_t count; // Ever recorded; the ring has the last of them.
+
+    // Original entry point.
+    void (*memoryRequest)(cache*, trace_op*, int, int64_t, void*,
+                          void (*)(void*, int, int64_t));
+
+    // The requestor of the cache.
+    void* cacheCtx;
+    void (*cacheCallback)(void*, int, int64_t);
+} rt;
+
+static const char* stageNames[REQ_STAGES] = {
+    [REQ_ISSUE] = "issue",
+    [REQ_HIT] = "hit",
+    [REQ_MISS] = "miss",
+    [REQ_PERM] = "permission",
+    [REQ_BUS_QUEUE] = "bus queue",
+    [REQ_BUS_GRANT] = "bus grant",
+    [REQ_SNOOP] = "snoop",
+    [REQ_CACHE_TRANSFER] = "cache transfer",
+    [REQ_MEMORY_TRANSFER] = "memory transfer",
+    [REQ_BUS_DONE] = "bus done",
+    [REQ_DRAM_START] = "dram start",
+    [REQ_DRAM_END] = "dram end",
+    [REQ_SQUELCH] = "squelch",
+    [REQ_DONE] = "done",
+};
+
+// The interconnect state that each bus stage starts.
+static const char* busStates[REQ_STAGES] = {
+    [REQ_BUS_QUEUE] = "queued",
+    [REQ_BUS_GRANT] = "waiting cache",
+    [REQ_SNOOP] = "waiting memory",
+    [REQ_CACHE_TRANSFER] = "transfering cache",
+    [REQ_MEMORY_TRANSFER] = "transfering memory",
+};
+
+static void reqTraceRecord(int stage, int processorNum, uint64_t addr,
+                           int64_t tag)
+{
+    if (rt.s == NULL)
+        return;
+
+    struct rt_event* e = &rt.ring[rt.count % rt.capacity];
+    e->tick = rt.s->tickCount;
+    e->addr = addr;
+    e->tag = tag;
+    e->stage = stage;
+    e->processorNum = processorNum;
+    rt.count++;
+}
+
+static void reqTraceEvent(void* self, int stage, int processorNum,
+                          uint64_t addr, int64_t tag)
+{
+    reqTraceRecord(stage, processorNum, addr, tag);
+    if (rt.next != NULL)
+        rt.next->event(rt.next->self, stage, processorNum, addr, tag);
+}
+
+//
+// Wrappers
+//
+static void reqTraceDone(void* ctx, int processorNum, int64_t tag)
+{
+    reqTraceRecord(REQ_DONE, processorNum, 0, tag);
+    rt.cacheCallback(rt.cacheCtx, processorNum, tag);
+}
+
+static void reqTraceMemoryRequest(cache* c, trace_op* op, int processorNum,
+                                  int64_t tag, void* ctx,
+                                  void (*callback)(void*, int, int64_t))
+{
+    rt.cacheCtx = ctx;
+    rt.cacheCallback = callback;
+    reqTraceRecord(REQ_ISSUE, processorNum, op->memAddress, tag);
+    rt.memoryRequest(c, op, processorNum, tag, NULL, reqTraceDone);
+}
+
+int reqTraceOpen(sim_env* env, int64_t capacity)
+{
+    if (rt.ring != NULL)
+    {
+        fprintf(stderr, "Only one simulation can be traced at a time\n");
+        return -1;
+    }
+    if (capacity <= 0)
+    {
+        fprintf(stderr, "The request trace must hold at least 1 event\n");
+        return -1;
+    }
+
+    memset(&rt, 0, sizeof(rt));
+    rt.ring = malloc(capacity * sizeof(struct rt_event));
+    if (rt.ring == NULL)
+    {
+        perror("Allocating the request trace");
+        return -1;
+    }
+    rt.capacity = capacity;
+    rt.processorCount = env->processorCount;
+    rt.sink.self = NULL;
+    rt.sink.event = reqTraceEvent;
+    rt.next = env->events;
+    env->events = &rt.sink;
+
+    return 0;
+}
+
+void reqTraceAttach(simulation* s)
+{
+    rt.s = s;
+    rt.memoryRequest = s->cache_sim->memoryRequest;
+    s->cache_sim->memoryRequest = reqTraceMemoryRequest;
+}
+
+void reqTraceDetach(simulation* s)
+{
+    if (rt.s != s)
+        return;
+
+    s->cache_sim->memoryRequest = rt.memoryRequest;
+    rt.s = NULL;
+}
+
+void reqTraceClose(void)
+{
+    free(rt.ring);
+    memset(&rt, 0, sizeof(rt));
+}
+
+//
+// Export
+//
+
+// A request that has been issued and not yet called back.
+struct rt_request {
+    int64_t id;
+    int64_t tag;
+    uint64_t addr;
+    uint64_t block;
+    int hasBlock;
+    int busDone;
+    int dram;             // Whether a fetch is open.
+    const char* bus;      // The state open on the interconnect, or NULL.
+    const char* outcome;  // hit or miss, or NULL.
+};
+
+struct rt_open {
+    struct rt_request* reqs; // In the order issued.
+    int count;
+    int size;
+};
+
+struct rt_writer {
+    FILE* f;
+    int first;
+    int64_t nextId;
+    struct rt_open* open; // For each processor.
+    int failed;           // Out of memory for the requests in flight.
+};
+
+static void writeStart(struct rt_writer* w, const char* ph, const char* cat,
+                       const char* name, int pid, int64_t ts)
+{
+    fprintf(w->f, "%s{\"ph\":\"%s\",\"cat\":\"%s\",\"name\":\"%s\","
+                  "\"pid\":%d,\"tid\":%d,\"ts\":%ld",
+            (w->first) ? "" : ",\n", ph, cat, name, pid, pid, ts);
+    w->first = 0;
+}
+
+// Part of a request, the slice of the request itself if name is NULL.
+static void writeAsync(struct rt_writer* w, const char* ph, const char* cat,
+                       const char* name, int pid,
+                       const struct rt_request* r, int64_t ts,
+                       const char* args)
+{
+    char tagName[32];
+
+    if (name == NULL)
+    {
+        snprintf(tagName, sizeof(tagName), "tag %ld", r->tag);
+        name = tagName;
+    }
+    writeStart(w, ph, cat, name, pid, ts);
+    fprintf(w->f, ",\"id\":%ld", r->id);
+    if (args != NULL)
+        fprintf(w->f, ",\"args\":{%s}", args);
+    fprintf(w->f, "}");
+}
+
+// A stage that matches no request.
+static void writeInstant(struct rt_writer* w, const struct rt_event* e)
+{
+    writeStart(w, "i", "stage", stageNames[e->stage], e->processorNum,
+               e->tick);
+    fprintf(w->f, ",\"s\":\"p\",\"args\":{\"addr\":\"0x%lx\"", e->addr);
+    if (e->tag >= 0)
+        fprintf(w->f, ",\"tag\":%ld", e->tag);
+    fprintf(w->f, "}}");
+}
+
+static struct rt_request* findTag(struct rt_open* o, int64_t tag)
+{
+    for (int i = 0; i < o->count; i++)
+    {
+        if (o->reqs[i].tag == tag)
+            return &o->reqs[i];
+    }
+    return NULL;
+}
+
+// The oldest request to block still on, or waiting for, the bus; or with
+//   dram, the oldest with a fetch open.
+static struct rt_request* findBlock(struct rt_open* o, uint64_t block,
+                                    int dram)
+{
+    for (int i = 0; i < o->count; i++)
+    {
+        struct rt_request* r = &o->reqs[i];
+        if (r->hasBlock && r->block == block
+            && ((dram) ? r->dram : !r->busDone))
+            return r;
+    }
+    return NULL;
+}
+
+// End what is open of r, and r itself.
+static void closeRequest(struct rt_writer* w, int pid, struct rt_request* r,
+                         int64_t ts, const char* args)
+{
+    if (r->bus != NULL)
+        writeAsync(w, "e", "request", r->bus, pid, r, ts, NULL);
+    if (r->dram)
+        writeAsync(w, "e", "dram", "dram", pid, r, ts, NULL);
+    writeAsync(w, "e", "request", NULL, pid, r, ts, args);
+}
+
+static void writeEvent(struct rt_writer* w, const struct rt_event* e)
+{
+    int pid = e->processorNum;
+    if (pid < 0 || pid >= rt.processorCount)
+    {
+        writeInstant(w, e);
+        return;
+    }
+
+    struct rt_open* o = &w->open[pid];
+    struct rt_request* r = NULL;
+    char args[128];
+
+    switch (e->stage)
+    {
+        case REQ_ISSUE:
+            if (o->count == o->size)
+            {
+                int size = (o->size == 0) ? 16 : 2 * o->size;
+                struct rt_request* reqs
+                    = realloc(o->reqs, size * sizeof(*reqs));
+                if (reqs == NULL)
+                {
+                    w->failed = 1;
+                    return;
+                }
+                o->reqs = reqs;
+                o->size = size;
+            }
+            r = &o->reqs[o->count++];
+            memset(r, 0, sizeof(*r));
+            r->id = w->nextId++;
+            r->tag = e->tag;
+            r->addr = e->addr;
+            snprintf(args, sizeof(args), "\"addr\":\"0x%lx\",\"tag\":%ld",
+                     e->addr, e->tag);
+            writeAsync(w, "b", "request", NULL, pid, r, e->tick, args);
+            return;
+
+        case REQ_HIT:
+        case REQ_MISS:
+        case REQ_PERM:
+            r = findTag(o, e->tag);
+            if (r == NULL)
+                break;
+            r->block = e->addr;
+            r->hasBlock = 1;
+            if (e->stage != REQ_PERM)
+                r->outcome = stageNames[e->stage];
+            writeAsync(w, "n", "stage", stageNames[e->stage], pid, r,
+                       e->tick, NULL);
+            return;
+
+        case REQ_BUS_QUEUE:
+        case REQ_BUS_GRANT:
+        case REQ_SNOOP:
+        case REQ_CACHE_TRANSFER:
+        case REQ_MEMORY_TRANSFER:
+        case REQ_BUS_DONE:
+            r = findBlock(o, e->addr, 0);
+            if (r == NULL)
+                break;
+            writeAsync(w, "n", "stage", stageNames[e->stage], pid, r,
+                       e->tick, NULL);
+            if (r->bus != NULL)
+                writeAsync(w, "e", "request", r->bus, pid, r, e->tick, NULL);
+            r->bus = busStates[e->stage];
+            if (r->bus != NULL)
+                writeAsync(w, "b", "request", r->bus, pid, r, e->tick, NULL);
+            r->busDone = (e->stage == REQ_BUS_DONE);
+            return;
+
+        case REQ_DRAM_START:
+            r = findBlock(o, e->addr, 0);
+            if (r == NULL || r->dram)
+                break;
+            r->dram = 1;
+            writeAsync(w, "n", "stage", stageNames[e->stage], pid, r,
+                       e->tick, NULL);
+            writeAsync(w, "b", "dram", "dram", pid, r, e->tick, NULL);
+            return;
+
+        case REQ_DRAM_END:
+        case REQ_SQUELCH:
+            r = findBlock(o, e->addr, 1);
+            if (r == NULL)
+                break;
+            r->dram = 0;
+            writeAsync(w, "n", "stage", stageNames[e->stage], pid, r,
+                       e->tick, NULL);
+            writeAsync(w, "e", "dram", "dram", pid, r, e->tick,
+                       (e->stage == REQ_SQUELCH) ? "\"squelched\":true"
+                                                 : NULL);
+            return;
+
+        case REQ_DONE:
+            r = findTag(o, e->tag);
+            if (r == NULL)
+                break;
+            snprintf(args, sizeof(args), "\"outcome\":\"%s\"",
+                     (r->outcome != NULL) ? r->outcome : "unknown");
+            closeRequest(w, pid, r, e->tick, args);
+            o->count--;
+            memmove(r, r + 1, (o->reqs + o->count - r) * sizeof(*r));
+            return;
+    }
+
+    writeInstant(w, e);
+}
+
+int reqTraceWrite(FILE* f)
+{
+    uint64_t first = (rt.count > rt.capacity) ? rt.count - rt.capacity : 0;
+    struct rt_writer w;
+    w.f = f;
+    w.first = 1;
+    w.nextId = 1;
+    w.failed = 0;
+    w.open = calloc(rt.processorCount, sizeof(struct rt_open));
+    if (w.open == NULL)
+        return -1;
+
+    // Viewers take ts as microseconds, so each one stands for a tick.
+    fprintf(f, "{\"otherData\":{\"ts\":\"ticks, shown as microseconds\","
+               "\"events\":%lu,\"kept\":%lu},\n"
+               "\"traceEvents\":[\n",
+            rt.count, rt.count - first);
+    for (int i = 0; i < rt.processorCount; i++)
+    {
+        writeStart(&w, "M", "__metadata", "process_name", i, 0);
+        fprintf(f, ",\"args\":{\"name\":\"processor %d\"}}", i);
+    }
+
+    int64_t last = 0;
+    for (uint64_t i = first; i < rt.count && !w.failed; i++)
+    {
+        const struct rt_event* e = &rt.ring[i % rt.capacity];
+        writeEvent(&w, e);
+        last = e->tick;
+    }
+
+    // Requests still in flight end with the trace.
+    for (int i = 0; i < rt.processorCount; i++)
+    {
+        for (int j = 0; j < w.open[i].count; j++)
+            closeRequest(&w, i, &w.open[i].reqs[j], last,
+                         "\"unfinished\":true");
+        free(w.open[i].reqs);
+    }
+    free(w.open);
+
+    if (w.failed)
+    {
+        perror("Tracking the requests in flight");
+        return -1;
+    }
+
+    fprintf(f, "\n]}\n");
+    return ferror(f) ? -1 : 0;
+}
@@ -0,0 +1,48 @@
+#ifndef REQTRACE_H
+#define REQTRACE_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "sim.h"
+
+//
+// Request trace
+//
+//   Records the stages of each memory request, see events.h, in a ring of a
+// fixed number of events, so that a long run keeps its last ones, and
+// writes them as Chrome trace-event JSON for chrome://tracing or Perfetto.
+// Each processor is a process of the trace, and each request an async slice
+// from its issue to its callback, named by its tag.  Inside it, every stage
+// between the two, such as hit or miss and bus grant, is an instant event
+// of its own; each state that the request waits in on the interconnect
+// (queued, waiting cache, waiting memory, transfering cache or memory) is a
+// slice; and the DRAM fetch is a slice on a track of its own.  Timestamps
+// are ticks, which viewers show as microseconds.  Stages that match no
+// request, such as those of a request whose issue has left the ring, are
+// process-wide instant events.
+//
+//   Like the profiler, only one simulation in a process can be traced at a
+// time.  The requestor of the cache is taken to be the same for every
+// request.
+//
+
+// Start recording the last capacity events of the simulation that will be
+//   created with env, whose components report to it, and pass them on to
+//   any sink that env already had.  0 on success.
+int reqTraceOpen(sim_env* env, int64_t capacity);
+
+// Record the issue and callback of each request to the cache of s, which
+//   was created with the env given to reqTraceOpen.
+void reqTraceAttach(simulation* s);
+
+// Put back the entry points of s.
+void reqTraceDetach(simulation* s);
+
+// Write the events recorded as JSON to f.  0 on success.
+int reqTraceWrite(FILE* f);
+
+// Release the events.
+void reqTraceClose(void);
+
+#endif
@@ -0,0 +1,74 @@
+#include <stdint.h>
+#include <stdlib.h>
+
+#include <common.h>
+
+#include "engine.h"
+
+//
+// Event scheduler
+//
+//   Every tick of the processor walks the whole component chain, even when
+// the only thing happening is a memory or bus countdown.  After each tick,
+// the engine asks each component when it next has work and jumps the clock
+// directly to the earliest such tick, letting the components account for
+// the skipped ticks themselves.  With clock domains, each component counts
+// in cycles of its own domain, which are converted to and from core cycles.
+//
+
+// Every component instance starts with its sim_interface.
+void schedRegister(sim_sched* sc, void* comp, int domain)
+{
+    assert(sc->simCount < SCHED_MAX_SIMS);
+
+    sc->domain[sc->simCount] = domain;
+    sc->sims[sc->simCount++] = comp;
+}
+
+// Number of ticks that every component can skip, 0 if any component
+//   has work on the next tick or cannot report its next event.
+int64_t schedIdleTicks(sim_sched* sc)
+{
+    int64_t idle = SIM_IDLE_FOREVER;
+
+    for (int i = 0; i < sc->simCount; i++)
+    {
+        sim_interface* si = sc->sims[i];
+        if (si->idleTicks == NULL || si->skipTicks == NULL)
+            return 0;
+
+        int64_t t = si->idleTicks(si);
+        if (sc->clock != NULL && t != SIM_IDLE_FOREVER)
+            t = clockCoreTicks(sc->clock, sc->domain[i], t);
+        if (t < idle)
+            idle = t;
+        if (idle <= 0)
+            return 0;
+    }
+
+    // Nothing is pending anywhere, which is left to the normal tick loop.
+    if (idle == SIM_IDLE_FOREVER)
+        return 0;
+
+    return idle;
+}
+
+void schedSkip(sim_sched* sc, int64_t ticks)
+{
+    if (sc->clock == NULL)
+    {
+        for (int i = 0; i < sc->simCount; i++)
+        {
+            sc->sims[i]->skipTicks(sc->sims[i], ticks);
+        }
+        return;
+    }
+
+    for (int i = 0; i < sc->simCount; i++)
+    {
+        int64_t t = clockEdges(sc->clock, sc->domain[i], ticks);
+        if (t > 0)
+            sc->sims[i]->skipTicks(sc->sims[i], t);
+    }
+    clockSkip(sc->clock, ticks);
+}
@@ -0,0 +1,1012 @@
+#include <stdio.h>
+#include <getopt.h>
+#include <dlfcn.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <libgen.h>
+#include <sys/time.h>
+
+#include "config.h"
+#include "legacy.h"
+#include "percore.h"
+#include "sim.h"
+#include "watch.h"
+
+//
+// loadSim (name, type)
+//    Attempts to load "name/libname.so", unless "name" is built in
+//
+int simComponentPath(char* name, char* path, size_t size)
+{
+    // TODO
+    //  - Support for alternate naming schemes
+    //  - if debug == 1, try loading a -debug.so
+    char* baseName = basename(name);
+
+    int len = snprintf(path, size, "%s/lib%s.so", name, baseName);
+    return (len < 0 || len >= size) ? -1 : 0;
+}
+
+struct sim* loadSim(char* name, char* type, const sim_env* env)
+{
+    char fullName[SIM_NAME_LIMIT] = {0};
+
+#ifdef CADSS_STATIC
+    struct sim* ss = staticSim(name);
+    if (ss != NULL)
+    {
+        return ss;
+    }
+#endif
+
+    if (simComponentPath(name, fullName, SIM_NAME_LIMIT) != 0)
+    {
+        fprintf(stderr,
+                "Failed to generate so name for %s component using %s\n", type,
+                name);
+
+        return NULL;
+    }
+
+    void* handle = dlopen(fullName, RTLD_LAZY);
+    if (handle == NULL)
+    {
+        fprintf(stderr, "Failed to load %s component using %s: %s\n", type,
+                fullName, dlerror());
+        return NULL;
+    }
+
+    struct sim* s = malloc(sizeof(struct sim));
+    if (s == NULL)
+    {
+        dlclose(handle);
+        fprintf(stderr, "Failed to allocate space for %s component\n", type);
+        return NULL;
+    }
+
+    s->handle = handle;
+    s->init = dlsym(handle, "init");
+    s->keep = 0;
+    s->dbgEnv = NULL;
+
+    const int* abi = dlsym(handle, "CADSS_ABI");
+    if (abi != NULL && *abi != CADSS_ABI_VERSION)
+    {
+        dlclose(handle);
+        free(s);
+        fprintf(stderr,
+                "Unsupported interface version %d for %s component, "
+                "expected %d\n",
+                *abi, type, CADSS_ABI_VERSION);
+        return NULL;
+    }
+
+    // Components for the original interface read their settings from
+    //   globals and must provide every entry point.
+    s->legacy = (abi == NULL);
+    if (s->legacy)
+    {
+        int* verbose = dlsym(handle, "CADSS_VERBOSE");
+        if (verbose != NULL)
+        {
+            *verbose = env->verbose;
+        }
+
+        int* pCount = dlsym(handle, "processorCount");
+        if (pCount != NULL)
+        {
+            *pCount = env->processorCount;
+        }
+
+        if (dlsym(handle, "tick") == NULL || dlsym(handle, "finish") == NULL
+            || dlsym(handle, "destroy") == NULL)
+        {
+            s->init = NULL;
+        }
+    }
+
+    if (s->init == NULL)
+    {
+        dlclose(handle);
+        free(s);
+        fprintf(stderr, "Failed to load interface for %s component\n", type);
+        return NULL;
+    }
+    return s;
+}
+
+void unloadSim(struct sim* s)
+{
+    // Built-in components have no library to close.
+    if (s->handle != NULL)
+    {
+        dlclose(s->handle);
+    }
+    free(s);
+}
+
+
+// Load the component for a role, "type" if no name was given.
+static struct sim* loadRole(char* name, char* type, const sim_env* env)
+{
+    return loadSim(name == NULL ? type : name, type, env);
+}
+
+static void simSetup(simulation* s, trace_reader* tr, const sim_env* env)
+{
+    memset(s, 0, sizeof(simulation));
+    s->env = *env;
+    s->tr = tr;
+
+    statsTableInit(&s->stats);
+    s->env.stats = &s->stats.reg;
+    statsCounter(&s->env, "sim.ticks", (const uint64_t*)&s->tickCount);
+    clock_gettime(CLOCK_MONOTONIC, &s->progressWall);
+}
+
+static int simInit(simulation* s);
+
+int simCreate(simulation* s, const sim_names* names, trace_reader* tr,
+              const sim_env* env)
+{
+    simSetup(s, tr, env);
+
+    s->isim = loadRole(names->inter, "interconnect", &s->env);
+    s->osim = loadRole(names->coher, "coherence", &s->env);
+    s->csim = loadRole(names->cache, "cache", &s->env);
+    s->psim = loadRole(names->proc, "processor", &s->env);
+    s->bsim = loadRole(names->branch, "branch", &s->env);
+    s->msim = loadRole(names->mem, "memory", &s->env);
+    if (s->isim == NULL || s->osim == NULL || s->csim == NULL
+        || s->psim == NULL || s->bsim == NULL || s->msim == NULL)
+    {
+        return -1;
+    }
+
+    return simInit(s);
+}
+
+int simCreateLoaded(simulation* s, const sim_loaded* sims, trace_reader* tr,
+                    const sim_env* env)
+{
+    simSetup(s, tr, env);
+
+    s->psim = sims->proc;
+    s->bsim = sims->branch;
+    s->csim = sims->cache;
+    s->osim = sims->coher;
+    s->isim = sims->inter;
+    s->msim = sims->mem;
+
+    return simInit(s);
+}
+
+// Create the instance of each loaded component.
+memory* simMemoryInit(struct sim* msim, const sim_env* env)
+{
+    int argCount = 0;
+    char** arg = getSettings("memory", &argCount);
+    if (arg == NULL) {}
+
+    memory_sim_args msa;
+    msa.arg_count = argCount;
+    msa.arg_list = arg;
+    msa.env = env;
+    optind = 1;
+    return msim->legacy ? legacyMemoryInit(msim, &msa) : msim->init(&msa);
+}
+
+interconn* simInterInit(struct sim* isim, const sim_env* env, memory* mem)
+{
+    int argCount = 0;
+    char** arg = getSettings("interconnect", &argCount);
+    if (arg == NULL) {}
+
+    inter_sim_args isa;
+    isa.arg_count = argCount;
+    isa.arg_list = arg;
+    isa.env = env;
+    isa.memory = mem;
+    optind = 1;
+    return isim->legacy ? legacyInterInit(isim, &isa) : isim->init(&isa);
+}
+
+coher* simCoherInit(struct sim* osim, const sim_env* env, interconn* inter)
+{
+    int argCount = 0;
+    char** arg = getSettings("coherence", &argCount);
+    if (arg == NULL) {}
+
+    coher_sim_args osa;
+    osa.arg_count = argCount;
+    osa.arg_list = arg;
+    osa.env = env;
+    osa.inter = inter;
+    optind = 1;
+    return osim->legacy ? legacyCoherInit(osim, &osa) : osim->init(&osa);
+}
+
+cache* simCacheInit(struct sim* csim, const sim_env* env, coher* coherComp)
+{
+    optind = 1;
+    int argCount = 0;
+    char** arg = getSettings("cache", &argCount);
+    if (arg == NULL) {}
+
+    cache_sim_args csa;
+    csa.arg_count = argCount;
+    csa.arg_list = arg;
+    csa.env = env;
+    csa.coherComp = coherComp;
+    return csim->legacy ? legacyCacheInit(csim, &csa) : csim->init(&csa);
+}
+
+branch* simBranchInit(struct sim* bsim, const sim_env* env)
+{
+    optind = 1;
+    int argCount = 0;
+    char** arg = getSettings("branch", &argCount);
+    if (arg == NULL) {}
+
+    branch_sim_args bsa;
+    bsa.arg_count = argCount;
+    bsa.arg_list = arg;
+    bsa.env = env;
+    return bsim->legacy ? legacyBranchInit(bsim, &bsa) : bsim->init(&bsa);
+}
+
+// The last -b of the cache settings of each processor.
+static int simBlockBits(simulation* s)
+{
+    int count = s->env.processorCount;
+
+    s->blockBits = calloc(count, sizeof(uint8_t));
+    if (s->blockBits == NULL)
+        return -1;
+
+    for (int i = 0; i < count; i++)
+    {
+        int argCount = 0;
+        const char* coreName;
+        char** arg = getCoreSettings("cache", i, &argCount, &coreName);
+
+        for (int j = 1; arg != NULL && j < argCount; j++)
+        {
+            int bits = -1;
+            if (strcmp(arg[j], "-b") == 0 && j + 1 < argCount)
+                bits = atoi(arg[++j]);
+            else if (strncmp(arg[j], "-b", 2) == 0)
+                bits = atoi(arg[j] + 2);
+
+            if (bits >= 0 && bits < 64)
+                s->blockBits[i] = bits;
+        }
+    }
+
+    return 0;
+}
+
+static int simInit(simulation* s)
+{
+    // B.N. - set optind to 1 before calling init on any component
+    //  that resets getopt() so the component can use it safely on its arguments
+    int argCount = 0;
+    char** arg = NULL;
+
+    // Only the cache and branch predictor have an instance per processor.
+    const char* shared[] = {"processor", "coherence", "interconnect",
+                            "memory", "clock"};
+    int refused = 0;
+    for (int i = 0; i < sizeof(shared) / sizeof(shared[0]); i++)
+        refused |= refuseCoreSettings(shared[i]);
+    if (refused)
+        return -1;
+
+    if (clockOpen(&s->clock, &s->env) != 0)
+    {
+        printf("Failed to set up the clock domains!\n");
+        return -1;
+    }
+    s->env.clockDomains = s->clock.on;
+
+    s->mem_sim = simMemoryInit(s->msim, &s->env);
+    if (s->mem_sim == NULL)
+    {
+        printf("Failed to initialize memory!\n");
+        return -1;
+    }
+
+    s->inter_sim = simInterInit(s->isim, &s->env, s->mem_sim);
+    if (s->inter_sim == NULL)
+    {
+        printf("Failed to initialize interconnect!\n");
+        return -1;
+    }
+
+    s->coher_sim = simCoherInit(s->osim, &s->env, s->inter_sim);
+    if (s->coher_sim == NULL)
+    {
+        printf("Failed to initialize coherence!\n");
+        return -1;
+    }
+
+    s->cache_sim = percoreCacheInit(s->csim, &s->env, s->coher_sim);
+    if (s->cache_sim == NULL)
+    {
+        printf("Failed to initialize cache!\n");
+        return -1;
+    }
+
+    if (simBlockBits(s) != 0)
+    {
+        printf("Failed to read the cache block sizes!\n");
+        return -1;
+    }
+
+    s->branch_sim = percoreBranchInit(s->bsim, &s->env);
+    if (s->branch_sim == NULL)
+    {
+        printf("Failed to initialize branch predictor!\n");
+        return -1;
+    }
+
+    optind = 1;
+    arg = getSettings("processor", &argCount);
+    if (arg == NULL) {}
+
+    processor_sim_args psa;
+    psa.arg_count = argCount;
+    psa.arg_list = arg;
+    psa.env = &s->env;
+    psa.tr = s->tr;
+    psa.cache_sim = s->cache_sim;
+    psa.branch_sim = s->branch_sim;
+    s->proc_sim = s->psim->legacy ? legacyProcInit(s->psim, &psa)
+                                  : s->psim->init(&psa);
+    if (s->proc_sim == NULL)
+    {
+        printf("Failed to initialize processor!\n");
+        return -1;
+    }
+
+    // Legacy components keep their own debug variables.
+    if (!s->psim->legacy)
+        s->psim->dbgEnv = &s->proc_sim->dbgEnv;
+    if (!s->bsim->legacy)
+        s->bsim->dbgEnv = &s->branch_sim->dbgEnv;
+    if (!s->csim->legacy)
+        s->csim->dbgEnv = &s->cache_sim->dbgEnv;
+    if (!s->osim->legacy)
+        s->osim->dbgEnv = &s->coher_sim->dbgEnv;
+    if (!s->isim->legacy)
+        s->isim->dbgEnv = &s->inter_sim->dbgEnv;
+    if (!s->msim->legacy)
+        s->msim->dbgEnv = &s->mem_sim->dbgEnv;
+
+    schedRegister(&s->sched, s->proc_sim, CLOCK_CORE);
+    schedRegister(&s->sched, s->branch_sim, CLOCK_CORE);
+    schedRegister(&s->sched, s->cache_sim, CLOCK_CORE);
+    schedRegister(&s->sched, s->coher_sim, CLOCK_UNCORE);
+    schedRegister(&s->sched, s->inter_sim, CLOCK_UNCORE);
+    schedRegister(&s->sched, s->mem_sim, CLOCK_DRAM);
+    if (s->clock.on)
+        s->sched.clock = &s->clock;
+
+    debugInitEnv(s->psim->dbgEnv);
+    debugInitEnv(s->bsim->dbgEnv);
+    debugInitEnv(s->csim->dbgEnv);
+    debugInitEnv(s->osim->dbgEnv);
+    debugInitEnv(s->isim->dbgEnv);
+    debugInitEnv(s->msim->dbgEnv);
+
+    return 0;
+}
+
+volatile sig_atomic_t simProgressDue = 0;
+volatile sig_atomic_t simDumpDue = 0;
+
+static const char* monitorLabel = NULL;
+
+static void monitorSignal(int sig)
+{
+    if (sig == SIGALRM)
+        simProgressDue = 1;
+    else
+        simDumpDue = 1;
+}
+
+int simMonitor(int seconds, const char* label)
+{
+    struct sigaction sa;
+
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = monitorSignal;
+    sa.sa_flags = SA_RESTART;
+    sigemptyset(&sa.sa_mask);
+    monitorLabel = label;
+
+    if (sigaction(SIGUSR1, &sa, NULL) != 0)
+        return -1;
+    if (seconds <= 0)
+        return 0;
+
+    struct itimerval it;
+    it.it_interval.tv_sec = seconds;
+    it.it_interval.tv_usec = 0;
+    it.it_value = it.it_interval;
+    if (sigaction(SIGALRM, &sa, NULL) != 0
+        || setitimer(ITIMER_REAL, &it, NULL) != 0)
+        return -1;
+
+    return 0;
+}
+
+// Rates since the last report, and how much of the trace is read.
+static void simProgress(simulation* s)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    int64_t ops = statsTableSum(&s->stats, "processor.ops");
+    double seconds = (now.tv_sec - s->progressWall.tv_sec)
+                     + (now.tv_nsec - s->progressWall.tv_nsec) / 1e9;
+
+    if (monitorLabel != NULL)
+        fprintf(stderr, "%s: ", monitorLabel);
+    fprintf(stderr, "tick %ld", s->tickCount);
+    if (seconds > 0)
+    {
+        fprintf(stderr, ", %.3f M ticks/s",
+                (s->tickCount - s->progressTick) / seconds / 1e6);
+        if (ops >= 0)
+            fprintf(stderr, ", %.3f M ops/s",
+                    (ops - s->progressOps) / seconds / 1e6);
+    }
+
+    double consumed = (s->tr->consumed != NULL) ? s->tr->consumed(s->tr) : -1;
+    if (consumed >= 0)
+        fprintf(stderr, ", %.1f%% of trace", 100 * consumed);
+    fprintf(stderr, "\n");
+
+    s->progressWall = now;
+    s->progressTick = s->tickCount;
+    s->progressOps = ops;
+}
+
+static void simMonitorDue(simulation* s)
+{
+    if (simDumpDue)
+    {
+        simDumpDue = 0;
+        if (s->clock.on)
+            clockSync(&s->clock, s->tickCount);
+        statsTableJson(&s->stats, stderr);
+        fflush(stderr);
+    }
+
+    if (simProgressDue)
+    {
+        simProgressDue = 0;
+        simProgress(s);
+    }
+}
+
+int simSampleStats(simulation* s, FILE* f, int64_t every, int byOps,
+                   const char* select)
+{
+    if (every <= 0 || statsSeriesOpen(&s->series, &s->stats, f, select) != 0)
+        return -1;
+
+    if (byOps && statsSeriesOps(&s->series) < 0)
+    {
+        fprintf(stderr, "The processor does not count committed ops\n");
+        statsSeriesClose(&s->series);
+        return -1;
+    }
+
+    s->sampleEvery = every;
+    s->sampleOps = byOps;
+    s->nextSample = (byOps ? statsSeriesOps(&s->series) : s->tickCount)
+                    + every;
+    return 0;
+}
+
+// Write a sample once the interval has passed.  Intervals in ops end at
+//   the first tick that commits past them.
+static void simSample(simulation* s)
+{
+    int64_t at = s->sampleOps ? statsSeriesOps(&s->series) : s->tickCount;
+    if (at < s->nextSample)
+        return;
+
+    statsSeriesSample(&s->series, s->tickCount);
+    s->nextSample = at - (at % s->sampleEvery) + s->sampleEvery;
+}
+
+// The main loop, compiled once with the debug hooks and once without.  -1
+//   if the debugger quit, or else whether the processor has more to do.
+//   With debug, it also returns as soon as there is nothing to debug.
+static inline __attribute__((always_inline)) int
+simLoop(simulation* s, int64_t endTick, const int debug)
+{
+    int progress = 1;
+    const int clocked = s->clock.on;
+
+    while (progress && s->tickCount < endTick)
+    {
+        // Idle ticks are only skipped when no one may be stepping through
+        //   them.
+        int sched = 1;
+
+        if (debug)
+        {
+            if (!debugActive())
+                break;
+
+            if (debugRepl(s->tickCount))
+                return -1;
+            sched = !CADSS_DBG_ON && CADSS_DBG_TICK < 0 && !CADSS_DBG_EXT;
+
+            // Mark components to watch and notify state changes.
+            debugWatchComponent(s->psim->dbgEnv, CADSS_DBG_WATCH_PROC);
+            debugWatchComponent(s->bsim->dbgEnv, CADSS_DBG_WATCH_BRANCH);
+            debugWatchComponent(s->csim->dbgEnv, CADSS_DBG_WATCH_CACHE);
+            debugWatchComponent(s->osim->dbgEnv, CADSS_DBG_WATCH_COHER);
+            debugWatchComponent(s->isim->dbgEnv, CADSS_DBG_WATCH_INTER);
+            debugWatchComponent(s->msim->dbgEnv, CADSS_DBG_WATCH_MEM);
+        }
+
+        // Processor requests trace ops as needed.
+        if (clocked)
+            clockTick(&s->clock);
+        progress = s->proc_sim->si.tick(s->proc_sim);
+        s->tickCount++;
+
+        if (debug)
+        {
+            // Check if any of the watched components
+            // requested to be notified of state change.
+            debugCheckNotif(s->psim->dbgEnv);
+            debugCheckNotif(s->bsim->dbgEnv);
+            debugCheckNotif(s->csim->dbgEnv);
+            debugCheckNotif(s->osim->dbgEnv);
+            debugCheckNotif(s->isim->dbgEnv);
+            debugCheckNotif(s->msim->dbgEnv);
+        }
+
+        if (s->series.f != NULL)
+            simSample(s);
+        if (simProgressDue || simDumpDue)
+            simMonitorDue(s);
+
+        if (sched && progress)
+        {
+            int64_t idle = schedIdleTicks(&s->sched);
+            if (idle > endTick - s->tickCount)
+                idle = endTick - s->tickCount;
+
+            // Stop at the next sample, which is then taken on time.
+            if (s->series.f != NULL && !s->sampleOps
+                && idle > s->nextSample - s->tickCount)
+                idle = s->nextSample - s->tickCount;
+
+            if (idle > 0)
+            {
+                schedSkip(&s->sched, idle);
+                s->tickCount += idle;
+                if (s->series.f != NULL)
+                    simSample(s);
+            }
+        }
+    }
+
+    return progress;
+}
+
+// The components below the processor, in the order that the tick chain
+//   runs them, as each ticks the ones it uses first.
+static void simClockAttach(simulation* s)
+{
+    sim_clock* c = &s->clock;
+
+    clockAttach(c, &s->branch_sim->si, CLOCK_CORE, s->tickCount);
+    clockAttach(c, &s->mem_sim->si, CLOCK_DRAM, s->tickCount);
+    clockAttach(c, &s->inter_sim->si, CLOCK_UNCORE, s->tickCount);
+    clockAttach(c, &s->coher_sim->si, CLOCK_UNCORE, s->tickCount);
+    clockAttach(c, &s->cache_sim->si, CLOCK_CORE, s->tickCount);
+}
+
+int simRunUntil(simulation* s, int64_t endTick)
+{
+    int progress = 1;
+
+    if (s->clock.on)
+        simClockAttach(s);
+
+    // The debugger can be left while running but not entered, so once it
+    //   is done, the rest of the run has no hooks at all.
+    if (debugActive())
+    {
+        watchAttach(s);
+        progress = simLoop(s, endTick, 1);
+        watchDetach(s);
+    }
+    if (progress > 0)
+        progress = simLoop(s, endTick, 0);
+
+    if (s->clock.on)
+        clockDetach(&s->clock, s->tickCount);
+
+    // The last, partial interval.
+    if (progress == 0 && s->series.f != NULL
+        && s->series.lastTick < s->tickCount)
+        statsSeriesSample(&s->series, s->tickCount);
+
+    return progress > 0;
+}
+
+void simRun(simulation* s)
+{
+    simRunUntil(s, INT64_MAX);
+}
+
+// Every component instance of a simulation, each starting with its
+//   sim_interface, in the order that they are checkpointed.
+#define SIM_ROLE_COUNT 7
+
+typedef struct _sim_role {
+    const char* name;
+    sim_interface* si;
+} sim_role;
+
+static void simRoles(simulation* s, sim_role* roles)
+{
+    sim_role r[SIM_ROLE_COUNT] = {
+        {"trace", &s->tr->si},
+        {"processor", &s->proc_sim->si},
+        {"branch", &s->branch_sim->si},
+        {"cache", &s->cache_sim->si},
+        {"coherence", &s->coher_sim->si},
+        {"interconnect", &s->inter_sim->si},
+        {"memory", &s->mem_sim->si},
+    };
+
+    memcpy(roles, r, sizeof(r));
+}
+
+int simReconfigure(simulation* s, char* componentName)
+{
+    sim_role roles[SIM_ROLE_COUNT];
+    simRoles(s, roles);
+
+    for (int i = 0; i < SIM_ROLE_COUNT; i++)
+    {
+        if (strcmp(roles[i].name, componentName) != 0)
+            continue;
+
+        sim_interface* si = roles[i].si;
+        if (si->reconfigure == NULL)
+            return -1;
+
+        int argCount = 0;
+        char** arg = getSettings(componentName, &argCount);
+
+        optind = 1;
+        return si->reconfigure(si, argCount, arg);
+    }
+
+    return -1;
+}
+
+int simWarmOp(simulation* s, trace_op* op, int processorNum)
+{
+    switch (op->op)
+    {
+        case MEM_LOAD:
+        case MEM_STORE:
+            if (s->cache_sim->warmRequest == NULL)
+            {
+                fprintf(stderr, "The cache component cannot be warmed\n");
+                return -1;
+            }
+            s->cache_sim->warmRequest(s->cache_sim, op, processorNum);
+            break;
+
+        // Predictors already update at once.
+        case BRANCH:
+            s->branch_sim->branchRequest(s->branch_sim, op, processorNum);
+            break;
+
+        default:
+            break;
+    }
+
+    return 0;
+}
+
+int64_t simWarm(simulation* s, int64_t ops)
+{
+    trace_reader* tr = s->tr;
+    int processorCount = s->env.processorCount;
+    int* done = calloc(processorCount, sizeof(int));
+    int active = processorCount;
+    int64_t warmed = 0;
+
+    for (int64_t i = 0; i < ops && active > 0; i++)
+    {
+        for (int p = 0; p < processorCount; p++)
+        {
+            if (done[p])
+                continue;
+
+            trace_op* op = tr->getNextOp(tr, p);
+            if (op == NULL)
+            {
+                done[p] = 1;
+                active--;
+                continue;
+            }
+
+            int r = simWarmOp(s, op, p);
+            free(op);
+            if (r != 0)
+            {
+                free(done);
+                return -1;
+            }
+            warmed++;
+        }
+    }
+
+    free(done);
+    return warmed;
+}
+
+//
+// Checkpoints
+//
+//   A checkpoint is the magic, the processor count and the tick, followed
+// by the state of each component in simRoles order, as its size and then
+// the bytes written by its save.
+//
+static const char CKPT_MAGIC[8] = "CADSSCK2";
+
+// Ticks that a save may be retried past the tick asked for.
+#define CKPT_MAX_DRIFT 1000
+
+// Save every component into memory, as a component that is busy leaves
+//   nothing to write.
+static int simSaveRoles(simulation* s, char** buf, size_t* size)
+{
+    sim_role roles[SIM_ROLE_COUNT];
+    simRoles(s, roles);
+
+    for (int i = 0; i < SIM_ROLE_COUNT; i++)
+    {
+        sim_interface* si = roles[i].si;
+        if (si->save == NULL)
+        {
+            fprintf(stderr, "The %s component cannot be checkpointed\n",
+                    roles[i].name);
+            return -1;
+        }
+
+        FILE* f = open_memstream(&buf[i], &size[i]);
+        if (f == NULL)
+        {
+            perror("Saving checkpoint");
+            return -1;
+        }
+
+        int r = si->save(si, f);
+        if (fclose(f) != 0)
+            r = -1;
+
+        if (r == SIM_SAVE_BUSY)
+            return SIM_SAVE_BUSY;
+        if (r != 0)
+        {
+            fprintf(stderr, "Failed to save the %s component\n",
+                    roles[i].name);
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+int simCheckpoint(simulation* s, int64_t endTick, const char* path)
+{
+    char* buf[SIM_ROLE_COUNT];
+    size_t size[SIM_ROLE_COUNT];
+    int r;
+
+    if (!simRunUntil(s, endTick))
+    {
+        fprintf(stderr, "Simulation ended before tick %ld\n", endTick);
+        return -1;
+    }
+
+    // Requests in flight are saved without their callbacks, so only a
+    //   component that cannot give them back to its requestor waits them out.
+    while (1)
+    {
+        memset(buf, 0, sizeof(buf));
+        r = simSaveRoles(s, buf, size);
+        if (r != SIM_SAVE_BUSY)
+            break;
+
+        for (int i = 0; i < SIM_ROLE_COUNT; i++)
+            free(buf[i]);
+
+        if (s->tickCount >= endTick + CKPT_MAX_DRIFT)
+        {
+            fprintf(stderr,
+                    "Requests in flight could not be saved within %d ticks "
+                    "of tick %ld\n",
+                    CKPT_MAX_DRIFT, endTick);
+            return -1;
+        }
+
+        if (!simRunUntil(s, s->tickCount + 1))
+        {
+            fprintf(stderr, "Simulation ended before it could be saved\n");
+            return -1;
+        }
+    }
+
+    FILE* f = NULL;
+    if (r == 0)
+    {
+        f = fopen(path, "wb");
+        if (f == NULL)
+        {
+            perror("Attempt to open checkpoint file");
+            r = -1;
+        }
+    }
+
+    if (f != NULL)
+    {
+        int32_t procCount = s->env.processorCount;
+        fwrite(CKPT_MAGIC, sizeof(CKPT_MAGIC), 1, f);
+        fwrite(&procCount, sizeof(procCount), 1, f);
+        fwrite(&s->tickCount, sizeof(s->tickCount), 1, f);
+
+        for (int i = 0; i < SIM_ROLE_COUNT; i++)
+        {
+            uint64_t len = size[i];
+            fwrite(&len, sizeof(len), 1, f);
+            fwrite(buf[i], 1, size[i], f);
+        }
+
+        int err = ferror(f);
+        if (fclose(f) != 0 || err)
+        {
+            perror("Writing checkpoint file");
+            r = -1;
+        }
+    }
+
+    for (int i = 0; i < SIM_ROLE_COUNT; i++)
+        free(buf[i]);
+
+    return r;
+}
+
+int simRestore(simulation* s, const char* path)
+{
+    sim_role roles[SIM_ROLE_COUNT];
+    simRoles(s, roles);
+
+    FILE* f = fopen(path, "rb");
+    if (f == NULL)
+    {
+        perror("Attempt to open checkpoint file");
+        return -1;
+    }
+
+    char magic[sizeof(CKPT_MAGIC)];
+    int32_t procCount;
+    int64_t tickCount;
+    if (fread(magic, sizeof(magic), 1, f) != 1
+        || memcmp(magic, CKPT_MAGIC, sizeof(magic)) != 0
+        || fread(&procCount, sizeof(procCount), 1, f) != 1
+        || fread(&tickCount, sizeof(tickCount), 1, f) != 1)
+    {
+        fprintf(stderr, "%s is not a checkpoint\n", path);
+        fclose(f);
+        return -1;
+    }
+
+    if (procCount != s->env.processorCount)
+    {
+        fprintf(stderr, "Checkpoint is for %d processors\n", procCount);
+        fclose(f);
+        return -1;
+    }
+
+    for (int i = 0; i < SIM_ROLE_COUNT; i++)
+    {
+        sim_interface* si = roles[i].si;
+        uint64_t len;
+
+        if (fread(&len, sizeof(len), 1, f) != 1)
+        {
+            fprintf(stderr, "Checkpoint is truncated\n");
+            fclose(f);
+            return -1;
+        }
+
+        // Each component must read back exactly what it saved.
+        long start = ftell(f);
+        if (si->restore == NULL || si->restore(si, f) != 0
+            || ftell(f) != start + (long)len)
+        {
+            fprintf(stderr, "Failed to restore the %s component\n",
+                    roles[i].name);
+            fclose(f);
+            return -1;
+        }
+    }
+
+    fclose(f);
+    s->tickCount = tickCount;
+
+    return 0;
+}
+
+int simWriteStats(simulation* s, const char* path)
+{
+    FILE* f = stdout;
+    if (strcmp(path, "-") != 0)
+    {
+        f = fopen(path, "w");
+        if (f == NULL)
+        {
+            perror("Opening statistics file");
+            return -1;
+        }
+    }
+
+    size_t len = strlen(path);
+    if (len >= 4 && strcmp(path + len - 4, ".csv") == 0)
+        statsTableCsv(&s->stats, f);
+    else
+        statsTableJson(&s->stats, f);
+
+    int r = ferror(f) ? -1 : 0;
+    if (f != stdout)
+        fclose(f);
+    else
+        fflush(f);
+    return r;
+}
+
+int simFinish(simulation* s, int outFd)
+{
+    return s->proc_sim->si.finish(s->proc_sim, outFd);
+}
+
+void simDestroy(simulation* s)
+{
+    // The processor destroys the components that it uses in turn.
+    if (s->proc_sim != NULL)
+        s->proc_sim->si.destroy(s->proc_sim);
+
+    struct sim** sims[] = {&s->csim, &s->psim, &s->bsim,
+                           &s->osim, &s->isim, &s->msim};
+    for (int i = 0; i < sizeof(sims) / sizeof(sims[0]); i++)
+    {
+        if (*sims[i] != NULL && !(*sims[i])->keep)
+            unloadSim(*sims[i]);
+        *sims[i] = NULL;
+    }
+
+    free(s->blockBits);
+    s->blockBits = NULL;
+
+    statsSeriesClose(&s->series);
+    statsTableFree(&s->stats);
+}
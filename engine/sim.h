@@ -0,0 +1,163 @@
+#ifndef SIM_H
+#define SIM_H
+
+#include <signal.h>
+#include <stdint.h>
+#include <time.h>
+
+#include <common.h>
+#include <trace.h>
+#include <branch.h>
+#include <cache.h>
+#include <coherence.h>
+#include <interconnect.h>
+#include <memory.h>
+#include <processor.h>
+
+#include "engine.h"
+#include "registry.h"
+
+//
+// Sim
+//
+//   One simulation: the components loaded for each role, their instances,
+// and the main tick loop.  The trace reader is created by the caller, so
+// that it can come from the trace component or any other source.  The
+// settings for each component are taken from the open configuration.
+//
+
+// Component names for each role, NULL for the default component.
+typedef struct _sim_names {
+    char* proc;
+    char* branch;
+    char* cache;
+    char* coher;
+    char* inter;
+    char* mem;
+} sim_names;
+
+// Components already loaded for each role.
+typedef struct _sim_loaded {
+    struct sim* proc;
+    struct sim* branch;
+    struct sim* cache;
+    struct sim* coher;
+    struct sim* inter;
+    struct sim* mem;
+} sim_loaded;
+
+typedef struct _simulation {
+    sim_env env;
+
+    struct sim* psim;
+    struct sim* bsim;
+    struct sim* csim;
+    struct sim* osim;
+    struct sim* isim;
+    struct sim* msim;
+
+    processor* proc_sim;
+    branch* branch_sim;
+    cache* cache_sim;
+    coher* coher_sim;
+    interconn* inter_sim;
+    memory* mem_sim;
+    trace_reader* tr;
+
+    // Block size of the cache of each processor in bits, from the -b of its
+    //   settings or 0 without one, which the debugger matches addresses by.
+    uint8_t* blockBits;
+
+    sim_sched sched;
+    sim_clock clock;
+    stats_table stats;
+    stats_series series;
+    int64_t sampleEvery;
+    int sampleOps;
+    int64_t nextSample;
+
+    // At the last progress report.
+    struct timespec progressWall;
+    int64_t progressTick;
+    int64_t progressOps;
+
+    int64_t tickCount;
+} simulation;
+
+struct sim* loadSim(char* name, char* type, const sim_env* env);
+void unloadSim(struct sim* s);
+// The shared object that loadSim loads for name, which it may change.  0 on
+//   success.
+int simComponentPath(char* name, char* path, size_t size);
+
+// Load and initialize every component, 0 on success.
+int simCreate(simulation* s, const sim_names* names, trace_reader* tr,
+              const sim_env* env);
+
+// The same with components that are already loaded.  Those that are kept,
+//   see struct sim, can be used by any number of simulations in turn.
+int simCreateLoaded(simulation* s, const sim_loaded* sims, trace_reader* tr,
+                    const sim_env* env);
+
+// A new instance of a loaded component, with its open settings and the
+//   component that it uses, or NULL on failure.  The instances of a
+//   simulation are made with these, and more can be, such as to check one
+//   against another.
+memory* simMemoryInit(struct sim* msim, const sim_env* env);
+interconn* simInterInit(struct sim* isim, const sim_env* env, memory* mem);
+coher* simCoherInit(struct sim* osim, const sim_env* env, interconn* inter);
+cache* simCacheInit(struct sim* csim, const sim_env* env, coher* coherComp);
+branch* simBranchInit(struct sim* bsim, const sim_env* env);
+
+// Tick until the processor is done or the debugger quits.
+void simRun(simulation* s);
+
+// Tick until the processor is done, the debugger quits or endTick is
+//   reached; 0 if the simulation is over.
+int simRunUntil(simulation* s, int64_t endTick);
+
+// Apply op to the cache or branch predictor state at once, without timing
+//   it, 0 on success or -1 if the cache cannot be warmed.
+int simWarmOp(simulation* s, trace_op* op, int processorNum);
+
+// Warm with the next ops of each processor's trace, taking one op from
+//   each in turn.  Returns the number of ops used, or -1 on failure.
+int64_t simWarm(simulation* s, int64_t ops);
+
+// Apply the current settings of the named component to its running
+//   instance, 0 on success or -1 if the component cannot be reconfigured.
+int simReconfigure(simulation* s, char* componentName);
+
+// Run to endTick, then on until no component has a request in flight, and
+//   save the state of every component to path.  0 once it is written.
+int simCheckpoint(simulation* s, int64_t endTick, const char* path);
+
+// Load the state saved by simCheckpoint into a simulation just created with
+//   the same components, 0 on success.
+int simRestore(simulation* s, const char* path);
+
+// Write the statistics registered by the components, as CSV if path ends
+//   in ".csv" and as JSON otherwise, to stdout if path is "-".  They count
+//   from the creation of the simulation, or from its restore.  0 on success.
+int simWriteStats(simulation* s, const char* path);
+
+// Set from signal handlers, and acted on by simRunUntil between ticks.
+extern volatile sig_atomic_t simProgressDue;
+extern volatile sig_atomic_t simDumpDue;
+
+// For the whole process, have the running simulation print its progress
+//   to stderr every `seconds` if above 0, and write its statistics to
+//   stderr as JSON on SIGUSR1, without stopping.  label, if not NULL,
+//   starts each progress line.  0 on success.
+int simMonitor(int seconds, const char* label);
+
+// Write a line of the selected statistics to f every `every` ticks, or
+//   every `every` ops committed by all the processors if byOps, and one at
+//   the end of the run.  See statsSeriesOpen for select.  0 on success.
+int simSampleStats(simulation* s, FILE* f, int64_t every, int byOps,
+                   const char* select);
+
+int simFinish(simulation* s, int outFd);
+void simDestroy(simulation* s);
+
+#endif
@@ -0,0 +1,633 @@
+#include <stdio.h>
+#include <getopt.h>
+#include <stdlib.h>
+#include <string.h>
+#include <float.h>
+#include <trace.h>
+#include <unistd.h>
+
+#include "config.h"
+#include "engine.h"
+#include "sim.h"
+
+//
+// SimPoint
+//
+//   Estimates a whole run from a few of its intervals.  The trace is first
+// profiled without simulating it: every interval of -I ops per processor
+// gets a basic block vector, the share of its instructions spent in each
+// block, randomly projected down to SP_DIMS dimensions.  The vectors are
+// clustered with k-means, and the interval closest to the center of each
+// cluster represents it.
+//
+//   The trace is then read again, skipping every op up to each chosen
+// interval, which alone is simulated in detail.  The whole run is
+// estimated as the ticks per op of each simulation, times the ops of the
+// intervals in its cluster.
+//
+//   With -W <ops>, the caches and predictors are warmed with up to that
+// many of the skipped ops of each processor before each interval, through
+// the functional warming entry points of the components.
+//
+
+#define SP_DIMS 15
+#define SP_MAX_ITERATIONS 100
+
+struct interval {
+    double bbv[SP_DIMS];
+    double instructions;
+    int64_t ops;
+    int cluster;
+};
+
+struct profile {
+    int64_t intervalLength;
+    int64_t intervalCount;
+    struct interval* intervals;
+    int64_t current;
+};
+
+struct simpoint {
+    int64_t interval;
+    int64_t clusterOps;
+    int64_t ops;
+    int64_t ticks;
+};
+
+void printHelp(char* prog)
+{
+    printf("%s \n", prog);
+    printf("  -h          \t Help message\n");
+    printf("  -v          \t Verbose\n");
+    printf("  -n <num>    \t Number of processors to simulate\n");
+    printf("  -c <file>   \t Cache simulator\n");
+    printf("  -p <file>   \t Pipeline simulator\n");
+    printf("  -o <file>   \t Coherence simulator\n");
+    printf("  -i <file>   \t Interconnection simulator\n");
+    printf("  -b <file>   \t Branch simulator\n");
+    printf("  -m <file>   \t Memory simulator\n");
+    printf("  -t <file>   \t Trace file / directory\n");
+    printf("  -s <file>   \t Setting / configuration file\n");
+    printf("  -I <ops>    \t Ops per processor in each interval\n");
+    printf("  -k <num>    \t Most intervals to simulate, default 10\n");
+    printf("  -W <ops>    \t Ops per processor to warm with before each\n"
+           "              \t  interval, default 0\n");
+    printf("  -P          \t Only profile and list the chosen intervals\n");
+}
+
+// A fixed pseudo-random value in [-1, 1] for each block and dimension.
+static double projection(uint64_t block, int dim)
+{
+    uint64_t z = block * SP_DIMS + dim + 0x9e3779b97f4a7c15ULL;
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    z = z ^ (z >> 31);
+
+    return (double)(z >> 11) / (double)(1ULL << 52) - 1.0;
+}
+
+static void visitBlock(void* ctx, uint64_t block, uint64_t ops)
+{
+    struct profile* pr = ctx;
+    struct interval* iv = &pr->intervals[pr->current];
+
+    for (int d = 0; d < SP_DIMS; d++)
+    {
+        iv->bbv[d] += ops * projection(block, d);
+    }
+    iv->instructions += ops;
+}
+
+static trace_reader* openTrace(struct sim* trace, char* prog, char* traceName,
+                               const sim_env* env)
+{
+    char* traceArgs[] = {prog, "-t", traceName, NULL};
+    trace_sim_args tsa;
+    tsa.arg_count = (traceName == NULL) ? 1 : 3;
+    tsa.arg_list = traceArgs;
+    tsa.env = env;
+    optind = 1;
+
+    return trace->init(&tsa);
+}
+
+// Builds the vector of every interval, 0 on success.
+static int profileTrace(struct profile* pr, trace_reader* tr, int procCount)
+{
+    int64_t size = 0;
+
+    if (tr->basicBlocks == NULL)
+    {
+        fprintf(stderr, "The trace does not have basic blocks\n");
+        return -1;
+    }
+
+    for (int p = 0; p < procCount; p++)
+    {
+        trace_op* op = NULL;
+        int64_t ops = 0;
+
+        while ((op = tr->getNextOp(tr, p)) != NULL)
+        {
+            pr->current = ops / pr->intervalLength;
+            if (pr->current == size)
+            {
+                size = (size == 0) ? 64 : size * 2;
+                struct interval* iv
+                    = realloc(pr->intervals, size * sizeof(struct interval));
+                if (iv == NULL)
+                {
+                    free(op);
+                    return -1;
+                }
+                memset(&iv[pr->current], 0,
+                       (size - pr->current) * sizeof(struct interval));
+                pr->intervals = iv;
+            }
+
+            tr->basicBlocks(tr, p, visitBlock, pr);
+            pr->intervals[pr->current].ops++;
+            free(op);
+            ops++;
+        }
+
+        int64_t count = (ops + pr->intervalLength - 1) / pr->intervalLength;
+        if (count > pr->intervalCount)
+            pr->intervalCount = count;
+    }
+
+    // Compare where the instructions went, not how many there were.
+    for (int64_t i = 0; i < pr->intervalCount; i++)
+    {
+        struct interval* iv = &pr->intervals[i];
+        if (iv->instructions == 0)
+            continue;
+
+        for (int d = 0; d < SP_DIMS; d++)
+            iv->bbv[d] /= iv->instructions;
+    }
+
+    return 0;
+}
+
+static double distance(const double* a, const double* b)
+{
+    double sum = 0;
+
+    for (int d = 0; d < SP_DIMS; d++)
+        sum += (a[d] - b[d]) * (a[d] - b[d]);
+
+    return sum;
+}
+
+// Clusters the intervals into at most k groups, returns the count used.
+static int cluster(struct profile* pr, int k, double (*centers)[SP_DIMS])
+{
+    int64_t n = pr->intervalCount;
+    struct interval* iv = pr->intervals;
+    double* nearest = malloc(n * sizeof(double));
+    uint64_t seed = 1;
+
+    if (k > n)
+        k = n;
+
+    // k-means++, seeded the same way on every run.
+    memcpy(centers[0], iv[0].bbv, sizeof(centers[0]));
+    for (int c = 1; c < k; c++)
+    {
+        double total = 0;
+        for (int64_t i = 0; i < n; i++)
+        {
+            nearest[i] = DBL_MAX;
+            for (int j = 0; j < c; j++)
+            {
+                double dist = distance(iv[i].bbv, centers[j]);
+                if (dist < nearest[i])
+                    nearest[i] = dist;
+            }
+            total += nearest[i];
+        }
+
+        // Every interval is already a center.
+        if (total == 0)
+        {
+            k = c;
+            break;
+        }
+
+        seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+        double pick = (double)(seed >> 11) / (double)(1ULL << 53) * total;
+        int64_t i = 0;
+        while (i < n - 1 && pick >= nearest[i])
+        {
+            pick -= nearest[i];
+            i++;
+        }
+        memcpy(centers[c], iv[i].bbv, sizeof(centers[c]));
+    }
+
+    for (int iter = 0; iter < SP_MAX_ITERATIONS; iter++)
+    {
+        int changed = 0;
+        for (int64_t i = 0; i < n; i++)
+        {
+            int best = 0;
+            double bestDist = DBL_MAX;
+            for (int c = 0; c < k; c++)
+            {
+                double dist = distance(iv[i].bbv, centers[c]);
+                if (dist < bestDist)
+                {
+                    bestDist = dist;
+                    best = c;
+                }
+            }
+
+            if (iter == 0 || iv[i].cluster != best)
+                changed = 1;
+            iv[i].cluster = best;
+        }
+
+        if (!changed)
+            break;
+
+        for (int c = 0; c < k; c++)
+        {
+            int64_t members = 0;
+            double sum[SP_DIMS] = {0};
+
+            for (int64_t i = 0; i < n; i++)
+            {
+                if (iv[i].cluster != c)
+                    continue;
+                for (int d = 0; d < SP_DIMS; d++)
+                    sum[d] += iv[i].bbv[d];
+                members++;
+            }
+
+            if (members == 0)
+                continue;
+            for (int d = 0; d < SP_DIMS; d++)
+                centers[c][d] = sum[d] / members;
+        }
+    }
+
+    free(nearest);
+    return k;
+}
+
+// Picks the interval closest to each cluster's center, in trace order.
+static int choose(struct profile* pr, int k, double (*centers)[SP_DIMS],
+                  struct simpoint* sp)
+{
+    int count = 0;
+
+    for (int c = 0; c < k; c++)
+    {
+        int64_t best = -1;
+        double bestDist = DBL_MAX;
+        int64_t clusterOps = 0;
+
+        for (int64_t i = 0; i < pr->intervalCount; i++)
+        {
+            struct interval* iv = &pr->intervals[i];
+            if (iv->cluster != c)
+                continue;
+
+            clusterOps += iv->ops;
+            double dist = distance(iv->bbv, centers[c]);
+            if (dist < bestDist)
+            {
+                bestDist = dist;
+                best = i;
+            }
+        }
+
+        if (best < 0)
+            continue;
+
+        // Insert sorted by interval, so the trace is only read once.
+        int pos = count++;
+        while (pos > 0 && sp[pos - 1].interval > best)
+        {
+            sp[pos] = sp[pos - 1];
+            pos--;
+        }
+        sp[pos] = (struct simpoint){best, clusterOps, 0, 0};
+    }
+
+    return count;
+}
+
+//
+// Window
+//
+//   A trace_reader that skips the ops of each processor up to its start
+// and ends the trace at its end.  Its source is read forward only, so later
+// windows must start after earlier ones.
+//
+typedef struct _window_ctx {
+    trace_reader pub; // Must be first, the instance is passed as a trace_reader*.
+    trace_reader* src;
+    int processorCount;
+    int64_t* pos;
+    int64_t start;
+    int64_t end;
+    int64_t delivered;
+} window_ctx;
+
+static trace_op* windowGetNextOp(trace_reader* r, int processorNum)
+{
+    window_ctx* self = (window_ctx*)r;
+    trace_reader* src = self->src;
+
+    if (processorNum >= self->processorCount)
+        return NULL;
+
+    while (self->pos[processorNum] < self->start)
+    {
+        trace_op* op = src->getNextOp(src, processorNum);
+        if (op == NULL)
+            return NULL;
+
+        free(op);
+        self->pos[processorNum]++;
+    }
+
+    if (self->pos[processorNum] >= self->end)
+        return NULL;
+
+    trace_op* op = src->getNextOp(src, processorNum);
+    if (op != NULL)
+    {
+        self->pos[processorNum]++;
+        self->delivered++;
+    }
+
+    return op;
+}
+
+// Reads the ops of each processor up to target, one from each in turn,
+//   warming s with them unless it is NULL.  0 on success.
+static int windowAdvance(window_ctx* self, int64_t target, simulation* s)
+{
+    trace_reader* src = self->src;
+    int active = 1;
+
+    while (active)
+    {
+        active = 0;
+        for (int p = 0; p < self->processorCount; p++)
+        {
+            if (self->pos[p] >= target)
+                continue;
+
+            trace_op* op = src->getNextOp(src, p);
+            if (op == NULL)
+            {
+                // Nothing is left to read, so the window is empty.
+                self->pos[p] = INT64_MAX;
+                continue;
+            }
+
+            int r = (s != NULL) ? simWarmOp(s, op, p) : 0;
+            free(op);
+            if (r != 0)
+                return -1;
+
+            self->pos[p]++;
+            active = 1;
+        }
+    }
+
+    return 0;
+}
+
+static int windowTick(void* r)
+{
+    return 1;
+}
+
+static int windowFinish(void* r, int outFd)
+{
+    return 0;
+}
+
+static int windowDestroy(void* r)
+{
+    window_ctx* self = (window_ctx*)r;
+
+    free(self->pos);
+    free(self);
+    return 0;
+}
+
+static window_ctx* windowReader(trace_reader* src, int processorCount)
+{
+    window_ctx* self = calloc(1, sizeof(window_ctx));
+    if (self == NULL)
+        return NULL;
+
+    self->pos = calloc(processorCount, sizeof(int64_t));
+    if (self->pos == NULL)
+    {
+        free(self);
+        return NULL;
+    }
+
+    self->src = src;
+    self->processorCount = processorCount;
+    self->pub.si.tick = windowTick;
+    self->pub.si.finish = windowFinish;
+    self->pub.si.destroy = windowDestroy;
+    self->pub.getNextOp = windowGetNextOp;
+
+    return self;
+}
+
+int main(int argc, char** argv)
+{
+    int opt;
+    int verbose = 0;
+    int procCount = 1;
+    int maxPoints = 10;
+    int profileOnly = 0;
+    int64_t intervalLength = 1000000;
+    int64_t warmLength = 0;
+    char* settingFile = NULL;
+    char* traceName = NULL;
+    sim_names names = {0};
+
+    while ((opt = getopt(argc, argv, "hvc:p:o:n:i:b:t:s:m:I:k:W:P")) != -1)
+    {
+        switch (opt)
+        {
+            case 'h':
+                printHelp(argv[0]);
+                return 0;
+            case 'p':
+                names.proc = optarg;
+                break;
+            case 'v':
+                verbose = 1;
+                break;
+            case 'c':
+                names.cache = optarg;
+                break;
+            case 'b':
+                names.branch = optarg;
+                break;
+            case 's':
+                settingFile = optarg;
+                break;
+            case 'o':
+                names.coher = optarg;
+                break;
+            case 'n':
+                procCount = atoi(optarg);
+                break;
+            case 'i':
+                names.inter = optarg;
+                break;
+            case 'm':
+                names.mem = optarg;
+                break;
+            case 't':
+                traceName = optarg;
+                break;
+            case 'I':
+                intervalLength = atol(optarg);
+                break;
+            case 'k':
+                maxPoints = atoi(optarg);
+                break;
+            case 'W':
+                warmLength = atol(optarg);
+                break;
+            case 'P':
+                profileOnly = 1;
+                break;
+        }
+    }
+
+    if (intervalLength < 1 || maxPoints < 1)
+    {
+        fprintf(stderr, "Intervals and clusters must be at least 1\n");
+        return 1;
+    }
+
+    sim_env env;
+    env.processorCount = procCount;
+    env.verbose = verbose;
+    env.clockDomains = 0;
+    env.stats = NULL;
+    env.events = NULL;
+
+    struct sim* trace = loadSim("trace", "trace", &env);
+    if (trace == NULL)
+        return 1;
+
+    trace_reader* tr = openTrace(trace, argv[0], traceName, &env);
+    if (tr == NULL)
+        return 1;
+
+    struct profile pr = {0};
+    pr.intervalLength = intervalLength;
+    int failed = profileTrace(&pr, tr, procCount);
+    tr->si.destroy(tr);
+    if (failed || pr.intervalCount == 0)
+    {
+        fprintf(stderr, "Failed to profile trace\n");
+        return 1;
+    }
+
+    double (*centers)[SP_DIMS] = calloc(maxPoints, sizeof(*centers));
+    struct simpoint* sp = calloc(maxPoints, sizeof(struct simpoint));
+    int k = cluster(&pr, maxPoints, centers);
+    int pointCount = choose(&pr, k, centers, sp);
+
+    int64_t totalOps = 0;
+    for (int64_t i = 0; i < pr.intervalCount; i++)
+        totalOps += pr.intervals[i].ops;
+
+    if (verbose)
+    {
+        fprintf(stderr, "%ld intervals, %ld ops, %d clusters\n",
+                pr.intervalCount, totalOps, pointCount);
+    }
+
+    if (!profileOnly)
+    {
+        if (settingFile == NULL)
+        {
+            fprintf(stderr,
+                    "No setting file specified, using default.config\n");
+            settingFile = "default.config";
+        }
+        if (openSettings(settingFile) != 0)
+        {
+            fprintf(stderr, "Failed to open setting file - %s\n",
+                    settingFile);
+            return 1;
+        }
+
+        tr = openTrace(trace, argv[0], traceName, &env);
+        window_ctx* win = (tr != NULL) ? windowReader(tr, procCount) : NULL;
+        if (win == NULL)
+            return 1;
+
+        for (int i = 0; i < pointCount; i++)
+        {
+            win->start = sp[i].interval * intervalLength;
+            win->end = win->start + intervalLength;
+            win->delivered = 0;
+
+            simulation s;
+            if (simCreate(&s, &names, &win->pub, &env) != 0)
+                return 1;
+
+            if (warmLength > 0
+                && (windowAdvance(win, win->start - warmLength, NULL) != 0
+                    || windowAdvance(win, win->start, &s) != 0))
+                return 1;
+
+            simRun(&s);
+            sp[i].ticks = s.tickCount;
+            sp[i].ops = win->delivered;
+            simDestroy(&s);
+        }
+
+        win->pub.si.destroy(win);
+        tr->si.destroy(tr);
+        freeSettings();
+    }
+
+    printf("interval\tweight\tops\tticks\n");
+    double estimate = 0;
+    for (int i = 0; i < pointCount; i++)
+    {
+        printf("%ld\t%.4f\t", sp[i].interval,
+               (double)sp[i].clusterOps / totalOps);
+        if (!profileOnly)
+        {
+            printf("%ld\t%ld", sp[i].ops, sp[i].ticks);
+            if (sp[i].ops > 0)
+                estimate += (double)sp[i].ticks * sp[i].clusterOps / sp[i].ops;
+        }
+        else
+        {
+            printf("\t");
+        }
+        printf("\n");
+    }
+
+    if (!profileOnly)
+        printf("Estimated ticks - %.0f\n", estimate);
+
+    unloadSim(trace);
+    free(centers);
+    free(sp);
+    free(pr.intervals);
+
+    return 0;
+}
@@ -0,0 +1,60 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include <common.h>
+
+#include "engine.h"
+
+//
+// Static components
+//
+//   cadss-engine-static is built with the components listed in
+// CADSS_STATIC_COMPONENTS compiled into it, each with its init and
+// CADSS_ABI renamed to <name>_init and <name>_CADSS_ABI.  Linking them
+// with the engine lets the whole simulator be optimized as one program.
+//
+
+#define CADSS_STATIC_COMPONENT(name)                                        \
+    extern const int name##_CADSS_ABI;                                     \
+    void* name##_init(void*);
+#include "static_components.h"
+#undef CADSS_STATIC_COMPONENT
+
+static const struct {
+    const char* name;
+    void* (*init)(void*);
+    const int* abi;
+} staticSims[] = {
+#define CADSS_STATIC_COMPONENT(name) {#name, name##_init, &name##_CADSS_ABI},
+#include "static_components.h"
+#undef CADSS_STATIC_COMPONENT
+};
+
+//
+// staticSim (name)
+//    Returns the built-in component "name", or NULL if it is not built in.
+//
+struct sim* staticSim(const char* name)
+{
+    for (size_t i = 0; i < sizeof(staticSims) / sizeof(staticSims[0]); i++)
+    {
+        if (strcmp(staticSims[i].name, name) != 0)
+            continue;
+
+        if (*staticSims[i].abi != CADSS_ABI_VERSION)
+            return NULL;
+
+        struct sim* s = malloc(sizeof(struct sim));
+        if (s == NULL)
+            return NULL;
+
+        s->handle = NULL;
+        s->init = staticSims[i].init;
+        s->legacy = 0;
+        s->keep = 0;
+        s->dbgEnv = NULL;
+        return s;
+    }
+
+    return NULL;
+}
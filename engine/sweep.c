@@ -0,0 +1,708 @@
+#include <stdio.h>
+#include <getopt.h>
+#include <limits.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <trace.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+
+#include "config.h"
+#include "engine.h"
+#include "sim.h"
+#include "tracebuf.h"
+
+//
+// Sweep
+//
+//   Runs one simulation for every combination of the values in a
+// configuration file, where any component argument may be written as
+//   {a,b,c}        - each of the listed values
+//   lo..hi[:step]  - each integer from lo to hi
+// such as:
+//   __cache -E {1,2,4} -b 4..6 -s 4..12:2
+// Other arguments, such as ../traces, are passed as they are.  A sweep has
+// at most SWEEP_MAX_RUNS runs.
+//
+// The trace is decoded once into shared memory, and the simulations are
+// run by a pool of forked workers.  Each run's output is collected into a
+// single, tab separated results table in the order of the runs, which is
+// written as the runs finish.
+//
+//   With -w <tick>, a single simulation runs to that tick first and every
+// worker forks from it, continuing from the warmed state after applying its
+// values.  Only components that can be reconfigured while running, such as
+// the memory and interconnect, may then have swept arguments.
+//
+
+#define SWEEP_MAX_AXES 32
+#define SWEEP_MAX_RUNS 1000000
+
+// One swept argument and its values.
+struct axis {
+    char* component;
+    char* option;
+    char** arg;
+    int valueCount;
+    char** values;
+};
+
+struct sweep {
+    int axisCount;
+    struct axis axes[SWEEP_MAX_AXES];
+    int64_t runCount;
+    int failed;
+    char* statsDir; // NULL if statistics are not written.
+    int progressSeconds;
+};
+
+// Per run results, in memory shared with the workers.
+struct run_result {
+    int64_t tickCount;
+    int done;
+};
+
+void printHelp(char* prog)
+{
+    printf("%s \n", prog);
+    printf("  -h          \t Help message\n");
+    printf("  -v          \t Verbose\n");
+    printf("  -n <num>    \t Number of processors to simulate\n");
+    printf("  -c <file>   \t Cache simulator\n");
+    printf("  -p <file>   \t Pipeline simulator\n");
+    printf("  -o <file>   \t Coherence simulator\n");
+    printf("  -i <file>   \t Interconnection simulator\n");
+    printf("  -b <file>   \t Branch simulator\n");
+    printf("  -m <file>   \t Memory simulator\n");
+    printf("  -t <file>   \t Trace file / directory\n");
+    printf("  -s <file>   \t Sweep configuration file\n");
+    printf("  -j <num>    \t Number of workers, default is one per core\n");
+    printf("  -r <file>   \t Results table, default is stdout\n");
+    printf("  -w <tick>   \t Warm up to <tick> once, then fork each run\n");
+    printf("  -P <sec>    \t Print the progress of each run every <sec>\n"
+           "              \t  seconds; SIGUSR1 to a worker writes its\n"
+           "              \t  statistics\n");
+    printf("  -S <dir>    \t Write the statistics of each run to\n"
+           "              \t  <dir>/<run>.json\n");
+}
+
+static int parseList(struct axis* a, char* val)
+{
+    size_t len = strlen(val);
+    if (len < 3 || val[len - 1] != '}')
+        return -1;
+
+    char* list = strndup(val + 1, len - 2);
+    a->values = malloc(sizeof(char*) * (len / 2 + 1));
+    if (list == NULL || a->values == NULL)
+        return -1;
+
+    // An empty value is an error rather than skipped, as {1,,2} is more
+    //   likely a typo than a run with the argument left empty.
+    for (char* v = list; v != NULL;)
+    {
+        char* next = strchr(v, ',');
+        if (next != NULL)
+            *next++ = '\0';
+        if (*v == '\0')
+            return -1;
+
+        a->values[a->valueCount++] = v;
+        v = next;
+    }
+
+    return 0;
+}
+
+// Whether val is written as lo..hi[:step] with every part an integer, so
+//   that an argument such as ../traces is left as it is.
+static int isRange(const char* val)
+{
+    char* end;
+
+    strtol(val, &end, 10);
+    if (end == val || strncmp(end, "..", 2) != 0)
+        return 0;
+
+    const char* part = end + 2;
+    strtol(part, &end, 10);
+    if (end == part)
+        return 0;
+
+    if (*end == ':')
+    {
+        part = end + 1;
+        strtol(part, &end, 10);
+        if (end == part)
+            return 0;
+    }
+
+    return *end == '\0';
+}
+
+static int parseRange(struct axis* a, char* val)
+{
+    long lo, hi, step = 1;
+    int n = 0;
+
+    if (sscanf(val, "%ld..%ld%n", &lo, &hi, &n) != 2)
+        return -1;
+    if (val[n] == ':' && sscanf(&val[n + 1], "%ld", &step) != 1)
+        return -1;
+    if (step <= 0 || hi < lo)
+        return -1;
+
+    // Unsigned, so that the width of any range of longs fits.
+    unsigned long count = ((unsigned long)hi - (unsigned long)lo) / step + 1;
+    if (count > SWEEP_MAX_RUNS)
+        return -1;
+
+    a->values = malloc(sizeof(char*) * count);
+    if (a->values == NULL)
+        return -1;
+
+    for (unsigned long i = 0; i < count; i++)
+    {
+        char* num = malloc(24);
+        if (num == NULL)
+            return -1;
+        snprintf(num, 24, "%ld", (long)(lo + i * step));
+        a->values[a->valueCount++] = num;
+    }
+
+    return 0;
+}
+
+// Record each argument that is written as a set of values.
+static void findAxis(char* componentName, char** arg, void* ctx)
+{
+    struct sweep* sw = ctx;
+    char* val = *arg;
+    struct axis a = {0};
+    int r;
+
+    if (val[0] == '{')
+        r = parseList(&a, val);
+    else if (isRange(val))
+        r = parseRange(&a, val);
+    else
+        return;
+
+    if (r != 0)
+    {
+        fprintf(stderr, "Invalid sweep values for %s - %s\n", componentName,
+                val);
+        sw->failed = 1;
+        return;
+    }
+
+    if (sw->axisCount == SWEEP_MAX_AXES)
+    {
+        fprintf(stderr, "More than %d swept arguments\n", SWEEP_MAX_AXES);
+        sw->failed = 1;
+        return;
+    }
+
+    // The first argument is the component name, so there is always one
+    //   before this argument, usually the option that it belongs to.
+    a.component = componentName;
+    a.option = (arg[-1][0] == '-') ? arg[-1] : "";
+    a.arg = arg;
+    sw->axes[sw->axisCount++] = a;
+}
+
+// Set each swept argument to its value for the run.
+static void applyRun(struct sweep* sw, int64_t run)
+{
+    for (int i = sw->axisCount - 1; i >= 0; i--)
+    {
+        struct axis* a = &sw->axes[i];
+
+        *a->arg = a->values[run % a->valueCount];
+        run /= a->valueCount;
+    }
+}
+
+// Apply the run's values to each component with a swept argument.
+static int reconfigureRun(struct sweep* sw, simulation* s)
+{
+    for (int i = 0; i < sw->axisCount; i++)
+    {
+        char* comp = sw->axes[i].component;
+        int seen = 0;
+        for (int j = 0; j < i; j++)
+            seen |= (sw->axes[j].component == comp);
+        if (seen)
+            continue;
+
+        if (simReconfigure(s, comp) != 0)
+        {
+            fprintf(stderr, "Failed to reconfigure %s after warm up\n", comp);
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+// Run a simulation from its start, or continue warm if it is not NULL.
+static void runWorker(struct sweep* sw, int64_t run, const sim_names* names,
+                      const trace_buffer* tb, const sim_env* env,
+                      simulation* warm, int outFd, struct run_result* result)
+{
+    // Components report to stdout, which goes to this run's output.
+    fflush(stdout);
+    if (dup2(outFd, STDOUT_FILENO) == -1)
+        _exit(1);
+
+    applyRun(sw, run);
+
+    simulation cold;
+    simulation* s = warm;
+    trace_reader* tr = NULL;
+    if (s == NULL)
+    {
+        s = &cold;
+        tr = traceBufferReader(tb);
+        if (tr == NULL || simCreate(s, names, tr, env) != 0)
+        {
+            fflush(stdout);
+            _exit(1);
+        }
+    }
+    else if (reconfigureRun(sw, s) != 0)
+    {
+        fflush(stdout);
+        _exit(1);
+    }
+
+    char label[32];
+    snprintf(label, sizeof(label), "run %ld", run);
+    simMonitor(sw->progressSeconds, label);
+
+    simRun(s);
+    simFinish(s, STDOUT_FILENO);
+    fflush(stdout);
+
+    if (sw->statsDir != NULL)
+    {
+        char path[PATH_MAX];
+        snprintf(path, sizeof(path), "%s/%ld.json", sw->statsDir, run);
+        simWriteStats(s, path);
+    }
+
+    result->tickCount = s->tickCount;
+    result->done = 1;
+
+    // A warm simulation belongs to the parent, and this process is about
+    //   to exit anyway.
+    if (s == &cold)
+    {
+        simDestroy(s);
+        tr->si.destroy(tr);
+    }
+    _exit(0);
+}
+
+// Write the run's output as one table cell.
+static void writeOutput(FILE* results, FILE* out)
+{
+    int c;
+    int pendingSep = 0;
+    int any = 0;
+
+    rewind(out);
+    while ((c = fgetc(out)) != EOF)
+    {
+        if (c == '\0' || c == '\r')
+            continue;
+
+        if (c == '\n' || c == '\t')
+        {
+            pendingSep = any;
+            continue;
+        }
+
+        if (pendingSep)
+            fputs("; ", results);
+        pendingSep = 0;
+        fputc(c, results);
+        any = 1;
+    }
+}
+
+// Write the row of a finished run, with the output that it left at path.
+static void writeRow(FILE* rf, struct sweep* sw, int64_t run, int status,
+                     const struct run_result* result, const char* path)
+{
+    applyRun(sw, run);
+
+    fprintf(rf, "%ld", run);
+    for (int i = 0; i < sw->axisCount; i++)
+    {
+        fprintf(rf, "\t%s", *sw->axes[i].arg);
+    }
+    fprintf(rf, "\t%d\t", status);
+    if (result->done)
+        fprintf(rf, "%ld", result->tickCount);
+    fprintf(rf, "\t");
+
+    FILE* out = fopen(path, "r");
+    if (out != NULL)
+    {
+        writeOutput(rf, out);
+        fclose(out);
+    }
+    fprintf(rf, "\n");
+}
+
+// A new file for the output of a run, at *path, which the worker writes to
+//   through the descriptor returned.  The parent keeps only the path, so
+//   the files open do not grow with the runs.  -1 on failure.
+static int openRunOutput(char** path)
+{
+    const char* dir = getenv("TMPDIR");
+    if (dir == NULL || dir[0] == '\0')
+        dir = "/tmp";
+
+    size_t size = strlen(dir) + sizeof("/cadss-sweep-XXXXXX");
+    *path = malloc(size);
+    if (*path == NULL)
+        return -1;
+    snprintf(*path, size, "%s/cadss-sweep-XXXXXX", dir);
+
+    int fd = mkstemp(*path);
+    if (fd == -1)
+    {
+        free(*path);
+        *path = NULL;
+    }
+    return fd;
+}
+
+// Kill any workers still running and wait for them.
+static void stopWorkers(pid_t* workers, long workerCount)
+{
+    for (int w = 0; w < workerCount; w++)
+    {
+        if (workers[w] == 0)
+            continue;
+
+        kill(workers[w], SIGKILL);
+        waitpid(workers[w], NULL, 0);
+        workers[w] = 0;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    int opt;
+    int verbose = 0;
+    int procCount = 1;
+    long workerCount = sysconf(_SC_NPROCESSORS_ONLN);
+    int64_t warmTick = 0;
+    char* settingFile = NULL;
+    char* traceName = NULL;
+    char* resultName = NULL;
+    char* statsDir = NULL;
+    int progressSeconds = 0;
+    sim_names names = {0};
+
+    while ((opt = getopt(argc, argv, "hvc:p:o:n:i:b:t:s:m:j:r:w:S:P:")) != -1)
+    {
+        switch (opt)
+        {
+            case 'h':
+                printHelp(argv[0]);
+                return 0;
+            case 'p':
+                names.proc = optarg;
+                break;
+            case 'v':
+                verbose = 1;
+                break;
+            case 'c':
+                names.cache = optarg;
+                break;
+            case 'b':
+                names.branch = optarg;
+                break;
+            case 's':
+                settingFile = optarg;
+                break;
+            case 'o':
+                names.coher = optarg;
+                break;
+            case 'n':
+                procCount = atoi(optarg);
+                break;
+            case 'i':
+                names.inter = optarg;
+                break;
+            case 'm':
+                names.mem = optarg;
+                break;
+            case 't':
+                traceName = optarg;
+                break;
+            case 'j':
+                workerCount = atol(optarg);
+                break;
+            case 'r':
+                resultName = optarg;
+                break;
+            case 'w':
+                warmTick = atol(optarg);
+                break;
+            case 'S':
+                statsDir = optarg;
+                break;
+            case 'P':
+                progressSeconds = atoi(optarg);
+                break;
+        }
+    }
+
+    if (workerCount < 1)
+        workerCount = 1;
+
+    sim_env env;
+    env.processorCount = procCount;
+    env.verbose = verbose;
+    env.clockDomains = 0;
+    env.stats = NULL;
+    env.events = NULL;
+
+    if (settingFile == NULL)
+    {
+        fprintf(stderr, "No sweep configuration file specified\n");
+        return 1;
+    }
+    if (openSettings(settingFile) != 0)
+    {
+        fprintf(stderr, "Failed to open setting file - %s\n", settingFile);
+        return 1;
+    }
+
+    struct sweep sw = {0};
+    visitSettings(findAxis, &sw);
+    if (sw.failed)
+        return 1;
+
+    sw.runCount = 1;
+    sw.statsDir = statsDir;
+    sw.progressSeconds = progressSeconds;
+    for (int i = 0; i < sw.axisCount; i++)
+    {
+        if (sw.runCount > SWEEP_MAX_RUNS / sw.axes[i].valueCount)
+        {
+            fprintf(stderr, "The sweep has more than %d runs\n",
+                    SWEEP_MAX_RUNS);
+            return 1;
+        }
+        sw.runCount *= sw.axes[i].valueCount;
+    }
+
+    // Decode the trace with the trace component, then release it.
+    struct sim* trace = loadSim("trace", "trace", &env);
+    if (trace == NULL)
+        return 1;
+
+    char* traceArgs[] = {argv[0], "-t", traceName, NULL};
+    trace_sim_args tsa;
+    tsa.arg_count = (traceName == NULL) ? 1 : 3;
+    tsa.arg_list = traceArgs;
+    tsa.env = &env;
+    optind = 1;
+    trace_reader* tr = trace->init(&tsa);
+    if (tr == NULL)
+        return 1;
+
+    trace_buffer* tb = traceBufferDecode(tr, procCount);
+    tr->si.destroy(tr);
+    unloadSim(trace);
+    if (tb == NULL)
+    {
+        fprintf(stderr, "Failed to decode trace\n");
+        return 1;
+    }
+
+    if (verbose)
+    {
+        fprintf(stderr, "%ld runs on %ld workers\n", sw.runCount,
+                workerCount);
+    }
+
+    // Warm up once with the values of the first run.
+    simulation warmSim;
+    simulation* warm = NULL;
+    trace_reader* warmTr = NULL;
+    if (warmTick > 0)
+    {
+        applyRun(&sw, 0);
+        warmTr = traceBufferReader(tb);
+        if (warmTr == NULL || simCreate(&warmSim, &names, warmTr, &env) != 0)
+            return 1;
+        warm = &warmSim;
+
+        if (reconfigureRun(&sw, warm) != 0)
+        {
+            fprintf(stderr, "Only arguments of components that can be "
+                            "reconfigured may be swept with -w\n");
+            return 1;
+        }
+
+        fflush(stdout);
+        simRunUntil(warm, warmTick);
+        if (verbose)
+        {
+            fprintf(stderr, "Warmed up to tick %ld\n", warm->tickCount);
+        }
+    }
+
+    FILE* rf = stdout;
+    if (resultName != NULL)
+    {
+        rf = fopen(resultName, "w");
+        if (rf == NULL)
+        {
+            perror("Opening results table");
+            return 1;
+        }
+    }
+
+    struct run_result* results
+        = mmap(NULL, sizeof(struct run_result) * sw.runCount,
+               PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    char** outputs = calloc(sw.runCount, sizeof(char*));
+    pid_t* workers = calloc(workerCount, sizeof(pid_t));
+    int* status = malloc(sw.runCount * sizeof(int));
+    int64_t* workerRun = calloc(workerCount, sizeof(int64_t));
+    if (results == MAP_FAILED || outputs == NULL || workers == NULL
+        || status == NULL || workerRun == NULL)
+    {
+        perror("Allocating sweep results");
+        return 1;
+    }
+    for (int64_t run = 0; run < sw.runCount; run++)
+        status[run] = -1;
+
+    fprintf(rf, "run");
+    for (int i = 0; i < sw.axisCount; i++)
+    {
+        struct axis* a = &sw.axes[i];
+        fprintf(rf, "\t%s%s%s", a->component, a->option[0] ? " " : "",
+                a->option);
+    }
+    fprintf(rf, "\tstatus\tticks\toutput\n");
+
+    int64_t nextRun = 0;
+    int64_t nextRow = 0;
+    int failed = 0;
+    while (nextRow < sw.runCount && !failed)
+    {
+        // Keep every worker busy while runs remain.
+        for (int w = 0; w < workerCount && nextRun < sw.runCount; w++)
+        {
+            if (workers[w] != 0)
+                continue;
+
+            int fd = openRunOutput(&outputs[nextRun]);
+            if (fd == -1)
+            {
+                perror("Creating run output");
+                failed = 1;
+                break;
+            }
+
+            fflush(stdout);
+            fflush(rf);
+            pid_t pid = fork();
+            if (pid == -1)
+            {
+                perror("Starting worker");
+                close(fd);
+                unlink(outputs[nextRun]);
+                free(outputs[nextRun]);
+                outputs[nextRun] = NULL;
+                failed = 1;
+                break;
+            }
+            if (pid == 0)
+            {
+                runWorker(&sw, nextRun, &names, tb, &env, warm, fd,
+                          &results[nextRun]);
+            }
+            close(fd);
+
+            workers[w] = pid;
+            workerRun[w] = nextRun;
+            nextRun++;
+        }
+        if (failed)
+            break;
+
+        int wstatus;
+        pid_t pid = wait(&wstatus);
+        if (pid == -1)
+        {
+            perror("Waiting on workers");
+            failed = 1;
+            break;
+        }
+
+        for (int w = 0; w < workerCount; w++)
+        {
+            if (workers[w] != pid)
+                continue;
+
+            status[workerRun[w]] = WIFEXITED(wstatus) ? WEXITSTATUS(wstatus)
+                                                      : 128 + WTERMSIG(wstatus);
+            workers[w] = 0;
+        }
+
+        // Rows are written in the order of the runs, as soon as each and
+        //   those before it are done.
+        for (; nextRow < sw.runCount && status[nextRow] != -1; nextRow++)
+        {
+            writeRow(rf, &sw, nextRow, status[nextRow], &results[nextRow],
+                     outputs[nextRow]);
+            unlink(outputs[nextRow]);
+            free(outputs[nextRow]);
+            outputs[nextRow] = NULL;
+        }
+    }
+
+    if (failed)
+    {
+        stopWorkers(workers, workerCount);
+        for (int64_t run = nextRow; run < nextRun; run++)
+        {
+            if (outputs[run] != NULL)
+                unlink(outputs[run]);
+            free(outputs[run]);
+        }
+    }
+
+    if (rf != stdout)
+        fclose(rf);
+
+    if (warm != NULL)
+    {
+        simDestroy(warm);
+        warmTr->si.destroy(warmTr);
+    }
+
+    munmap(results, sizeof(struct run_result) * sw.runCount);
+    free(outputs);
+    free(workers);
+    free(status);
+    free(workerRun);
+    traceBufferFree(tb);
+    freeSettings();
+
+    return failed;
+}
@@ -0,0 +1,220 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+
+#include "tracebuf.h"
+
+const size_t TRACE_BUF_CHUNK_SIZE = 1 << 16;
+
+trace_buffer* traceBufferDecode(trace_reader* tr, int processorCount)
+{
+    trace_buffer* tb = calloc(1, sizeof(trace_buffer));
+    if (tb == NULL)
+        return NULL;
+
+    tb->processorCount = processorCount;
+    tb->opCount = calloc(processorCount, sizeof(int64_t));
+    tb->ops = calloc(processorCount, sizeof(trace_op*));
+    if (tb->opCount == NULL || tb->ops == NULL)
+    {
+        traceBufferFree(tb);
+        return NULL;
+    }
+
+    // The streams are first read into private memory, as their length is
+    //   only known at the end.
+    int64_t total = 0;
+    for (int i = 0; i < processorCount; i++)
+    {
+        size_t size = 0;
+        trace_op* op = NULL;
+
+        while ((op = tr->getNextOp(tr, i)) != NULL)
+        {
+            if (tb->opCount[i] == size)
+            {
+                size += TRACE_BUF_CHUNK_SIZE;
+                trace_op* ops = realloc(tb->ops[i], size * sizeof(trace_op));
+                if (ops == NULL)
+                {
+                    free(op);
+                    traceBufferFree(tb);
+                    return NULL;
+                }
+                tb->ops[i] = ops;
+            }
+
+            tb->ops[i][tb->opCount[i]++] = *op;
+            free(op);
+        }
+
+        total += tb->opCount[i];
+    }
+
+    tb->regionSize = (total > 0 ? total : 1) * sizeof(trace_op);
+    tb->region = mmap(NULL, tb->regionSize, PROT_READ | PROT_WRITE,
+                      MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (tb->region == MAP_FAILED)
+    {
+        perror("Mapping decoded trace");
+        tb->region = NULL;
+        traceBufferFree(tb);
+        return NULL;
+    }
+
+    trace_op* next = tb->region;
+    for (int i = 0; i < processorCount; i++)
+    {
+        if (tb->opCount[i] > 0)
+            memcpy(next, tb->ops[i], tb->opCount[i] * sizeof(trace_op));
+        free(tb->ops[i]);
+        tb->ops[i] = next;
+        next += tb->opCount[i];
+    }
+
+    mprotect(tb->region, tb->regionSize, PROT_READ);
+
+    return tb;
+}
+
+void traceBufferFree(trace_buffer* tb)
+{
+    if (tb->region != NULL)
+    {
+        munmap(tb->region, tb->regionSize);
+    }
+    else if (tb->ops != NULL)
+    {
+        for (int i = 0; i < tb->processorCount; i++)
+            free(tb->ops[i]);
+    }
+
+    free(tb->ops);
+    free(tb->opCount);
+    free(tb);
+}
+
+//
+// Replay
+//
+typedef struct _replay_ctx {
+    trace_reader pub; // Must be first, the instance is passed as a trace_reader*.
+    const trace_buffer* tb;
+    int64_t* pos;
+} replay_ctx;
+
+static trace_op* replayGetNextOp(trace_reader* r, int processorNum)
+{
+    replay_ctx* self = (replay_ctx*)r;
+    const trace_buffer* tb = self->tb;
+
+    if (processorNum >= tb->processorCount
+        || self->pos[processorNum] == tb->opCount[processorNum])
+    {
+        return NULL;
+    }
+
+    // The caller owns and frees each op, as with the trace component.
+    trace_op* op = malloc(sizeof(trace_op));
+    if (op == NULL)
+        return NULL;
+
+    *op = tb->ops[processorNum][self->pos[processorNum]++];
+    return op;
+}
+
+static double replayConsumed(trace_reader* r)
+{
+    replay_ctx* self = (replay_ctx*)r;
+    const trace_buffer* tb = self->tb;
+    int64_t done = 0;
+    int64_t total = 0;
+
+    for (int i = 0; i < tb->processorCount; i++)
+    {
+        done += self->pos[i];
+        total += tb->opCount[i];
+    }
+
+    return (total > 0) ? (double)done / total : -1;
+}
+
+static int replayTick(void* r)
+{
+    return 1;
+}
+
+static int replayFinish(void* r, int outFd)
+{
+    return 0;
+}
+
+// The position in each stream, which is only valid for the same trace.
+static int replaySave(void* r, FILE* f)
+{
+    replay_ctx* self = (replay_ctx*)r;
+    const trace_buffer* tb = self->tb;
+
+    fwrite(&tb->processorCount, sizeof(int), 1, f);
+    fwrite(self->pos, sizeof(int64_t), tb->processorCount, f);
+
+    return ferror(f) ? -1 : 0;
+}
+
+static int replayRestore(void* r, FILE* f)
+{
+    replay_ctx* self = (replay_ctx*)r;
+    const trace_buffer* tb = self->tb;
+    int processorCount;
+
+    if (fread(&processorCount, sizeof(int), 1, f) != 1
+        || processorCount != tb->processorCount
+        || fread(self->pos, sizeof(int64_t), processorCount, f)
+               != processorCount)
+    {
+        return -1;
+    }
+
+    for (int i = 0; i < processorCount; i++)
+    {
+        if (self->pos[i] < 0 || self->pos[i] > tb->opCount[i])
+            return -1;
+    }
+
+    return 0;
+}
+
+static int replayDestroy(void* r)
+{
+    replay_ctx* self = (replay_ctx*)r;
+
+    free(self->pos);
+    free(self);
+    return 0;
+}
+
+trace_reader* traceBufferReader(const trace_buffer* tb)
+{
+    replay_ctx* self = calloc(1, sizeof(replay_ctx));
+    if (self == NULL)
+        return NULL;
+
+    self->pos = calloc(tb->processorCount, sizeof(int64_t));
+    if (self->pos == NULL)
+    {
+        free(self);
+        return NULL;
+    }
+
+    self->tb = tb;
+    self->pub.si.tick = replayTick;
+    self->pub.si.finish = replayFinish;
+    self->pub.si.destroy = replayDestroy;
+    self->pub.si.save = replaySave;
+    self->pub.si.restore = replayRestore;
+    self->pub.getNextOp = replayGetNextOp;
+    self->pub.consumed = replayConsumed;
+
+    return &self->pub;
+}
@@ -0,0 +1,33 @@
+#ifndef TRACEBUF_H
+#define TRACEBUF_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include <trace.h>
+
+//
+// Trace buffer
+//
+//   A trace decoded once into a shared memory region, so that any number of
+// simulations, including ones in forked processes, can replay it without
+// parsing the trace again.  Each simulation replays it through its own
+// trace_reader.
+//
+
+typedef struct _trace_buffer {
+    int processorCount;
+    int64_t* opCount;   // Ops in the stream of each processor.
+    trace_op** ops;     // Stream of each processor, in the shared region.
+    void* region;
+    size_t regionSize;
+} trace_buffer;
+
+// Read every op of each processor from tr, NULL on failure.
+trace_buffer* traceBufferDecode(trace_reader* tr, int processorCount);
+void traceBufferFree(trace_buffer* tb);
+
+// A new trace_reader that replays tb from its start.
+trace_reader* traceBufferReader(const trace_buffer* tb);
+
+#endif
@@ -0,0 +1,393 @@
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "watch.h"
+
+// A slot of the hash set, by open addressing.  Removed addresses keep their
+//   slot with no kinds, until the set is next resized.
+typedef struct _watch_slot {
+    uint64_t addr;
+    uint8_t kinds;
+    uint8_t used;
+} watch_slot;
+
+static struct {
+    watch_slot* slots;
+    int bits;       // The set has 1 << bits slots.
+    int hashBits;   // Addresses are hashed by blocks of 1 << hashBits.
+    int used;       // Slots taken, including those of removed addresses.
+    int addrCount;  // Addresses with a watchpoint.
+    int queueCount; // Processors with a queue watchpoint.
+
+    // Length that each processor's queue may reach, -1 if unwatched, and
+    //   whether it was last seen over it.
+    int* queueLimit;
+    uint8_t* queueOver;
+    int processorCount;
+
+    int hit;
+    char hitMsg[128];
+
+    simulation* s;
+
+    // Original entry points.
+    void (*memoryRequest)(cache*, trace_op*, int, int64_t, void*,
+                          void (*)(void*, int, int64_t));
+    uint8_t (*permReq)(coher*, uint8_t, uint64_t, int);
+    uint8_t (*invlReq)(coher*, uint64_t, int);
+    uint8_t (*coherBusReq)(coher*, bus_req_type, uint64_t, int);
+    void (*interBusReq)(interconn*, bus_req_type, uint64_t, int);
+} watch;
+
+static inline uint64_t watchSlot(uint64_t addr)
+{
+    // Fibonacci hashing, from the top bits of the product.
+    return ((addr >> watch.hashBits) * 0x9e3779b97f4a7c15ULL)
+           >> (64 - watch.bits);
+}
+
+static watch_slot* watchFind(uint64_t addr)
+{
+    uint64_t mask = (1ULL << watch.bits) - 1;
+
+    for (uint64_t i = watchSlot(addr);; i = (i + 1) & mask)
+    {
+        watch_slot* ws = &watch.slots[i];
+        if (!ws->used || ws->addr == addr)
+            return ws;
+    }
+}
+
+// The kinds of the watched addresses in the block of addr in the cache of
+//   processorNum.  No block is larger than those hashed by, so they all
+//   share the run of slots that addr hashes to.
+static inline uint8_t watchKinds(uint64_t addr, int processorNum)
+{
+    if (watch.addrCount == 0)
+        return 0;
+
+    int blockBits = (processorNum >= 0 && processorNum < watch.processorCount)
+                        ? watch.s->blockBits[processorNum]
+                        : watch.hashBits;
+    uint64_t mask = (1ULL << watch.bits) - 1;
+    uint8_t kinds = 0;
+
+    for (uint64_t i = watchSlot(addr); watch.slots[i].used; i = (i + 1) & mask)
+    {
+        if (((watch.slots[i].addr ^ addr) >> blockBits) == 0)
+            kinds |= watch.slots[i].kinds;
+    }
+    return kinds;
+}
+
+// Keep the set at most half full, dropping removed addresses.
+static int watchGrow(void)
+{
+    watch_slot* old = watch.slots;
+    int oldSize = (old == NULL) ? 0 : 1 << watch.bits;
+    int bits = 4;
+
+    while ((1 << bits) < 4 * (watch.addrCount + 1))
+        bits++;
+
+    watch_slot* slots = calloc(1 << bits, sizeof(watch_slot));
+    if (slots == NULL)
+        return -1;
+
+    watch.slots = slots;
+    watch.bits = bits;
+    watch.used = 0;
+    for (int i = 0; i < oldSize; i++)
+    {
+        if (old[i].kinds == 0)
+            continue;
+
+        *watchFind(old[i].addr) = old[i];
+        watch.used++;
+    }
+
+    free(old);
+    return 0;
+}
+
+static void watchStop(const char* fmt, ...)
+{
+    // The first hit of a tick is the one reported.
+    if (watch.hit)
+        return;
+
+    va_list ap;
+    va_start(ap, fmt);
+    vsnprintf(watch.hitMsg, sizeof(watch.hitMsg), fmt, ap);
+    va_end(ap);
+    watch.hit = 1;
+}
+
+//
+// Wrappers
+//
+static void watchMemoryRequest(cache* c, trace_op* op, int processorNum,
+                               int64_t tag, void* ctx,
+                               void (*callback)(void*, int, int64_t))
+{
+    if (watchKinds(op->memAddress, processorNum) & WATCH_REQUEST)
+        watchStop("Processor %d requested %lx", processorNum, op->memAddress);
+
+    watch.memoryRequest(c, op, processorNum, tag, ctx, callback);
+}
+
+static void watchState(coher* cc, uint64_t addr, int processorNum,
+                       const char* before)
+{
+    const char* after = cc->stateName(cc, addr, processorNum);
+
+    if (strcmp(before, after) != 0)
+        watchStop("Processor %d state of %lx: %s -> %s", processorNum, addr,
+                  before, after);
+}
+
+static uint8_t watchPermReq(coher* cc, uint8_t is_read, uint64_t addr,
+                            int processorNum)
+{
+    if (!(watchKinds(addr, processorNum) & WATCH_STATE))
+        return watch.permReq(cc, is_read, addr, processorNum);
+
+    const char* before = cc->stateName(cc, addr, processorNum);
+    uint8_t r = watch.permReq(cc, is_read, addr, processorNum);
+    watchState(cc, addr, processorNum, before);
+    return r;
+}
+
+static uint8_t watchInvlReq(coher* cc, uint64_t addr, int processorNum)
+{
+    if (!(watchKinds(addr, processorNum) & WATCH_STATE))
+        return watch.invlReq(cc, addr, processorNum);
+
+    const char* before = cc->stateName(cc, addr, processorNum);
+    uint8_t r = watch.invlReq(cc, addr, processorNum);
+    watchState(cc, addr, processorNum, before);
+    return r;
+}
+
+static uint8_t watchCoherBusReq(coher* cc, bus_req_type reqType,
+                                uint64_t addr, int processorNum)
+{
+    if (!(watchKinds(addr, processorNum) & WATCH_STATE))
+        return watch.coherBusReq(cc, reqType, addr, processorNum);
+
+    const char* before = cc->stateName(cc, addr, processorNum);
+    uint8_t r = watch.coherBusReq(cc, reqType, addr, processorNum);
+    watchState(cc, addr, processorNum, before);
+    return r;
+}
+
+// Queues only grow on a request, and are checked again by the next one.
+static void watchInterBusReq(interconn* ic, bus_req_type brt, uint64_t addr,
+                             int procNum)
+{
+    watch.interBusReq(ic, brt, addr, procNum);
+
+    if (watch.queueCount == 0 || procNum < 0
+        || procNum >= watch.processorCount || watch.queueLimit[procNum] < 0)
+        return;
+
+    int length = ic->queueLength(ic, procNum);
+    int over = (length > watch.queueLimit[procNum]);
+    if (over && !watch.queueOver[procNum])
+        watchStop("Processor %d has %d requests queued for the bus",
+                  procNum, length);
+    watch.queueOver[procNum] = over;
+}
+
+int watchAddress(uint64_t addr, uint8_t kind)
+{
+    if ((kind & WATCH_STATE) && watch.s != NULL
+        && watch.s->coher_sim->stateName == NULL)
+    {
+        printf("The coherence component cannot report states.\n");
+        return -1;
+    }
+
+    if (2 * (watch.used + 1) > ((watch.slots == NULL) ? 0 : 1 << watch.bits)
+        && watchGrow() != 0)
+    {
+        printf("Out of memory for watchpoints.\n");
+        return -1;
+    }
+
+    watch_slot* ws = watchFind(addr);
+    if (!ws->used)
+    {
+        ws->addr = addr;
+        ws->used = 1;
+        watch.used++;
+    }
+    if (ws->kinds == 0)
+        watch.addrCount++;
+    ws->kinds |= kind;
+
+    return 0;
+}
+
+int watchQueue(int processorNum, int length)
+{
+    if (watch.s == NULL || processorNum < 0
+        || processorNum >= watch.processorCount)
+    {
+        printf("No processor %d.\n", processorNum);
+        return -1;
+    }
+
+    if (length >= 0 && watch.s->inter_sim->queueLength == NULL)
+    {
+        printf("The interconnect cannot report queue lengths.\n");
+        return -1;
+    }
+
+    int* limit = &watch.queueLimit[processorNum];
+    watch.queueCount += (length >= 0) - (*limit >= 0);
+    *limit = (length >= 0) ? length : -1;
+    watch.queueOver[processorNum] = 0;
+
+    return 0;
+}
+
+int watchRemove(uint64_t addr)
+{
+    if (watch.addrCount == 0)
+        return -1;
+
+    watch_slot* ws = watchFind(addr);
+    if (!ws->used || ws->kinds == 0)
+        return -1;
+
+    ws->kinds = 0;
+    watch.addrCount--;
+    return 0;
+}
+
+void watchClear(void)
+{
+    free(watch.slots);
+    watch.slots = NULL;
+    watch.bits = 0;
+    watch.used = 0;
+    watch.addrCount = 0;
+
+    for (int i = 0; i < watch.processorCount; i++)
+        watch.queueLimit[i] = -1;
+    watch.queueCount = 0;
+}
+
+int watchCount(void)
+{
+    return watch.addrCount + watch.queueCount;
+}
+
+void watchList(void)
+{
+    int size = (watch.slots == NULL) ? 0 : 1 << watch.bits;
+
+    printf("Watchpoints:\n");
+    for (int i = 0; i < size; i++)
+    {
+        const watch_slot* ws = &watch.slots[i];
+        if (ws->kinds == 0)
+            continue;
+
+        printf("    %lx%s%s\n", ws->addr,
+               (ws->kinds & WATCH_REQUEST) ? "  requested" : "",
+               (ws->kinds & WATCH_STATE) ? "  state" : "");
+    }
+
+    for (int i = 0; i < watch.processorCount; i++)
+    {
+        if (watch.queueLimit[i] >= 0)
+            printf("    Processor %d queue over %d\n", i, watch.queueLimit[i]);
+    }
+}
+
+const char* watchHit(void)
+{
+    if (!watch.hit)
+        return NULL;
+
+    watch.hit = 0;
+    return watch.hitMsg;
+}
+
+void watchAttach(simulation* s)
+{
+    if (watch.s == s)
+        return;
+    watchDetach(watch.s);
+
+    // Queue watchpoints are for the processors of one simulation.
+    int count = s->env.processorCount;
+    if (count != watch.processorCount)
+    {
+        int* limit = realloc(watch.queueLimit, count * sizeof(int));
+        uint8_t* over = realloc(watch.queueOver, count);
+        if (limit != NULL)
+            watch.queueLimit = limit;
+        if (over != NULL)
+            watch.queueOver = over;
+        if (limit == NULL || over == NULL)
+            count = 0;
+
+        for (int i = 0; i < count; i++)
+            watch.queueLimit[i] = -1;
+        watch.processorCount = count;
+        watch.queueCount = 0;
+    }
+    if (count > 0)
+        memset(watch.queueOver, 0, count);
+
+    watch.s = s;
+
+    // Hash by the largest block, rehashing the watchpoints of the last run.
+    int hashBits = 0;
+    for (int i = 0; i < s->env.processorCount; i++)
+    {
+        if (s->blockBits[i] > hashBits)
+            hashBits = s->blockBits[i];
+    }
+    if (hashBits != watch.hashBits)
+    {
+        watch.hashBits = hashBits;
+        if (watch.slots != NULL && watchGrow() != 0)
+        {
+            printf("Out of memory for watchpoints, they are cleared.\n");
+            watchClear();
+        }
+    }
+
+    watch.memoryRequest = s->cache_sim->memoryRequest;
+    s->cache_sim->memoryRequest = watchMemoryRequest;
+
+    watch.permReq = s->coher_sim->permReq;
+    watch.invlReq = s->coher_sim->invlReq;
+    watch.coherBusReq = s->coher_sim->busReq;
+    s->coher_sim->permReq = watchPermReq;
+    s->coher_sim->invlReq = watchInvlReq;
+    s->coher_sim->busReq = watchCoherBusReq;
+
+    watch.interBusReq = s->inter_sim->busReq;
+    s->inter_sim->busReq = watchInterBusReq;
+}
+
+void watchDetach(simulation* s)
+{
+    if (s == NULL || watch.s != s)
+        return;
+
+    s->cache_sim->memoryRequest = watch.memoryRequest;
+    s->coher_sim->permReq = watch.permReq;
+    s->coher_sim->invlReq = watch.invlReq;
+    s->coher_sim->busReq = watch.coherBusReq;
+    s->inter_sim->busReq = watch.interBusReq;
+
+    watch.s = NULL;
+}
@@ -0,0 +1,47 @@
+#ifndef WATCH_H
+#define WATCH_H
+
+#include <stdint.h>
+
+#include "sim.h"
+
+//
+// Watch
+//
+//   Watchpoints for the debug REPL.  Watched addresses are kept in a hash
+// set, hashed by the largest cache block of the simulation, and checked by
+// wrappers that are put around the entry points taking an address while a
+// simulation runs under the debugger, so each request costs one lookup.  A
+// request matches a watched address in the same block of the cache of its
+// processor, whose size is taken from the -b of the cache settings.  As
+// nothing is checked between requests, idle ticks are still skipped.  A
+// watchpoint that is hit drops into the REPL at the end of its tick.
+//
+
+// Kinds of address watchpoint.
+#define WATCH_REQUEST 0x1 // Requested of the cache by any processor.
+#define WATCH_STATE 0x2   // Its coherence state changes in any cache.
+
+// Add the kinds in kind to the watchpoints of addr, 0 on success.
+int watchAddress(uint64_t addr, uint8_t kind);
+
+// Watch the bus queue of processorNum for more than length requests, or
+//   stop watching it if length is negative.  0 on success.
+int watchQueue(int processorNum, int length);
+
+// Remove every watchpoint on exactly addr, 0 if there were any.
+int watchRemove(uint64_t addr);
+void watchClear(void);
+
+// Number of watchpoints set.
+int watchCount(void);
+void watchList(void);
+
+// What hit a watchpoint since the last call, NULL if nothing did.
+const char* watchHit(void);
+
+// Check the watchpoints on the requests of s until detached.
+void watchAttach(simulation* s);
+void watchDetach(simulation* s);
+
+#endif
@@ -3,6 +3,9 @@
 
 #include <memory.h>
 #include <interconnect.h>
+#include <events.h>
+#include <probes.h>
+#include <stats.h>
 
 typedef enum _bus_req_state
 {
@@ -22,17 +25,43 @@ typedef struct _bus_req {
     uint8_t shared;
     uint8_t data;
     uint8_t dataAvail;
+    int64_t queuedAt;
     struct _bus_req* next;
 } bus_req;
 
-bus_req* pendingRequest = NULL;
-bus_req** queuedRequests;
-interconn* self;
-coher* coherComp;
-memory* memComp;
+// State of one interconnect instance.
+typedef struct _inter_ctx {
+    interconn pub; // Must be first, the instance is passed as an interconn*.
+    int processorCount;
+    bus_req* pendingRequest;
+    bus_req** queuedRequests;
+    coher* coherComp;
+    memory* memComp;
+    int countDown;
+    int lastProc; // for round robin arbitration
+    int arbitration;
+    int cacheDelay;
+    int cacheTransfer;
+    int64_t tickCount;
+    const sim_env* env; // Where request stages are reported.
+
+    // Statistics
+    uint64_t* requests;   // Per processor
+    uint64_t busyTicks;   // Ticks with a request on the bus
+    uint64_t cacheTransfers;
+    uint64_t memoryTransfers;
+    uint64_t queueDepth;  // Requests waiting for the bus
+    stat_hist queueWait;  // Ticks from a request to its grant
+} inter_ctx;
+
+// Order in which queued requests are granted the bus.
+enum
+{
+    ARB_ROUND_ROBIN,
+    ARB_FIXED_PRIORITY // Lowest processor number first.
+};
 
-int CADSS_VERBOSE = 0;
-int processorCount = 1;
+const int CADSS_ABI = CADSS_ABI_VERSION;
 
 static const char* req_state_map[] = {
     [NONE] = "None",
@@ -47,29 +76,40 @@ static const char* req_type_map[]
     = {[NO_REQ] = "None", [BUSRD] = "BusRd",   [BUSWR] = "BusRdX",
        [DATA] = "Data",   [SHARED] = "Shared", [MEMORY] = "Memory"};
 
-const int CACHE_DELAY = 10;
-const int CACHE_TRANSFER = 10;
-
-void registerCoher(coher* cc);
-void busReq(bus_req_type brt, uint64_t addr, int procNum);
-int busReqCacheTransfer(uint64_t addr, int procNum);
-void printInterconnState(void);
-void interconnNotifyState(void);
+static const int CACHE_DELAY = 10;
+static const int CACHE_TRANSFER = 10;
+
+static void registerCoher(interconn* ic, coher* cc);
+static void busReq(interconn* ic, bus_req_type brt, uint64_t addr,
+                   int procNum);
+static int busReqCacheTransfer(interconn* ic, uint64_t addr, int procNum);
+static void printInterconnState(inter_ctx* self);
+static void interconnNotifyState(inter_ctx* self);
+static int tick(void* ic);
+static int64_t idleTicks(void* ic);
+static void skipTicks(void* ic, int64_t ticks);
+static int finish(void* ic, int outFd);
+static int destroy(void* ic);
+static int reconfigure(void* ic, int arg_count, char** arg_list);
+static int save(void* ic, FILE* f);
+static int restore(void* ic, FILE* f);
 
 // Helper methods for per-processor request queues.
-static void enqBusRequest(bus_req* pr, int procNum)
+static void enqBusRequest(inter_ctx* self, bus_req* pr, int procNum)
 {
     bus_req* iter;
 
+    self->queueDepth++;
+
     // No items in the queue.
-    if (!queuedRequests[procNum])
+    if (!self->queuedRequests[procNum])
     {
-        queuedRequests[procNum] = pr;
+        self->queuedRequests[procNum] = pr;
         return;
     }
 
     // Add request to the end of the queue.
-    iter = queuedRequests[procNum];
+    iter = self->queuedRequests[procNum];
     while (iter->next)
     {
         iter = iter->next;
@@ -79,32 +119,33 @@ static void enqBusRequest(bus_req* pr, int procNum)
     iter->next = pr;
 }
 
-static bus_req* deqBusRequest(int procNum)
+static bus_req* deqBusRequest(inter_ctx* self, int procNum)
 {
     bus_req* ret;
 
-    ret = queuedRequests[procNum];
+    ret = self->queuedRequests[procNum];
 
     // Move the head to the next request (if there is one).
     if (ret)
     {
-        queuedRequests[procNum] = ret->next;
+        self->queuedRequests[procNum] = ret->next;
+        self->queueDepth--;
     }
 
     return ret;
 }
 
-static int busRequestQueueSize(int procNum)
+static int busRequestQueueSize(inter_ctx* self, int procNum)
 {
     int count = 0;
     bus_req* iter;
 
-    if (!queuedRequests[procNum])
+    if (!self->queuedRequests[procNum])
     {
         return 0;
     }
 
-    iter = queuedRequests[procNum];
+    iter = self->queuedRequests[procNum];
     while (iter)
     {
         iter = iter->next;
@@ -114,49 +155,115 @@ static int busRequestQueueSize(int procNum)
     return count;
 }
 
+static int queueLength(interconn* ic, int procNum)
+{
+    return busRequestQueueSize((inter_ctx*)ic, procNum);
+}
+
 interconn* init(inter_sim_args* isa)
 {
+    inter_ctx* self = calloc(1, sizeof(inter_ctx));
+    self->processorCount = isa->env->processorCount;
+    self->arbitration = ARB_ROUND_ROBIN;
+    self->cacheDelay = CACHE_DELAY;
+    self->cacheTransfer = CACHE_TRANSFER;
+    if (reconfigure(self, isa->arg_count, isa->arg_list) != 0)
+    {
+        free(self);
+        return NULL;
+    }
+
+    self->queuedRequests = malloc(sizeof(bus_req*) * self->processorCount);
+    for (int i = 0; i < self->processorCount; i++)
+    {
+        self->queuedRequests[i] = NULL;
+    }
+
+    self->env = isa->env;
+    self->requests = calloc(self->processorCount, sizeof(uint64_t));
+    statsVector(isa->env, "interconnect.requests", self->requests,
+                self->processorCount);
+    statsCounter(isa->env, "interconnect.busyTicks", &self->busyTicks);
+    statsCounter(isa->env, "interconnect.cacheTransfers",
+                 &self->cacheTransfers);
+    statsCounter(isa->env, "interconnect.memoryTransfers",
+                 &self->memoryTransfers);
+    statsGauge(isa->env, "interconnect.queueDepth", &self->queueDepth);
+    statsHist(isa->env, "interconnect.queueWait", &self->queueWait);
+
+    self->pub.busReq = busReq;
+    self->pub.registerCoher = registerCoher;
+    self->pub.busReqCacheTransfer = busReqCacheTransfer;
+    self->pub.queueLength = queueLength;
+    self->pub.si.tick = tick;
+    self->pub.si.finish = finish;
+    self->pub.si.destroy = destroy;
+    self->pub.si.idleTicks = idleTicks;
+    self->pub.si.skipTicks = skipTicks;
+    self->pub.si.reconfigure = reconfigure;
+    self->pub.si.save = save;
+    self->pub.si.restore = restore;
+
+    self->memComp = isa->memory;
+    self->memComp->registerInterconnect(self->memComp, &self->pub);
+
+    return &self->pub;
+}
+
+// -a <0|1>   - arbitration, 0 is round robin and 1 is fixed priority
+// -d <ticks> - delay before a request is offered to the caches
+// -x <ticks> - duration of a cache-to-cache transfer
+//   New values apply from the next request.
+static int reconfigure(void* ic, int arg_count, char** arg_list)
+{
+    inter_ctx* self = (inter_ctx*)ic;
     int op;
 
-    while ((op = getopt(isa->arg_count, isa->arg_list, "v")) != -1)
+    while ((op = getopt(arg_count, arg_list, "va:d:x:")) != -1)
     {
         switch (op)
         {
+            case 'a':
+                self->arbitration = atoi(optarg);
+                break;
+            case 'd':
+                self->cacheDelay = atoi(optarg);
+                break;
+            case 'x':
+                self->cacheTransfer = atoi(optarg);
+                break;
             default:
                 break;
         }
     }
 
-    queuedRequests = malloc(sizeof(bus_req*) * processorCount);
-    for (int i = 0; i < processorCount; i++)
+    if (self->arbitration != ARB_ROUND_ROBIN
+        && self->arbitration != ARB_FIXED_PRIORITY)
     {
-        queuedRequests[i] = NULL;
+        fprintf(stderr, "Undefined arbitration - %d\n", self->arbitration);
+        return -1;
+    }
+    if (self->cacheDelay <= 0 || self->cacheTransfer <= 0)
+    {
+        fprintf(stderr, "Interconnect delays must be at least 1 tick\n");
+        return -1;
     }
 
-    self = malloc(sizeof(interconn));
-    self->busReq = busReq;
-    self->registerCoher = registerCoher;
-    self->busReqCacheTransfer = busReqCacheTransfer;
-    self->si.tick = tick;
-    self->si.finish = finish;
-    self->si.destroy = destroy;
-
-    memComp = isa->memory;
-    memComp->registerInterconnect(self);
-
-    return self;
+    return 0;
 }
 
-int countDown = 0;
-int lastProc = 0; // for round robin arbitration
-
-void registerCoher(coher* cc)
+static void registerCoher(interconn* ic, coher* cc)
 {
-    coherComp = cc;
+    inter_ctx* self = (inter_ctx*)ic;
+
+    self->coherComp = cc;
 }
 
-void memReqCallback(int procNum, uint64_t addr)
+static void memReqCallback(void* ic, int procNum, uint64_t addr)
 {
+    inter_ctx* self = (inter_ctx*)ic;
+    bus_req* pendingRequest = self->pendingRequest;
+
     if (!pendingRequest)
     {
         return;
@@ -168,8 +275,11 @@ void memReqCallback(int procNum, uint64_t addr)
     }
 }
 
-void busReq(bus_req_type brt, uint64_t addr, int procNum)
+static void busReq(interconn* ic, bus_req_type brt, uint64_t addr, int procNum)
 {
+    inter_ctx* self = (inter_ctx*)ic;
+    bus_req* pendingRequest = self->pendingRequest;
+
     if (pendingRequest == NULL)
     {
         assert(brt != SHARED);
@@ -181,8 +291,13 @@ void busReq(bus_req_type brt, uint64_t addr, int procNum)
         nextReq->procNum = procNum;
         nextReq->dataAvail = 0;
 
-        pendingRequest = nextReq;
-        countDown = CACHE_DELAY;
+        self->requests[procNum]++;
+        statHistAdd(&self->queueWait, 0);
+        eventsReport(self->env, REQ_BUS_GRANT, procNum, addr, -1);
+        CADSS_PROBE3(bus_grant, procNum, addr, 0);
+
+        self->pendingRequest = nextReq;
+        self->countDown = self->cacheDelay;
 
         return;
     }
@@ -196,7 +311,9 @@ void busReq(bus_req_type brt, uint64_t addr, int procNum)
         assert(pendingRequest->currentState == WAITING_MEMORY);
         pendingRequest->data = 1;
         pendingRequest->currentState = TRANSFERING_CACHE;
-        countDown = CACHE_TRANSFER;
+        self->countDown = self->cacheTransfer;
+        eventsReport(self->env, REQ_CACHE_TRANSFER, pendingRequest->procNum,
+                     addr, -1);
         return;
     }
     else
@@ -209,24 +326,38 @@ void busReq(bus_req_type brt, uint64_t addr, int procNum)
         nextReq->addr = addr;
         nextReq->procNum = procNum;
         nextReq->dataAvail = 0;
+        nextReq->queuedAt = self->tickCount;
+
+        self->requests[procNum]++;
+        eventsReport(self->env, REQ_BUS_QUEUE, procNum, addr, -1);
 
-        enqBusRequest(nextReq, procNum);
+        enqBusRequest(self, nextReq, procNum);
     }
 }
 
-int tick()
+static int tick(void* ic)
 {
-    memComp->si.tick();
+    inter_ctx* self = (inter_ctx*)ic;
+    coher* coherComp = self->coherComp;
+    memory* memComp = self->memComp;
 
-    if (self->dbgEnv.cadssDbgWatchedComp && !self->dbgEnv.cadssDbgNotifyState)
+    memComp->si.tick(memComp);
+
+    if (self->pub.dbgEnv.cadssDbgWatchedComp
+        && !self->pub.dbgEnv.cadssDbgNotifyState)
     {
-        printInterconnState();
+        printInterconnState(self);
     }
 
-    if (countDown > 0)
+    self->tickCount++;
+    bus_req* pendingRequest = self->pendingRequest;
+    if (pendingRequest != NULL)
+        self->busyTicks++;
+
+    if (self->countDown > 0)
     {
         assert(pendingRequest != NULL);
-        countDown--;
+        self->countDown--;
 
         // If the count-down has elapsed (or there hasn't been a
         // cache-to-cache transfer, the memory will respond with
@@ -234,26 +365,37 @@ int tick()
         if (pendingRequest->dataAvail)
         {
             pendingRequest->currentState = TRANSFERING_MEMORY;
-            countDown = 0;
+            self->countDown = 0;
+            eventsReport(self->env, REQ_MEMORY_TRANSFER,
+                         pendingRequest->procNum, pendingRequest->addr, -1);
         }
 
-        if (countDown == 0)
+        // Memory may run on a slower clock, and count its fetch in its own
+        //   ticks, so the data is waited for.
+        if (self->countDown == 0
+            && pendingRequest->currentState == WAITING_MEMORY)
+        {
+            self->countDown = 1;
+        }
+        else if (self->countDown == 0)
         {
             if (pendingRequest->currentState == WAITING_CACHE)
             {
                 // Make a request to memory.
-                countDown
-                    = memComp->busReq(pendingRequest->addr,
-                                      pendingRequest->procNum, memReqCallback);
+                self->countDown = memComp->busReq(
+                    memComp, pendingRequest->addr, pendingRequest->procNum,
+                    self, memReqCallback);
 
                 pendingRequest->currentState = WAITING_MEMORY;
+                eventsReport(self->env, REQ_SNOOP, pendingRequest->procNum,
+                             pendingRequest->addr, -1);
 
                 // The processors will snoop for this request as well.
-                for (int i = 0; i < processorCount; i++)
+                for (int i = 0; i < self->processorCount; i++)
                 {
                     if (pendingRequest->procNum != i)
                     {
-                        coherComp->busReq(pendingRequest->brt,
+                        coherComp->busReq(coherComp, pendingRequest->brt,
                                           pendingRequest->addr, i);
                     }
                 }
@@ -267,12 +409,16 @@ int tick()
             {
                 bus_req_type brt
                     = (pendingRequest->shared == 1) ? SHARED : DATA;
-                coherComp->busReq(brt, pendingRequest->addr,
+                coherComp->busReq(coherComp, brt, pendingRequest->addr,
                                   pendingRequest->procNum);
 
-                interconnNotifyState();
+                self->memoryTransfers++;
+                eventsReport(self->env, REQ_BUS_DONE,
+                             pendingRequest->procNum, pendingRequest->addr,
+                             -1);
+                interconnNotifyState(self);
                 free(pendingRequest);
-                pendingRequest = NULL;
+                self->pendingRequest = NULL;
             }
             else if (pendingRequest->currentState == TRANSFERING_CACHE)
             {
@@ -280,27 +426,41 @@ int tick()
                 if (pendingRequest->shared == 1)
                     brt = SHARED;
 
-                coherComp->busReq(brt, pendingRequest->addr,
+                coherComp->busReq(coherComp, brt, pendingRequest->addr,
                                   pendingRequest->procNum);
 
-                interconnNotifyState();
+                self->cacheTransfers++;
+                eventsReport(self->env, REQ_BUS_DONE,
+                             pendingRequest->procNum, pendingRequest->addr,
+                             -1);
+                interconnNotifyState(self);
                 free(pendingRequest);
-                pendingRequest = NULL;
+                self->pendingRequest = NULL;
             }
         }
     }
-    else if (countDown == 0)
+    else if (self->countDown == 0)
     {
-        for (int i = 0; i < processorCount; i++)
+        for (int i = 0; i < self->processorCount; i++)
         {
-            int pos = (i + lastProc) % processorCount;
-            if (queuedRequests[pos] != NULL)
+            int first = (self->arbitration == ARB_ROUND_ROBIN)
+                            ? self->lastProc
+                            : 0;
+            int pos = (i + first) % self->processorCount;
+            if (self->queuedRequests[pos] != NULL)
             {
-                pendingRequest = deqBusRequest(pos);
-                countDown = CACHE_DELAY;
+                pendingRequest = deqBusRequest(self, pos);
+                self->pendingRequest = pendingRequest;
+                self->countDown = self->cacheDelay;
                 pendingRequest->currentState = WAITING_CACHE;
-
-                lastProc = (pos + 1) % processorCount;
+                statHistAdd(&self->queueWait,
+                            self->tickCount - pendingRequest->queuedAt);
+                eventsReport(self->env, REQ_BUS_GRANT, pos,
+                             pendingRequest->addr, -1);
+                CADSS_PROBE3(bus_grant, pos, pendingRequest->addr,
+                             self->tickCount - pendingRequest->queuedAt);
+
+                self->lastProc = (pos + 1) % self->processorCount;
                 break;
             }
         }
@@ -309,8 +469,43 @@ int tick()
     return 0;
 }
 
-void printInterconnState(void)
+static int64_t idleTicks(void* ic)
+{
+    inter_ctx* self = (inter_ctx*)ic;
+
+    if (self->countDown > 0)
+    {
+        if (self->pendingRequest->dataAvail)
+            return 0;
+
+        return self->countDown - 1;
+    }
+
+    for (int i = 0; i < self->processorCount; i++)
+    {
+        if (self->queuedRequests[i] != NULL)
+            return 0;
+    }
+
+    return SIM_IDLE_FOREVER;
+}
+
+static void skipTicks(void* ic, int64_t ticks)
+{
+    inter_ctx* self = (inter_ctx*)ic;
+
+    self->tickCount += ticks;
+    if (self->countDown > 0)
+    {
+        self->countDown -= ticks;
+        self->busyTicks += ticks;
+    }
+}
+
+static void printInterconnState(inter_ctx* self)
 {
+    bus_req* pendingRequest = self->pendingRequest;
+
     if (!pendingRequest)
     {
         return;
@@ -326,42 +521,52 @@ void printInterconnState(void)
            "                  Next: %p\n"
            "             Countdown: %d\n"
            "    Request Queue Size: \n",
-           processorCount, pendingRequest->procNum, pendingRequest->addr,
-           req_type_map[pendingRequest->brt],
+           self->processorCount, pendingRequest->procNum,
+           pendingRequest->addr, req_type_map[pendingRequest->brt],
            req_state_map[pendingRequest->currentState],
            pendingRequest->shared ? "Shared" : "Data", pendingRequest->next,
-           countDown);
+           self->countDown);
 
-    for (int p = 0; p < processorCount; p++)
+    for (int p = 0; p < self->processorCount; p++)
     {
-        printf("       - Processor[%02d]: %d\n", p, busRequestQueueSize(p));
+        printf("       - Processor[%02d]: %d\n", p,
+               busRequestQueueSize(self, p));
     }
 }
 
-void interconnNotifyState(void)
+static void interconnNotifyState(inter_ctx* self)
 {
-    if (!pendingRequest)
+    debug_env_vars* dbgEnv = &self->pub.dbgEnv;
+
+    if (!self->pendingRequest)
         return;
 
-    if (self->dbgEnv.cadssDbgExternBreak)
+    if (dbgEnv->cadssDbgExternBreak)
     {
-        printInterconnState();
+        printInterconnState(self);
         raise(SIGTRAP);
         return;
     }
 
-    if (self->dbgEnv.cadssDbgWatchedComp && self->dbgEnv.cadssDbgNotifyState)
+    if (dbgEnv->cadssDbgWatchedComp && dbgEnv->cadssDbgNotifyState)
     {
-        self->dbgEnv.cadssDbgNotifyState = 0;
-        printInterconnState();
+        dbgEnv->cadssDbgNotifyState = 0;
+        printInterconnState(self);
     }
 }
 
 // Return a non-zero value if the current request
 // was satisfied by a cache-to-cache transfer.
-int busReqCacheTransfer(uint64_t addr, int procNum)
+static int busReqCacheTransfer(interconn* ic, uint64_t addr, int procNum)
 {
-    assert(pendingRequest);
+    inter_ctx* self = (inter_ctx*)ic;
+    bus_req* pendingRequest = self->pendingRequest;
+
+    // On a slower clock, memory may only see that the request it fetches
+    //   for was done after it is gone.
+    assert(pendingRequest != NULL || self->env->clockDomains);
+    if (pendingRequest == NULL)
+        return 1;
 
     if (addr == pendingRequest->addr && procNum == pendingRequest->procNum)
         return (pendingRequest->currentState == TRANSFERING_CACHE);
@@ -369,15 +574,143 @@ int busReqCacheTransfer(uint64_t addr, int procNum)
     return 0;
 }
 
-int finish(int outFd)
+// A bus request as saved, without its queue link.
+typedef struct _saved_req {
+    int32_t brt;
+    int32_t currentState;
+    uint64_t addr;
+    int32_t procNum;
+    uint8_t shared;
+    uint8_t data;
+    uint8_t dataAvail;
+} saved_req;
+
+static void saveRequest(bus_req* br, FILE* f)
+{
+    saved_req sr = {0};
+
+    sr.brt = br->brt;
+    sr.currentState = br->currentState;
+    sr.addr = br->addr;
+    sr.procNum = br->procNum;
+    sr.shared = br->shared;
+    sr.data = br->data;
+    sr.dataAvail = br->dataAvail;
+    fwrite(&sr, sizeof(sr), 1, f);
+}
+
+static bus_req* restoreRequest(FILE* f)
 {
-    memComp->si.finish(outFd);
+    saved_req sr;
+
+    if (fread(&sr, sizeof(sr), 1, f) != 1)
+        return NULL;
+
+    bus_req* br = calloc(1, sizeof(bus_req));
+    br->brt = sr.brt;
+    br->currentState = sr.currentState;
+    br->addr = sr.addr;
+    br->procNum = sr.procNum;
+    br->shared = sr.shared;
+    br->data = sr.data;
+    br->dataAvail = sr.dataAvail;
+
+    return br;
+}
+
+// The current request and every queued one.  Requests only hold data, so
+//   they can be saved at any tick.
+static int save(void* ic, FILE* f)
+{
+    inter_ctx* self = (inter_ctx*)ic;
+    int32_t hasPending = (self->pendingRequest != NULL);
+
+    fwrite(&self->processorCount, sizeof(int), 1, f);
+    fwrite(&self->countDown, sizeof(int), 1, f);
+    fwrite(&self->lastProc, sizeof(int), 1, f);
+    fwrite(&hasPending, sizeof(hasPending), 1, f);
+    if (hasPending)
+        saveRequest(self->pendingRequest, f);
+
+    for (int i = 0; i < self->processorCount; i++)
+    {
+        int32_t count = busRequestQueueSize(self, i);
+        fwrite(&count, sizeof(count), 1, f);
+
+        for (bus_req* br = self->queuedRequests[i]; br != NULL; br = br->next)
+            saveRequest(br, f);
+    }
+
+    return ferror(f) ? -1 : 0;
+}
+
+static int restore(void* ic, FILE* f)
+{
+    inter_ctx* self = (inter_ctx*)ic;
+    int processorCount;
+    int32_t hasPending;
+
+    if (fread(&processorCount, sizeof(int), 1, f) != 1
+        || processorCount != self->processorCount
+        || fread(&self->countDown, sizeof(int), 1, f) != 1
+        || fread(&self->lastProc, sizeof(int), 1, f) != 1
+        || fread(&hasPending, sizeof(hasPending), 1, f) != 1)
+        return -1;
+
+    if (hasPending)
+    {
+        self->pendingRequest = restoreRequest(f);
+        if (self->pendingRequest == NULL)
+            return -1;
+    }
+
+    for (int i = 0; i < self->processorCount; i++)
+    {
+        int32_t count;
+        if (fread(&count, sizeof(count), 1, f) != 1)
+            return -1;
+
+        for (int32_t j = 0; j < count; j++)
+        {
+            bus_req* br = restoreRequest(f);
+            if (br == NULL)
+                return -1;
+
+            enqBusRequest(self, br, i);
+        }
+    }
+
+    if (self->memComp->restoreRequestor != NULL)
+        self->memComp->restoreRequestor(self->memComp, self, memReqCallback);
+
     return 0;
 }
 
-int destroy(void)
+static int finish(void* ic, int outFd)
 {
-    // TODO
-    memComp->si.destroy();
+    inter_ctx* self = (inter_ctx*)ic;
+
+    self->memComp->si.finish(self->memComp, outFd);
+    return 0;
+}
+
+static int destroy(void* ic)
+{
+    inter_ctx* self = (inter_ctx*)ic;
+
+    self->memComp->si.destroy(self->memComp);
+
+    for (int i = 0; i < self->processorCount; i++)
+    {
+        while (self->queuedRequests[i] != NULL)
+        {
+            free(deqBusRequest(self, i));
+        }
+    }
+    free(self->queuedRequests);
+    free(self->pendingRequest);
+    free(self->requests);
+    free(self);
+
     return 0;
 }
@@ -1,106 +1,294 @@
+#include <getopt.h>
+#include <stdio.h>
 #include <stdlib.h>
 
 #include <memory.h>
 #include <interconnect.h>
+#include <events.h>
+#include <probes.h>
+#include <stats.h>
 
 #include "memory_internal.h"
 
-void registerInterconnect(interconn* interconnect);
-int busReq(uint64_t addr, int procNum, void (*callback)(int, uint64_t));
+const int CADSS_ABI = CADSS_ABI_VERSION;
 
-memory* self = NULL;
-memReq* pendingRequest = NULL;
-interconn* interComp;
-int countDown = 0;
+static void registerInterconnect(memory* m, interconn* interconnect);
+static void restoreRequestor(memory* m, void* ctx,
+                             void (*callback)(void*, int, uint64_t));
+static int busReq(memory* m, uint64_t addr, int procNum, void* ctx,
+                  void (*callback)(void*, int, uint64_t));
+static int tick(void* m);
+static int64_t idleTicks(void* m);
+static void skipTicks(void* m, int64_t ticks);
+static int finish(void* m, int outFd);
+static int destroy(void* m);
+static int reconfigure(void* m, int arg_count, char** arg_list);
+static int save(void* m, FILE* f);
+static int restore(void* m, FILE* f);
 
 // This is the same as "BUS_TIME".
-const int DRAM_FETCH_TICKS = 90;
+static const int DRAM_FETCH_TICKS = 90;
 
 memory* init(memory_sim_args* args)
 {
-    // TODO: Add "getopt" when we have actual arguments.
-
-    self = calloc(1, sizeof(memory));
+    memory_ctx* self = calloc(1, sizeof(memory_ctx));
     assert(self);
 
-    self->registerInterconnect = registerInterconnect;
-    self->busReq = busReq;
-    self->si.tick = tick;
-    self->si.finish = finish;
-    self->si.destroy = destroy;
-    pendingRequest = NULL;
+    self->fetchTicks = DRAM_FETCH_TICKS;
+    if (reconfigure(self, args->arg_count, args->arg_list) != 0)
+    {
+        free(self);
+        return NULL;
+    }
+
+    self->env = args->env;
+    self->pub.registerInterconnect = registerInterconnect;
+    self->pub.restoreRequestor = restoreRequestor;
+    self->pub.busReq = busReq;
+    self->pub.si.tick = tick;
+    self->pub.si.finish = finish;
+    self->pub.si.destroy = destroy;
+    self->pub.si.idleTicks = idleTicks;
+    self->pub.si.skipTicks = skipTicks;
+    self->pub.si.reconfigure = reconfigure;
+    self->pub.si.save = save;
+    self->pub.si.restore = restore;
+    self->pendingRequest = NULL;
 
-    return self;
+    statsCounter(self->env, "memory.requests", &self->requests);
+    statsCounter(self->env, "memory.squelched", &self->squelched);
+    statsCounter(self->env, "memory.busyTicks", &self->busyTicks);
+
+    return &self->pub;
 }
 
-void registerInterconnect(interconn* interconnect)
+// -l <ticks> - DRAM fetch latency, applies to the following requests.
+static int reconfigure(void* m, int arg_count, char** arg_list)
 {
+    memory_ctx* self = (memory_ctx*)m;
+    int op;
+
+    while ((op = getopt(arg_count, arg_list, "l:")) != -1)
+    {
+        switch (op)
+        {
+            case 'l':
+                self->fetchTicks = atoi(optarg);
+                break;
+            default:
+                return -1;
+        }
+    }
+
+    if (self->fetchTicks <= 0)
+    {
+        fprintf(stderr, "Memory latency must be at least 1 tick\n");
+        return -1;
+    }
+
+    return 0;
+}
+
+static void registerInterconnect(memory* m, interconn* interconnect)
+{
+    memory_ctx* self = (memory_ctx*)m;
     assert(self);
     assert(interconnect);
 
-    interComp = interconnect;
+    self->interComp = interconnect;
 }
 
-int busReq(uint64_t addr, int procNum, void (*callback)(int, uint64_t))
+static int busReq(memory* m, uint64_t addr, int procNum, void* ctx,
+                  void (*callback)(void*, int, uint64_t))
 {
-    assert(pendingRequest == NULL);
+    memory_ctx* self = (memory_ctx*)m;
 
-    pendingRequest = calloc(1, sizeof(memReq));
+    // Only on a slower clock than the interconnect can a fetch for a request
+    //   that it has since done some other way still be pending.
+    assert(self->pendingRequest == NULL || self->env->clockDomains);
+    if (self->pendingRequest != NULL)
+    {
+        eventsReport(self->env, REQ_SQUELCH, self->pendingRequest->procNum,
+                     self->pendingRequest->addr, -1);
+        CADSS_PROBE2(dram_squelch, self->pendingRequest->procNum,
+                     self->pendingRequest->addr);
+        free(self->pendingRequest);
+        self->pendingRequest = NULL;
+        self->squelched++;
+    }
+
+    memReq* pendingRequest = calloc(1, sizeof(memReq));
     pendingRequest->addr = addr;
     pendingRequest->procNum = procNum;
     pendingRequest->squelch = 0;
+    pendingRequest->ctx = ctx;
     pendingRequest->callback = callback;
+    self->pendingRequest = pendingRequest;
+    self->requests++;
+    eventsReport(self->env, REQ_DRAM_START, procNum, addr, -1);
 
-    countDown = DRAM_FETCH_TICKS;
+    self->countDown = self->fetchTicks;
+    CADSS_PROBE3(dram_issue, procNum, addr, self->countDown);
 
-    return countDown;
+    return self->countDown;
 }
 
-int tick()
+static int tick(void* m)
 {
-    if (countDown > 0)
+    memory_ctx* self = (memory_ctx*)m;
+    memReq* pendingRequest = self->pendingRequest;
+
+    if (self->countDown > 0)
     {
         assert(pendingRequest);
+        self->busyTicks++;
 
         // Check if one of the caches responded to the request that we are
         // processing. If that's the case, we "squelch" the response and
         // make ourselves available for the next request.
-        if (interComp->busReqCacheTransfer(pendingRequest->addr,
-                                           pendingRequest->procNum))
+        if (self->interComp->busReqCacheTransfer(self->interComp,
+                                                 pendingRequest->addr,
+                                                 pendingRequest->procNum))
         {
             pendingRequest->squelch = 1;
-            countDown = 0;
+            self->squelched++;
+            eventsReport(self->env, REQ_SQUELCH, pendingRequest->procNum,
+                         pendingRequest->addr, -1);
+            CADSS_PROBE2(dram_squelch, pendingRequest->procNum,
+                         pendingRequest->addr);
+            self->countDown = 0;
             goto done;
         }
 
-        countDown--;
+        self->countDown--;
     }
 
 done:
-    if (pendingRequest && countDown == 0)
+    if (pendingRequest && self->countDown == 0)
     {
         if (!pendingRequest->squelch)
         {
-            pendingRequest->callback(pendingRequest->procNum,
+            eventsReport(self->env, REQ_DRAM_END, pendingRequest->procNum,
+                         pendingRequest->addr, -1);
+            pendingRequest->callback(pendingRequest->ctx,
+                                     pendingRequest->procNum,
                                      pendingRequest->addr);
         }
 
         free(pendingRequest);
-        pendingRequest = NULL;
+        self->pendingRequest = NULL;
     }
 
-    return countDown;
+    return self->countDown;
 }
 
-int finish(int outFd)
+static int64_t idleTicks(void* m)
+{
+    memory_ctx* self = (memory_ctx*)m;
+    memReq* pendingRequest = self->pendingRequest;
+
+    if (pendingRequest == NULL)
+        return SIM_IDLE_FOREVER;
+
+    // A cache-to-cache transfer squelches the request on the next tick.
+    if (self->countDown == 0
+        || self->interComp->busReqCacheTransfer(self->interComp,
+                                                pendingRequest->addr,
+                                                pendingRequest->procNum))
+        return 0;
+
+    return self->countDown - 1;
+}
+
+static void skipTicks(void* m, int64_t ticks)
+{
+    memory_ctx* self = (memory_ctx*)m;
+
+    if (self->pendingRequest != NULL)
+        self->busyTicks += ticks;
+    self->countDown -= ticks;
+}
+
+// A fetch in flight, without its callback into the interconnect.
+typedef struct _saved_fetch {
+    int32_t procNum;
+    int32_t squelch;
+    uint64_t addr;
+} saved_fetch;
+
+// fetchTicks is a setting, not state.
+static int save(void* m, FILE* f)
+{
+    memory_ctx* self = (memory_ctx*)m;
+    int32_t hasPending = (self->pendingRequest != NULL);
+
+    fwrite(&self->countDown, sizeof(self->countDown), 1, f);
+    fwrite(&hasPending, sizeof(hasPending), 1, f);
+    if (hasPending)
+    {
+        memReq* pr = self->pendingRequest;
+        saved_fetch sf = {pr->procNum, pr->squelch, pr->addr};
+        fwrite(&sf, sizeof(sf), 1, f);
+    }
+
+    return ferror(f) ? -1 : 0;
+}
+
+static int restore(void* m, FILE* f)
+{
+    memory_ctx* self = (memory_ctx*)m;
+    int32_t hasPending;
+
+    if (fread(&self->countDown, sizeof(self->countDown), 1, f) != 1
+        || fread(&hasPending, sizeof(hasPending), 1, f) != 1)
+        return -1;
+
+    if (hasPending)
+    {
+        saved_fetch sf;
+        if (fread(&sf, sizeof(sf), 1, f) != 1)
+            return -1;
+
+        memReq* pr = calloc(1, sizeof(memReq));
+        if (pr == NULL)
+            return -1;
+        pr->procNum = sf.procNum;
+        pr->squelch = sf.squelch;
+        pr->addr = sf.addr;
+        pr->ctx = self->requestorCtx;
+        pr->callback = self->requestorCallback;
+        self->pendingRequest = pr;
+    }
+
+    return 0;
+}
+
+// The interconnect restores before memory does, or after.
+static void restoreRequestor(memory* m, void* ctx,
+                             void (*callback)(void*, int, uint64_t))
+{
+    memory_ctx* self = (memory_ctx*)m;
+
+    self->requestorCtx = ctx;
+    self->requestorCallback = callback;
+    if (self->pendingRequest != NULL)
+    {
+        self->pendingRequest->ctx = ctx;
+        self->pendingRequest->callback = callback;
+    }
+}
+
+static int finish(void* m, int outFd)
 {
     return 0;
 }
 
-int destroy(void)
+static int destroy(void* m)
 {
+    memory_ctx* self = (memory_ctx*)m;
+
+    free(self->pendingRequest);
     free(self);
-    free(pendingRequest);
 
     return 0;
 }
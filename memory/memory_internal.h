@@ -1,12 +1,35 @@
 #ifndef MEMORY_INTERNAL_H
 #define MEMORY_INTERNAL_H
 
+#include <memory.h>
+#include <interconnect.h>
+
 // Describes a DRAM request.
 typedef struct _memReq {
     int procNum;
     uint64_t addr;
     int squelch;
-    void (*callback)(int, uint64_t);
+    void* ctx;
+    void (*callback)(void*, int, uint64_t);
 } memReq;
 
+// State of one memory instance.
+typedef struct _memory_ctx {
+    memory pub; // Must be first, the instance is passed as a memory*.
+    const sim_env* env;
+    memReq* pendingRequest;
+    interconn* interComp;
+    int countDown;
+    int fetchTicks;
+
+    // The requestor given back after a restore.
+    void* requestorCtx;
+    void (*requestorCallback)(void*, int, uint64_t);
+
+    // Statistics
+    uint64_t requests;
+    uint64_t squelched; // Requests answered by a cache instead
+    uint64_t busyTicks; // Ticks with a fetch in flight
+} memory_ctx;
+
 #endif // MEMORY_INTERNAL_H
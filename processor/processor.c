@@ -4,21 +4,47 @@
 #include <unistd.h>
 
 #include "processor.h"
+#include "probes.h"
+#include "stats.h"
 #include "trace.h"
 #include "cache.h"
 #include "branch.h"
 
-trace_reader* tr = NULL;
-cache* cs = NULL;
-branch* bs = NULL;
-processor* self = NULL;
-
-int processorCount = 1;
-int CADSS_VERBOSE = 0;
-
-int* pendingMem = NULL;
-int* pendingBranch = NULL;
-int64_t* memOpTag = NULL;
+// State of one processor instance.
+typedef struct _processor_ctx {
+    processor pub; // Must be first, the instance is passed as a processor*.
+    int processorCount;
+
+    trace_reader* tr;
+    cache* cs;
+    branch* bs;
+
+    int* pendingMem;
+    int* pendingBranch;
+    int* traceDone;
+    int64_t* memOpTag;
+
+    int64_t tickCount;
+    int64_t stallCount;
+
+    // Statistics, per core.
+    uint64_t* opCount;
+    uint64_t* memOpCount;
+    uint64_t* branchCount;
+    uint64_t* mispredictCount;
+    int64_t* memIssue; // Tick of the pending memory op.
+    stat_hist memLatency;
+} processor_ctx;
+
+const int CADSS_ABI = CADSS_ABI_VERSION;
+
+static int tick(void* p);
+static int64_t idleTicks(void* p);
+static void skipTicks(void* p, int64_t ticks);
+static int finish(void* p, int outFd);
+static int destroy(void* p);
+static int save(void* p, FILE* f);
+static int restore(void* p, FILE* f);
 
 //
 // init
@@ -29,10 +55,6 @@ processor* init(processor_sim_args* psa)
 {
     int op;
 
-    tr = psa->tr;
-    cs = psa->cache_sim;
-    bs = psa->branch_sim;
-
     // TODO - get argument list from assignment
     while ((op = getopt(psa->arg_count, psa->arg_list, "f:d:m:j:k:c:")) != -1)
     {
@@ -64,42 +86,86 @@ processor* init(processor_sim_args* psa)
         }
     }
 
-    pendingBranch = calloc(processorCount, sizeof(int));
-    pendingMem = calloc(processorCount, sizeof(int));
-    memOpTag = calloc(processorCount, sizeof(int64_t));
-
-    self = calloc(1, sizeof(processor));
-    return self;
+    processor_ctx* self = calloc(1, sizeof(processor_ctx));
+    int processorCount = psa->env->processorCount;
+
+    self->processorCount = processorCount;
+    self->tr = psa->tr;
+    self->cs = psa->cache_sim;
+    self->bs = psa->branch_sim;
+
+    self->pendingBranch = calloc(processorCount, sizeof(int));
+    self->pendingMem = calloc(processorCount, sizeof(int));
+    self->traceDone = calloc(processorCount, sizeof(int));
+    self->memOpTag = calloc(processorCount, sizeof(int64_t));
+    self->opCount = calloc(processorCount, sizeof(uint64_t));
+    self->memOpCount = calloc(processorCount, sizeof(uint64_t));
+    self->branchCount = calloc(processorCount, sizeof(uint64_t));
+    self->mispredictCount = calloc(processorCount, sizeof(uint64_t));
+    self->memIssue = calloc(processorCount, sizeof(int64_t));
+
+    statsVector(psa->env, "processor.ops", self->opCount, processorCount);
+    statsVector(psa->env, "processor.memOps", self->memOpCount,
+                processorCount);
+    statsVector(psa->env, "processor.branches", self->branchCount,
+                processorCount);
+    statsVector(psa->env, "processor.mispredicts", self->mispredictCount,
+                processorCount);
+    statsHist(psa->env, "processor.memLatency", &self->memLatency);
+
+    self->tickCount = 0;
+    self->stallCount = -1;
+
+    self->pub.si.tick = tick;
+    self->pub.si.finish = finish;
+    self->pub.si.destroy = destroy;
+    self->pub.si.idleTicks = idleTicks;
+    self->pub.si.skipTicks = skipTicks;
+    self->pub.si.save = save;
+    self->pub.si.restore = restore;
+
+    return &self->pub;
 }
 
-const int64_t STALL_TIME = 100000;
-int64_t tickCount = 0;
-int64_t stallCount = -1;
+static const int64_t STALL_TIME = 100000;
 
-int64_t makeTag(int procNum, int64_t baseTag)
+static int64_t makeTag(int procNum, int64_t baseTag)
 {
     return ((int64_t)procNum) | (baseTag << 8);
 }
 
-void memOpCallback(int procNum, int64_t tag)
+static void memOpCallback(void* p, int procNum, int64_t tag)
 {
+    processor_ctx* self = (processor_ctx*)p;
     int64_t baseTag = (tag >> 8);
 
     // Is the completed memop one that is pending?
-    if (baseTag == memOpTag[procNum])
+    if (baseTag == self->memOpTag[procNum])
     {
-        memOpTag[procNum]++;
-        pendingMem[procNum] = 0;
-        stallCount = tickCount + STALL_TIME;
+        self->memOpTag[procNum]++;
+        self->pendingMem[procNum] = 0;
+
+        // Completions are delivered before the tick is counted.
+        int64_t latency = self->tickCount + 1 - self->memIssue[procNum];
+        statHistAdd(&self->memLatency, latency);
+        CADSS_PROBE3(mem_done, procNum, tag, latency);
+        self->stallCount = self->tickCount + STALL_TIME;
     }
     else
     {
-        printf("memopTag: %ld != tag %ld\n", memOpTag[procNum], tag);
+        printf("memopTag: %ld != tag %ld\n", self->memOpTag[procNum], tag);
     }
 }
 
-int tick(void)
+static int tick(void* p)
 {
+    processor_ctx* self = (processor_ctx*)p;
+    trace_reader* tr = self->tr;
+    cache* cs = self->cs;
+    branch* bs = self->bs;
+    int* pendingMem = self->pendingMem;
+    int* pendingBranch = self->pendingBranch;
+
     // if room in pipeline, request op from trace
     //   for the sample processor, it requests an op
     //   each tick until it reaches a branch or memory op
@@ -108,16 +174,16 @@ int tick(void)
     trace_op* nextOp = NULL;
 
     // Pass along to the branch predictor and cache simulator that time ticked
-    bs->si.tick();
-    cs->si.tick();
-    tickCount++;
+    bs->si.tick(bs);
+    cs->si.tick(cs);
+    self->tickCount++;
 
-    if (tickCount == stallCount)
+    if (self->tickCount == self->stallCount)
     {
         printf(
             "Processor may be stalled.  Now at tick - %ld, last op at %ld\n",
-            tickCount, tickCount - STALL_TIME);
-        for (int i = 0; i < processorCount; i++)
+            self->tickCount, self->tickCount - STALL_TIME);
+        for (int i = 0; i < self->processorCount; i++)
         {
             if (pendingMem[i] == 1)
             {
@@ -127,7 +193,7 @@ int tick(void)
     }
 
     int progress = 0;
-    for (int i = 0; i < processorCount; i++)
+    for (int i = 0; i < self->processorCount; i++)
     {
         if (pendingMem[i] == 1)
         {
@@ -145,28 +211,43 @@ int tick(void)
         }
 
         // TODO: get and manage ops for each processor core
-        nextOp = tr->getNextOp(i);
+        nextOp = tr->getNextOp(tr, i);
 
         if (nextOp == NULL)
+        {
+            self->traceDone[i] = 1;
             continue;
+        }
 
         progress = 1;
+        self->opCount[i]++;
 
         switch (nextOp->op)
         {
             case MEM_LOAD:
             case MEM_STORE:
                 pendingMem[i] = 1;
-                cs->memoryRequest(nextOp, i, makeTag(i, memOpTag[i]),
+                self->memOpCount[i]++;
+                self->memIssue[i] = self->tickCount;
+                CADSS_PROBE3(mem_issue, i, nextOp->memAddress,
+                             makeTag(i, self->memOpTag[i]));
+                cs->memoryRequest(cs, nextOp, i,
+                                  makeTag(i, self->memOpTag[i]), self,
                                   memOpCallback);
                 break;
 
             case BRANCH:
-                pendingBranch[i]
-                    = (bs->branchRequest(nextOp, i) == nextOp->nextPCAddress)
-                          ? 0
-                          : 1;
+            {
+                uint64_t predicted = bs->branchRequest(bs, nextOp, i);
+                pendingBranch[i] = (predicted == nextOp->nextPCAddress) ? 0
+                                                                        : 1;
+                self->branchCount[i]++;
+                self->mispredictCount[i] += pendingBranch[i];
+                if (pendingBranch[i])
+                    CADSS_PROBE3(branch_mispredict, i, nextOp->pcAddress,
+                                 predicted);
                 break;
+            }
 
             case ALU:
             case ALU_LONG:
@@ -180,13 +261,95 @@ int tick(void)
     return progress;
 }
 
-int finish(int outFd)
+static int64_t idleTicks(void* p)
+{
+    processor_ctx* self = (processor_ctx*)p;
+
+    // Only idle while every core is blocked on memory or has exhausted
+    //   its trace, and at least one is still waiting.
+    int waiting = 0;
+    for (int i = 0; i < self->processorCount; i++)
+    {
+        if (self->pendingMem[i] == 1)
+            waiting = 1;
+        else if (self->pendingBranch[i] > 0 || !self->traceDone[i])
+            return 0;
+    }
+
+    if (!waiting)
+        return 0;
+
+    // Still report a possible stall on the tick that it happens.
+    if (self->stallCount > self->tickCount)
+        return self->stallCount - self->tickCount - 1;
+
+    return SIM_IDLE_FOREVER;
+}
+
+static void skipTicks(void* p, int64_t ticks)
+{
+    processor_ctx* self = (processor_ctx*)p;
+
+    self->tickCount += ticks;
+}
+
+// Progress of each core.  The trace position is saved by the trace reader.
+static int save(void* p, FILE* f)
+{
+    processor_ctx* self = (processor_ctx*)p;
+    int n = self->processorCount;
+
+    // An outstanding memory op holds the callback into this instance, which
+    //   the cache can only give back if it has restoreRequestor.
+    for (int i = 0; i < n; i++)
+    {
+        if (self->pendingMem[i] && self->cs->restoreRequestor == NULL)
+            return SIM_SAVE_BUSY;
+    }
+
+    fwrite(&n, sizeof(n), 1, f);
+    fwrite(self->pendingMem, sizeof(int), n, f);
+    fwrite(self->memIssue, sizeof(int64_t), n, f);
+    fwrite(self->pendingBranch, sizeof(int), n, f);
+    fwrite(self->traceDone, sizeof(int), n, f);
+    fwrite(self->memOpTag, sizeof(int64_t), n, f);
+    fwrite(&self->tickCount, sizeof(int64_t), 1, f);
+    fwrite(&self->stallCount, sizeof(int64_t), 1, f);
+
+    return ferror(f) ? -1 : 0;
+}
+
+static int restore(void* p, FILE* f)
+{
+    processor_ctx* self = (processor_ctx*)p;
+    int n = 0;
+
+    if (fread(&n, sizeof(n), 1, f) != 1 || n != self->processorCount)
+        return -1;
+
+    if (fread(self->pendingMem, sizeof(int), n, f) != n
+        || fread(self->memIssue, sizeof(int64_t), n, f) != n
+        || fread(self->pendingBranch, sizeof(int), n, f) != n
+        || fread(self->traceDone, sizeof(int), n, f) != n
+        || fread(self->memOpTag, sizeof(int64_t), n, f) != n
+        || fread(&self->tickCount, sizeof(int64_t), 1, f) != 1
+        || fread(&self->stallCount, sizeof(int64_t), 1, f) != 1)
+        return -1;
+
+    if (self->cs->restoreRequestor != NULL)
+        self->cs->restoreRequestor(self->cs, self, memOpCallback);
+
+    return 0;
+}
+
+static int finish(void* p, int outFd)
 {
-    int c = cs->si.finish(outFd);
-    int b = bs->si.finish(outFd);
+    processor_ctx* self = (processor_ctx*)p;
+    int c = self->cs->si.finish(self->cs, outFd);
+    int b = self->bs->si.finish(self->bs, outFd);
 
     char buf[32];
-    size_t charCount = snprintf(buf, 32, "Ticks - %ld\n", tickCount);
+    size_t charCount = snprintf(buf, 32, "Ticks - %ld\n", self->tickCount);
 
     (void)!write(outFd, buf, charCount + 1);
 
@@ -195,10 +358,22 @@ int finish(int outFd)
     return 0;
 }
 
-int destroy(void)
+static int destroy(void* p)
 {
-    int c = cs->si.destroy();
-    int b = bs->si.destroy();
+    processor_ctx* self = (processor_ctx*)p;
+    int c = self->cs->si.destroy(self->cs);
+    int b = self->bs->si.destroy(self->bs);
+
+    free(self->pendingBranch);
+    free(self->pendingMem);
+    free(self->traceDone);
+    free(self->memOpTag);
+    free(self->opCount);
+    free(self->memOpCount);
+    free(self->branchCount);
+    free(self->mispredictCount);
+    free(self->memIssue);
+    free(self);
 
     if (b || c)
         return 1;
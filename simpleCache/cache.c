@@ -6,29 +6,54 @@
 #include <assert.h>
 
 #include <coherence.h>
+#include <events.h>
+#include <probes.h>
 #include "stree.h"
 
-cache* self = NULL;
+typedef void (*memCallbackFunc)(void*, int, int64_t);
 
-int processorCount = 1;
-int CADSS_VERBOSE = 0;
-int blockSize = 1;
-
-coher* coherComp = NULL;
-
-int64_t* pendingTag = NULL;
-
-typedef void (*memCallbackFunc)(int, int64_t);
-
-memCallbackFunc* memCallback = NULL;
+typedef struct _pendingRequest {
+    int64_t tag;
+    int64_t addr;
+    int processorNum;
+    void* ctx;
+    memCallbackFunc callback;
+    struct _pendingRequest* next;
+} pendingRequest;
 
-void coherCallback(int type, int processorNum, int64_t addr);
-void memoryRequest(trace_op* op, int processorNum, int64_t tag,
-                   void (*callback)(int, int64_t));
+// State of one cache instance.
+typedef struct _cache_ctx {
+    cache pub; // Must be first, the instance is passed as a cache*.
+    int processorCount;
+    int verbose;
+    int blockSize;
+    const sim_env* env; // Where request stages are reported.
+    coher* coherComp;
+    pendingRequest* readyReq;
+    pendingRequest* pendReq;
+    void* requestorCtx; // Given back after a restore.
+    memCallbackFunc requestorCallback;
+} cache_ctx;
+
+const int CADSS_ABI = CADSS_ABI_VERSION;
+
+static void coherCallback(void* c, int type, int processorNum, int64_t addr);
+static void memoryRequest(cache* c, trace_op* op, int processorNum,
+                          int64_t tag, void* ctx, memCallbackFunc callback);
+static void warmRequest(cache* c, trace_op* op, int processorNum);
+static int tick(void* c);
+static int64_t idleTicks(void* c);
+static void skipTicks(void* c, int64_t ticks);
+static int finish(void* c, int outFd);
+static int destroy(void* c);
+static int save(void* c, FILE* f);
+static int restore(void* c, FILE* f);
+static void restoreRequestor(cache* c, void* ctx, memCallbackFunc callback);
 
 cache* init(cache_sim_args* csa)
 {
     int op;
+    int blockSize = 1;
 
     // TODO - get argument list from assignment
     while ((op = getopt(csa->arg_count, csa->arg_list, "E:s:b:i:R:")) != -1)
@@ -62,49 +87,50 @@ cache* init(cache_sim_args* csa)
         }
     }
 
-    self = malloc(sizeof(cache));
-    self->memoryRequest = memoryRequest;
-    self->si.tick = tick;
-    self->si.finish = finish;
-    self->si.destroy = destroy;
-
-    coherComp = csa->coherComp;
-    coherComp->registerCacheInterface(coherCallback);
-
-    memCallback = calloc(processorCount, sizeof(memCallbackFunc));
-    pendingTag = calloc(processorCount, sizeof(int));
-
-    return self;
+    cache_ctx* self = calloc(1, sizeof(cache_ctx));
+    self->processorCount = csa->env->processorCount;
+    self->verbose = csa->env->verbose;
+    self->blockSize = blockSize;
+    self->env = csa->env;
+
+    self->pub.memoryRequest = memoryRequest;
+    self->pub.warmRequest = warmRequest;
+    self->pub.restoreRequestor = restoreRequestor;
+    self->pub.si.tick = tick;
+    self->pub.si.finish = finish;
+    self->pub.si.destroy = destroy;
+    self->pub.si.idleTicks = idleTicks;
+    self->pub.si.skipTicks = skipTicks;
+    self->pub.si.save = save;
+    self->pub.si.restore = restore;
+
+    self->coherComp = csa->coherComp;
+    self->coherComp->registerCacheInterface(self->coherComp, self,
+                                            coherCallback);
+
+    return &self->pub;
 }
 
-typedef struct _pendingRequest {
-    int64_t tag;
-    int64_t addr;
-    int processorNum;
-    void (*callback)(int, int64_t);
-    struct _pendingRequest* next;
-} pendingRequest;
-
-pendingRequest* readyReq = NULL;
-pendingRequest* pendReq = NULL;
-
 // type could be READ, WRITE, INVALIDATE, simple ignores this
-void coherCallback(int type, int processorNum, int64_t addr)
+static void coherCallback(void* c, int type, int processorNum, int64_t addr)
 {
-    assert(pendReq != NULL);
-    assert(processorNum < processorCount);
+    cache_ctx* self = (cache_ctx*)c;
+    pendingRequest* pendReq = self->pendReq;
+
+    assert(processorNum < self->processorCount);
 
     // "simpleCache" does not support invalidations.
     if (type != DATA_RECV)
         return;
+    assert(pendReq != NULL);
 
     if (pendReq->processorNum == processorNum && pendReq->addr == addr)
     {
         pendingRequest* pr = pendReq;
-        pendReq = pendReq->next;
+        self->pendReq = pendReq->next;
 
-        pr->next = readyReq;
-        readyReq = pr;
+        pr->next = self->readyReq;
+        self->readyReq = pr;
     }
     else
     {
@@ -117,15 +143,15 @@ void coherCallback(int type, int processorNum, int64_t addr)
             {
                 prevReq->next = pr->next;
 
-                pr->next = readyReq;
-                readyReq = pr;
+                pr->next = self->readyReq;
+                self->readyReq = pr;
                 break;
             }
             pr = pr->next;
             prevReq = prevReq->next;
         }
 
-        if (pr == NULL && CADSS_VERBOSE == 1)
+        if (pr == NULL && self->verbose == 1)
         {
             pr = pendReq;
             while (pr != NULL)
@@ -138,61 +164,192 @@ void coherCallback(int type, int processorNum, int64_t addr)
     }
 }
 
-void memoryRequest(trace_op* op, int processorNum, int64_t tag,
-                   void (*callback)(int, int64_t))
+static void memoryRequest(cache* c, trace_op* op, int processorNum,
+                          int64_t tag, void* ctx, memCallbackFunc callback)
 {
+    cache_ctx* self = (cache_ctx*)c;
+    coher* coherComp = self->coherComp;
+
     assert(op != NULL);
     assert(callback != NULL);
 
     // As a simplifying assumption, requests do not cross cache lines
-    uint64_t addr = (op->memAddress & ~(blockSize - 1));
-    uint8_t perm
-        = coherComp->permReq((op->op == MEM_LOAD), addr, processorNum);
+    uint64_t addr = (op->memAddress & ~(self->blockSize - 1));
+    eventsReport(self->env, REQ_PERM, processorNum, addr, tag);
+    uint8_t perm = coherComp->permReq(coherComp, (op->op == MEM_LOAD), addr,
+                                      processorNum);
+
+    // Only permissions are kept, so a hit is a request that has them.
+    eventsReport(self->env, (perm == 1) ? REQ_HIT : REQ_MISS, processorNum,
+                 addr, tag);
+    if (perm != 1)
+        CADSS_PROBE2(cache_miss, processorNum, addr);
 
     pendingRequest* pr = malloc(sizeof(pendingRequest));
     pr->tag = tag;
     pr->addr = addr;
+    pr->ctx = ctx;
     pr->callback = callback;
     pr->processorNum = processorNum;
 
     if (perm == 1)
     {
         // create callback for next tick
-        pr->next = readyReq;
-        readyReq = pr;
+        pr->next = self->readyReq;
+        self->readyReq = pr;
     }
     else
     {
         // create pending callback
-        pr->next = pendReq;
-        pendReq = pr;
+        pr->next = self->pendReq;
+        self->pendReq = pr;
     }
 }
 
-int tick()
+// Only the coherence state is kept, so that is all there is to warm.
+static void warmRequest(cache* c, trace_op* op, int processorNum)
 {
-    coherComp->si.tick();
+    cache_ctx* self = (cache_ctx*)c;
+    coher* coherComp = self->coherComp;
+
+    if (coherComp->warmReq == NULL)
+        return;
+
+    uint64_t addr = (op->memAddress & ~(self->blockSize - 1));
+    coherComp->warmReq(coherComp, (op->op == MEM_LOAD), addr, processorNum);
+}
 
-    pendingRequest* pr = readyReq;
+static int tick(void* c)
+{
+    cache_ctx* self = (cache_ctx*)c;
+
+    self->coherComp->si.tick(self->coherComp);
+
+    pendingRequest* pr = self->readyReq;
     while (pr != NULL)
     {
         pendingRequest* t = pr;
-        pr->callback(pr->processorNum, pr->tag);
+        pr->callback(pr->ctx, pr->processorNum, pr->tag);
         pr = pr->next;
         free(t);
     }
-    readyReq = NULL;
+    self->readyReq = NULL;
 
     return 1;
 }
 
-int finish(int outFd)
+static int64_t idleTicks(void* c)
 {
+    cache_ctx* self = (cache_ctx*)c;
+
+    // Completed requests are delivered on the next tick.
+    return (self->readyReq != NULL) ? 0 : SIM_IDLE_FOREVER;
+}
+
+static void skipTicks(void* c, int64_t ticks) {}
+
+// A request in flight, without its callback into the processor.
+typedef struct _saved_request {
+    int64_t tag;
+    int64_t addr;
+    int32_t processorNum;
+} saved_request;
+
+static void saveRequests(pendingRequest* list, FILE* f)
+{
+    int32_t count = 0;
+    for (pendingRequest* pr = list; pr != NULL; pr = pr->next)
+        count++;
+    fwrite(&count, sizeof(count), 1, f);
+
+    for (pendingRequest* pr = list; pr != NULL; pr = pr->next)
+    {
+        saved_request sr = {pr->tag, pr->addr, pr->processorNum};
+        fwrite(&sr, sizeof(sr), 1, f);
+    }
+}
+
+// Read back a list in its saved order, bound to the requestor.
+static int restoreRequests(cache_ctx* self, pendingRequest** list, FILE* f)
+{
+    int32_t count;
+    if (fread(&count, sizeof(count), 1, f) != 1)
+        return -1;
+
+    pendingRequest** tail = list;
+    for (int32_t i = 0; i < count; i++)
+    {
+        saved_request sr;
+        if (fread(&sr, sizeof(sr), 1, f) != 1)
+            return -1;
+
+        pendingRequest* pr = malloc(sizeof(pendingRequest));
+        pr->tag = sr.tag;
+        pr->addr = sr.addr;
+        pr->processorNum = sr.processorNum;
+        pr->ctx = self->requestorCtx;
+        pr->callback = self->requestorCallback;
+        pr->next = NULL;
+        *tail = pr;
+        tail = &pr->next;
+    }
+
     return 0;
 }
 
-int destroy(void)
+// The simple cache keeps no lines, only its requests in flight.
+static int save(void* c, FILE* f)
 {
-    // free any internally allocated memory here
+    cache_ctx* self = (cache_ctx*)c;
+
+    saveRequests(self->readyReq, f);
+    saveRequests(self->pendReq, f);
+
+    return ferror(f) ? -1 : 0;
+}
+
+static int restore(void* c, FILE* f)
+{
+    cache_ctx* self = (cache_ctx*)c;
+
+    if (restoreRequests(self, &self->readyReq, f) != 0
+        || restoreRequests(self, &self->pendReq, f) != 0)
+        return -1;
+
     return 0;
 }
+
+// The processor restores after the cache, so rebind what restore read back.
+static void restoreRequestor(cache* c, void* ctx, memCallbackFunc callback)
+{
+    cache_ctx* self = (cache_ctx*)c;
+
+    self->requestorCtx = ctx;
+    self->requestorCallback = callback;
+    for (pendingRequest* pr = self->readyReq; pr != NULL; pr = pr->next)
+    {
+        pr->ctx = ctx;
+        pr->callback = callback;
+    }
+    for (pendingRequest* pr = self->pendReq; pr != NULL; pr = pr->next)
+    {
+        pr->ctx = ctx;
+        pr->callback = callback;
+    }
+}
+
+static int finish(void* c, int outFd)
+{
+    return 0;
+}
+
+static int destroy(void* c)
+{
+    cache_ctx* self = (cache_ctx*)c;
+    coher* coherComp = self->coherComp;
+
+    // free any internally allocated memory here
+    free(self);
+
+    return coherComp->si.destroy(coherComp);
+}
@@ -8,12 +8,18 @@ contech::TaskGraph* tg = NULL;
 
 int contextCount = 1;
 
+// Tasks read by every context, for the progress through the graph.
+unsigned int tasksRead = 0;
+
 struct taskTrack {
   bool isComplete;
   contech::TaskId tid;
   contech::Task* t;  
   contech::Task::memOpCollection moc;
   contech::Task::memOpCollection::iterator mit, met;
+  
+  // Actions up to the last op returned, for its basic blocks.
+  std::vector<contech::Action>::iterator scan, bbFirst, bbLast;
 };
 
 taskTrack* currentTasks;
@@ -63,6 +69,7 @@ void updateContext(int processorNum)
         currentTasks[processorNum].isComplete = true;
         return;
     }
+    tasksRead++;
     
     if (t->getType() != contech::task_type_basic_blocks)
     {
@@ -82,6 +89,9 @@ void updateContext(int processorNum)
     currentTasks[processorNum].moc = t->getMemOps();
     currentTasks[processorNum].mit = currentTasks[processorNum].moc.begin();
     currentTasks[processorNum].met = currentTasks[processorNum].moc.end();
+    currentTasks[processorNum].scan = t->getActions().begin();
+    currentTasks[processorNum].bbFirst = currentTasks[processorNum].scan;
+    currentTasks[processorNum].bbLast = currentTasks[processorNum].scan;
 }
 
 trace_op* getNextOp(int processorNum)
@@ -111,6 +121,13 @@ trace_op* getNextOp(int processorNum)
         }
         
         contech::MemoryAction ma = *currentTasks[processorNum].mit;
+        
+        // The blocks of this op are the ones since the previous op.
+        auto cur = currentTasks[processorNum].mit.operator->();
+        currentTasks[processorNum].bbFirst = currentTasks[processorNum].scan;
+        currentTasks[processorNum].bbLast = cur + 1;
+        currentTasks[processorNum].scan = cur + 1;
+        
         currentTasks[processorNum].mit++;
         
         trace_op* op = (trace_op*) calloc(1, sizeof(trace_op));
@@ -124,4 +141,32 @@ trace_op* getNextOp(int processorNum)
         
         return op;
     }
-}
\ No newline at end of file
+}
+
+void getBasicBlocks(int processorNum, trace_bb_visit visit, void* ctx)
+{
+    assert(processorNum >= 0 && processorNum < contextCount);
+    
+    if (currentTasks[processorNum].isComplete == true) return;
+    if (currentTasks[processorNum].t == NULL) return;
+    
+    contech::TaskGraphInfo* tgi = tg->getTaskGraphInfo();
+    for (auto it = currentTasks[processorNum].bbFirst; it != currentTasks[processorNum].bbLast; ++it)
+    {
+        if (!it->isBasicBlockAction()) continue;
+        
+        contech::BasicBlockAction bba = *it;
+        uint ops = tgi->getBasicBlockInfo(bba.basic_block_id).numOfOps;
+        
+        // Blocks without info still count as executed.
+        visit(ctx, bba.basic_block_id, (ops > 0) ? ops : 1);
+    }
+}
+
+double getProgress()
+{
+    unsigned int total = tg->getNumberOfTasks();
+    if (total == 0) return -1;
+    
+    return (double)tasksRead / total;
+}
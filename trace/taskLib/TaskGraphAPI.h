@@ -10,6 +10,8 @@ extern "C" {
 
 int8_t initTaskGraph(FILE*);
 trace_op* getNextOp(int processorNum);
+void getBasicBlocks(int processorNum, trace_bb_visit visit, void* ctx);
+double getProgress();
 
 #ifdef __cplusplus
 }
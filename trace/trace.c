@@ -1,6 +1,5 @@
 #include "trace.h"
 #include "trace_internal.h"
-#include "taskLib/TaskGraphAPI.h"
 
 #include <stdio.h>
 #include <getopt.h>
@@ -11,38 +10,81 @@
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <fcntl.h>
+#include <unistd.h>
 
 #include <dlfcn.h>
 
-trace_op* getNextOp(int);
-
-int processorCount = 1;
+// State of one trace reader instance.
+typedef struct _trace_ctx {
+    trace_reader pub; // Must be first, the instance is passed as a trace_reader*.
+    int processorCount;
+    
+    FILE** traceFile;
+    int masterFD;
+    
+    int8_t isTaskGraph;
+    trace_op* (*gno)(int processorNum);
+    void (*gbb)(int processorNum, trace_bb_visit visit, void* ctx);
+    double (*gpr)(void);
+    
+    // Address of the block being read and of the block of the last op,
+    //   for each processor.  A block starts at the target of a branch.
+    uint64_t* blockAddr;
+    uint64_t* opBlock;
+    
+    // In rate mode, the trace is decoded once into rateOps and every
+    //   processor reads it from its own position, with its data addresses
+    //   moved by rateStride times its number.
+    int8_t isRate;
+    trace_op* rateOps;
+    int64_t rateOpCount;
+    int64_t* ratePos;
+    uint64_t rateStride;
+    
+    uint64_t opCount;
+} trace_ctx;
 
-FILE** traceFile = NULL;
-int masterFD = 0;
+const int CADSS_ABI = CADSS_ABI_VERSION;
 
-int8_t isTaskGraph = 0;
-trace_op* (*gno)(int processorNum) = NULL;
+static trace_op* getNextOp(trace_reader* r, int processorNum);
+static int tick(void* r);
+static int finish(void* r, int outFd);
+static int destroy(void* r);
+static int save(void* r, FILE* f);
+static int restore(void* r, FILE* f);
+static void basicBlocks(trace_reader* r, int processorNum,
+                        trace_bb_visit visit, void* ctx);
+static double consumed(trace_reader* r);
+static int readOp(FILE* tf, trace_op* op, uint64_t opCount);
+static int decodeRate(trace_ctx* self);
 
 trace_reader* init(trace_sim_args* tsa)
 {
     char* trace = NULL;
-    trace_reader* tr = malloc(sizeof(trace_reader));
-    if (tr == NULL) return NULL;
-    tr->getNextOp = getNextOp;
+    char* rate = NULL;
+    trace_ctx* self = calloc(1, sizeof(trace_ctx));
+    if (self == NULL) return NULL;
+    self->pub.getNextOp = getNextOp;
+    self->processorCount = tsa->env->processorCount;
     
     int op = 0;
-    while ((op = getopt(tsa->arg_count, tsa->arg_list, "hdvc:p:o:n:i:b:t:s:m:")) != -1)
+    while ((op = getopt(tsa->arg_count, tsa->arg_list, "hdvc:p:o:n:i:b:t:s:m:R:")) != -1)
     {
         switch (op)
         {
             case 't':
                 trace = optarg;
                 break;
+            case 'R':
+                rate = optarg;
+                break;
         }
     }
     
-    traceFile = calloc(processorCount, sizeof(FILE*));
+    FILE** traceFile = calloc(self->processorCount, sizeof(FILE*));
+    self->traceFile = traceFile;
+    self->blockAddr = calloc(self->processorCount, sizeof(uint64_t));
+    self->opBlock = calloc(self->processorCount, sizeof(uint64_t));
     
     if (trace == NULL)
     {
@@ -51,15 +93,18 @@ trace_reader* init(trace_sim_args* tsa)
     }
     else
     {
-        masterFD = open(trace, O_DIRECTORY);
-        if (masterFD == -1)
+        self->masterFD = open(trace, O_DIRECTORY);
+        if (self->masterFD == -1)
         {
             traceFile[0] = fopen(trace, "rb");
             if (traceFile[0] == NULL)
             {
                 perror("Attempt to open trace file");
                 fprintf(stderr, "Failed on trace file name - %s\n", optarg);
-                free(tr);
+                free(traceFile);
+                free(self->blockAddr);
+                free(self->opBlock);
+                free(self);
                 return NULL;
             }
             
@@ -74,62 +119,80 @@ trace_reader* init(trace_sim_args* tsa)
                 int8_t (*itg)(FILE*) = dlsym(handle, "initTaskGraph");
                 if (itg != NULL)
                 {
-                    isTaskGraph = itg(traceFile[0]);
+                    self->isTaskGraph = itg(traceFile[0]);
                 }
                 else
                 {
                     
                 }
                 
-                gno = dlsym(handle, "getNextOp");
+                self->gno = dlsym(handle, "getNextOp");
+                self->gbb = dlsym(handle, "getBasicBlocks");
+                self->gpr = dlsym(handle, "getProgress");
             }
         }
         
         // openat()
     }
     
-    tr->si.tick = tick;
-    tr->si.finish = finish;
-    tr->si.destroy = destroy;
-    
-    return tr;
-}
-
-uint64_t opCount = 0;
-trace_op* getNextOp(int processorNum)
-{
-    trace_op* op = calloc(1, sizeof(trace_op));
-    FILE* tf = NULL;
-    
-    if (isTaskGraph == 1)
-    {
-        return gno(processorNum);
-    }
-    
-    if (traceFile[processorNum] == NULL)
+    if (rate != NULL)
     {
-        char fileName[16];
-        snprintf(fileName, 16, "p%d.trace", processorNum);
+        self->isRate = 1;
+        self->rateStride = strtoull(rate, NULL, 0);
         
-        int tempFD = openat(masterFD, fileName, O_RDONLY);
-        if (tempFD == -1)
+        // Each processor of a directory already has its own trace.
+        if ((trace != NULL && self->masterFD != -1) || self->isTaskGraph == 1)
         {
-            perror("Error opening processor specific trace - ");
-            
+            fprintf(stderr, "Rate mode needs a single text trace\n");
+            destroy(self);
             return NULL;
         }
-        
-        traceFile[processorNum] = fdopen(tempFD, "r");
-        if (traceFile[processorNum] == NULL)
+        if (decodeRate(self) != 0)
         {
-            perror("Error converting FD for processor specific trace - ");
-            
+            destroy(self);
             return NULL;
         }
     }
     
-    tf = traceFile[processorNum];
+    self->pub.si.tick = tick;
+    self->pub.si.finish = finish;
+    self->pub.si.destroy = destroy;
+    self->pub.si.save = save;
+    self->pub.si.restore = restore;
+    self->pub.basicBlocks = basicBlocks;
+    self->pub.consumed = consumed;
+    
+    return &self->pub;
+}
+
+// Opens the trace of one processor from the trace directory.
+static int openProcessorTrace(trace_ctx* self, int processorNum)
+{
+    char fileName[32];
+    snprintf(fileName, sizeof(fileName), "p%d.trace", processorNum);
     
+    int tempFD = openat(self->masterFD, fileName, O_RDONLY);
+    if (tempFD == -1)
+    {
+        perror("Error opening processor specific trace - ");
+        return -1;
+    }
+    
+    FILE* tf = fdopen(tempFD, "r");
+    if (tf == NULL)
+    {
+        perror("Error converting FD for processor specific trace - ");
+        close(tempFD);
+        return -1;
+    }
+    
+    self->traceFile[processorNum] = tf;
+    return 0;
+}
+
+// Reads the next op of tf into op, 0 on success or -1 at the end.
+static int readOp(FILE* tf, trace_op* op, uint64_t opCount)
+{
     // TODO - Support for other basic formats
     char opType = 0;
     uint64_t memAddress, pcAddress, nextPC;
@@ -137,14 +200,12 @@ trace_op* getNextOp(int processorNum)
     int32_t op0, op1, op2;
     if (0 == fscanf(tf, "%c", &opType))
     {
-        free(op);
-        return NULL;
+        return -1;
     }
     
     if (opType == '\0' || isspace(opType))
     {
-        free(op);
-        return NULL;
+        return -1;
     }
     
     switch (opType)
@@ -218,30 +279,260 @@ trace_op* getNextOp(int processorNum)
             break;
         default:
             fprintf(stderr, "Invalid op type: %x on %ld\n", opType, opCount);
+            return -1;
+    }
+    
+    return 0;
+}
+
+// Decodes the whole trace for rate mode, so that its parsing and memory do
+//   not grow with the number of processors.
+static int decodeRate(trace_ctx* self)
+{
+    int64_t size = 0;
+    
+    while (1)
+    {
+        if (self->rateOpCount == size)
+        {
+            size = (size == 0) ? 4096 : size * 2;
+            trace_op* ops = realloc(self->rateOps, size * sizeof(trace_op));
+            if (ops == NULL)
+            {
+                fprintf(stderr, "Out of memory for the rate mode trace\n");
+                return -1;
+            }
+            self->rateOps = ops;
+        }
+        
+        trace_op* op = &self->rateOps[self->rateOpCount];
+        memset(op, 0, sizeof(trace_op));
+        if (readOp(self->traceFile[0], op, self->rateOpCount) != 0)
+        {
+            break;
+        }
+        self->rateOpCount++;
+    }
+    
+    self->ratePos = calloc(self->processorCount, sizeof(int64_t));
+    return (self->ratePos == NULL) ? -1 : 0;
+}
+
+static trace_op* getNextOp(trace_reader* r, int processorNum)
+{
+    trace_ctx* self = (trace_ctx*)r;
+    FILE** traceFile = self->traceFile;
+    trace_op* op = NULL;
+    
+    if (self->isTaskGraph == 1)
+    {
+        return self->gno(processorNum);
+    }
+    
+    if (self->isRate)
+    {
+        if (self->ratePos[processorNum] == self->rateOpCount)
+        {
+            return NULL;
+        }
+        
+        op = malloc(sizeof(trace_op));
+        *op = self->rateOps[self->ratePos[processorNum]++];
+        if (op->op == MEM_LOAD || op->op == MEM_STORE)
+        {
+            op->memAddress += processorNum * self->rateStride;
+        }
+    }
+    else
+    {
+        if (traceFile[processorNum] == NULL
+            && openProcessorTrace(self, processorNum) != 0)
+        {
+            return NULL;
+        }
+        
+        op = calloc(1, sizeof(trace_op));
+        if (readOp(traceFile[processorNum], op, self->opCount) != 0)
+        {
             free(op);
             return NULL;
+        }
     }
     
-    opCount++;
+    self->opBlock[processorNum] = self->blockAddr[processorNum];
+    if (op->op == BRANCH)
+    {
+        self->blockAddr[processorNum] = op->nextPCAddress;
+    }
+    
+    self->opCount++;
     return op;
 }
 
-int tick(void)
+// Each op of a text trace is one instruction of the current block.
+static void basicBlocks(trace_reader* r, int processorNum,
+                        trace_bb_visit visit, void* ctx)
+{
+    trace_ctx* self = (trace_ctx*)r;
+    
+    if (self->isTaskGraph == 1)
+    {
+        if (self->gbb != NULL)
+            self->gbb(processorNum, visit, ctx);
+        return;
+    }
+    
+    visit(ctx, self->opBlock[processorNum], 1);
+}
+
+// Bytes read of every processor's trace, or tasks read of a taskgraph.
+static double consumed(trace_reader* r)
+{
+    trace_ctx* self = (trace_ctx*)r;
+    
+    if (self->isTaskGraph == 1)
+    {
+        return (self->gpr != NULL) ? self->gpr() : -1;
+    }
+    if (self->isRate)
+    {
+        int64_t done = 0;
+        for (int i = 0; i < self->processorCount; i++)
+        {
+            done += self->ratePos[i];
+        }
+        return (self->rateOpCount > 0)
+               ? (double)done / (self->rateOpCount * self->processorCount)
+               : -1;
+    }
+    if (self->traceFile[0] == stdin)
+    {
+        return -1;
+    }
+    
+    // A single file is only read by processor 0.
+    int fileCount = (self->masterFD == -1) ? 1 : self->processorCount;
+    off_t done = 0;
+    off_t size = 0;
+    for (int i = 0; i < fileCount; i++)
+    {
+        FILE* tf = self->traceFile[i];
+        struct stat st;
+        
+        if (tf != NULL)
+        {
+            if (fstat(fileno(tf), &st) != 0) return -1;
+            done += ftello(tf);
+        }
+        else
+        {
+            char fileName[32];
+            snprintf(fileName, sizeof(fileName), "p%d.trace", i);
+            if (fstatat(self->masterFD, fileName, &st, 0) != 0) continue;
+        }
+        size += st.st_size;
+    }
+    
+    return (size > 0) ? (double)done / size : -1;
+}
+
+static int tick(void* r)
 {
     return 1;    
 }
 
-int finish(int outFd)
+static int finish(void* r, int outFd)
 {
     return 0;    
 }
 
-int destroy(void)
+// The position in each processor's trace, -1 if it was not opened yet, or
+//   its op in rate mode, and the block being read there.  The checkpoint is only valid with the
+//   same trace files.
+static int save(void* r, FILE* f)
+{
+    trace_ctx* self = (trace_ctx*)r;
+    
+    if (self->isTaskGraph == 1)
+    {
+        fprintf(stderr, "Taskgraph traces cannot be checkpointed\n");
+        return -1;
+    }
+    
+    fwrite(&self->opCount, sizeof(self->opCount), 1, f);
+    for (int i = 0; i < self->processorCount; i++)
+    {
+        int64_t offset = -1;
+        if (self->isRate)
+        {
+            offset = self->ratePos[i];
+        }
+        else if (self->traceFile[i] != NULL)
+        {
+            offset = ftell(self->traceFile[i]);
+            if (offset == -1)
+            {
+                perror("Attempt to find trace position");
+                return -1;
+            }
+        }
+        fwrite(&offset, sizeof(offset), 1, f);
+        fwrite(&self->blockAddr[i], sizeof(uint64_t), 1, f);
+    }
+    
+    return ferror(f) ? -1 : 0;
+}
+
+static int restore(void* r, FILE* f)
+{
+    trace_ctx* self = (trace_ctx*)r;
+    
+    if (fread(&self->opCount, sizeof(self->opCount), 1, f) != 1)
+        return -1;
+    
+    for (int i = 0; i < self->processorCount; i++)
+    {
+        int64_t offset;
+        if (fread(&offset, sizeof(offset), 1, f) != 1
+            || fread(&self->blockAddr[i], sizeof(uint64_t), 1, f) != 1)
+            return -1;
+        if (offset == -1)
+            continue;
+        
+        if (self->isRate)
+        {
+            if (offset > self->rateOpCount)
+                return -1;
+            self->ratePos[i] = offset;
+            continue;
+        }
+        
+        if (self->traceFile[i] == NULL && openProcessorTrace(self, i) != 0)
+            return -1;
+        if (fseek(self->traceFile[i], offset, SEEK_SET) != 0)
+        {
+            perror("Attempt to seek in trace");
+            return -1;
+        }
+    }
+    
+    return 0;
+}
+
+static int destroy(void* r)
 {
+    trace_ctx* self = (trace_ctx*)r;
     int i;
-    for (i = 0; i < processorCount; i++)
+    for (i = 0; i < self->processorCount; i++)
     {
-        if (traceFile[i] != NULL) fclose(traceFile[i]);
+        if (self->traceFile[i] != NULL) fclose(self->traceFile[i]);
     }
+    if (self->masterFD > 0) close(self->masterFD);
+    free(self->traceFile);
+    free(self->blockAddr);
+    free(self->opBlock);
+    free(self->rateOps);
+    free(self->ratePos);
+    free(self);
     return 0;
 }